@@ -2,6 +2,7 @@
 #define BENCHMARK
 
 #include <concurrency/ShardedUnorderedMap.hpp>
+#include <concurrency/StripedUnorderedMap.hpp>
 #include <atomic>
 #include <chrono>
 #include <sstream>
@@ -14,11 +15,35 @@ constexpr uint64_t default_benchmark_iterations = 1'000'000;
 template <typename>
 struct is_sharded : std::false_type {};
 
-template <typename Key, typename Val>
-struct is_sharded<::concurrency::ShardedUnorderedMap<Key, Val>> : std::true_type {};
+template <typename Key, typename Val, uint32_t ShardCount, typename Hash, typename Pred, typename Allocator, template <class...> class InternalMap>
+struct is_sharded<::concurrency::ShardedUnorderedMap<Key, Val, ShardCount, Hash, Pred, Allocator, InternalMap>> : std::true_type {};
 
-template <typename Key, typename Val, uint32_t ShardCount>
-struct is_sharded<::concurrency::ShardedUnorderedMap<Key, Val, ShardCount>> : std::true_type {};
+template <typename>
+struct is_flat : std::false_type {};
+
+template <typename Key, typename Val, typename Hash, typename Pred, typename Allocator>
+struct is_flat<::concurrency::UnorderedMap<Key, Val, Hash, Pred, Allocator, ::concurrency::FlatHashMap>> : std::true_type {};
+
+template <typename Key, typename Val, uint32_t ShardCount, typename Hash, typename Pred, typename Allocator>
+struct is_flat<::concurrency::ShardedUnorderedMap<Key, Val, ShardCount, Hash, Pred, Allocator, ::concurrency::FlatHashMap>> : std::true_type {};
+
+template <typename>
+struct is_striped : std::false_type {};
+
+template <typename Key, typename Val, typename Hash, typename Pred, typename Allocator, std::size_t StripeCount>
+struct is_striped<::concurrency::StripedUnorderedMap<Key, Val, Hash, Pred, Allocator, StripeCount>> : std::true_type {};
+
+// Returns the name reported in the map_type column of the benchmark results.
+template <typename map_type>
+const char *map_type_name() {
+  if constexpr (is_striped<map_type>::value) {
+    return "Striped";
+  } else if constexpr (is_sharded<map_type>::value) {
+    return is_flat<map_type>::value ? "ShardedFlat" : "Sharded";
+  } else {
+    return is_flat<map_type>::value ? "UnshardedFlat" : "Unsharded";
+  }
+}
 
 template <typename T>
 struct TypeParseTraits;
@@ -49,11 +74,10 @@ struct TypeParseTraits;
     }                                                                                                                     \
     ::Benchmark::Result r;                                                                                                \
     r.operation = #bname;                                                                                                 \
+    r.map_type = map_type_name<map_type>();                                                                               \
     if constexpr (is_sharded<map_type>::value) {                                                                          \
-      r.map_type    = "Sharded";                                                                                          \
       r.shard_count = std::to_string(test_map.shard_count());                                                             \
     } else {                                                                                                              \
-      r.map_type    = "Unsharded";                                                                                        \
       r.shard_count = "N/A";                                                                                              \
     }                                                                                                                     \
     r.key_type              = TypeParseTraits<typename map_type::key_type>::name;                                         \
@@ -1,13 +1,37 @@
 #include <Benchmark.h>
+#include <concurrency/BufferedWriter.hpp>
+#include <concurrency/CounterMap.hpp>
+#include <concurrency/Epoch.hpp>
+#include <concurrency/InMemoryStore.hpp>
+#include <concurrency/OrderedMap.hpp>
 #include <concurrency/ShardedUnorderedMap.hpp>
+#include <concurrency/ShardedUnorderedMultimap.hpp>
+#include <concurrency/ShardedUnorderedSet.hpp>
+#include <concurrency/StripedUnorderedMap.hpp>
 #include <concurrency/UnorderedMap.hpp>
+#include <concurrency/WriteBehindCache.hpp>
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <iostream>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
+using ::concurrency::BufferedWriter;
+using ::concurrency::CounterMap;
+using ::concurrency::Epoch;
+using ::concurrency::InMemoryStore;
+using ::concurrency::OrderedMap;
 using ::concurrency::ShardedUnorderedMap;
+using ::concurrency::ShardedUnorderedMultimap;
+using ::concurrency::ShardedUnorderedSet;
+using ::concurrency::StripedUnorderedMap;
 using ::concurrency::UnorderedMap;
+using ::concurrency::WriteBehindCache;
 
 template <typename map_type>
 void teardown_test_map(map_type &m) {
@@ -51,6 +75,22 @@ void setup_test_map(map_type &m) {
   }
 }
 
+template <typename map_type>
+void setup_bloom_filter_test_map(map_type &m) {
+  m.enable_bloom_filter(setup_test_map_size);
+  setup_test_map(m);
+}
+
+// Looks up one key that setup_test_map() never inserts for every key that it does. Shared by
+// the find_not_existing benchmarks, which differ only in whether the Bloom filter is enabled.
+template <typename map_type>
+void find_not_existing(map_type &m) {
+  for (auto const &[key, val]: get_map_init_values<map_type>()) {
+    (void) val;
+    m.find(key + static_cast<int>(setup_test_map_size) + 1);
+  }
+}
+
 REGISTER_PARSE_TYPE(int);
 
 REGISTER_BENCHMARK(default_constructor, 1, [&test_map]() { test_map = typename std::remove_reference<decltype(test_map)>::type(); })
@@ -150,6 +190,8 @@ REGISTER_BENCHMARK(find, setup_test_map_size, [&test_map]() {
     test_map.find(key);
   }
 })
+REGISTER_BENCHMARK(find_not_existing, setup_test_map_size, [&test_map]() { find_not_existing(test_map); })
+REGISTER_BENCHMARK(find_not_existing_bloom_filter, setup_test_map_size, [&test_map]() { find_not_existing(test_map); })
 REGISTER_BENCHMARK(data, 1, [&test_map]() { (void) test_map.data(); })
 REGISTER_BENCHMARK(load_factor, 1, [&test_map]() { (void) test_map.load_factor(); })
 REGISTER_BENCHMARK(get_max_load_factor, 1, [&test_map]() { (void) test_map.max_load_factor(); })
@@ -157,9 +199,427 @@ REGISTER_BENCHMARK(set_max_load_factor, 1, [&test_map]() { test_map.max_load_fac
 REGISTER_BENCHMARK(rehash, 1, [&test_map]() { test_map.rehash(setup_test_map_size * 2); })
 REGISTER_BENCHMARK(reserve, 1, [&test_map]() { test_map.reserve(setup_test_map_size * 2); })
 
-int main() {
+// Scrambles i so that consecutive indices produce unrelated keys. Without this, std::hash<int>
+// being the identity function lets std::unordered_map lay sequential keys out contiguously,
+// which hides the pointer chasing this benchmark is meant to expose.
+int scattered_key(uint64_t const i) { return static_cast<int>(static_cast<uint32_t>(i) * 2654435761u); }
+
+// Times find() on a map holding the given number of entries, visiting keys in a scattered
+// order so that larger maps cannot be served from the CPU caches. Used to compare the
+// std::unordered_map and ::concurrency::FlatHashMap shard backends as the map grows.
+template <typename map_type>
+::Benchmark::Result bench_find_at_scale(uint64_t const entries, std::string const &label) {
+  map_type test_map;
+  if constexpr (is_sharded<map_type>::value) {
+    test_map.reserve(entries / test_map.shard_count());
+  } else {
+    test_map.reserve(entries);
+  }
+  for (uint64_t i = 0; i < entries; ++i) {
+    test_map.insert({scattered_key(i), static_cast<int>(i)});
+  }
+
+  ::Benchmark::Result r;
+  r.operation        = "find_" + label + "_entries";
+  r.map_type         = map_type_name<map_type>();
+  r.shard_count      = "N/A";
+  r.key_type         = TypeParseTraits<typename map_type::key_type>::name;
+  r.val_type         = TypeParseTraits<typename map_type::mapped_type>::name;
+  r.total_operations = default_benchmark_iterations;
+  if constexpr (is_sharded<map_type>::value) {
+    r.shard_count = std::to_string(test_map.shard_count());
+  }
+  r.total_elapsed_ms = ::Benchmark::bench([&test_map, entries]() {
+    static thread_local uint64_t next  = 0;
+    static thread_local uint64_t found = 0; // Consumes the result so the lookup cannot be optimized away.
+    next                               = (next + 0x9E3779B1) % entries;
+    found += test_map.find(scattered_key(next));
+  });
+  r.avg_operations_per_ms = default_benchmark_iterations / static_cast<double>(std::max<int64_t>(1, r.total_elapsed_ms.count()));
+  return r;
+}
+
+template <typename map_type>
+void bench_find_at_scales(std::vector<::Benchmark::Result> &results, bool const include_large) {
+  results.push_back(bench_find_at_scale<map_type>(1'000, "1K"));
+  results.push_back(bench_find_at_scale<map_type>(1'000'000, "1M"));
+  if (include_large) {
+    results.push_back(bench_find_at_scale<map_type>(100'000'000, "100M"));
+  }
+}
+
+// Returns count keys drawn from [0, key_space) with Zipfian skew (exponent 0.99), so that a
+// handful of hot keys receive most of the operations.
+std::vector<int> zipfian_keys(uint64_t const count, int const key_space) {
+  std::vector<int> keys;
+  std::vector<double> cdf(key_space);
+  double total = 0;
+  for (int k = 0; k < key_space; ++k) {
+    total += 1.0 / std::pow(k + 1, 0.99);
+    cdf[k] = total;
+  }
+  std::mt19937_64 rng(42);
+  std::uniform_real_distribution<double> uniform(0, total);
+  keys.reserve(count);
+  for (uint64_t i = 0; i < count; ++i) {
+    keys.push_back(static_cast<int>(std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin()));
+  }
+  return keys;
+}
+
+// Times insert_or_assign() under a skewed write load on a single map, with and without flat
+// combining of the writes.
+template <typename map_type>
+::Benchmark::Result bench_zipfian_writes(bool const flat_combining) {
+  map_type test_map;
+  if (flat_combining) test_map.enable_flat_combining();
+  auto const keys = zipfian_keys(default_benchmark_iterations, static_cast<int>(setup_test_map_size));
+
+  ::Benchmark::Result r;
+  r.operation        = flat_combining ? "insert_or_assign_zipfian_flat_combining" : "insert_or_assign_zipfian";
+  r.map_type         = map_type_name<map_type>();
+  r.shard_count      = "N/A";
+  r.key_type         = TypeParseTraits<typename map_type::key_type>::name;
+  r.val_type         = TypeParseTraits<typename map_type::mapped_type>::name;
+  r.total_operations = default_benchmark_iterations;
+  if constexpr (is_sharded<map_type>::value) {
+    r.shard_count = std::to_string(test_map.shard_count());
+  }
+  std::atomic_uint64_t next = 0;
+  r.total_elapsed_ms        = ::Benchmark::bench([&test_map, &keys, &next]() {
+    auto const key = keys[next.fetch_add(1, std::memory_order_relaxed) % keys.size()];
+    test_map.insert_or_assign(key, key);
+  });
+  r.avg_operations_per_ms = default_benchmark_iterations / static_cast<double>(std::max<int64_t>(1, r.total_elapsed_ms.count()));
+  return r;
+}
+
+// Times counter-style upserts under a skewed write load, either applied directly or through a
+// per-thread BufferedWriter that coalesces them and flushes once per shard.
+template <typename map_type>
+::Benchmark::Result bench_zipfian_upserts(bool const buffered) {
+  map_type test_map;
+  auto const keys    = zipfian_keys(default_benchmark_iterations, static_cast<int>(setup_test_map_size));
+  auto const threads = std::max(1u, std::thread::hardware_concurrency());
+
+  ::Benchmark::Result r;
+  r.operation        = buffered ? "upsert_zipfian_buffered" : "upsert_zipfian";
+  r.map_type         = map_type_name<map_type>();
+  r.shard_count      = std::to_string(test_map.shard_count());
+  r.key_type         = TypeParseTraits<typename map_type::key_type>::name;
+  r.val_type         = TypeParseTraits<typename map_type::mapped_type>::name;
+  r.total_operations = default_benchmark_iterations;
+  auto const start   = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (uint32_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&test_map, &keys, buffered, t, threads]() {
+      auto const add = std::plus<typename map_type::mapped_type>();
+      if (buffered) {
+        BufferedWriter<map_type> writer(test_map);
+        for (auto i = t; i < keys.size(); i += threads) {
+          writer.upsert(keys[i], 1);
+        }
+      } else {
+        for (auto i = t; i < keys.size(); i += threads) {
+          test_map.upsert(keys[i], 1, add);
+        }
+      }
+    });
+  }
+  for (auto &w: workers) {
+    w.join();
+  }
+  r.total_elapsed_ms      = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  r.avg_operations_per_ms = default_benchmark_iterations / static_cast<double>(std::max<int64_t>(1, r.total_elapsed_ms.count()));
+  return r;
+}
+
+// Times writes to a cache in front of a store with a 20us round trip, either writing each
+// update through to the store or leaving them to WriteBehindCache to batch.
+::Benchmark::Result bench_store_writes(bool const write_behind) {
+  constexpr uint64_t iterations = 20'000;
+  using store_type              = InMemoryStore<int, int>;
+  using cache_type              = WriteBehindCache<int, int, store_type>;
+  store_type store(std::chrono::microseconds(20));
+  auto const keys = zipfian_keys(iterations, static_cast<int>(setup_test_map_size));
+
+  ::Benchmark::Result r;
+  r.operation        = write_behind ? "store_write_behind" : "store_write_through";
+  r.map_type         = "Sharded";
+  r.shard_count      = std::to_string(::concurrency::DefaultUnorderedMapShardCount);
+  r.key_type         = TypeParseTraits<int>::name;
+  r.val_type         = TypeParseTraits<int>::name;
+  r.total_operations = iterations;
+  std::atomic_uint64_t next = 0;
+  if (write_behind) {
+    cache_type cache(store);
+    r.total_elapsed_ms = ::Benchmark::bench(
+        [&cache, &keys, &next]() {
+          auto const key = keys[next.fetch_add(1, std::memory_order_relaxed) % keys.size()];
+          cache.put(key, key);
+        },
+        iterations);
+    auto const start = std::chrono::steady_clock::now();
+    cache.flush();
+    r.total_elapsed_ms += std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  } else {
+    ShardedUnorderedMap<int, int> cache;
+    r.total_elapsed_ms = ::Benchmark::bench(
+        [&cache, &store, &keys, &next]() {
+          auto const key = keys[next.fetch_add(1, std::memory_order_relaxed) % keys.size()];
+          cache.insert_or_assign(key, key);
+          store.write({{key, key}});
+        },
+        iterations);
+  }
+  r.avg_operations_per_ms = iterations / static_cast<double>(std::max<int64_t>(1, r.total_elapsed_ms.count()));
+  return r;
+}
+
+// Times deduplicating a stream of keys drawn from a large key space, either with a map to
+// dummy bools, with a set, or with a set fed batches of DedupeBatchSize keys through
+// insert_many().
+enum class DedupeMode { map_of_bool, set, set_insert_many };
+
+::Benchmark::Result bench_dedupe(DedupeMode const mode) {
+  constexpr uint64_t DedupeBatchSize = 256;
+  std::vector<int> keys(default_benchmark_iterations);
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> key_space(0, static_cast<int>(default_benchmark_iterations));
+  for (auto &key: keys) {
+    key = key_space(rng);
+  }
+
+  ::Benchmark::Result r;
+  r.operation        = mode == DedupeMode::map_of_bool ? "dedupe_map_of_bool" : mode == DedupeMode::set ? "dedupe_set" : "dedupe_set_insert_many";
+  r.map_type         = "Sharded";
+  r.shard_count      = std::to_string(::concurrency::DefaultUnorderedSetShardCount);
+  r.key_type         = TypeParseTraits<int>::name;
+  r.val_type         = mode == DedupeMode::map_of_bool ? "bool" : "N/A";
+  r.total_operations = default_benchmark_iterations;
+  std::atomic_uint64_t next = 0;
+  if (mode == DedupeMode::map_of_bool) {
+    ShardedUnorderedMap<int, bool> seen;
+    r.total_elapsed_ms = ::Benchmark::bench([&seen, &keys, &next]() { (void) seen.insert({keys[next.fetch_add(1, std::memory_order_relaxed) % keys.size()], true}); });
+  } else if (mode == DedupeMode::set) {
+    ShardedUnorderedSet<int> seen;
+    r.total_elapsed_ms = ::Benchmark::bench([&seen, &keys, &next]() { (void) seen.insert(keys[next.fetch_add(1, std::memory_order_relaxed) % keys.size()]); });
+  } else {
+    ShardedUnorderedSet<int> seen;
+    r.total_elapsed_ms = ::Benchmark::bench(
+        [&seen, &keys, &next]() {
+          auto const first = next.fetch_add(DedupeBatchSize, std::memory_order_relaxed) % keys.size();
+          auto const last  = std::min<uint64_t>(first + DedupeBatchSize, keys.size());
+          (void) seen.insert_many(keys.begin() + first, keys.begin() + last);
+        },
+        default_benchmark_iterations / DedupeBatchSize);
+  }
+  r.avg_operations_per_ms = default_benchmark_iterations / static_cast<double>(std::max<int64_t>(1, r.total_elapsed_ms.count()));
+  return r;
+}
+
+// Times a secondary index of tags to document ids, kept either as a map to vectors of ids or as
+// a multimap, by either reading every id of a tag or adding an id to a tag. A read copies the
+// tag's whole vector out of the map, and an add replaces it with a longer copy, whereas the
+// multimap visits ids in place and inserts one element per add.
+::Benchmark::Result bench_secondary_index(bool const multimap, bool const adds) {
+  constexpr int TagCount  = 1024;
+  constexpr int IdsPerTag = 64;
+
+  ::Benchmark::Result r;
+  r.operation        = std::string(adds ? "index_add" : "index_read") + (multimap ? "_multimap" : "_map_of_vector");
+  r.map_type         = "Sharded";
+  r.shard_count      = std::to_string(::concurrency::DefaultUnorderedMultimapShardCount);
+  r.key_type         = TypeParseTraits<int>::name;
+  r.val_type         = multimap ? TypeParseTraits<int>::name : "std::vector<int>";
+  r.total_operations = default_benchmark_iterations;
+  std::atomic_uint64_t next = 0;
+  std::atomic_uint64_t sink = 0;
+  if (multimap) {
+    ShardedUnorderedMultimap<int, int> index;
+    for (int tag = 0; tag < TagCount; ++tag) {
+      for (int id = 0; id < IdsPerTag; ++id) {
+        index.insert({tag, tag * IdsPerTag + id});
+      }
+    }
+    r.total_elapsed_ms = ::Benchmark::bench([&index, &next, &sink, adds]() {
+      auto const n = next.fetch_add(1, std::memory_order_relaxed);
+      if (adds) {
+        index.insert({static_cast<int>(n % TagCount), static_cast<int>(n)});
+        return;
+      }
+      uint64_t sum = 0;
+      (void) index.visit_all(static_cast<int>(n % TagCount), [&sum](const int &id) { sum += id; });
+      sink.fetch_add(sum, std::memory_order_relaxed);
+    });
+  } else {
+    ShardedUnorderedMap<int, std::vector<int>> index;
+    for (int tag = 0; tag < TagCount; ++tag) {
+      std::vector<int> ids;
+      for (int id = 0; id < IdsPerTag; ++id) {
+        ids.push_back(tag * IdsPerTag + id);
+      }
+      index.insert_or_assign(tag, std::move(ids));
+    }
+    auto const append = [](const std::vector<int> &ids, const std::vector<int> &added) {
+      auto result = ids;
+      result.insert(result.end(), added.begin(), added.end());
+      return result;
+    };
+    r.total_elapsed_ms = ::Benchmark::bench([&index, &next, &sink, &append, adds]() {
+      auto const n = next.fetch_add(1, std::memory_order_relaxed);
+      if (adds) {
+        (void) index.upsert(static_cast<int>(n % TagCount), std::vector<int>{static_cast<int>(n)}, append);
+        return;
+      }
+      uint64_t sum = 0;
+      for (auto id: index.at(static_cast<int>(n % TagCount))) {
+        sum += id;
+      }
+      sink.fetch_add(sum, std::memory_order_relaxed);
+    });
+  }
+  r.avg_operations_per_ms = default_benchmark_iterations / static_cast<double>(std::max<int64_t>(1, r.total_elapsed_ms.count()));
+  return r;
+}
+
+// Times queries for the elements whose keys fall in a window of RangeWidth keys, either by
+// copying a sharded map's data() and filtering it, as the unordered maps require, or with
+// OrderedMap::visit_range().
+::Benchmark::Result bench_range_scan(bool const ordered) {
+  constexpr int MapSize         = 10'000;
+  constexpr int RangeWidth      = 100;
+  constexpr uint64_t iterations = 2'000;
+
+  ::Benchmark::Result r;
+  r.operation        = ordered ? "range_scan_visit_range" : "range_scan_data_copy";
+  r.map_type         = ordered ? "Ordered" : "Sharded";
+  r.shard_count      = ordered ? "N/A" : std::to_string(::concurrency::DefaultUnorderedMapShardCount);
+  r.key_type         = TypeParseTraits<int>::name;
+  r.val_type         = TypeParseTraits<int>::name;
+  r.total_operations = iterations;
+  std::atomic_uint64_t next = 0;
+  std::atomic_uint64_t sink = 0;
+  if (ordered) {
+    OrderedMap<int, int> m;
+    for (int i = 0; i < MapSize; ++i) {
+      (void) m.insert(i, i);
+    }
+    r.total_elapsed_ms = ::Benchmark::bench(
+        [&m, &next, &sink]() {
+          auto const lo = static_cast<int>(next.fetch_add(1, std::memory_order_relaxed) % (MapSize - RangeWidth));
+          uint64_t sum  = 0;
+          (void) m.visit_range(lo, lo + RangeWidth, [&sum](const int &, const int &v) { sum += v; });
+          sink.fetch_add(sum, std::memory_order_relaxed);
+        },
+        iterations);
+  } else {
+    ShardedUnorderedMap<int, int> m;
+    for (int i = 0; i < MapSize; ++i) {
+      (void) m.insert({i, i});
+    }
+    r.total_elapsed_ms = ::Benchmark::bench(
+        [&m, &next, &sink]() {
+          auto const lo = static_cast<int>(next.fetch_add(1, std::memory_order_relaxed) % (MapSize - RangeWidth));
+          uint64_t sum  = 0;
+          for (auto const &el: m.data()) {
+            if (el.first >= lo && el.first < lo + RangeWidth) sum += el.second;
+          }
+          sink.fetch_add(sum, std::memory_order_relaxed);
+        },
+        iterations);
+  }
+  r.avg_operations_per_ms = iterations / static_cast<double>(std::max<int64_t>(1, r.total_elapsed_ms.count()));
+  return r;
+}
+
+// Times incrementing metrics-style counters, spread round-robin over CounterKeyCount keys,
+// either with upsert() on a sharded map, which puts every increment of a key on that key's
+// shard lock, or with a CounterMap, which keeps partial counts per thread.
+::Benchmark::Result bench_counter_increments(bool const counter_map) {
+  constexpr int CounterKeyCount = 1024;
+
+  ::Benchmark::Result r;
+  r.operation        = counter_map ? "counter_increment_counter_map" : "counter_increment_upsert";
+  r.map_type         = counter_map ? "Counter" : "Sharded";
+  r.key_type         = TypeParseTraits<int>::name;
+  r.val_type         = "int64_t";
+  r.total_operations = default_benchmark_iterations;
+  std::atomic_uint64_t next = 0;
+  if (counter_map) {
+    CounterMap<int> m;
+    r.shard_count      = std::to_string(m.stripe_count());
+    r.total_elapsed_ms = ::Benchmark::bench([&m, &next]() { m.increment(static_cast<int>(next.fetch_add(1, std::memory_order_relaxed) % CounterKeyCount)); });
+  } else {
+    ShardedUnorderedMap<int, int64_t> m;
+    r.shard_count      = std::to_string(::concurrency::DefaultUnorderedMapShardCount);
+    r.total_elapsed_ms = ::Benchmark::bench([&m, &next]() {
+      (void) m.upsert(static_cast<int>(next.fetch_add(1, std::memory_order_relaxed) % CounterKeyCount), int64_t{1}, [](const int64_t &count, const int64_t &one) { return count + one; });
+    });
+  }
+  r.avg_operations_per_ms = default_benchmark_iterations / static_cast<double>(std::max<int64_t>(1, r.total_elapsed_ms.count()));
+  return r;
+}
+
+// Times the read side of a shared object from the given number of reader threads, each
+// pinned with an Epoch or under a std::shared_lock. Every shared_lock writes the mutex's
+// shared reader count, while a pin only writes the calling thread's own slot. Each reader
+// runs its share of the iterations without touching a shared counter, so that the guard
+// is the only contended write.
+::Benchmark::Result bench_read_guards(bool const epoch_guard, uint32_t const threads) {
+  struct Payload {
+    uint64_t values[8];
+  };
+
+  ::Benchmark::Result r;
+  r.operation        = epoch_guard ? "read_guard_epoch_pin" : "read_guard_shared_lock";
+  r.map_type         = epoch_guard ? "Epoch" : "shared_mutex";
+  r.key_type         = "N/A";
+  r.val_type         = "Payload";
+  r.shard_count      = "N/A";
+  r.total_operations = default_benchmark_iterations;
+  r.thread_count     = threads;
+  Payload payload{{1, 2, 3, 4, 5, 6, 7, 8}};
+  std::atomic<Payload *> shared{&payload};
+  std::atomic_uint64_t sink = 0; // Consumes the results so the reads cannot be optimized away.
+  Epoch epoch;
+  std::shared_mutex mutex;
+  auto const start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (uint32_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      uint64_t local = 0;
+      for (auto i = t; i < default_benchmark_iterations; i += threads) {
+        if (epoch_guard) {
+          auto guard       = epoch.pin();
+          Payload const *p = shared.load(std::memory_order_acquire);
+          local += p->values[local % 8];
+        } else {
+          std::shared_lock<std::shared_mutex> lock(mutex);
+          Payload const *p = shared.load(std::memory_order_acquire);
+          local += p->values[local % 8];
+        }
+      }
+      sink.fetch_add(local, std::memory_order_relaxed);
+    });
+  }
+  for (auto &w: workers) {
+    w.join();
+  }
+  r.total_elapsed_ms      = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  r.avg_operations_per_ms = default_benchmark_iterations / static_cast<double>(std::max<int64_t>(1, r.total_elapsed_ms.count()));
+  return r;
+}
+
+// Usage: concurrency_map_benchmark [--large]
+//   --large  Additionally runs the 100M entry find() comparison, which needs several GB of memory.
+int main(int argc, char **argv) {
+  bool const include_large = argc > 1 && std::string(argv[1]) == "--large";
   UnorderedMap<int, int> m1;
   ShardedUnorderedMap<int, int> m2;
+  UnorderedMap<int, int> m3;
+  ShardedUnorderedMap<int, int> m4;
+  StripedUnorderedMap<int, int> m5;
   std::vector<::Benchmark::Result> results;
 
   results.push_back(INVOKE_BENCHMARK(default_constructor, m1, void_func, teardown_test_map));
@@ -210,6 +670,10 @@ int main() {
   results.push_back(INVOKE_BENCHMARK(count, m2, setup_test_map, teardown_test_map));
   results.push_back(INVOKE_BENCHMARK(find, m1, setup_test_map, teardown_test_map));
   results.push_back(INVOKE_BENCHMARK(find, m2, setup_test_map, teardown_test_map));
+  results.push_back(INVOKE_BENCHMARK(find_not_existing, m1, setup_test_map, teardown_test_map));
+  results.push_back(INVOKE_BENCHMARK(find_not_existing, m2, setup_test_map, teardown_test_map));
+  results.push_back(INVOKE_BENCHMARK(find_not_existing_bloom_filter, m3, setup_bloom_filter_test_map, teardown_test_map));
+  results.push_back(INVOKE_BENCHMARK(find_not_existing_bloom_filter, m4, setup_bloom_filter_test_map, teardown_test_map));
   results.push_back(INVOKE_BENCHMARK(data, m1, setup_test_map, teardown_test_map));
   results.push_back(INVOKE_BENCHMARK(data, m2, setup_test_map, teardown_test_map));
   results.push_back(INVOKE_BENCHMARK(load_factor, m1, setup_test_map, teardown_test_map));
@@ -222,6 +686,41 @@ int main() {
   results.push_back(INVOKE_BENCHMARK(rehash, m2, setup_test_map, teardown_test_map));
   results.push_back(INVOKE_BENCHMARK(reserve, m1, setup_test_map, teardown_test_map));
   results.push_back(INVOKE_BENCHMARK(reserve, m2, setup_test_map, teardown_test_map));
+  results.push_back(INVOKE_BENCHMARK(insert_when_empty, m5, void_func, teardown_test_map));
+  results.push_back(INVOKE_BENCHMARK(insert_or_assign_existing, m5, setup_test_map, teardown_test_map));
+  results.push_back(INVOKE_BENCHMARK(erase_existing, m5, setup_test_map, teardown_test_map));
+  results.push_back(INVOKE_BENCHMARK(at, m5, setup_test_map, teardown_test_map));
+  results.push_back(INVOKE_BENCHMARK(find, m5, setup_test_map, teardown_test_map));
+  results.push_back(INVOKE_BENCHMARK(find_not_existing, m5, setup_test_map, teardown_test_map));
+
+  results.push_back(bench_zipfian_writes<UnorderedMap<int, int>>(false));
+  results.push_back(bench_zipfian_writes<UnorderedMap<int, int>>(true));
+  results.push_back(bench_zipfian_writes<ShardedUnorderedMap<int, int>>(false));
+  results.push_back(bench_zipfian_writes<ShardedUnorderedMap<int, int>>(true));
+  results.push_back(bench_zipfian_upserts<ShardedUnorderedMap<int, int>>(false));
+  results.push_back(bench_zipfian_upserts<ShardedUnorderedMap<int, int>>(true));
+  results.push_back(bench_store_writes(false));
+  results.push_back(bench_store_writes(true));
+  results.push_back(bench_dedupe(DedupeMode::map_of_bool));
+  results.push_back(bench_dedupe(DedupeMode::set));
+  results.push_back(bench_dedupe(DedupeMode::set_insert_many));
+  results.push_back(bench_secondary_index(false, false));
+  results.push_back(bench_secondary_index(true, false));
+  results.push_back(bench_secondary_index(false, true));
+  results.push_back(bench_secondary_index(true, true));
+  results.push_back(bench_range_scan(false));
+  results.push_back(bench_range_scan(true));
+  results.push_back(bench_counter_increments(false));
+  results.push_back(bench_counter_increments(true));
+  for (uint32_t const threads: {1u, std::max(1u, std::thread::hardware_concurrency())}) {
+    results.push_back(bench_read_guards(false, threads));
+    results.push_back(bench_read_guards(true, threads));
+  }
+
+  bench_find_at_scales<UnorderedMap<int, int>>(results, include_large);
+  bench_find_at_scales<::concurrency::FlatUnorderedMap<int, int>>(results, include_large);
+  bench_find_at_scales<ShardedUnorderedMap<int, int>>(results, include_large);
+  bench_find_at_scales<::concurrency::ShardedFlatUnorderedMap<int, int>>(results, include_large);
 
   std::cout << ::Benchmark::Result::results_to_csv(results);
   return EXIT_SUCCESS;
@@ -0,0 +1,194 @@
+#include <concurrency/BoundedQueue.hpp>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using ::concurrency::BoundedQueue;
+
+constexpr uint64_t total_items   = 2'000'000;
+constexpr std::size_t capacity   = 1024;
+constexpr std::size_t batch_size = 64;
+
+// The baseline: a bounded std::deque guarded by a mutex, with condition variables
+// for waiting producers and consumers.
+class MutexQueue {
+public:
+  explicit MutexQueue(std::size_t capacity) : m_capacity(capacity) {}
+
+  bool push(uint64_t value) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_not_full.wait(lock, [this]() { return m_items.size() < m_capacity || m_closed; });
+      if (m_closed) return false;
+      m_items.push_back(value);
+    }
+    m_not_empty.notify_one();
+    return true;
+  }
+
+  std::optional<uint64_t> pop() {
+    std::optional<uint64_t> value;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_not_empty.wait(lock, [this]() { return !m_items.empty() || m_closed; });
+      if (m_items.empty()) return std::nullopt;
+      value = m_items.front();
+      m_items.pop_front();
+    }
+    m_not_full.notify_one();
+    return value;
+  }
+
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_closed = true;
+    }
+    m_not_empty.notify_all();
+    m_not_full.notify_all();
+  }
+
+private:
+  std::size_t const m_capacity;
+  std::mutex m_mutex{};
+  std::condition_variable m_not_empty{};
+  std::condition_variable m_not_full{};
+  std::deque<uint64_t> m_items{};
+  bool m_closed{false};
+};
+
+struct Result {
+  std::string queue_type;
+  unsigned producers;
+  unsigned consumers;
+  std::size_t batch;
+  std::chrono::milliseconds total_elapsed_ms;
+
+  std::string csv_row() const {
+    std::stringstream s;
+    s << queue_type << "," << producers << "," << consumers << "," << batch << "," << total_items << ","
+      << total_items / static_cast<double>(std::max<int64_t>(1, total_elapsed_ms.count())) << "," << total_elapsed_ms.count() << "\n";
+    return s.str();
+  }
+};
+
+// Moves total_items integers from the producers to the consumers through queue, and checks
+// that they all arrived. produce(queue, first, last) pushes the integers in [first, last),
+// and consume(queue, sum) pops until the queue is closed and empty, adding to sum.
+template <class Queue, class Produce, class Consume>
+Result run(std::string queue_type, std::size_t batch, unsigned producers, unsigned consumers, Produce produce, Consume consume) {
+  Queue queue(capacity);
+  std::vector<uint64_t> sums(consumers, 0);
+  auto const start = std::chrono::steady_clock::now();
+  std::vector<std::thread> producer_threads;
+  for (unsigned p = 0; p < producers; ++p) {
+    producer_threads.emplace_back([&queue, &produce, p, producers]() { produce(queue, total_items * p / producers, total_items * (p + 1) / producers); });
+  }
+  std::vector<std::thread> consumer_threads;
+  for (unsigned c = 0; c < consumers; ++c) {
+    consumer_threads.emplace_back([&queue, &consume, &sums, c]() { consume(queue, sums[c]); });
+  }
+  for (auto &t: producer_threads) {
+    t.join();
+  }
+  queue.close();
+  for (auto &t: consumer_threads) {
+    t.join();
+  }
+  auto const elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  uint64_t sum       = 0;
+  for (auto s: sums) {
+    sum += s;
+  }
+  if (sum != total_items * (total_items - 1) / 2) {
+    std::cerr << queue_type << ": lost or duplicated items\n";
+    std::exit(EXIT_FAILURE);
+  }
+  return {std::move(queue_type), producers, consumers, batch, elapsed};
+}
+
+Result bench_mutex_deque(unsigned producers, unsigned consumers) {
+  return run<MutexQueue>(
+      "mutex_deque", 1, producers, consumers,
+      [](MutexQueue &q, uint64_t first, uint64_t last) {
+        for (auto i = first; i < last; ++i) {
+          (void) q.push(i);
+        }
+      },
+      [](MutexQueue &q, uint64_t &sum) {
+        while (auto value = q.pop()) {
+          sum += *value;
+        }
+      });
+}
+
+Result bench_bounded_queue(unsigned producers, unsigned consumers) {
+  return run<BoundedQueue<uint64_t>>(
+      "bounded_queue", 1, producers, consumers,
+      [](BoundedQueue<uint64_t> &q, uint64_t first, uint64_t last) {
+        for (auto i = first; i < last; ++i) {
+          (void) q.push(i);
+        }
+      },
+      [](BoundedQueue<uint64_t> &q, uint64_t &sum) {
+        while (auto value = q.pop()) {
+          sum += *value;
+        }
+      });
+}
+
+Result bench_bounded_queue_batched(unsigned producers, unsigned consumers) {
+  return run<BoundedQueue<uint64_t>>(
+      "bounded_queue", batch_size, producers, consumers,
+      [](BoundedQueue<uint64_t> &q, uint64_t first, uint64_t last) {
+        std::vector<uint64_t> batch;
+        batch.reserve(batch_size);
+        for (auto i = first; i < last; i += batch_size) {
+          batch.clear();
+          for (auto j = i; j < std::min<uint64_t>(i + batch_size, last); ++j) {
+            batch.push_back(j);
+          }
+          (void) q.push_n(batch.begin(), batch.end());
+        }
+      },
+      [](BoundedQueue<uint64_t> &q, uint64_t &sum) {
+        std::vector<uint64_t> batch(batch_size);
+        while (auto const n = q.pop_n(batch.begin(), batch.size())) {
+          for (std::size_t i = 0; i < n; ++i) {
+            sum += batch[i];
+          }
+        }
+      });
+}
+
+// Usage: concurrency_queue_benchmark
+// Reports the throughput of each queue with one producer and one consumer, and with
+// half of the hardware threads producing and half consuming.
+int main() {
+  auto const half = std::max(1u, std::thread::hardware_concurrency() / 2);
+  std::vector<std::pair<unsigned, unsigned>> shapes{{1, 1}};
+  if (half > 1) shapes.emplace_back(half, half);
+
+  std::vector<Result> results;
+  for (auto const &shape: shapes) {
+    results.push_back(bench_mutex_deque(shape.first, shape.second));
+    results.push_back(bench_bounded_queue(shape.first, shape.second));
+    results.push_back(bench_bounded_queue_batched(shape.first, shape.second));
+  }
+
+  std::cout << "queue_type,producers,consumers,batch_size,total_items,avg_items_per_ms,total_elapsed_ms\n";
+  for (auto const &r: results) {
+    std::cout << r.csv_row();
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,234 @@
+#ifndef ASYNC_SHARED_MUTEX_H
+#define ASYNC_SHARED_MUTEX_H
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#include <coroutine>
+#define CONCURRENCY_COROUTINES 1
+#endif
+
+namespace concurrency {
+  // A request to lock an AsyncSharedMutex without blocking. Once the mutex has been locked
+  // on the waiter's behalf, exclusively or shared as requested, grant(waiter) is called on
+  // the thread that unlocked it. Waiters are queued intrusively, so the waiter must stay
+  // alive until it has been granted.
+  struct AsyncLockWaiter {
+    bool exclusive{false};
+    void (*grant)(AsyncLockWaiter &){nullptr};
+    AsyncLockWaiter *next{nullptr};
+  };
+
+  // This class provides a std::shared_mutex that can also be locked asynchronously. It meets
+  // the SharedMutex requirements, so threads may lock it with std::unique_lock and
+  // std::shared_lock as usual. lock_async() instead tries to lock it and, if it is taken,
+  // queues the request in FIFO order instead of blocking. Every unlock() and unlock_shared()
+  // then checks for queued requests and grants as many as the mutex admits, in order, on
+  // the unlocking thread.
+  //
+  // Without queued requests, unlocking costs one extra fence and load.
+  class AsyncSharedMutex {
+  public:
+    AsyncSharedMutex()                                    = default;
+    AsyncSharedMutex(const AsyncSharedMutex &)            = delete;
+    AsyncSharedMutex &operator=(const AsyncSharedMutex &) = delete;
+
+    void lock() { m_mutex.lock(); }
+    bool try_lock() { return m_mutex.try_lock(); }
+    void unlock() {
+      m_mutex.unlock();
+      grant_queued();
+    }
+
+    void lock_shared() { m_mutex.lock_shared(); }
+    bool try_lock_shared() { return m_mutex.try_lock_shared(); }
+    void unlock_shared() {
+      m_mutex.unlock_shared();
+      grant_queued();
+    }
+
+    bool try_lock(bool exclusive) { return exclusive ? try_lock() : try_lock_shared(); }
+    void unlock(bool exclusive) { exclusive ? unlock() : unlock_shared(); }
+
+    // Locks the mutex for waiter and returns true if that can be done at once, in which case
+    // waiter.grant is not called. Otherwise queues waiter and returns false. waiter.grant may
+    // then be called, and the waiter destroyed, before this returns, even on this thread.
+    bool lock_async(AsyncLockWaiter &waiter) {
+      if (m_waiting.load(std::memory_order_relaxed) == 0 && try_lock(waiter.exclusive)) return true;
+      {
+        std::lock_guard<std::mutex> lock(m_queue_mutex);
+        waiter.next = nullptr;
+        (m_tail == nullptr ? m_head : m_tail->next) = &waiter;
+        m_tail                                      = &waiter;
+        m_waiting.fetch_add(1, std::memory_order_relaxed);
+      }
+      // Pairs with the fence in grant_queued(): either the thread holding the mutex sees the
+      // waiter once it unlocks, or the mutex is seen unlocked here.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      grant_waiters();
+      return false;
+    }
+
+  private:
+    // The mutexes whose queues the current thread is granting from. Waiters granted
+    // from a queue may unlock the same mutex before returning, in which case the loop
+    // already running further down the stack continues with the queue.
+    struct GrantFrame {
+      const AsyncSharedMutex *mutex;
+      GrantFrame *prev;
+    };
+
+    void grant_queued() {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (m_waiting.load(std::memory_order_relaxed) != 0) grant_waiters();
+    }
+
+    // Locks the mutex for queued waiters, from the head of the queue, until one cannot be
+    // admitted, and grants them.
+    void grant_waiters() {
+      for (auto *frame = t_frames; frame != nullptr; frame = frame->prev) {
+        if (frame->mutex == this) return;
+      }
+      GrantFrame frame{this, t_frames};
+      t_frames = &frame;
+      while (true) {
+        AsyncLockWaiter *waiter = nullptr;
+        {
+          std::lock_guard<std::mutex> lock(m_queue_mutex);
+          if (m_head == nullptr || !try_lock(m_head->exclusive)) break;
+          waiter = m_head;
+          m_head = waiter->next;
+          if (m_head == nullptr) m_tail = nullptr;
+          m_waiting.fetch_sub(1, std::memory_order_relaxed);
+        }
+        waiter->grant(*waiter);
+      }
+      t_frames = frame.prev;
+    }
+
+    static inline thread_local GrantFrame *t_frames = nullptr;
+
+    std::shared_mutex m_mutex{};
+    std::atomic<std::size_t> m_waiting{0};
+    std::mutex m_queue_mutex{};
+    AsyncLockWaiter *m_head{nullptr};
+    AsyncLockWaiter *m_tail{nullptr};
+  };
+
+  namespace detail {
+    // Releases an AsyncSharedMutex, held exclusively or shared, when destroyed.
+    struct AsyncUnlock {
+      ~AsyncUnlock() { mutex.unlock(exclusive); }
+
+      AsyncSharedMutex &mutex;
+      bool exclusive;
+    };
+
+    // Calls f() and releases mutex, which must be held as exclusive says, and then fulfils
+    // promise with the result or exception of f.
+    template <class R, class F>
+    void fulfil_locked(AsyncSharedMutex &mutex, bool exclusive, F &f, std::promise<R> &promise) {
+      try {
+        if constexpr (std::is_void_v<R>) {
+          {
+            AsyncUnlock unlock{mutex, exclusive};
+            f();
+          }
+          promise.set_value();
+        } else {
+          auto result = [&]() {
+            AsyncUnlock unlock{mutex, exclusive};
+            return f();
+          }();
+          promise.set_value(std::move(result));
+        }
+      } catch (...) {
+        promise.set_exception(std::current_exception());
+      }
+    }
+
+    template <class F>
+    struct FutureLockWaiter : AsyncLockWaiter {
+      using result_type = std::invoke_result_t<F &>;
+
+      FutureLockWaiter(AsyncSharedMutex &m, F &&fn) : mutex(m), f(std::move(fn)) {}
+
+      static void run(AsyncLockWaiter &waiter) {
+        std::unique_ptr<FutureLockWaiter> self(static_cast<FutureLockWaiter *>(&waiter));
+        fulfil_locked(self->mutex, self->exclusive, self->f, self->promise);
+      }
+
+      AsyncSharedMutex &mutex;
+      F f;
+      std::promise<result_type> promise{};
+    };
+  } // namespace detail
+
+  // Locks mutex, exclusively or shared, without blocking, calls f() once it is locked, and
+  // returns a std::future for its result. If the mutex is free, f() runs on the calling
+  // thread before this returns. Otherwise it runs on the thread that unlocks the mutex.
+  template <class F>
+  auto lock_async_future(AsyncSharedMutex &mutex, bool exclusive, F f) -> std::future<std::invoke_result_t<F &>> {
+    auto waiter       = std::make_unique<detail::FutureLockWaiter<F>>(mutex, std::move(f));
+    waiter->exclusive = exclusive;
+    waiter->grant     = &detail::FutureLockWaiter<F>::run;
+    auto future       = waiter->promise.get_future();
+    // Once queued, the waiter is owned by whichever thread grants it.
+    auto *queued = waiter.release();
+    if (mutex.lock_async(*queued)) detail::FutureLockWaiter<F>::run(*queued);
+    return future;
+  }
+
+  // Declared in every translation unit, so that classes returning it are defined the same
+  // way whether or not coroutines are available, but only defined when they are.
+  template <class F>
+  class AsyncLockOperation;
+
+#ifdef CONCURRENCY_COROUTINES
+  // An awaitable that locks mutex, exclusively or shared, calls f() with the lock held, and
+  // unlocks it before producing f's result. If the mutex is taken, the awaiting coroutine is
+  // suspended rather than blocking its thread, and is resumed by the thread that unlocks the
+  // mutex. Exceptions thrown by f propagate out of co_await.
+  template <class F>
+  class AsyncLockOperation : private AsyncLockWaiter {
+  public:
+    AsyncLockOperation(AsyncSharedMutex &mutex, bool exclusive, F f) : m_mutex(mutex), m_f(std::move(f)) {
+      this->exclusive = exclusive;
+      this->grant     = &AsyncLockOperation::resume;
+    }
+
+    AsyncLockOperation(const AsyncLockOperation &)            = delete;
+    AsyncLockOperation &operator=(const AsyncLockOperation &) = delete;
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+      m_handle = handle;
+      return !m_mutex.lock_async(*this);
+    }
+
+    auto await_resume() {
+      detail::AsyncUnlock unlock{m_mutex, this->exclusive};
+      return m_f();
+    }
+
+  private:
+    static void resume(AsyncLockWaiter &waiter) { static_cast<AsyncLockOperation &>(waiter).m_handle.resume(); }
+
+    AsyncSharedMutex &m_mutex;
+    F m_f;
+    std::coroutine_handle<> m_handle{};
+  };
+#endif
+
+} // namespace concurrency
+
+#endif // ASYNC_SHARED_MUTEX_H
@@ -0,0 +1,167 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <concurrency/FlatHashMap.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace concurrency {
+
+  // This class provides a blocked, counting Bloom filter over precomputed hashes. Every hash
+  // maps to a single 64 byte block holding 128 four-bit counters, of which it increments
+  // BloomFilterProbes, so a query reads exactly one cache line. Counters (rather than bits)
+  // allow hashes to be removed again. A counter that reaches its maximum value is never
+  // decremented, which can only cause false positives.
+  //
+  // may_contain() may be called from any number of threads without locking, concurrently with
+  // a single writer. Calls to add(), remove(), clear(), and rebuild() must be serialized by the
+  // caller, as ::concurrency::UnorderedMap does with its write lock. rebuild() swaps in a new
+  // table without disturbing concurrent readers; the tables it replaces are kept alive until
+  // the filter is destroyed, since a reader may still be using them. Growing by doubling
+  // bounds that overhead by the size of the current table.
+  class CountingBloomFilter {
+    static constexpr std::size_t BlockBytes        = 64;
+    static constexpr std::size_t CountersPerBlock  = BlockBytes * 2;
+    static constexpr std::size_t ElementsPerBlock  = 8;
+    static constexpr std::size_t BloomFilterProbes = 4;
+    static constexpr uint8_t CounterMax            = 0x0F;
+
+    struct alignas(BlockBytes) Block {
+      std::atomic<uint8_t> cells[BlockBytes];
+    };
+
+    struct Table {
+      explicit Table(std::size_t block_count) : blocks(new Block[block_count]), block_mask(block_count - 1) {
+        for (std::size_t b = 0; b < block_count; ++b) {
+          for (auto &cell: blocks[b].cells) {
+            cell.store(0, std::memory_order_relaxed);
+          }
+        }
+      }
+
+      std::unique_ptr<Block[]> blocks;
+      std::size_t block_mask;
+    };
+
+  public:
+    using size_type = std::size_t;
+
+    // Creates a disabled filter, for which may_contain() always returns true.
+    CountingBloomFilter() = default;
+
+    CountingBloomFilter(const CountingBloomFilter &)            = delete;
+    CountingBloomFilter &operator=(const CountingBloomFilter &) = delete;
+
+    ~CountingBloomFilter() = default;
+
+    bool enabled() const noexcept { return m_current.load(std::memory_order_acquire) != nullptr; }
+
+    // Returns the number of hashes the current table was sized for.
+    size_type capacity() const noexcept { return m_capacity; }
+
+    // Returns the number of hashes added and not yet removed.
+    size_type size() const noexcept { return m_size; }
+
+    // Returns false only if hash has definitely not been added.
+    bool may_contain(std::size_t hash) const noexcept {
+      auto const *table = m_current.load(std::memory_order_acquire);
+      if (table == nullptr) return true;
+      uint64_t const h  = detail::mix_hash(hash);
+      auto const &block = table->blocks[(h >> 32) & table->block_mask];
+      for (std::size_t p = 0; p < BloomFilterProbes; ++p) {
+        auto const counter = (h >> (7 * p)) & (CountersPerBlock - 1);
+        auto const cell    = block.cells[counter >> 1].load(std::memory_order_relaxed);
+        if (((cell >> ((counter & 1) * 4)) & CounterMax) == 0) return false;
+      }
+      return true;
+    }
+
+    void add(std::size_t hash) noexcept {
+      auto *table = m_current.load(std::memory_order_relaxed);
+      if (table == nullptr) return;
+      update(*table, hash, +1);
+      ++m_size;
+    }
+
+    void remove(std::size_t hash) noexcept {
+      auto *table = m_current.load(std::memory_order_relaxed);
+      if (table == nullptr) return;
+      update(*table, hash, -1);
+      --m_size;
+    }
+
+    // Removes every hash. Concurrent readers may observe a partially cleared table,
+    // which is safe since every hash is being removed.
+    void clear() noexcept {
+      auto *table = m_current.load(std::memory_order_relaxed);
+      if (table == nullptr) return;
+      for (std::size_t b = 0; b <= table->block_mask; ++b) {
+        for (auto &cell: table->blocks[b].cells) {
+          cell.store(0, std::memory_order_relaxed);
+        }
+      }
+      m_size = 0;
+    }
+
+    // Returns true if more hashes have been added than the current table was sized for,
+    // so that the caller should rebuild() it with a larger capacity.
+    bool needs_growth() const noexcept { return m_size > m_capacity; }
+
+    // Replaces the contents of the filter with hash_of(el) for every el in [first, last), in
+    // a new table sized for at least capacity hashes. Enables the filter if it was disabled.
+    template <class It, class HashOf>
+    void rebuild(size_type capacity, It first, It last, HashOf &&hash_of) {
+      size_type block_count = 1;
+      while (block_count * ElementsPerBlock < capacity) {
+        block_count *= 2;
+      }
+      auto table = std::make_unique<Table>(block_count);
+      size_type n = 0;
+      for (; first != last; ++first, ++n) {
+        update(*table, hash_of(*first), +1);
+      }
+      m_current.store(table.get(), std::memory_order_release);
+      m_tables.push_back(std::move(table));
+      m_capacity = block_count * ElementsPerBlock;
+      m_size     = n;
+    }
+
+    // Exchanges the contents, and the tables backing them, with other. Readers that loaded
+    // a table before the swap may go on using it until the filter now owning it is destroyed.
+    void swap(CountingBloomFilter &other) noexcept {
+      auto *table = m_current.load(std::memory_order_relaxed);
+      m_current.store(other.m_current.load(std::memory_order_relaxed), std::memory_order_release);
+      other.m_current.store(table, std::memory_order_release);
+      m_tables.swap(other.m_tables);
+      std::swap(m_capacity, other.m_capacity);
+      std::swap(m_size, other.m_size);
+    }
+
+  private:
+    static void update(Table &table, std::size_t hash, int delta) noexcept {
+      uint64_t const h = detail::mix_hash(hash);
+      auto &block      = table.blocks[(h >> 32) & table.block_mask];
+      for (std::size_t p = 0; p < BloomFilterProbes; ++p) {
+        auto const counter = (h >> (7 * p)) & (CountersPerBlock - 1);
+        auto &cell         = block.cells[counter >> 1];
+        auto const shift   = (counter & 1) * 4;
+        auto const bits    = cell.load(std::memory_order_relaxed);
+        auto const value   = (bits >> shift) & CounterMax;
+        if (value == CounterMax || (delta < 0 && value == 0)) continue;
+        auto const updated = static_cast<uint8_t>((bits & ~(CounterMax << shift)) | ((value + delta) << shift));
+        cell.store(updated, std::memory_order_relaxed);
+      }
+    }
+
+    std::atomic<Table *> m_current{nullptr};
+    std::vector<std::unique_ptr<Table>> m_tables{};
+    size_type m_capacity{0};
+    size_type m_size{0};
+  };
+
+} // namespace concurrency
+
+#endif // BLOOM_FILTER_H
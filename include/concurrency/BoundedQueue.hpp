@@ -0,0 +1,339 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace concurrency {
+  constexpr std::size_t DefaultBoundedQueueCapacity = 1024;
+  constexpr int BoundedQueueSpinCount               = 64;
+
+  // This class provides a bounded, lock-free, multi-producer multi-consumer FIFO queue, for
+  // feeding work between threads. It is a ring buffer of cache-line-sized cells, each carrying
+  // a sequence number that tells producers and consumers whose turn it is, so that a push or
+  // pop claims its cell with a single compare-and-swap and never waits on a thread that is
+  // reading or writing another cell. The capacity is rounded up to a power of two.
+  //
+  // try_push() and try_pop() never block. push() and pop() spin briefly and then sleep until
+  // the queue has room or an element. Sleeping threads are tracked, so that the fast paths
+  // only touch the queue's mutex when some thread is actually asleep. push_n() and pop_n()
+  // move several elements per claim, with one compare-and-swap for each run of consecutive
+  // free or full cells.
+  //
+  // close() marks the end of the input: later pushes fail, and pop() returns nothing once
+  // the remaining elements have been popped. Pushes that race with close() either fail or are
+  // delivered, so producers should finish before the queue is closed.
+  //
+  // http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+  template <class T>
+  class BoundedQueue {
+    struct alignas(64) Cell {
+      std::atomic<std::size_t> sequence{0};
+      alignas(T) unsigned char storage[sizeof(T)];
+
+      T &value() noexcept { return *std::launder(reinterpret_cast<T *>(storage)); }
+    };
+
+  public:
+    using value_type = T;
+    using size_type  = std::size_t;
+
+    // ------------------------------ Constructors ------------------------------ //
+    explicit BoundedQueue(size_type capacity = DefaultBoundedQueueCapacity) {
+      size_type rounded = 2;
+      while (rounded < capacity) {
+        rounded *= 2;
+      }
+      m_cells = std::make_unique<Cell[]>(rounded);
+      m_mask  = rounded - 1;
+      for (size_type i = 0; i < rounded; ++i) {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+      }
+    }
+
+    BoundedQueue(const BoundedQueue &)            = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    // Destroys any elements that were never popped.
+    ~BoundedQueue() {
+      auto const tail = m_tail.load(std::memory_order_acquire);
+      for (auto pos = m_head.load(std::memory_order_acquire); pos != tail; ++pos) {
+        auto &cell = m_cells[pos & m_mask];
+        if (cell.sequence.load(std::memory_order_acquire) == pos + 1) cell.value().~T();
+      }
+    }
+
+    // -------------------------------- Capacity -------------------------------- //
+    size_type capacity() const noexcept { return m_mask + 1; }
+
+    // Returns the number of elements in the queue. Only exact while
+    // no other thread is pushing or popping.
+    size_type size() const noexcept {
+      auto const head = m_head.load(std::memory_order_acquire);
+      auto const tail = m_tail.load(std::memory_order_acquire);
+      return tail > head ? tail - head : 0;
+    }
+
+    // May report a push that is still in progress as not yet visible.
+    bool empty() const noexcept {
+      auto const pos = m_head.load(std::memory_order_relaxed);
+      return m_cells[pos & m_mask].sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    // May report a pop that is still in progress as not yet visible.
+    bool full() const noexcept {
+      auto const pos = m_tail.load(std::memory_order_relaxed);
+      return m_cells[pos & m_mask].sequence.load(std::memory_order_acquire) != pos;
+    }
+
+    // ------------------------------- Producers -------------------------------- //
+    // Returns false, leaving value untouched, if the queue is full or closed.
+    template <class U>
+    bool try_push(U &&value) {
+      if (closed()) return false;
+      size_type pos;
+      if (claim(m_tail, 0, 1, pos) == 0) return false;
+      publish(pos, std::forward<U>(value));
+      notify(m_sleeping_consumers, m_not_empty, false);
+      return true;
+    }
+
+    // Pushes value, waiting for room if the queue is full. Returns
+    // false, leaving value untouched, if the queue is closed.
+    template <class U>
+    bool push(U &&value) {
+      for (int spin = 0; !try_push(std::forward<U>(value)); ++spin) {
+        if (closed()) return false;
+        if (spin < BoundedQueueSpinCount) {
+          std::this_thread::yield();
+          continue;
+        }
+        sleep(m_sleeping_producers, m_not_full, [this]() { return !full() || closed(); });
+      }
+      return true;
+    }
+
+    // Moves as many elements as fit from the start of [first, last) into the queue and
+    // returns an iterator past the last one moved. Never blocks.
+    template <class InputIt>
+    InputIt try_push_n(InputIt first, InputIt last) {
+      while (first != last && !closed()) {
+        size_type pos;
+        auto const n = claim(m_tail, 0, remaining(first, last), pos);
+        if (n == 0) break;
+        for (size_type i = 0; i < n; ++i, ++first) {
+          publish(pos + i, std::move(*first));
+        }
+        notify(m_sleeping_consumers, m_not_empty, n > 1);
+      }
+      return first;
+    }
+
+    // Moves every element of [first, last) into the queue, waiting for room as needed.
+    // Returns an iterator past the last element moved, which is last unless the queue
+    // was closed.
+    template <class InputIt>
+    InputIt push_n(InputIt first, InputIt last) {
+      for (int spin = 0; first != last; ++spin) {
+        auto const next = try_push_n(first, last);
+        if (next != first) {
+          first = next;
+          spin  = 0;
+          continue;
+        }
+        if (closed()) break;
+        if (spin < BoundedQueueSpinCount) {
+          std::this_thread::yield();
+          continue;
+        }
+        sleep(m_sleeping_producers, m_not_full, [this]() { return !full() || closed(); });
+      }
+      return first;
+    }
+
+    // Rejects later pushes and wakes every sleeping thread. Elements already
+    // in the queue may still be popped.
+    void close() {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed.store(true, std::memory_order_seq_cst);
+      }
+      m_not_empty.notify_all();
+      m_not_full.notify_all();
+    }
+
+    bool closed() const noexcept { return m_closed.load(std::memory_order_acquire); }
+
+    // ------------------------------- Consumers -------------------------------- //
+    // Returns false, leaving value untouched, if the queue is empty.
+    bool try_pop(T &value) {
+      auto popped = try_pop_one();
+      if (!popped) return false;
+      value = std::move(*popped);
+      return true;
+    }
+
+    // Pops the oldest element, waiting for one if the queue is empty.
+    // Returns nothing once the queue is closed and empty.
+    std::optional<T> pop() {
+      for (int spin = 0;; ++spin) {
+        auto popped = try_pop_one();
+        if (popped) return popped;
+        if (closed() && empty()) return try_pop_one();
+        if (spin < BoundedQueueSpinCount) {
+          std::this_thread::yield();
+          continue;
+        }
+        sleep(m_sleeping_consumers, m_not_empty, [this]() { return !empty() || closed(); });
+      }
+    }
+
+    // Moves up to max_count of the oldest elements to the range beginning at d_first and
+    // returns the number moved. Never blocks.
+    template <class OutputIt>
+    size_type try_pop_n(OutputIt d_first, size_type max_count) {
+      size_type popped = 0;
+      while (popped < max_count) {
+        size_type pos;
+        auto const n = claim(m_head, 1, max_count - popped, pos);
+        if (n == 0) break;
+        for (size_type i = 0; i < n; ++i, ++d_first) {
+          *d_first = take(pos + i);
+        }
+        popped += n;
+        notify(m_sleeping_producers, m_not_full, n > 1);
+      }
+      return popped;
+    }
+
+    // Moves up to max_count of the oldest elements to the range beginning at d_first, waiting
+    // until there is at least one, and returns the number moved. Returns 0 only once the queue
+    // is closed and empty, or if max_count is 0.
+    template <class OutputIt>
+    size_type pop_n(OutputIt d_first, size_type max_count) {
+      if (max_count == 0) return 0;
+      for (int spin = 0;; ++spin) {
+        auto const n = try_pop_n(d_first, max_count);
+        if (n != 0) return n;
+        if (closed() && empty()) {
+          return try_pop_n(d_first, max_count);
+        }
+        if (spin < BoundedQueueSpinCount) {
+          std::this_thread::yield();
+          continue;
+        }
+        sleep(m_sleeping_consumers, m_not_empty, [this]() { return !empty() || closed(); });
+      }
+    }
+
+  private:
+    // Claims up to max_count consecutive cells from index, whose cells are ready for this side
+    // once their sequence equals position + offset: 0 for producers, 1 for consumers. Sets pos
+    // to the first claimed position and returns the number of cells claimed, which is 0 if the
+    // first cell is not ready. A ready cell stays ready until its position is claimed, so the
+    // run checked before the compare-and-swap is still ready after it succeeds.
+    size_type claim(std::atomic<size_type> &index, size_type offset, size_type max_count, size_type &pos) {
+      pos = index.load(std::memory_order_relaxed);
+      while (true) {
+        size_type n = 0;
+        while (n < max_count && n <= m_mask) {
+          auto const seq  = m_cells[(pos + n) & m_mask].sequence.load(std::memory_order_acquire);
+          auto const diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + n + offset);
+          if (diff != 0) {
+            if (n == 0 && diff < 0) return 0;
+            break;
+          }
+          ++n;
+        }
+        if (n == 0) {
+          // Another thread claimed this position first.
+          pos = index.load(std::memory_order_relaxed);
+          continue;
+        }
+        if (index.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) return n;
+      }
+    }
+
+    // Constructs the element in the claimed cell at pos and hands the cell to consumers.
+    template <class U>
+    void publish(size_type pos, U &&value) {
+      auto &cell = m_cells[pos & m_mask];
+      ::new (static_cast<void *>(cell.storage)) T(std::forward<U>(value));
+      cell.sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    // Moves the element out of the claimed cell at pos and hands the cell back to producers.
+    T take(size_type pos) {
+      auto &cell = m_cells[pos & m_mask];
+      T value(std::move(cell.value()));
+      cell.value().~T();
+      cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+      return value;
+    }
+
+    std::optional<T> try_pop_one() {
+      size_type pos;
+      if (claim(m_head, 1, 1, pos) == 0) return std::nullopt;
+      std::optional<T> value(take(pos));
+      notify(m_sleeping_producers, m_not_full, false);
+      return value;
+    }
+
+    template <class InputIt>
+    static size_type remaining(InputIt first, InputIt last) {
+      if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>) {
+        return static_cast<size_type>(std::distance(first, last));
+      } else {
+        return 1;
+      }
+    }
+
+    // The fences pair with those in sleep(), so that either the sleeping thread sees
+    // the change before sleeping or this thread sees that it is asleep.
+    void notify(std::atomic<uint32_t> &sleeping, std::condition_variable &cv, bool all) {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (sleeping.load(std::memory_order_relaxed) == 0) return;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+      }
+      if (all) {
+        cv.notify_all();
+      } else {
+        cv.notify_one();
+      }
+    }
+
+    template <class Ready>
+    void sleep(std::atomic<uint32_t> &sleeping, std::condition_variable &cv, Ready ready) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      sleeping.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      cv.wait(lock, ready);
+      sleeping.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_type m_mask{0};
+    alignas(64) std::atomic<size_type> m_tail{0};
+    alignas(64) std::atomic<size_type> m_head{0};
+    alignas(64) std::atomic<uint32_t> m_sleeping_producers{0};
+    std::atomic<uint32_t> m_sleeping_consumers{0};
+    std::atomic_bool m_closed{false};
+    std::mutex m_mutex{};
+    std::condition_variable m_not_empty{};
+    std::condition_variable m_not_full{};
+  };
+
+} // namespace concurrency
+
+#endif // BOUNDED_QUEUE_H
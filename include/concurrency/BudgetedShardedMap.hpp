@@ -0,0 +1,278 @@
+#ifndef BUDGETED_SHARDED_MAP_H
+#define BUDGETED_SHARDED_MAP_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace concurrency {
+  constexpr uint32_t DefaultBudgetedMapShardCount = 32;
+  constexpr std::size_t BudgetedMapEvictionSamples = 5;
+
+  // Charges an entry the size of its key-value pair plus the bookkeeping of a hash table
+  // node: a next pointer, a cached hash, and a bucket pointer. Values that own heap memory,
+  // such as strings or vectors, need a sizer that adds it.
+  template <class Key, class Val>
+  struct DefaultEntrySizer {
+    std::size_t operator()(const Key &, const Val &) const noexcept { return sizeof(std::pair<const Key, Val>) + 3 * sizeof(void *); }
+  };
+
+  // This class provides a sharded, thread-safe, unordered map limited by the total size of its
+  // entries rather than their number. Every entry is charged Sizer()(key, value) bytes, and each
+  // shard may hold budget / ShardCount bytes. A write that takes a shard over its share evicts
+  // entries from that shard until it is back within it, never evicting the entry just written;
+  // an entry larger than a whole share therefore evicts everything else in its shard.
+  //
+  // Victims are chosen by sampled LRU: BudgetedMapEvictionSamples entries are picked at random
+  // and the least recently used one is evicted. Recency is measured in writes to the shard, and
+  // a lookup only stores the shard's current write count into the entry, with a relaxed atomic
+  // store under the shard's shared lock, so reads never contend on a shared list.
+  template <class Key,
+            class Val,
+            uint32_t ShardCount = DefaultBudgetedMapShardCount,
+            class Sizer         = DefaultEntrySizer<Key, Val>,
+            class Hash          = std::hash<Key>,
+            class Pred          = std::equal_to<Key>>
+  class BudgetedShardedMap {
+    static_assert(ShardCount != 0, "ShardCount template parameter must be non-zero.");
+
+  public:
+    // ------------------------------ Member types ------------------------------ //
+    using key_type    = Key;
+    using mapped_type = Val;
+    using value_type  = std::pair<const Key, Val>;
+    using size_type   = std::size_t;
+    using hasher      = Hash;
+    using key_equal   = Pred;
+    using sizer       = Sizer;
+
+  private:
+    struct Node {
+      Node(const Key &k, Val v, size_type c, uint64_t stamp) : key(k), value(std::move(v)), charge(c), last_used(stamp) {}
+
+      Key key;
+      Val value;
+      size_type charge;
+      std::atomic<uint64_t> last_used;
+    };
+
+    // Nodes are kept densely in a vector, so that eviction can sample them at random, and
+    // index maps each key to its node's position.
+    struct alignas(64) Shard {
+      mutable std::shared_mutex mutex{};
+      std::unordered_map<Key, size_type, Hash, Pred> index{};
+      std::vector<std::unique_ptr<Node>> nodes{};
+      size_type bytes{0};
+      std::atomic<uint64_t> clock{0};
+      std::minstd_rand rng{};
+      uint64_t evictions{0};
+    };
+
+  public:
+    // ------------------------------ Constructors ------------------------------ //
+    // Creates a map whose entries may be charged at most budget bytes in total.
+    explicit BudgetedShardedMap(size_type budget, Sizer sizer = Sizer()) : m_share(std::max<size_type>(1, budget / ShardCount)), m_sizer(std::move(sizer)) {
+      uint32_t seed = 1;
+      for (auto &shard: m_shards) {
+        shard.rng.seed(seed++);
+      }
+    }
+
+    BudgetedShardedMap(const BudgetedShardedMap &)            = delete;
+    BudgetedShardedMap &operator=(const BudgetedShardedMap &) = delete;
+
+    // -------------------------------- Capacity -------------------------------- //
+    bool empty() const { return size() == 0; }
+
+    size_type size() const {
+      return sum_shards([](const Shard &shard) { return shard.nodes.size(); });
+    }
+
+    // Returns the number of bytes charged for the entries in the map.
+    size_type bytes() const {
+      return sum_shards([](const Shard &shard) { return shard.bytes; });
+    }
+
+    // Returns the number of bytes that may be charged in total.
+    size_type budget() const noexcept { return m_share * ShardCount; }
+
+    // Returns the number of entries evicted to stay within the budget.
+    uint64_t evictions() const {
+      return sum_shards([](const Shard &shard) { return shard.evictions; });
+    }
+
+    // ------------------------------- Modifiers -------------------------------- //
+    // Inserts obj unless an entry for k exists, evicting other entries if needed.
+    // Returns true if obj was inserted.
+    template <class M>
+    bool insert(const Key &k, M &&obj) {
+      auto &shard = get_shard(k);
+      std::unique_lock<std::shared_mutex> lock(shard.mutex);
+      if (shard.index.find(k) != shard.index.end()) return false;
+      write_locked(shard, k, std::forward<M>(obj));
+      return true;
+    }
+
+    // Inserts or replaces the entry for k, evicting other entries if needed.
+    // Returns true if no entry for k existed.
+    template <class M>
+    bool insert_or_assign(const Key &k, M &&obj) {
+      auto &shard = get_shard(k);
+      std::unique_lock<std::shared_mutex> lock(shard.mutex);
+      return write_locked(shard, k, std::forward<M>(obj));
+    }
+
+    size_type erase(const Key &key) {
+      auto &shard = get_shard(key);
+      std::unique_lock<std::shared_mutex> lock(shard.mutex);
+      auto it = shard.index.find(key);
+      if (it == shard.index.end()) return 0;
+      remove_locked(shard, it->second);
+      return 1;
+    }
+
+    void clear() {
+      for (auto &shard: m_shards) {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.index.clear();
+        shard.nodes.clear();
+        shard.bytes = 0;
+      }
+    }
+
+    // --------------------------------- Lookup --------------------------------- //
+    // Returns a copy of the element mapped to the provided key, marking
+    // it as recently used. Does bounds checking.
+    Val at(const Key &key) const {
+      auto const &shard = get_shard(key);
+      std::shared_lock<std::shared_mutex> lock(shard.mutex);
+      auto it = shard.index.find(key);
+      if (it == shard.index.end()) throw std::out_of_range("::concurrency::BudgetedShardedMap::at: key not found");
+      auto &node = *shard.nodes[it->second];
+      touch(shard, node);
+      return node.value;
+    }
+
+    // Does not mark the entry as used.
+    size_type count(const Key &key) const { return find(key) ? 1 : 0; }
+
+    // Returns a bool indicating whether or not the provided key is
+    // present in the map. Does not mark the entry as used.
+    bool find(const Key &key) const {
+      auto const &shard = get_shard(key);
+      std::shared_lock<std::shared_mutex> lock(shard.mutex);
+      return shard.index.find(key) != shard.index.end();
+    }
+
+    // ---------------------------------- Misc ---------------------------------- //
+    static constexpr uint32_t shard_count() noexcept { return ShardCount; }
+    hasher hash_function() const { return hasher(); }
+
+  private:
+    // Skips the store if the stamp is already current, so that repeated hits on a hot
+    // entry do not keep dirtying its cache line.
+    static void touch(const Shard &shard, Node &node) noexcept {
+      auto const now = shard.clock.load(std::memory_order_relaxed);
+      if (node.last_used.load(std::memory_order_relaxed) != now) node.last_used.store(now, std::memory_order_relaxed);
+    }
+
+    // Inserts or replaces the entry for k and then evicts until the shard is within its share.
+    // Callers must hold the shard's write lock. Returns true if no entry for k existed.
+    template <class M>
+    bool write_locked(Shard &shard, const Key &k, M &&obj) {
+      auto const stamp = shard.clock.fetch_add(1, std::memory_order_relaxed) + 1;
+      auto it          = shard.index.find(k);
+      bool inserted    = it == shard.index.end();
+      size_type pos;
+      if (inserted) {
+        Val value(std::forward<M>(obj));
+        auto const charge = m_sizer(k, value);
+        shard.nodes.push_back(std::make_unique<Node>(k, std::move(value), charge, stamp));
+        pos = shard.nodes.size() - 1;
+        try {
+          shard.index.emplace(k, pos);
+        } catch (...) {
+          shard.nodes.pop_back();
+          throw;
+        }
+        shard.bytes += charge;
+      } else {
+        pos        = it->second;
+        auto &node = *shard.nodes[pos];
+        node.value = std::forward<M>(obj);
+        shard.bytes -= node.charge;
+        node.charge = m_sizer(k, node.value);
+        shard.bytes += node.charge;
+        node.last_used.store(stamp, std::memory_order_relaxed);
+      }
+      evict_locked(shard, shard.nodes[pos].get());
+      return inserted;
+    }
+
+    // Evicts sampled least recently used entries, other than keep, until the shard is within
+    // its share. Callers must hold the shard's write lock.
+    void evict_locked(Shard &shard, const Node *keep) {
+      while (shard.bytes > m_share && shard.nodes.size() > 1) {
+        std::uniform_int_distribution<size_type> pick(0, shard.nodes.size() - 1);
+        size_type victim = shard.nodes.size();
+        uint64_t oldest  = UINT64_MAX;
+        for (std::size_t s = 0; s < BudgetedMapEvictionSamples; ++s) {
+          auto const pos   = pick(shard.rng);
+          auto const &node = *shard.nodes[pos];
+          if (&node == keep) continue;
+          auto const used = node.last_used.load(std::memory_order_relaxed);
+          if (used < oldest) {
+            oldest = used;
+            victim = pos;
+          }
+        }
+        if (victim == shard.nodes.size()) continue;
+        remove_locked(shard, victim);
+        ++shard.evictions;
+      }
+    }
+
+    // Removes the node at pos by moving the last node into its place.
+    // Callers must hold the shard's write lock.
+    static void remove_locked(Shard &shard, size_type pos) {
+      shard.bytes -= shard.nodes[pos]->charge;
+      shard.index.erase(shard.nodes[pos]->key);
+      if (pos + 1 != shard.nodes.size()) {
+        shard.nodes[pos]                            = std::move(shard.nodes.back());
+        shard.index.find(shard.nodes[pos]->key)->second = pos;
+      }
+      shard.nodes.pop_back();
+    }
+
+    template <class F>
+    auto sum_shards(F &&f) const {
+      decltype(f(m_shards[0])) n = 0;
+      for (auto const &shard: m_shards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        n += f(shard);
+      }
+      return n;
+    }
+
+    uint32_t get_shard_idx(const Key &key) const { return hash_function()(key) % ShardCount; }
+    Shard &get_shard(const Key &key) { return m_shards[get_shard_idx(key)]; }
+    const Shard &get_shard(const Key &key) const { return m_shards[get_shard_idx(key)]; }
+
+    size_type const m_share;
+    Sizer m_sizer;
+    std::array<Shard, ShardCount> m_shards{};
+  };
+
+} // namespace concurrency
+
+#endif // BUDGETED_SHARDED_MAP_H
@@ -0,0 +1,130 @@
+#ifndef BUFFERED_WRITER_H
+#define BUFFERED_WRITER_H
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace concurrency {
+  constexpr std::size_t DefaultBufferedWriterMaxPending = 1024;
+  constexpr std::chrono::milliseconds DefaultBufferedWriterMaxDelay{10};
+
+  // This class buffers writes to a ::concurrency::ShardedUnorderedMap (or any map providing
+  // insert_or_assign_many() and upsert_many()) so that a thread issuing many small writes
+  // pays for one lock acquisition per shard per flush instead of one per write. Writes to
+  // the same key are coalesced while buffered: insert_or_assign() replaces any pending write
+  // for its key, and upsert() folds its value into the pending one with Combine, which must
+  // therefore be associative.
+  //
+  // A BufferedWriter is not thread-safe; each writing thread is meant to own one. Buffered
+  // writes become visible to readers of the map only once flushed, which happens when
+  // max_pending keys are buffered, when a write finds the oldest pending one older than
+  // max_delay, on flush(), and on destruction. There is no background thread, so a thread
+  // that stops writing should call flush() itself.
+  //
+  // Keys are buffered with the map's hasher and key_equal, so that they coalesce exactly as
+  // they would in the map.
+  template <class Map, class Combine = std::plus<typename Map::mapped_type>>
+  class BufferedWriter {
+  public:
+    using map_type    = Map;
+    using key_type    = typename Map::key_type;
+    using mapped_type = typename Map::mapped_type;
+    using size_type   = std::size_t;
+    using clock       = std::chrono::steady_clock;
+
+    explicit BufferedWriter(Map &map, size_type max_pending = DefaultBufferedWriterMaxPending, clock::duration max_delay = DefaultBufferedWriterMaxDelay, Combine combine = Combine())
+        : m_map(map),
+          m_max_pending(max_pending == 0 ? 1 : max_pending),
+          m_max_delay(max_delay),
+          m_combine(std::move(combine)),
+          m_pending(0, map.hash_function(), map.key_eq()) {}
+
+    BufferedWriter(const BufferedWriter &)            = delete;
+    BufferedWriter &operator=(const BufferedWriter &) = delete;
+
+    // Flushes any pending writes.
+    ~BufferedWriter() { flush(); }
+
+    // Buffers map.insert_or_assign(k, obj), discarding any write pending for k.
+    template <class M>
+    void insert_or_assign(const key_type &k, M &&obj) {
+      note_write();
+      auto &pending  = m_pending[k];
+      pending.value  = std::forward<M>(obj);
+      pending.assign = true;
+      flush_if_due();
+    }
+
+    // Buffers map.upsert(k, obj, combine). If a write is already pending for k, obj is
+    // combined into it instead, so that one write reaches the map.
+    template <class M>
+    void upsert(const key_type &k, M &&obj) {
+      note_write();
+      auto it = m_pending.find(k);
+      if (it == m_pending.end()) {
+        m_pending.emplace(k, Pending{mapped_type(std::forward<M>(obj)), false});
+      } else {
+        it->second.value = m_combine(it->second.value, obj);
+      }
+      flush_if_due();
+    }
+
+    // Applies every pending write to the map, taking each shard's lock at most twice.
+    // Writes are only dropped from the buffer once the map has accepted them, so if the map
+    // or Combine throws, the pending upserts, and the assignments if they were not yet
+    // applied, are kept for the next flush. Upserts applied before the exception are then
+    // applied again.
+    void flush() {
+      if (m_pending.empty()) return;
+      std::vector<std::pair<key_type, mapped_type>> assigns;
+      std::vector<std::pair<key_type, mapped_type>> upserts;
+      for (auto const &el: m_pending) {
+        (el.second.assign ? assigns : upserts).emplace_back(el.first, el.second.value);
+      }
+      if (!assigns.empty()) {
+        m_map.insert_or_assign_many(std::make_move_iterator(assigns.begin()), std::make_move_iterator(assigns.end()));
+        for (auto it = m_pending.begin(); it != m_pending.end();) {
+          it = it->second.assign ? m_pending.erase(it) : std::next(it);
+        }
+      }
+      if (!upserts.empty()) m_map.upsert_many(std::make_move_iterator(upserts.begin()), std::make_move_iterator(upserts.end()), m_combine);
+      m_pending.clear();
+    }
+
+    // Returns the number of keys with a write waiting to be flushed.
+    size_type pending() const noexcept { return m_pending.size(); }
+
+    Map &map() noexcept { return m_map; }
+
+  private:
+    struct Pending {
+      mapped_type value{};
+      bool assign{false};
+    };
+
+    void note_write() {
+      if (m_pending.empty()) m_oldest = clock::now();
+    }
+
+    // The age of the oldest pending write is checked on every write, so that a thread that
+    // writes rarely still flushes within max_delay of its next write.
+    void flush_if_due() {
+      if (m_pending.size() >= m_max_pending || clock::now() - m_oldest >= m_max_delay) flush();
+    }
+
+    Map &m_map;
+    size_type m_max_pending;
+    clock::duration m_max_delay;
+    Combine m_combine;
+    clock::time_point m_oldest{};
+    std::unordered_map<key_type, Pending, typename Map::hasher, typename Map::key_equal> m_pending;
+  };
+
+} // namespace concurrency
+
+#endif // BUFFERED_WRITER_H
@@ -0,0 +1,133 @@
+#ifndef COUNTER_MAP_H
+#define COUNTER_MAP_H
+
+#include <concurrency/ShardedCounter.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace concurrency {
+  // This class provides a map of keys to counters for metrics-style workloads, where a
+  // moderate number of keys are incremented from many threads and read rarely. Rather than
+  // sharding by key, which puts every increment of a hot key on the same lock, the map is
+  // striped by thread: each stripe is an independently locked std::unordered_map holding
+  // partial counts, and a thread only ever writes to its own stripe. A write therefore takes
+  // a lock that no other writer is using, unless there are more threads than stripes.
+  //
+  // Reads merge the stripes lazily: sum() looks the key up in every stripe, and data() merges
+  // all of them. Each key may thus be stored once per stripe, so prefer ShardedUnorderedMap
+  // when there are many keys, each updated rarely.
+  //
+  // The stripe count defaults to the number of hardware threads, rounded up to a power of
+  // two. add_many() increments a run of keys under a single lock.
+  template <class Key, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>>
+  class CounterMap {
+    using counts_type = std::unordered_map<Key, int64_t, Hash, KeyEqual>;
+
+    struct alignas(64) Stripe {
+      std::mutex mutex{};
+      counts_type counts{};
+    };
+
+  public:
+    using key_type  = Key;
+    using size_type = std::size_t;
+
+    // ------------------------------ Constructors ------------------------------ //
+    explicit CounterMap(size_type stripe_count = std::thread::hardware_concurrency())
+        : m_mask(detail::stripe_count_for(std::max<size_type>(1, stripe_count)) - 1), m_stripes(std::make_unique<Stripe[]>(m_mask + 1)) {}
+
+    CounterMap(const CounterMap &)            = delete;
+    CounterMap &operator=(const CounterMap &) = delete;
+
+    // -------------------------------- Updates --------------------------------- //
+    void add(const Key &k, int64_t delta = 1) {
+      auto &s = own_stripe();
+      std::lock_guard<std::mutex> lock(s.mutex);
+      s.counts[k] += delta;
+    }
+
+    void increment(const Key &k) { add(k, 1); }
+
+    void decrement(const Key &k) { add(k, -1); }
+
+    // Increments the counter of every key in [first, last) by one.
+    template <class InputIt>
+    void add_many(InputIt first, InputIt last) {
+      auto &s = own_stripe();
+      std::lock_guard<std::mutex> lock(s.mutex);
+      for (; first != last; ++first) {
+        ++s.counts[*first];
+      }
+    }
+
+    // Removes the key's counter. Returns true if the key was present.
+    bool erase(const Key &k) {
+      bool erased = false;
+      for (size_type i = 0; i <= m_mask; ++i) {
+        std::lock_guard<std::mutex> lock(m_stripes[i].mutex);
+        erased = m_stripes[i].counts.erase(k) != 0 || erased;
+      }
+      return erased;
+    }
+
+    void clear() {
+      for (size_type i = 0; i <= m_mask; ++i) {
+        std::lock_guard<std::mutex> lock(m_stripes[i].mutex);
+        m_stripes[i].counts.clear();
+      }
+    }
+
+    // --------------------------------- Reads ---------------------------------- //
+    // Returns the key's count, or 0 if it was never added to.
+    int64_t sum(const Key &k) const {
+      int64_t sum = 0;
+      for (size_type i = 0; i <= m_mask; ++i) {
+        std::lock_guard<std::mutex> lock(m_stripes[i].mutex);
+        auto it = m_stripes[i].counts.find(k);
+        if (it != m_stripes[i].counts.end()) sum += it->second;
+      }
+      return sum;
+    }
+
+    // Returns the sum over all keys.
+    int64_t total() const {
+      int64_t sum = 0;
+      for (size_type i = 0; i <= m_mask; ++i) {
+        std::lock_guard<std::mutex> lock(m_stripes[i].mutex);
+        for (auto const &el: m_stripes[i].counts) {
+          sum += el.second;
+        }
+      }
+      return sum;
+    }
+
+    // Returns a copy of every key's count.
+    counts_type data() const {
+      counts_type merged;
+      for (size_type i = 0; i <= m_mask; ++i) {
+        std::lock_guard<std::mutex> lock(m_stripes[i].mutex);
+        for (auto const &el: m_stripes[i].counts) {
+          merged[el.first] += el.second;
+        }
+      }
+      return merged;
+    }
+
+    size_type stripe_count() const noexcept { return m_mask + 1; }
+
+  private:
+    Stripe &own_stripe() const noexcept { return m_stripes[detail::thread_stripe() & m_mask]; }
+
+    size_type const m_mask;
+    std::unique_ptr<Stripe[]> m_stripes;
+  };
+
+} // namespace concurrency
+
+#endif // COUNTER_MAP_H
@@ -0,0 +1,371 @@
+#ifndef DELEGATED_SHARDED_MAP_H
+#define DELEGATED_SHARDED_MAP_H
+
+#include <concurrency/FlatHashMap.hpp>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace concurrency {
+  constexpr uint32_t DefaultDelegatedShardCount       = 4;
+  constexpr std::size_t DefaultDelegatedQueueCapacity = 1024;
+  constexpr std::size_t DelegatedMaxBatchSize         = 256;
+
+  namespace detail {
+    // A bounded, lock-free, multi-producer single-consumer ring buffer. Each cell carries a
+    // sequence number that tells producers and the consumer whose turn it is, so that
+    // neither side ever waits on the other while a cell is being written.
+    //
+    // http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+    template <class T>
+    class MpscRing {
+      struct alignas(64) Cell {
+        std::atomic<std::size_t> sequence{0};
+        T value{};
+      };
+
+    public:
+      explicit MpscRing(std::size_t capacity) {
+        std::size_t rounded = 2;
+        while (rounded < capacity) {
+          rounded *= 2;
+        }
+        m_cells = std::make_unique<Cell[]>(rounded);
+        m_mask  = rounded - 1;
+        for (std::size_t i = 0; i < rounded; ++i) {
+          m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+      }
+
+      // Returns false, leaving value untouched, if the ring is full.
+      bool try_push(T &value) {
+        auto pos = m_tail.load(std::memory_order_relaxed);
+        while (true) {
+          auto &cell      = m_cells[pos & m_mask];
+          auto const seq  = cell.sequence.load(std::memory_order_acquire);
+          auto const diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+          if (diff == 0) {
+            if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+              cell.value = std::move(value);
+              cell.sequence.store(pos + 1, std::memory_order_release);
+              return true;
+            }
+          } else if (diff < 0) {
+            return false;
+          } else {
+            pos = m_tail.load(std::memory_order_relaxed);
+          }
+        }
+      }
+
+      // Must only be called from the single consumer thread.
+      bool try_pop(T &value) {
+        auto const pos = m_head.load(std::memory_order_relaxed);
+        auto &cell     = m_cells[pos & m_mask];
+        if (cell.sequence.load(std::memory_order_acquire) != pos + 1) return false;
+        value = std::move(cell.value);
+        cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+        m_head.store(pos + 1, std::memory_order_relaxed);
+        return true;
+      }
+
+      // May report a push that is still in progress as not yet visible.
+      bool empty() const noexcept {
+        auto const pos = m_head.load(std::memory_order_relaxed);
+        return m_cells[pos & m_mask].sequence.load(std::memory_order_acquire) != pos + 1;
+      }
+
+    private:
+      std::unique_ptr<Cell[]> m_cells;
+      std::size_t m_mask{0};
+      alignas(64) std::atomic<std::size_t> m_tail{0};
+      alignas(64) std::atomic<std::size_t> m_head{0};
+    };
+  } // namespace detail
+
+  // This class provides a sharded, unordered map in which every shard is owned by a dedicated
+  // worker thread. Rather than locking a shard, callers submit operations to its worker through
+  // a lock-free ring buffer and receive the results through std::futures, so a shard's data is
+  // only ever touched by one thread and stays in that thread's caches. Each time a worker wakes
+  // up it applies up to DelegatedMaxBatchSize queued operations before checking in again.
+  //
+  // In addition to the usual single-key operations, arbitrary work may be delegated to the
+  // worker that owns a key with submit(), which returns a future, or post(), which does not.
+  // Operations on the same key are applied in the order in which they were submitted by any
+  // one thread. If a shard's queue is full, submitting to it blocks until there is room.
+  //
+  // Whole-map operations such as size(), clear(), and data() submit work to every shard and
+  // wait for the results. Workers are stopped, after draining their queues, on destruction.
+  template <class Key,
+            class Val,
+            uint32_t ShardCount                   = DefaultDelegatedShardCount,
+            class Hash                            = std::hash<Key>,
+            class Pred                            = std::equal_to<Key>,
+            class Allocator                       = std::allocator<std::pair<const Key, Val>>,
+            template <class...> class InternalMap = std::unordered_map>
+  class DelegatedShardedMap {
+    static_assert(ShardCount != 0, "ShardCount template parameter must be non-zero.");
+
+  public:
+    // ------------------------------ Member types ------------------------------ //
+    using self_type         = DelegatedShardedMap<Key, Val, ShardCount, Hash, Pred, Allocator, InternalMap>;
+    using internal_map_type = InternalMap<Key, Val, Hash, Pred, Allocator>;
+    using key_type          = typename internal_map_type::key_type;
+    using mapped_type       = typename internal_map_type::mapped_type;
+    using value_type        = typename internal_map_type::value_type;
+    using size_type         = typename internal_map_type::size_type;
+    using hasher            = typename internal_map_type::hasher;
+    using key_equal         = typename internal_map_type::key_equal;
+
+  private:
+    class Task {
+    public:
+      virtual ~Task()                         = default;
+      virtual void run(internal_map_type &map) = 0;
+    };
+
+    template <class F>
+    class TaskImpl final : public Task {
+    public:
+      explicit TaskImpl(F &&f) : m_f(std::move(f)) {}
+      void run(internal_map_type &map) override { m_f(map); }
+
+    private:
+      F m_f;
+    };
+
+    using task_ptr = std::unique_ptr<Task>;
+
+    struct Shard {
+      explicit Shard(std::size_t queue_capacity) : queue(queue_capacity) {}
+
+      detail::MpscRing<task_ptr> queue;
+      internal_map_type map{};
+      std::mutex mutex{};
+      std::condition_variable wakeup{};
+      std::atomic_bool sleeping{false};
+      std::atomic_bool stopping{false};
+      std::thread worker{};
+    };
+
+  public:
+    // ------------------------------ Constructors ------------------------------ //
+    // Starts one worker thread per shard. Each shard's queue holds at least
+    // queue_capacity pending operations.
+    explicit DelegatedShardedMap(std::size_t queue_capacity = DefaultDelegatedQueueCapacity) {
+      for (auto &shard: m_shards) {
+        shard = std::make_unique<Shard>(queue_capacity);
+      }
+      for (auto &shard: m_shards) {
+        shard->worker = std::thread(&self_type::run_worker, std::ref(*shard));
+      }
+    }
+    DelegatedShardedMap(std::initializer_list<value_type> ilist) : DelegatedShardedMap() {
+      for (auto const &el: ilist) {
+        (void) insert(el);
+      }
+    }
+
+    DelegatedShardedMap(const DelegatedShardedMap &)            = delete;
+    DelegatedShardedMap &operator=(const DelegatedShardedMap &) = delete;
+
+    ~DelegatedShardedMap() {
+      for (auto &shard: m_shards) {
+        shard->stopping.store(true, std::memory_order_seq_cst);
+        wake(*shard);
+      }
+      for (auto &shard: m_shards) {
+        shard->worker.join();
+      }
+    }
+
+    // -------------------------------- Capacity -------------------------------- //
+    bool empty() const { return size() == 0; }
+
+    size_type size() const {
+      return reduce_shards([](internal_map_type &m) { return m.size(); });
+    }
+
+    // ------------------------------- Modifiers -------------------------------- //
+    void clear() {
+      (void) reduce_shards([](internal_map_type &m) {
+        m.clear();
+        return size_type{0};
+      });
+    }
+
+    std::future<bool> insert(const value_type &value) {
+      return submit(value.first, [value](internal_map_type &m) { return m.insert(value).second; });
+    }
+    std::future<bool> insert(value_type &&value) {
+      auto const &key = value.first;
+      return submit(key, [value = std::move(value)](internal_map_type &m) mutable { return m.insert(std::move(value)).second; });
+    }
+
+    template <class M>
+    std::future<bool> insert_or_assign(const Key &k, M &&obj) {
+      return submit(k, [k, obj = std::forward<M>(obj)](internal_map_type &m) mutable { return m.insert_or_assign(k, std::move(obj)).second; });
+    }
+
+    std::future<size_type> erase(const Key &key) {
+      return submit(key, [key](internal_map_type &m) { return m.erase(key); });
+    }
+
+    // ------------------------------ Accessors --------------------------------- //
+    // Returns a future holding a copy of the element mapped to the provided key,
+    // or holding std::out_of_range if the key is not present.
+    std::future<Val> at(const Key &key) const {
+      return submit(key, [key](internal_map_type &m) { return m.at(key); });
+    }
+
+    std::future<size_type> count(const Key &key) const {
+      return submit(key, [key](internal_map_type &m) { return m.count(key); });
+    }
+
+    // Returns a future holding a bool indicating whether
+    // or not the provided key is present in the map.
+    std::future<bool> find(const Key &key) const {
+      return submit(key, [key](internal_map_type &m) { return m.find(key) != m.end(); });
+    }
+
+    // Returns a copy of the data in each
+    // shard as a single non-thread-safe map.
+    internal_map_type data() const {
+      std::vector<std::future<internal_map_type>> parts;
+      for (auto const &shard: m_shards) {
+        parts.push_back(submit_to(*shard, [](internal_map_type &m) { return m; }));
+      }
+      internal_map_type m;
+      for (auto &part: parts) {
+        auto shard_data = part.get();
+        m.merge(shard_data);
+      }
+      return m;
+    }
+
+    // ------------------------------- Delegation ------------------------------- //
+    // Runs f(map) on the worker that owns key, where map is that worker's shard, and returns
+    // a future holding its result or the exception it threw. f may read and modify any
+    // element of the shard whose key maps to it, but must not retain references to the shard.
+    template <class F>
+    auto submit(const Key &key, F &&f) const -> std::future<std::invoke_result_t<std::decay_t<F> &, internal_map_type &>> {
+      return submit_to(*m_shards[get_shard_idx(key)], std::forward<F>(f));
+    }
+
+    // Runs f(map) on the worker that owns key, like submit(), but without a future. Use
+    // this to deliver results through a callback. Exceptions thrown by f are discarded.
+    template <class F>
+    void post(const Key &key, F &&f) const {
+      enqueue(*m_shards[get_shard_idx(key)], [f = std::forward<F>(f)](internal_map_type &m) mutable {
+        try {
+          f(m);
+        } catch (...) {
+        }
+      });
+    }
+
+    // ------------------------------ Hash Policy ------------------------------- //
+    uint32_t shard_count() const noexcept { return ShardCount; }
+
+    // ------------------------------- Observers -------------------------------- //
+    hasher hash_function() const { return hasher(); }
+
+    key_equal key_eq() const { return key_equal(); }
+
+  private:
+    uint32_t get_shard_idx(Key const &key) const { return hash_function()(key) % ShardCount; }
+
+    template <class F>
+    auto submit_to(Shard &shard, F &&f) const -> std::future<std::invoke_result_t<std::decay_t<F> &, internal_map_type &>> {
+      using result_type = std::invoke_result_t<std::decay_t<F> &, internal_map_type &>;
+      std::promise<result_type> promise;
+      auto future = promise.get_future();
+      enqueue(shard, [f = std::forward<F>(f), promise = std::move(promise)](internal_map_type &m) mutable {
+        try {
+          if constexpr (std::is_void_v<result_type>) {
+            f(m);
+            promise.set_value();
+          } else {
+            promise.set_value(f(m));
+          }
+        } catch (...) {
+          promise.set_exception(std::current_exception());
+        }
+      });
+      return future;
+    }
+
+    // Submits f to every shard and returns the sum of the results.
+    template <class F>
+    size_type reduce_shards(F const &f) const {
+      std::vector<std::future<size_type>> parts;
+      for (auto const &shard: m_shards) {
+        parts.push_back(submit_to(*shard, f));
+      }
+      size_type total = 0;
+      for (auto &part: parts) {
+        total += part.get();
+      }
+      return total;
+    }
+
+    template <class F>
+    static void enqueue(Shard &shard, F &&f) {
+      task_ptr task = std::make_unique<TaskImpl<std::decay_t<F>>>(std::forward<F>(f));
+      while (!shard.queue.try_push(task)) {
+        wake(shard);
+        std::this_thread::yield();
+      }
+      wake(shard);
+    }
+
+    // The fences pair with those in run_worker(), so that either the worker sees the new
+    // task before sleeping or this thread sees that the worker is sleeping.
+    static void wake(Shard &shard) {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!shard.sleeping.load(std::memory_order_relaxed)) return;
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.wakeup.notify_one();
+    }
+
+    static void run_worker(Shard &shard) {
+      task_ptr task;
+      while (true) {
+        std::size_t processed = 0;
+        while (processed < DelegatedMaxBatchSize && shard.queue.try_pop(task)) {
+          task->run(shard.map);
+          task.reset();
+          ++processed;
+        }
+        if (processed != 0) continue;
+        if (shard.stopping.load(std::memory_order_acquire)) {
+          if (shard.queue.empty()) return;
+          continue;
+        }
+
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        shard.sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        shard.wakeup.wait(lock, [&shard]() { return !shard.queue.empty() || shard.stopping.load(std::memory_order_acquire); });
+        shard.sleeping.store(false, std::memory_order_relaxed);
+      }
+    }
+
+    std::array<std::unique_ptr<Shard>, ShardCount> m_shards{};
+  };
+
+} // namespace concurrency
+
+#endif // DELEGATED_SHARDED_MAP_H
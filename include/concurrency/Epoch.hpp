@@ -0,0 +1,293 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace concurrency {
+  // Each thread tries to reclaim what it has retired after this many calls to retire().
+  constexpr std::size_t EpochReclaimInterval = 64;
+
+  // This class implements epoch-based memory reclamation for structures whose readers do
+  // not take locks. A reader calls pin() and keeps the returned guard for as long as it
+  // uses pointers loaded from the shared structure. A writer that unlinks an object passes
+  // it to retire() instead of deleting it, and the object is only destroyed once every
+  // thread that was pinned at the time has unpinned.
+  //
+  // A global epoch counter is advanced when every pinned thread has observed its current
+  // value. Objects are stamped with the epoch in which they were retired, and an object
+  // retired in epoch e is freed once the global epoch reaches e + 2, since by then no
+  // thread can still be pinned in an epoch that saw the object linked. Pinning costs a
+  // store to a slot that only the calling thread writes and a fence, so readers never
+  // contend with each other the way std::shared_lock does on a shared_mutex.
+  //
+  // Retired objects are kept per thread and reclaimed by the retiring thread every
+  // EpochReclaimInterval retirements, or by calling reclaim(). What a thread has retired
+  // but not yet freed when it exits is handed to whichever thread next calls reclaim(),
+  // and anything still pending is freed when the Epoch is destroyed. A thread that stays
+  // pinned stops the epoch from advancing, so guards should be short-lived.
+  //
+  // The destructor must not run while any thread is pinned or retiring.
+  class Epoch {
+    struct Retired {
+      void *object;
+      void (*destroy)(void *);
+      uint64_t epoch;
+    };
+
+    struct alignas(64) Record {
+      // The epoch this thread is pinned in, or zero if it is not pinned.
+      std::atomic<uint64_t> pinned{0};
+      std::atomic_bool in_use{true};
+      unsigned nesting             = 0;
+      std::size_t since_reclaim    = 0;
+      std::vector<Retired> retired = {};
+      Record *next                 = nullptr;
+    };
+
+    struct State {
+      ~State() {
+        for (Record *r = records.load(std::memory_order_acquire); r != nullptr;) {
+          Record *next = r->next;
+          destroy(r->retired);
+          delete r;
+          r = next;
+        }
+        destroy(orphans);
+      }
+
+      // Marks a record free for reuse by another thread, leaving its pending objects
+      // for the next reclaim().
+      void release(Record &r) {
+        if (!r.retired.empty()) {
+          std::lock_guard<std::mutex> lock(orphans_mutex);
+          orphans.insert(orphans.end(), r.retired.begin(), r.retired.end());
+        }
+        r.retired.clear();
+        r.since_reclaim = 0;
+        r.in_use.store(false, std::memory_order_release);
+      }
+
+      std::atomic<uint64_t> global{1};
+      std::atomic<Record *> records{nullptr};
+      std::mutex orphans_mutex;
+      std::vector<Retired> orphans;
+    };
+
+    // The records this thread holds in every Epoch it has used. Records are returned
+    // to their Epoch when the thread exits, unless the Epoch is already gone.
+    struct ThreadRecords {
+      struct Entry {
+        uint64_t id;
+        std::weak_ptr<State> state;
+        Record *record;
+      };
+
+      ~ThreadRecords() {
+        for (auto &e: entries) {
+          if (auto state = e.state.lock()) state->release(*e.record);
+        }
+      }
+
+      std::vector<Entry> entries;
+      std::size_t last = 0;
+    };
+
+  public:
+    // Keeps the calling thread pinned until destroyed. Guards may nest.
+    class guard {
+    public:
+      guard(guard &&other) noexcept : m_record(std::exchange(other.m_record, nullptr)) {}
+      guard(const guard &)            = delete;
+      guard &operator=(const guard &) = delete;
+      guard &operator=(guard &&)      = delete;
+
+      ~guard() {
+        if (m_record != nullptr && --m_record->nesting == 0) {
+          m_record->pinned.store(0, std::memory_order_release);
+        }
+      }
+
+    private:
+      friend class Epoch;
+      explicit guard(Record *record) noexcept : m_record(record) {}
+
+      Record *m_record;
+    };
+
+    Epoch() : m_state(std::make_shared<State>()), m_id(next_id()) {}
+
+    Epoch(const Epoch &)            = delete;
+    Epoch &operator=(const Epoch &) = delete;
+
+    // Pins the calling thread in the current epoch. Objects retired from now on are not
+    // freed until the returned guard, and every other guard, has been destroyed.
+    [[nodiscard]] guard pin() {
+      Record &r = record();
+      if (r.nesting++ == 0) {
+        // The pinned epoch must be visible before this thread loads any shared pointer. The
+        // fence pairs with the one in try_advance(): either that scan sees this pin, or this
+        // thread sees every object unlinked before the epoch advanced as unreachable.
+        r.pinned.store(m_state->global.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+      }
+      return guard(&r);
+    }
+
+    // Destroys object with delete once no pinned thread can still reach it. object must
+    // already be unreachable for threads that pin from now on.
+    template <class T>
+    void retire(T *object) {
+      retire(object, std::default_delete<T>());
+    }
+
+    // Calls deleter(object) once no pinned thread can still reach it.
+    template <class T, class D>
+    void retire(T *object, D deleter) {
+      using deleter_type = std::decay_t<D>;
+      if (object == nullptr) return;
+      if constexpr (std::is_empty_v<deleter_type> && std::is_default_constructible_v<deleter_type>) {
+        (void) deleter;
+        push(object, [](void *p) { deleter_type()(static_cast<T *>(p)); });
+      } else {
+        using boxed_type = std::pair<deleter_type, T *>;
+        auto boxed       = std::make_unique<boxed_type>(std::move(deleter), object);
+        push(boxed.get(), [](void *p) {
+          std::unique_ptr<boxed_type> b(static_cast<boxed_type *>(p));
+          b->first(b->second);
+        });
+        (void) boxed.release();
+      }
+    }
+
+    // Tries to advance the epoch, then frees whatever the calling thread and any exited
+    // thread have retired that no pinned thread can still reach. Returns the number of
+    // objects freed.
+    std::size_t reclaim() {
+      Record &r = record();
+      return collect(r, true);
+    }
+
+    // Returns the current global epoch.
+    uint64_t epoch() const noexcept { return m_state->global.load(std::memory_order_acquire); }
+
+    // Returns the number of objects the calling thread has retired but not yet freed.
+    std::size_t pending() { return record().retired.size(); }
+
+  private:
+    static uint64_t next_id() noexcept {
+      static std::atomic<uint64_t> id{0};
+      return id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static ThreadRecords &thread_records() {
+      static thread_local ThreadRecords records;
+      return records;
+    }
+
+    static void destroy(std::vector<Retired> &retired) noexcept {
+      for (auto const &r: retired) {
+        r.destroy(r.object);
+      }
+      retired.clear();
+    }
+
+    // Returns the calling thread's record, claiming a free one or adding a new one the
+    // first time this thread uses this Epoch.
+    Record &record() {
+      auto &tr = thread_records();
+      if (tr.last < tr.entries.size() && tr.entries[tr.last].id == m_id) {
+        return *tr.entries[tr.last].record;
+      }
+      for (std::size_t i = 0; i < tr.entries.size(); ++i) {
+        if (tr.entries[i].id == m_id) {
+          tr.last = i;
+          return *tr.entries[i].record;
+        }
+      }
+      // Entries of destroyed Epochs are dropped here so they do not accumulate.
+      tr.entries.erase(std::remove_if(tr.entries.begin(), tr.entries.end(), [](auto const &e) { return e.state.expired(); }), tr.entries.end());
+
+      Record *claimed = nullptr;
+      for (Record *r = m_state->records.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+        bool expected = false;
+        if (!r->in_use.load(std::memory_order_relaxed) && r->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+          claimed = r;
+          break;
+        }
+      }
+      if (claimed == nullptr) {
+        auto fresh = std::make_unique<Record>();
+        fresh->next = m_state->records.load(std::memory_order_relaxed);
+        while (!m_state->records.compare_exchange_weak(fresh->next, fresh.get(), std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        claimed = fresh.release();
+      }
+      tr.entries.push_back({m_id, m_state, claimed});
+      tr.last = tr.entries.size() - 1;
+      return *claimed;
+    }
+
+    void push(void *object, void (*destroy)(void *)) {
+      Record &r = record();
+      // Reading the epoch after object was unlinked guarantees that any thread pinned in
+      // an older epoch is waited for.
+      r.retired.push_back({object, destroy, m_state->global.load(std::memory_order_seq_cst)});
+      if (++r.since_reclaim >= EpochReclaimInterval) {
+        r.since_reclaim = 0;
+        (void) collect(r, false);
+      }
+    }
+
+    // Advances the global epoch if every pinned thread has observed it. Returns the
+    // epoch in effect afterwards.
+    uint64_t try_advance() noexcept {
+      uint64_t current = m_state->global.load(std::memory_order_seq_cst);
+      // Pairs with the fence in pin(), so that no thread pinned before this point is missed.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      for (Record *r = m_state->records.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+        uint64_t const pinned = r->pinned.load(std::memory_order_seq_cst);
+        if (pinned != 0 && pinned != current) return current;
+      }
+      if (m_state->global.compare_exchange_strong(current, current + 1, std::memory_order_seq_cst)) {
+        return current + 1;
+      }
+      return current;
+    }
+
+    // Frees the objects in r, and in the orphans if include_orphans, retired at least two
+    // epochs ago.
+    std::size_t collect(Record &r, bool const include_orphans) {
+      uint64_t const epoch = try_advance();
+      auto const expired   = [epoch](const Retired &retired) { return retired.epoch + 2 <= epoch; };
+
+      std::vector<Retired> freeable;
+      auto const split = [&freeable, &expired](std::vector<Retired> &retired) {
+        auto const it = std::stable_partition(retired.begin(), retired.end(), [&expired](const Retired &x) { return !expired(x); });
+        freeable.insert(freeable.end(), it, retired.end());
+        retired.erase(it, retired.end());
+      };
+      split(r.retired);
+      if (include_orphans) {
+        std::lock_guard<std::mutex> lock(m_state->orphans_mutex);
+        split(m_state->orphans);
+      }
+      // Deleters may retire further objects, so they run only after the lists are settled.
+      std::size_t const freed = freeable.size();
+      destroy(freeable);
+      return freed;
+    }
+
+    std::shared_ptr<State> m_state;
+    uint64_t m_id;
+  };
+
+} // namespace concurrency
+
+#endif // EPOCH_H
@@ -0,0 +1,377 @@
+#ifndef EXPIRING_SHARDED_MAP_H
+#define EXPIRING_SHARDED_MAP_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace concurrency {
+  constexpr uint32_t DefaultExpiringMapShardCount = 32;
+  constexpr std::chrono::milliseconds DefaultExpiringMapTick{100};
+
+  namespace detail {
+    // A hierarchical timing wheel of TimingWheelLevels levels with TimingWheelSlots slots each.
+    // A slot on level l spans TimingWheelSlots^l ticks. Items are filed on the lowest level
+    // whose span reaches their deadline, and every time a level wraps around, the next slot of
+    // the level above is cascaded down, so advancing by one tick touches one slot on most
+    // ticks no matter how many items are scheduled. Deadlines beyond the top level's span are
+    // filed in its farthest slot and re-filed each time that slot is cascaded.
+    //
+    // Not thread-safe.
+    template <class T>
+    class TimingWheel {
+      static constexpr std::size_t TimingWheelLevels = 4;
+      static constexpr std::size_t TimingWheelBits   = 6;
+      static constexpr std::size_t TimingWheelSlots  = std::size_t(1) << TimingWheelBits;
+      static constexpr uint64_t SlotMask             = TimingWheelSlots - 1;
+      static constexpr uint64_t Horizon              = uint64_t(1) << (TimingWheelBits * TimingWheelLevels);
+
+      struct Item {
+        T value;
+        uint64_t deadline;
+      };
+
+    public:
+      // Returns the tick the wheel has advanced to.
+      uint64_t now() const noexcept { return m_now; }
+
+      // Returns the number of scheduled items.
+      std::size_t size() const noexcept { return m_size; }
+
+      // Schedules value to fire once the wheel advances to deadline, or on the next tick
+      // if deadline has already passed. Returns the tick the item is scheduled for.
+      uint64_t schedule(T value, uint64_t deadline) {
+        deadline = std::max(deadline, m_now + 1);
+        file(Item{std::move(value), deadline});
+        ++m_size;
+        return deadline;
+      }
+
+      // Advances the wheel to tick target, calling fire(value, deadline) for every item whose
+      // deadline is passed along the way. fire may schedule further items. Returns the number
+      // of items fired.
+      template <class F>
+      std::size_t advance(uint64_t target, F &&fire) {
+        std::size_t fired = 0;
+        if (m_size == 0 && target > m_now) m_now = target;
+        while (m_now < target) {
+          ++m_now;
+          cascade();
+          auto due = std::move(m_slots[0][m_now & SlotMask]);
+          m_slots[0][m_now & SlotMask].clear();
+          m_size -= due.size();
+          for (auto &item: due) {
+            fire(item.value, item.deadline);
+          }
+          fired += due.size();
+          if (m_size == 0) m_now = target;
+        }
+        return fired;
+      }
+
+      void clear() noexcept {
+        for (auto &level: m_slots) {
+          for (auto &slot: level) {
+            slot.clear();
+          }
+        }
+        m_size = 0;
+      }
+
+    private:
+      // Files item in the slot that will be due, or cascaded, at its deadline.
+      void file(Item &&item) {
+        auto const delta = item.deadline - m_now;
+        auto const due   = delta < Horizon ? item.deadline : m_now + Horizon - 1;
+        std::size_t level = 0;
+        while (level + 1 < TimingWheelLevels && (delta >> (TimingWheelBits * (level + 1))) != 0) {
+          ++level;
+        }
+        m_slots[level][(due >> (TimingWheelBits * level)) & SlotMask].push_back(std::move(item));
+      }
+
+      // Called after m_now crosses a level 0 revolution: moves the items of the current slot
+      // of each level that just wrapped down to the levels below.
+      void cascade() {
+        for (std::size_t level = 1; level < TimingWheelLevels; ++level) {
+          if (((m_now >> (TimingWheelBits * (level - 1))) & SlotMask) != 0) return;
+          auto &slot = m_slots[level][(m_now >> (TimingWheelBits * level)) & SlotMask];
+          auto items = std::move(slot);
+          slot.clear();
+          for (auto &item: items) {
+            if (item.deadline <= m_now) {
+              m_slots[0][m_now & SlotMask].push_back(std::move(item));
+            } else {
+              file(std::move(item));
+            }
+          }
+        }
+      }
+
+      std::array<std::array<std::vector<Item>, TimingWheelSlots>, TimingWheelLevels> m_slots{};
+      uint64_t m_now{0};
+      std::size_t m_size{0};
+    };
+  } // namespace detail
+
+  // This class provides a sharded, thread-safe, unordered map whose entries expire. Every entry
+  // is written with a time to live, after which find(), at(), and count() no longer see it.
+  //
+  // Each shard schedules its entries' expiry times on a hierarchical timing wheel (see
+  // detail::TimingWheel) with a resolution of one tick, and reclaims expired entries by
+  // advancing the wheel, which only visits the entries that are due rather than scanning the
+  // shard. Writes to a shard advance its wheel, and expire() advances every shard's wheel, so a
+  // map that is rarely written to should call expire() periodically; this does not block
+  // writers to other shards. size() counts expired entries that have not yet been reclaimed.
+  //
+  // Each entry has a single item on its shard's wheel, which is left in place when a write or
+  // touch() postpones the entry's expiry and is rescheduled for the new expiry once it comes
+  // due, so frequently touched entries cost no more than idle ones. Only a write that brings
+  // an entry's expiry forward schedules a new item, and the old one is ignored when it comes
+  // due, as is the item of an erased entry.
+  template <class Key,
+            class Val,
+            uint32_t ShardCount = DefaultExpiringMapShardCount,
+            class Hash          = std::hash<Key>,
+            class Pred          = std::equal_to<Key>,
+            class Clock         = std::chrono::steady_clock>
+  class ExpiringShardedMap {
+    static_assert(ShardCount != 0, "ShardCount template parameter must be non-zero.");
+
+  public:
+    // ------------------------------ Member types ------------------------------ //
+    using key_type    = Key;
+    using mapped_type = Val;
+    using size_type   = std::size_t;
+    using hasher      = Hash;
+    using key_equal   = Pred;
+    using clock       = Clock;
+    using time_point  = typename Clock::time_point;
+    using duration    = typename Clock::duration;
+
+  private:
+    struct Entry {
+      Val value;
+      time_point expiry;
+      // The tick the entry's item on the wheel is scheduled for.
+      uint64_t scheduled{0};
+    };
+
+    struct alignas(64) Shard {
+      mutable std::shared_mutex mutex{};
+      std::unordered_map<Key, Entry, Hash, Pred> map{};
+      detail::TimingWheel<Key> wheel{};
+    };
+
+  public:
+    // ------------------------------ Constructors ------------------------------ //
+    // Entries are reclaimed within one tick of expiring, as long as the map is written to or
+    // expire() is called.
+    explicit ExpiringShardedMap(duration tick = DefaultExpiringMapTick) : m_epoch(Clock::now()), m_tick(tick > duration::zero() ? tick : duration(1)) {}
+
+    ExpiringShardedMap(const ExpiringShardedMap &)            = delete;
+    ExpiringShardedMap &operator=(const ExpiringShardedMap &) = delete;
+
+    // -------------------------------- Capacity -------------------------------- //
+    // Includes expired entries that have not yet been reclaimed.
+    size_type size() const {
+      size_type n = 0;
+      for (auto const &shard: m_shards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        n += shard.map.size();
+      }
+      return n;
+    }
+
+    // ------------------------------- Modifiers -------------------------------- //
+    // Inserts obj, to expire ttl from now, unless an unexpired entry for k exists. Returns
+    // true if obj was inserted.
+    template <class M>
+    bool insert(const Key &k, M &&obj, duration ttl) {
+      auto const now = Clock::now();
+      auto &shard    = get_shard(k);
+      std::unique_lock<std::shared_mutex> lock(shard.mutex);
+      advance_locked(shard, now);
+      auto it = shard.map.find(k);
+      if (it != shard.map.end() && it->second.expiry > now) return false;
+      write_locked(shard, it, k, std::forward<M>(obj), now + ttl);
+      return true;
+    }
+
+    // Inserts or replaces the entry for k, to expire ttl from now. Returns true if no
+    // unexpired entry for k existed.
+    template <class M>
+    bool insert_or_assign(const Key &k, M &&obj, duration ttl) {
+      auto const now = Clock::now();
+      auto &shard    = get_shard(k);
+      std::unique_lock<std::shared_mutex> lock(shard.mutex);
+      advance_locked(shard, now);
+      auto it             = shard.map.find(k);
+      bool const inserted = it == shard.map.end() || it->second.expiry <= now;
+      write_locked(shard, it, k, std::forward<M>(obj), now + ttl);
+      return inserted;
+    }
+
+    // Postpones the expiry of the entry for k to ttl from now. Returns false if there is no
+    // unexpired entry for k.
+    bool touch(const Key &k, duration ttl) {
+      auto const now = Clock::now();
+      auto &shard    = get_shard(k);
+      std::unique_lock<std::shared_mutex> lock(shard.mutex);
+      advance_locked(shard, now);
+      auto it = shard.map.find(k);
+      if (it == shard.map.end() || it->second.expiry <= now) return false;
+      it->second.expiry = now + ttl;
+      schedule_locked(shard, k, it->second);
+      return true;
+    }
+
+    // Returns the number of unexpired entries removed, which is either 0 or 1.
+    size_type erase(const Key &key) {
+      auto const now = Clock::now();
+      auto &shard    = get_shard(key);
+      std::unique_lock<std::shared_mutex> lock(shard.mutex);
+      advance_locked(shard, now);
+      auto it = shard.map.find(key);
+      if (it == shard.map.end()) return 0;
+      bool const live = it->second.expiry > now;
+      shard.map.erase(it);
+      return live ? 1 : 0;
+    }
+
+    void clear() {
+      for (auto &shard: m_shards) {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.map.clear();
+        shard.wheel.clear();
+      }
+    }
+
+    // Reclaims every expired entry whose tick has passed, one shard at a time. Returns the
+    // number of entries reclaimed.
+    size_type expire() {
+      size_type reclaimed = 0;
+      for (auto &shard: m_shards) {
+        auto const now = Clock::now();
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        reclaimed += advance_locked(shard, now);
+      }
+      return reclaimed;
+    }
+
+    // --------------------------------- Lookup --------------------------------- //
+    // Returns a copy of the unexpired element mapped to key. Does bounds checking.
+    Val at(const Key &key) const {
+      auto const now    = Clock::now();
+      auto const &shard = get_shard(key);
+      std::shared_lock<std::shared_mutex> lock(shard.mutex);
+      auto it = shard.map.find(key);
+      if (it == shard.map.end() || it->second.expiry <= now) throw std::out_of_range("::concurrency::ExpiringShardedMap::at: key not found");
+      return it->second.value;
+    }
+
+    size_type count(const Key &key) const { return find(key) ? 1 : 0; }
+
+    // Returns a bool indicating whether or not an unexpired
+    // entry for the provided key is present in the map.
+    bool find(const Key &key) const { return expiry(key).has_value(); }
+
+    // Returns the time at which the entry for key expires, or nothing if there is no
+    // unexpired entry for key.
+    std::optional<time_point> expiry(const Key &key) const {
+      auto const now    = Clock::now();
+      auto const &shard = get_shard(key);
+      std::shared_lock<std::shared_mutex> lock(shard.mutex);
+      auto it = shard.map.find(key);
+      if (it == shard.map.end() || it->second.expiry <= now) return std::nullopt;
+      return it->second.expiry;
+    }
+
+    // Returns the number of expiry times scheduled on the shards' timing wheels, including
+    // those of entries erased or rescheduled since.
+    size_type scheduled() const {
+      size_type n = 0;
+      for (auto const &shard: m_shards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        n += shard.wheel.size();
+      }
+      return n;
+    }
+
+    // ---------------------------------- Misc ---------------------------------- //
+    static constexpr uint32_t shard_count() noexcept { return ShardCount; }
+    duration tick() const noexcept { return m_tick; }
+    hasher hash_function() const { return hasher(); }
+
+  private:
+    // Callers must hold the shard's write lock.
+    template <class It, class M>
+    void write_locked(Shard &shard, It it, const Key &k, M &&obj, time_point expiry) {
+      if (it == shard.map.end()) {
+        it = shard.map.emplace(k, Entry{Val(std::forward<M>(obj)), expiry}).first;
+      } else {
+        it->second.value  = std::forward<M>(obj);
+        it->second.expiry = expiry;
+      }
+      schedule_locked(shard, k, it->second);
+    }
+
+    // Makes sure entry has an item on the wheel that comes due no later than its expiry.
+    // An item that comes due earlier is kept, and rescheduled by advance_locked(). Callers
+    // must hold the shard's write lock.
+    void schedule_locked(Shard &shard, const Key &k, Entry &entry) {
+      auto const tick = to_tick_ceil(entry.expiry);
+      if (entry.scheduled != 0 && entry.scheduled <= tick) return;
+      entry.scheduled = shard.wheel.schedule(k, tick);
+    }
+
+    // Advances the shard's wheel to now, erasing every entry that has expired by then.
+    // Items that came due before their entry's current expiry are rescheduled, and items
+    // superseded by an earlier one, or whose entry was erased, are dropped. Callers must
+    // hold the shard's write lock. Returns the number of entries erased.
+    size_type advance_locked(Shard &shard, time_point now) {
+      size_type erased = 0;
+      shard.wheel.advance(to_tick_floor(now), [&](const Key &key, uint64_t deadline) {
+        auto it = shard.map.find(key);
+        if (it == shard.map.end() || it->second.scheduled != deadline) return;
+        if (it->second.expiry > now) {
+          it->second.scheduled = shard.wheel.schedule(key, to_tick_ceil(it->second.expiry));
+          return;
+        }
+        shard.map.erase(it);
+        ++erased;
+      });
+      return erased;
+    }
+
+    uint64_t to_tick_floor(time_point t) const noexcept {
+      if (t <= m_epoch) return 0;
+      return static_cast<uint64_t>((t - m_epoch) / m_tick);
+    }
+
+    uint64_t to_tick_ceil(time_point t) const noexcept {
+      auto const floor = to_tick_floor(t);
+      return m_epoch + m_tick * static_cast<typename duration::rep>(floor) < t ? floor + 1 : floor;
+    }
+
+    uint32_t get_shard_idx(const Key &key) const { return hash_function()(key) % ShardCount; }
+    Shard &get_shard(const Key &key) { return m_shards[get_shard_idx(key)]; }
+    const Shard &get_shard(const Key &key) const { return m_shards[get_shard_idx(key)]; }
+
+    time_point const m_epoch;
+    duration const m_tick;
+    std::array<Shard, ShardCount> m_shards{};
+  };
+
+} // namespace concurrency
+
+#endif // EXPIRING_SHARDED_MAP_H
@@ -0,0 +1,192 @@
+#ifndef FLAT_COMBINER_H
+#define FLAT_COMBINER_H
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace concurrency {
+  constexpr std::size_t DefaultFlatCombinerSlotCount = 32;
+  constexpr int FlatCombinerPollCount                 = 64;
+  constexpr int FlatCombinerDrainPasses               = 4;
+
+  // This class implements flat combining over an existing mutex. Instead of every thread
+  // acquiring the mutex to apply its own operation, a thread publishes its operation in a
+  // publication slot and then tries to acquire the mutex. Whichever thread succeeds becomes the
+  // combiner: it applies every pending operation in one pass while the data they touch stays
+  // hot in its cache, and the other threads merely wait for their operation to be marked done.
+  // The lock holder applies pending operations both before and after its own, so operations
+  // published while it runs are not left waiting for the next holder.
+  // Waiting threads poll only their own request, and fall back to trying the mutex once every
+  // FlatCombinerPollCount polls when no combining pass is under way, so they do not keep
+  // pulling the mutex's cache line away from the combiner.
+  //
+  // Each thread prefers one slot, chosen when it first uses any FlatCombiner. If that slot is
+  // busy, the following slots are tried, and if every slot is busy the thread acquires the
+  // mutex directly. Operations run on whichever thread combines them, so they must not
+  // depend on thread-local state. Exceptions are rethrown on the thread that published the
+  // operation.
+  //
+  // Slots are only allocated by enable(), so a disabled FlatCombiner costs a single pointer.
+  template <std::size_t SlotCount = DefaultFlatCombinerSlotCount>
+  class FlatCombiner {
+    static_assert(SlotCount != 0, "SlotCount template parameter must be non-zero.");
+
+    struct Request {
+      void (*run)(Request &) = nullptr;
+      void *operation        = nullptr;
+      std::exception_ptr error{};
+      std::atomic_bool done{false};
+    };
+
+    struct alignas(64) Slot {
+      std::atomic<Request *> request{nullptr};
+    };
+
+  public:
+    FlatCombiner() = default;
+
+    FlatCombiner(const FlatCombiner &)            = delete;
+    FlatCombiner &operator=(const FlatCombiner &) = delete;
+
+    ~FlatCombiner() { delete[] m_slots.load(std::memory_order_relaxed); }
+
+    bool enabled() const noexcept { return m_slots.load(std::memory_order_acquire) != nullptr; }
+
+    // Allocates the publication slots. Has no effect if already enabled. Callers must
+    // serialize calls to enable(), for example by holding the mutex passed to apply().
+    void enable() {
+      if (enabled()) return;
+      m_slots.store(new Slot[SlotCount], std::memory_order_release);
+    }
+
+    // Applies f() while mutex is held exclusively, either on this thread or on whichever
+    // thread is combining, and returns its result. If the combiner is disabled, simply
+    // locks mutex and calls f().
+    template <class Mutex, class F>
+    auto apply(Mutex &mutex, F &&f) -> std::invoke_result_t<F &> {
+      using result_type = std::invoke_result_t<F &>;
+      Slot *slots       = m_slots.load(std::memory_order_acquire);
+      if (slots == nullptr) {
+        std::lock_guard<Mutex> lock(mutex);
+        return f();
+      }
+      // Without contention there is nothing to combine with, so skip publishing.
+      if (mutex.try_lock()) {
+        std::lock_guard<Mutex> lock(mutex, std::adopt_lock);
+        DrainGuard drain{*this, slots};
+        combine(slots);
+        return f();
+      }
+
+      std::conditional_t<std::is_void_v<result_type>, bool, std::optional<result_type>> result{};
+      auto operation = [&f, &result]() {
+        if constexpr (std::is_void_v<result_type>) {
+          f();
+          result = true;
+        } else {
+          result.emplace(f());
+        }
+      };
+      Request request;
+      request.operation = &operation;
+      request.run       = [](Request &r) {
+        try {
+          (*static_cast<decltype(operation) *>(r.operation))();
+        } catch (...) {
+          r.error = std::current_exception();
+        }
+      };
+
+      if (!publish(slots, request)) {
+        std::lock_guard<Mutex> lock(mutex);
+        DrainGuard drain{*this, slots};
+        combine(slots);
+        return f();
+      }
+      for (int polls = 1; !request.done.load(std::memory_order_acquire); ++polls) {
+        if (polls % FlatCombinerPollCount == 0 && !m_combining.load(std::memory_order_relaxed) && mutex.try_lock()) {
+          drain(slots);
+          mutex.unlock();
+        } else {
+          std::this_thread::yield();
+        }
+      }
+      if (request.error) std::rethrow_exception(request.error);
+      if constexpr (!std::is_void_v<result_type>) {
+        return std::move(*result);
+      }
+    }
+
+  private:
+    // Drains the publication slots when destroyed, before the lock it is declared after is
+    // released.
+    struct DrainGuard {
+      FlatCombiner &combiner;
+      Slot *slots;
+      ~DrainGuard() { combiner.drain(slots); }
+    };
+
+    // Returns the index of the slot this thread tries first.
+    static std::size_t preferred_slot() {
+      static std::atomic<std::size_t> next_thread{0};
+      static thread_local std::size_t const slot = next_thread.fetch_add(1, std::memory_order_relaxed);
+      return slot % SlotCount;
+    }
+
+    // The pending count is raised before a request becomes visible in a slot, so it never
+    // undercounts the published requests.
+    bool publish(Slot *slots, Request &request) {
+      m_pending.fetch_add(1, std::memory_order_acq_rel);
+      auto const first = preferred_slot();
+      for (std::size_t i = 0; i < SlotCount; ++i) {
+        Request *expected = nullptr;
+        auto &slot        = slots[(first + i) % SlotCount].request;
+        if (slot.compare_exchange_strong(expected, &request, std::memory_order_acq_rel)) return true;
+      }
+      m_pending.fetch_sub(1, std::memory_order_acq_rel);
+      return false;
+    }
+
+    // Applies every pending request. The slot is emptied before the request is marked done,
+    // since its publisher may return, destroying the request, as soon as it is. Callers must
+    // hold the mutex exclusively.
+    void combine(Slot *slots) noexcept {
+      if (m_pending.load(std::memory_order_acquire) == 0) return;
+      m_combining.store(true, std::memory_order_relaxed);
+      for (std::size_t i = 0; i < SlotCount; ++i) {
+        Request *request = slots[i].request.load(std::memory_order_acquire);
+        if (request == nullptr) continue;
+        request->run(*request);
+        slots[i].request.store(nullptr, std::memory_order_release);
+        m_pending.fetch_sub(1, std::memory_order_acq_rel);
+        request->done.store(true, std::memory_order_release);
+      }
+      m_combining.store(false, std::memory_order_relaxed);
+    }
+
+    // Applies pending requests until none are left, making at most FlatCombinerDrainPasses
+    // passes, so that a steady stream of publishers cannot keep the caller combining forever.
+    // Callers must hold the mutex exclusively.
+    void drain(Slot *slots) noexcept {
+      for (int pass = 0; pass < FlatCombinerDrainPasses && m_pending.load(std::memory_order_acquire) != 0; ++pass) {
+        combine(slots);
+      }
+    }
+
+    std::atomic<Slot *> m_slots{nullptr};
+    std::atomic<std::size_t> m_pending{0};
+    // Set while a thread applies pending requests, which tells waiting threads that their
+    // request is about to be served.
+    std::atomic_bool m_combining{false};
+  };
+
+} // namespace concurrency
+
+#endif // FLAT_COMBINER_H
@@ -0,0 +1,720 @@
+#ifndef FLAT_HASH_MAP_H
+#define FLAT_HASH_MAP_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if !defined(CONCURRENCY_FLAT_HASH_MAP_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CONCURRENCY_FLAT_HASH_MAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace concurrency {
+  namespace detail {
+    // Every slot of a FlatHashMap has one control byte. Full slots store the low 7 bits of the
+    // key's hash (h2), so any control byte with the sign bit set is either empty or a tombstone.
+    using ctrl_t                         = int8_t;
+    constexpr ctrl_t CtrlEmpty           = -128;
+    constexpr ctrl_t CtrlDeleted         = -2;
+    constexpr std::size_t FlatGroupWidth = 16;
+
+    // Spreads the entropy of a user-provided hash across all of its bits, so that
+    // identity hashes such as std::hash<int> can be split into independent fields.
+    inline std::size_t mix_hash(std::size_t hash) {
+      uint64_t h = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+      return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+
+    inline uint32_t trailing_zeros(uint32_t mask) {
+#if defined(_MSC_VER)
+      unsigned long idx = 0;
+      _BitScanForward(&idx, mask);
+      return static_cast<uint32_t>(idx);
+#else
+      return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+    }
+
+    // A group of FlatGroupWidth control bytes that are matched against a value all at once.
+    // Each match returns a bitmask in which bit i is set if control byte i matched.
+    class FlatGroup {
+    public:
+#ifdef CONCURRENCY_FLAT_HASH_MAP_SSE2
+      explicit FlatGroup(const ctrl_t *pos) : m_ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pos))) {}
+
+      uint32_t match(ctrl_t h2) const { return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), m_ctrl))); }
+      uint32_t match_empty() const { return match(CtrlEmpty); }
+      uint32_t match_empty_or_deleted() const { return static_cast<uint32_t>(_mm_movemask_epi8(m_ctrl)); }
+
+    private:
+      __m128i m_ctrl;
+#else
+      explicit FlatGroup(const ctrl_t *pos) { std::memcpy(m_ctrl, pos, FlatGroupWidth); }
+
+      uint32_t match(ctrl_t h2) const {
+        uint32_t mask = 0;
+        for (std::size_t i = 0; i < FlatGroupWidth; ++i) {
+          if (m_ctrl[i] == h2) mask |= (1u << i);
+        }
+        return mask;
+      }
+      uint32_t match_empty() const { return match(CtrlEmpty); }
+      uint32_t match_empty_or_deleted() const {
+        uint32_t mask = 0;
+        for (std::size_t i = 0; i < FlatGroupWidth; ++i) {
+          if (m_ctrl[i] < 0) mask |= (1u << i);
+        }
+        return mask;
+      }
+
+    private:
+      ctrl_t m_ctrl[FlatGroupWidth];
+#endif
+    };
+  } // namespace detail
+
+  // This class provides a flat, open-addressing hash map in the style of SwissTable. Elements
+  // are stored inline in a single slot array alongside a parallel array of one-byte control
+  // words, so a lookup touches the control group and (usually) a single slot rather than
+  // chasing a pointer into a separately allocated node. Control bytes are probed
+  // FlatGroupWidth at a time using SSE2 where available, with a scalar fallback otherwise.
+  // Define CONCURRENCY_FLAT_HASH_MAP_NO_SIMD to force the scalar fallback.
+  //
+  // FlatHashMap implements the subset of the std::unordered_map interface used by
+  // ::concurrency::UnorderedMap, so it can be selected as that class' internal map type.
+  // Unlike std::unordered_map, references and iterators are invalidated by any insertion that
+  // grows the table, and the "bucket" interface reports individual slots.
+  //
+  // https://abseil.io/about/design/swisstables
+  template <class Key, class Val, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>, class Allocator = std::allocator<std::pair<const Key, Val>>>
+  class FlatHashMap {
+    using ctrl_t = detail::ctrl_t;
+    using slot_t = std::pair<const Key, Val>;
+
+    // FlatGroupWidth control bytes stored directly in front of the slots they describe, so
+    // that matching a group and reading the matched slot usually touch the same cache lines.
+    struct Chunk {
+      ctrl_t ctrl[detail::FlatGroupWidth];
+      alignas(slot_t) unsigned char storage[detail::FlatGroupWidth * sizeof(slot_t)];
+
+      // Returns the address of slot i, for constructing an element in it.
+      slot_t *raw_slot(std::size_t i) noexcept { return reinterpret_cast<slot_t *>(storage + i * sizeof(slot_t)); }
+      // Returns the element constructed in slot i.
+      slot_t *slot(std::size_t i) noexcept { return std::launder(raw_slot(i)); }
+      const slot_t *slot(std::size_t i) const noexcept { return std::launder(reinterpret_cast<const slot_t *>(storage + i * sizeof(slot_t))); }
+    };
+
+    template <bool IsConst>
+    class Iterator {
+      friend class FlatHashMap;
+      template <bool>
+      friend class Iterator;
+      using chunk_ptr = std::conditional_t<IsConst, const Chunk *, Chunk *>;
+
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type        = slot_t;
+      using difference_type   = std::ptrdiff_t;
+      using reference         = std::conditional_t<IsConst, const slot_t &, slot_t &>;
+      using pointer           = std::conditional_t<IsConst, const slot_t *, slot_t *>;
+
+      Iterator() = default;
+      template <bool C = IsConst, std::enable_if_t<C, int> = 0>
+      Iterator(const Iterator<false> &other) : m_chunk(other.m_chunk), m_idx(other.m_idx), m_end(other.m_end) {}
+
+      reference operator*() const { return *m_chunk->slot(m_idx); }
+      pointer operator->() const { return m_chunk->slot(m_idx); }
+
+      Iterator &operator++() {
+        advance();
+        skip_empty_slots();
+        return *this;
+      }
+      Iterator operator++(int) {
+        auto tmp = *this;
+        ++(*this);
+        return tmp;
+      }
+
+      friend bool operator==(const Iterator &lhs, const Iterator &rhs) { return lhs.m_chunk == rhs.m_chunk && lhs.m_idx == rhs.m_idx; }
+      friend bool operator!=(const Iterator &lhs, const Iterator &rhs) { return !(lhs == rhs); }
+
+    private:
+      Iterator(chunk_ptr chunk, std::size_t idx, chunk_ptr end) : m_chunk(chunk), m_idx(idx), m_end(end) {}
+
+      void advance() {
+        if (++m_idx == detail::FlatGroupWidth) {
+          m_idx = 0;
+          ++m_chunk;
+        }
+      }
+
+      void skip_empty_slots() {
+        while (m_chunk != m_end && m_chunk->ctrl[m_idx] < 0) {
+          advance();
+        }
+      }
+
+      chunk_ptr m_chunk{nullptr};
+      std::size_t m_idx{0};
+      chunk_ptr m_end{nullptr};
+    };
+
+    // Owns a single element that has been extracted from a FlatHashMap.
+    class NodeHandle {
+      friend class FlatHashMap;
+
+    public:
+      using key_type       = Key;
+      using mapped_type    = Val;
+      using allocator_type = Allocator;
+
+      NodeHandle() = default;
+      NodeHandle(NodeHandle &&other) noexcept(std::is_nothrow_move_constructible_v<slot_t>) { take(other); }
+      NodeHandle &operator=(NodeHandle &&other) noexcept(std::is_nothrow_move_constructible_v<slot_t>) {
+        if (this != &other) {
+          m_value.reset();
+          take(other);
+        }
+        return *this;
+      }
+      ~NodeHandle() = default;
+
+      bool empty() const noexcept { return !m_value.has_value(); }
+      explicit operator bool() const noexcept { return !empty(); }
+
+      const key_type &key() const { return m_value->first; }
+      mapped_type &mapped() const { return m_value->second; }
+
+    private:
+      void take(NodeHandle &other) {
+        if (other.m_value) m_value.emplace(std::move(*other.m_value));
+        other.m_value.reset();
+      }
+
+      mutable std::optional<slot_t> m_value{};
+    };
+
+  public:
+    // ------------------------------ Member types ------------------------------ //
+    using self_type            = FlatHashMap<Key, Val, Hash, Pred, Allocator>;
+    using key_type             = Key;
+    using mapped_type          = Val;
+    using value_type           = slot_t;
+    using size_type            = std::size_t;
+    using difference_type      = std::ptrdiff_t;
+    using hasher               = Hash;
+    using key_equal            = Pred;
+    using allocator_type       = Allocator;
+    using reference            = value_type &;
+    using const_reference      = const value_type &;
+    using pointer              = value_type *;
+    using const_pointer        = const value_type *;
+    using iterator             = Iterator<false>;
+    using const_iterator       = Iterator<true>;
+    using local_iterator       = iterator;
+    using const_local_iterator = const_iterator;
+    using node_type            = NodeHandle;
+
+    struct insert_return_type {
+      iterator position;
+      bool inserted;
+      node_type node;
+    };
+
+    // The maximum load factor used unless one is set through max_load_factor(float).
+    static constexpr float DefaultMaxLoadFactor = 0.875f;
+
+    // ------------------------------ Constructors ------------------------------ //
+    FlatHashMap() = default;
+    explicit FlatHashMap(size_type bucket_count, const hasher &hash = hasher(), const key_equal &eq = key_equal(), const allocator_type &alloc = allocator_type()) :
+        m_hash(hash), m_eq(eq), m_alloc(alloc) {
+      rehash(bucket_count);
+    }
+    template <class InputIt>
+    FlatHashMap(InputIt first, InputIt last) {
+      insert(first, last);
+    }
+    FlatHashMap(std::initializer_list<value_type> ilist) { insert(ilist); }
+
+    FlatHashMap(const FlatHashMap &other) :
+        m_max_load_factor(other.m_max_load_factor),
+        m_hash(other.m_hash),
+        m_eq(other.m_eq),
+        m_alloc(std::allocator_traits<allocator_type>::select_on_container_copy_construction(other.m_alloc)) {
+      reserve(other.size());
+      for (auto const &el: other) {
+        (void) emplace_unique(hash_of(el.first), el);
+      }
+    }
+    FlatHashMap(FlatHashMap &&other) noexcept :
+        m_chunks(std::exchange(other.m_chunks, nullptr)),
+        m_capacity(std::exchange(other.m_capacity, 0)),
+        m_size(std::exchange(other.m_size, 0)),
+        m_deleted(std::exchange(other.m_deleted, 0)),
+        m_max_load_factor(other.m_max_load_factor),
+        m_hash(std::move(other.m_hash)),
+        m_eq(std::move(other.m_eq)),
+        m_alloc(std::move(other.m_alloc)) {}
+
+    FlatHashMap &operator=(const FlatHashMap &other) {
+      if (this != &other) {
+        FlatHashMap tmp(other);
+        swap(tmp);
+      }
+      return *this;
+    }
+    FlatHashMap &operator=(FlatHashMap &&other) noexcept {
+      if (this != &other) {
+        release();
+        m_chunks          = std::exchange(other.m_chunks, nullptr);
+        m_capacity        = std::exchange(other.m_capacity, 0);
+        m_size            = std::exchange(other.m_size, 0);
+        m_deleted         = std::exchange(other.m_deleted, 0);
+        m_max_load_factor = other.m_max_load_factor;
+        m_hash            = std::move(other.m_hash);
+        m_eq              = std::move(other.m_eq);
+        m_alloc           = std::move(other.m_alloc);
+      }
+      return *this;
+    }
+    FlatHashMap &operator=(std::initializer_list<value_type> ilist) {
+      clear();
+      insert(ilist);
+      return *this;
+    }
+
+    ~FlatHashMap() { release(); }
+
+    allocator_type get_allocator() const { return m_alloc; }
+
+    // ------------------------------- Iterators -------------------------------- //
+    iterator begin() noexcept { return make_begin(iterator_at(0)); }
+    const_iterator begin() const noexcept { return make_begin(iterator_at(0)); }
+    const_iterator cbegin() const noexcept { return begin(); }
+    iterator end() noexcept { return iterator_at(m_capacity); }
+    const_iterator end() const noexcept { return iterator_at(m_capacity); }
+    const_iterator cend() const noexcept { return end(); }
+
+    // -------------------------------- Capacity -------------------------------- //
+    bool empty() const noexcept { return m_size == 0; }
+    size_type size() const noexcept { return m_size; }
+    size_type max_size() const noexcept { return std::allocator_traits<allocator_type>::max_size(m_alloc); }
+
+    // ------------------------------- Modifiers -------------------------------- //
+    void clear() noexcept {
+      destroy_slots();
+      reset_ctrl(m_chunks, m_capacity);
+      m_size    = 0;
+      m_deleted = 0;
+    }
+
+    std::pair<iterator, bool> insert(const value_type &value) { return try_emplace(value.first, value.second); }
+    std::pair<iterator, bool> insert(value_type &&value) { return try_emplace(value.first, std::move(value.second)); }
+    template <class P, std::enable_if_t<std::is_constructible_v<value_type, P &&>, int> = 0>
+    std::pair<iterator, bool> insert(P &&value) {
+      return emplace(std::forward<P>(value));
+    }
+    template <class InputIt>
+    void insert(InputIt first, InputIt last) {
+      for (; first != last; ++first) {
+        (void) insert(*first);
+      }
+    }
+    void insert(std::initializer_list<value_type> ilist) { insert(ilist.begin(), ilist.end()); }
+    insert_return_type insert(node_type &&nh) {
+      if (nh.empty()) return {end(), false, node_type()};
+      auto const hash = hash_of(nh.key());
+      auto const idx  = find_index(nh.key(), hash);
+      if (idx != m_capacity) return {iterator_at(idx), false, std::move(nh)};
+      auto it = emplace_unique(hash, std::move(*nh.m_value));
+      nh.m_value.reset();
+      return {it, true, node_type()};
+    }
+
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(const Key &k, M &&obj) {
+      auto result = try_emplace(k, std::forward<M>(obj));
+      if (!result.second) result.first->second = std::forward<M>(obj);
+      return result;
+    }
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(Key &&k, M &&obj) {
+      auto result = try_emplace(std::move(k), std::forward<M>(obj));
+      if (!result.second) result.first->second = std::forward<M>(obj);
+      return result;
+    }
+
+    template <class... Args>
+    std::pair<iterator, bool> emplace(Args &&...args) {
+      value_type tmp(std::forward<Args>(args)...);
+      auto const hash = hash_of(tmp.first);
+      auto const idx  = find_index(tmp.first, hash);
+      if (idx != m_capacity) return {iterator_at(idx), false};
+      return {emplace_unique(hash, std::move(tmp)), true};
+    }
+
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(const Key &k, Args &&...args) {
+      return try_emplace_impl(k, std::forward<Args>(args)...);
+    }
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(Key &&k, Args &&...args) {
+      return try_emplace_impl(std::move(k), std::forward<Args>(args)...);
+    }
+
+    size_type erase(const Key &key) {
+      auto const idx = find_index(key, hash_of(key));
+      if (idx == m_capacity) return 0;
+      erase_at(idx);
+      return 1;
+    }
+    iterator erase(const_iterator pos) {
+      auto const idx = static_cast<size_type>(pos.m_chunk - m_chunks) * detail::FlatGroupWidth + pos.m_idx;
+      erase_at(idx);
+      auto next = iterator_at(idx);
+      next.skip_empty_slots();
+      return next;
+    }
+    iterator erase(iterator pos) { return erase(const_iterator(pos)); }
+
+    void swap(FlatHashMap &other) noexcept {
+      using std::swap;
+      swap(m_chunks, other.m_chunks);
+      swap(m_capacity, other.m_capacity);
+      swap(m_size, other.m_size);
+      swap(m_deleted, other.m_deleted);
+      swap(m_max_load_factor, other.m_max_load_factor);
+      swap(m_hash, other.m_hash);
+      swap(m_eq, other.m_eq);
+      swap(m_alloc, other.m_alloc);
+    }
+
+    node_type extract(const Key &k) {
+      node_type nh;
+      auto const idx = find_index(k, hash_of(k));
+      if (idx == m_capacity) return nh;
+      nh.m_value.emplace(std::move(*slot_at(idx)));
+      erase_at(idx);
+      return nh;
+    }
+
+    // Moves every element of source whose key is not already present into this map. Accepts any
+    // map-like container providing begin(), end(), and erase(iterator), including
+    // std::unordered_map and std::unordered_multimap.
+    template <class Source>
+    void merge(Source &source) {
+      if (static_cast<const void *>(&source) == static_cast<const void *>(this)) return;
+      for (auto it = source.begin(); it != source.end();) {
+        if (contains(it->first)) {
+          ++it;
+          continue;
+        }
+        (void) try_emplace(it->first, std::move(it->second));
+        it = source.erase(it);
+      }
+    }
+    template <class Source>
+    void merge(Source &&source) {
+      merge(source);
+    }
+
+    // ------------------------------- Lookup ----------------------------------- //
+    Val &at(const Key &key) {
+      auto const idx = find_index(key, hash_of(key));
+      if (idx == m_capacity) throw std::out_of_range("::concurrency::FlatHashMap::at: key not found");
+      return slot_at(idx)->second;
+    }
+    const Val &at(const Key &key) const {
+      auto const idx = find_index(key, hash_of(key));
+      if (idx == m_capacity) throw std::out_of_range("::concurrency::FlatHashMap::at: key not found");
+      return slot_at(idx)->second;
+    }
+
+    Val &operator[](const Key &key) { return try_emplace(key).first->second; }
+    Val &operator[](Key &&key) { return try_emplace(std::move(key)).first->second; }
+
+    size_type count(const Key &key) const { return contains(key) ? 1 : 0; }
+
+    iterator find(const Key &key) { return iterator_at(find_index(key, hash_of(key))); }
+    const_iterator find(const Key &key) const { return iterator_at(find_index(key, hash_of(key))); }
+
+    bool contains(const Key &key) const { return find_index(key, hash_of(key)) != m_capacity; }
+
+    // --------------------------- Bucket Interface ----------------------------- //
+    // Each slot of the table is reported as a bucket holding zero or one elements.
+    size_type bucket_count() const noexcept { return m_capacity; }
+    size_type max_bucket_count() const noexcept { return max_size(); }
+    size_type bucket_size(size_type n) const { return (n < m_capacity && ctrl_at(n) >= 0) ? 1 : 0; }
+    // Returns the slot holding the provided key, or the slot it would be inserted into.
+    size_type bucket(const Key &key) const {
+      if (m_capacity == 0) return 0;
+      auto const hash = hash_of(key);
+      auto const idx  = find_index(key, hash);
+      return idx != m_capacity ? idx : find_first_non_full(m_chunks, m_capacity, hash);
+    }
+
+    // ------------------------------ Hash Policy ------------------------------- //
+    float load_factor() const noexcept { return m_capacity == 0 ? 0.0f : static_cast<float>(m_size) / static_cast<float>(m_capacity); }
+
+    float max_load_factor() const noexcept { return m_max_load_factor; }
+
+    // Sets the maximum load factor. The value actually applied to the table is clamped
+    // to (0, 0.9375] so that every probe sequence is guaranteed to reach an empty slot.
+    void max_load_factor(float ml) {
+      m_max_load_factor = ml;
+      if (m_size + m_deleted > max_elements(m_capacity)) rehash(0);
+    }
+
+    void rehash(size_type count) {
+      auto const min_for_size = static_cast<size_type>(std::ceil(static_cast<float>(m_size) / effective_max_load_factor())) + 1;
+      auto const target       = normalize_capacity(std::max(count, m_size == 0 ? 0 : min_for_size));
+      if (target != m_capacity || m_deleted != 0) resize(target);
+    }
+
+    void reserve(size_type count) { rehash(static_cast<size_type>(std::ceil(static_cast<float>(count) / effective_max_load_factor()))); }
+
+    // ------------------------------- Observers -------------------------------- //
+    hasher hash_function() const { return m_hash; }
+
+    key_equal key_eq() const { return m_eq; }
+
+  private:
+    using chunk_allocator_type = typename std::allocator_traits<allocator_type>::template rebind_alloc<Chunk>;
+    using slot_traits          = std::allocator_traits<allocator_type>;
+    using chunk_traits         = std::allocator_traits<chunk_allocator_type>;
+
+    // Mixes the user-provided hash so that identity hashes (e.g. std::hash<int>) still spread
+    // across both the group index (h1) and the control byte (h2).
+    size_type hash_of(const Key &key) const { return detail::mix_hash(m_hash(key)); }
+    static size_type h1(size_type hash) { return hash >> 7; }
+    static ctrl_t h2(size_type hash) { return static_cast<ctrl_t>(hash & 0x7F); }
+
+    float effective_max_load_factor() const { return std::clamp(m_max_load_factor, 0.01f, 0.9375f); }
+
+    size_type max_elements(size_type capacity) const {
+      if (capacity == 0) return 0;
+      auto const n = static_cast<size_type>(static_cast<float>(capacity) * effective_max_load_factor());
+      return std::clamp<size_type>(n, 1, capacity - 1);
+    }
+
+    // Rounds count up to a power-of-two number of groups, or zero for an empty request.
+    static size_type normalize_capacity(size_type count) {
+      if (count == 0) return 0;
+      size_type capacity = detail::FlatGroupWidth;
+      while (capacity < count) {
+        capacity *= 2;
+      }
+      return capacity;
+    }
+
+    // Visits chunk indices using triangular probing, which reaches every chunk exactly once
+    // when the chunk count is a power of two. The functor returns true to stop probing.
+    template <class F>
+    static void probe(size_type capacity, size_type hash, F &&f) {
+      auto const mask = capacity / detail::FlatGroupWidth - 1;
+      auto chunk      = h1(hash) & mask;
+      for (size_type i = 1;; ++i) {
+        if (f(chunk)) return;
+        chunk = (chunk + i) & mask;
+      }
+    }
+
+    size_type find_index(const Key &key, size_type hash) const {
+      if (m_size == 0) return m_capacity;
+      auto const tag = h2(hash);
+      size_type idx  = m_capacity;
+      probe(m_capacity, hash, [&](size_type chunk) {
+        auto const &c = m_chunks[chunk];
+        detail::FlatGroup g(c.ctrl);
+        for (auto mask = g.match(tag); mask != 0; mask &= mask - 1) {
+          auto const i = detail::trailing_zeros(mask);
+          if (m_eq(c.slot(i)->first, key)) {
+            idx = chunk * detail::FlatGroupWidth + i;
+            return true;
+          }
+        }
+        return g.match_empty() != 0;
+      });
+      return idx;
+    }
+
+    static size_type find_first_non_full(const Chunk *chunks, size_type capacity, size_type hash) {
+      size_type idx = capacity;
+      probe(capacity, hash, [&](size_type chunk) {
+        auto const mask = detail::FlatGroup(chunks[chunk].ctrl).match_empty_or_deleted();
+        if (mask == 0) return false;
+        idx = chunk * detail::FlatGroupWidth + detail::trailing_zeros(mask);
+        return true;
+      });
+      return idx;
+    }
+
+    template <class K, class... Args>
+    std::pair<iterator, bool> try_emplace_impl(K &&k, Args &&...args) {
+      auto const hash = hash_of(k);
+      auto const idx  = find_index(k, hash);
+      if (idx != m_capacity) return {iterator_at(idx), false};
+      return {emplace_unique(hash, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(k)), std::forward_as_tuple(std::forward<Args>(args)...)), true};
+    }
+
+    // Constructs a new element whose key is known not to be present in the table.
+    template <class... Args>
+    iterator emplace_unique(size_type hash, Args &&...args) {
+      if (m_size + m_deleted + 1 > max_elements(m_capacity)) grow();
+      auto const idx = find_first_non_full(m_chunks, m_capacity, hash);
+      auto &chunk    = m_chunks[idx / detail::FlatGroupWidth];
+      auto const i   = idx % detail::FlatGroupWidth;
+      slot_traits::construct(m_alloc, chunk.raw_slot(i), std::forward<Args>(args)...);
+      if (chunk.ctrl[i] == detail::CtrlDeleted) --m_deleted;
+      chunk.ctrl[i] = h2(hash);
+      ++m_size;
+      return iterator_at(idx);
+    }
+
+    // Doubles the table, or rebuilds it at the same size if most of the
+    // non-empty slots are tombstones.
+    void grow() {
+      if (m_capacity == 0) {
+        resize(detail::FlatGroupWidth);
+      } else if (m_size * 2 <= max_elements(m_capacity)) {
+        resize(m_capacity);
+      } else {
+        resize(m_capacity * 2);
+      }
+    }
+
+    void resize(size_type new_capacity) {
+      chunk_allocator_type chunk_alloc(m_alloc);
+      Chunk *new_chunks = nullptr;
+      if (new_capacity != 0) {
+        new_chunks = chunk_traits::allocate(chunk_alloc, new_capacity / detail::FlatGroupWidth);
+        for (size_type c = 0; c < new_capacity / detail::FlatGroupWidth; ++c) {
+          ::new (static_cast<void *>(new_chunks + c)) Chunk;
+        }
+        reset_ctrl(new_chunks, new_capacity);
+      }
+      for (size_type i = 0; i < m_capacity; ++i) {
+        if (ctrl_at(i) < 0) continue;
+        auto *old_slot  = slot_at(i);
+        auto const hash = hash_of(old_slot->first);
+        auto const idx  = find_first_non_full(new_chunks, new_capacity, hash);
+        auto &chunk     = new_chunks[idx / detail::FlatGroupWidth];
+        slot_traits::construct(m_alloc, chunk.raw_slot(idx % detail::FlatGroupWidth), std::move(*old_slot));
+        slot_traits::destroy(m_alloc, old_slot);
+        chunk.ctrl[idx % detail::FlatGroupWidth] = h2(hash);
+      }
+      deallocate();
+      m_chunks   = new_chunks;
+      m_capacity = new_capacity;
+      m_deleted  = 0;
+    }
+
+    void erase_at(size_type idx) {
+      auto &chunk  = m_chunks[idx / detail::FlatGroupWidth];
+      auto const i = idx % detail::FlatGroupWidth;
+      slot_traits::destroy(m_alloc, chunk.slot(i));
+      --m_size;
+      // A probe sequence only continues past a chunk that has no empty slots, so if this
+      // slot's chunk already has one, the slot can be marked empty instead of deleted.
+      if (detail::FlatGroup(chunk.ctrl).match_empty() != 0) {
+        chunk.ctrl[i] = detail::CtrlEmpty;
+      } else {
+        chunk.ctrl[i] = detail::CtrlDeleted;
+        ++m_deleted;
+      }
+    }
+
+    ctrl_t ctrl_at(size_type idx) const noexcept { return m_chunks[idx / detail::FlatGroupWidth].ctrl[idx % detail::FlatGroupWidth]; }
+    value_type *slot_at(size_type idx) const noexcept { return m_chunks[idx / detail::FlatGroupWidth].slot(idx % detail::FlatGroupWidth); }
+
+    static void reset_ctrl(Chunk *chunks, size_type capacity) noexcept {
+      for (size_type c = 0; c < capacity / detail::FlatGroupWidth; ++c) {
+        std::memset(chunks[c].ctrl, static_cast<unsigned char>(detail::CtrlEmpty), detail::FlatGroupWidth);
+      }
+    }
+
+    iterator iterator_at(size_type idx) noexcept {
+      return iterator(m_chunks + idx / detail::FlatGroupWidth, idx % detail::FlatGroupWidth, m_chunks + m_capacity / detail::FlatGroupWidth);
+    }
+    const_iterator iterator_at(size_type idx) const noexcept {
+      return const_iterator(m_chunks + idx / detail::FlatGroupWidth, idx % detail::FlatGroupWidth, m_chunks + m_capacity / detail::FlatGroupWidth);
+    }
+
+    template <class It>
+    static It make_begin(It it) noexcept {
+      it.skip_empty_slots();
+      return it;
+    }
+
+    void destroy_slots() noexcept {
+      for (size_type i = 0; i < m_capacity; ++i) {
+        if (ctrl_at(i) >= 0) slot_traits::destroy(m_alloc, slot_at(i));
+      }
+    }
+
+    void deallocate() noexcept {
+      if (m_capacity == 0) return;
+      chunk_allocator_type chunk_alloc(m_alloc);
+      chunk_traits::deallocate(chunk_alloc, m_chunks, m_capacity / detail::FlatGroupWidth);
+    }
+
+    void release() noexcept {
+      destroy_slots();
+      deallocate();
+      m_chunks   = nullptr;
+      m_capacity = 0;
+      m_size     = 0;
+      m_deleted  = 0;
+    }
+
+    Chunk *m_chunks{nullptr};
+    size_type m_capacity{0};
+    size_type m_size{0};
+    size_type m_deleted{0};
+    float m_max_load_factor{DefaultMaxLoadFactor};
+    hasher m_hash{};
+    key_equal m_eq{};
+    allocator_type m_alloc{};
+  };
+
+  template <class Key, class T, class Hash, class KeyEqual, class Alloc>
+  bool operator==(const ::concurrency::FlatHashMap<Key, T, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::FlatHashMap<Key, T, Hash, KeyEqual, Alloc> &rhs) {
+    if (lhs.size() != rhs.size()) return false;
+    for (auto const &el: lhs) {
+      auto it = rhs.find(el.first);
+      if (it == rhs.end() || !(it->second == el.second)) return false;
+    }
+    return true;
+  }
+
+  template <class Key, class T, class Hash, class KeyEqual, class Alloc>
+  bool operator!=(const ::concurrency::FlatHashMap<Key, T, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::FlatHashMap<Key, T, Hash, KeyEqual, Alloc> &rhs) {
+    return !(lhs == rhs);
+  }
+
+  // Specializes the std::swap algorithm for ::concurrency::FlatHashMap. Swaps the contents of lhs and rhs. Calls lhs.swap(rhs).
+  template <class Key, class T, class Hash, class KeyEqual, class Alloc>
+  void swap(::concurrency::FlatHashMap<Key, T, Hash, KeyEqual, Alloc> &lhs, ::concurrency::FlatHashMap<Key, T, Hash, KeyEqual, Alloc> &rhs) noexcept {
+    lhs.swap(rhs);
+  }
+
+} // namespace concurrency
+
+#endif // FLAT_HASH_MAP_H
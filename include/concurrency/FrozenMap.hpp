@@ -0,0 +1,407 @@
+#ifndef FROZEN_MAP_H
+#define FROZEN_MAP_H
+
+#include <concurrency/FlatHashMap.hpp>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace concurrency {
+
+  // This class provides an immutable hash map intended for data that is built once and then
+  // only read. Since a FrozenMap can never change after construction, any number of threads
+  // may query it concurrently without locks or atomic operations.
+  //
+  // Elements are stored in one contiguous array, ordered by bucket, alongside an array of
+  // bucket offsets. There are at least as many buckets as elements, so a lookup reads one
+  // offset pair and then scans, on average, about one element whose cached hash is compared
+  // before the key itself.
+  //
+  // A FrozenMap is usually obtained from UnorderedMap::freeze() or ShardedUnorderedMap::freeze(),
+  // but may be built from any map-like container. Construction may be spread across multiple
+  // threads. See also ::concurrency::AtomicFrozenMap for replacing a FrozenMap as new
+  // generations of data arrive.
+  template <class Key, class Val, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>>
+  class FrozenMap {
+    using slot_value_type = std::pair<const Key, Val>;
+
+    struct Slot {
+      std::size_t hash;
+      slot_value_type value;
+    };
+
+  public:
+    // ------------------------------ Member types ------------------------------ //
+    using self_type       = FrozenMap<Key, Val, Hash, Pred>;
+    using key_type        = Key;
+    using mapped_type     = Val;
+    using value_type      = slot_value_type;
+    using size_type       = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using hasher          = Hash;
+    using key_equal       = Pred;
+    using const_reference = const value_type &;
+    using const_pointer   = const value_type *;
+
+    class const_iterator {
+      friend class FrozenMap;
+
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type        = slot_value_type;
+      using difference_type   = std::ptrdiff_t;
+      using reference         = const slot_value_type &;
+      using pointer           = const slot_value_type *;
+
+      const_iterator() = default;
+
+      reference operator*() const { return m_slot->value; }
+      pointer operator->() const { return &m_slot->value; }
+
+      const_iterator &operator++() {
+        ++m_slot;
+        return *this;
+      }
+      const_iterator operator++(int) {
+        auto tmp = *this;
+        ++m_slot;
+        return tmp;
+      }
+
+      friend bool operator==(const const_iterator &lhs, const const_iterator &rhs) { return lhs.m_slot == rhs.m_slot; }
+      friend bool operator!=(const const_iterator &lhs, const const_iterator &rhs) { return !(lhs == rhs); }
+
+    private:
+      explicit const_iterator(const Slot *slot) : m_slot(slot) {}
+
+      const Slot *m_slot{nullptr};
+    };
+    using iterator = const_iterator;
+
+    // ------------------------------ Constructors ------------------------------ //
+    FrozenMap() = default;
+
+    // Builds a FrozenMap holding a copy of every element of source, using up to thread_count
+    // threads. If source is an rvalue, mapped values are moved out of it rather than copied.
+    // Source must be a map-like container providing size(), begin(), and end(), and must not
+    // be modified while the FrozenMap is being built.
+    template <class Map, std::enable_if_t<!std::is_same_v<std::decay_t<Map>, FrozenMap>, int> = 0>
+    explicit FrozenMap(Map &&source, unsigned thread_count = 1, const hasher &hash = hasher(), const key_equal &eq = key_equal()) :
+        m_hash(hash), m_eq(eq) {
+      build(std::forward<Map>(source), std::max(1u, thread_count));
+    }
+    FrozenMap(std::initializer_list<value_type> ilist) {
+      std::vector<value_type> unique;
+      for (auto const &el: ilist) {
+        auto const dup = std::find_if(unique.begin(), unique.end(), [&](auto const &u) { return m_eq(u.first, el.first); });
+        if (dup == unique.end()) unique.push_back(el);
+      }
+      build(unique, 1);
+    }
+
+    FrozenMap(const FrozenMap &)            = delete;
+    FrozenMap &operator=(const FrozenMap &) = delete;
+    FrozenMap(FrozenMap &&other) noexcept :
+        m_slots(std::exchange(other.m_slots, nullptr)),
+        m_size(std::exchange(other.m_size, 0)),
+        m_offsets(std::move(other.m_offsets)),
+        m_bucket_mask(std::exchange(other.m_bucket_mask, 0)),
+        m_hash(std::move(other.m_hash)),
+        m_eq(std::move(other.m_eq)) {}
+    FrozenMap &operator=(FrozenMap &&other) noexcept {
+      if (this != &other) {
+        release();
+        m_slots       = std::exchange(other.m_slots, nullptr);
+        m_size        = std::exchange(other.m_size, 0);
+        m_offsets     = std::move(other.m_offsets);
+        m_bucket_mask = std::exchange(other.m_bucket_mask, 0);
+        m_hash        = std::move(other.m_hash);
+        m_eq          = std::move(other.m_eq);
+      }
+      return *this;
+    }
+
+    ~FrozenMap() { release(); }
+
+    // ------------------------------- Iterators -------------------------------- //
+    // Iteration is safe from any thread, as a FrozenMap never changes.
+    const_iterator begin() const noexcept { return const_iterator(m_slots); }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator end() const noexcept { return const_iterator(m_slots + m_size); }
+    const_iterator cend() const noexcept { return end(); }
+
+    // -------------------------------- Capacity -------------------------------- //
+    bool empty() const noexcept { return m_size == 0; }
+    size_type size() const noexcept { return m_size; }
+
+    // ------------------------------ Accessors --------------------------------- //
+    // Returns a reference to the element mapped to the provided key.
+    // Does bounds checking.
+    const Val &at(const Key &key) const {
+      auto const *slot = lookup(key);
+      if (slot == nullptr) throw std::out_of_range("::concurrency::FrozenMap::at: key not found");
+      return slot->value.second;
+    }
+
+    // Returns a pointer to the element mapped to the provided
+    // key, or nullptr if the key is not present.
+    const Val *get(const Key &key) const {
+      auto const *slot = lookup(key);
+      return slot == nullptr ? nullptr : &slot->value.second;
+    }
+
+    size_type count(const Key &key) const { return lookup(key) == nullptr ? 0 : 1; }
+
+    // Returns a bool indicating whether or not the
+    // provided key is present in the map.
+    bool find(const Key &key) const { return lookup(key) != nullptr; }
+
+    // --------------------------- Bucket Interface ----------------------------- //
+    size_type bucket_count() const noexcept { return m_offsets.empty() ? 0 : m_offsets.size() - 1; }
+
+    // ------------------------------- Observers -------------------------------- //
+    hasher hash_function() const { return m_hash; }
+
+    key_equal key_eq() const { return m_eq; }
+
+  private:
+    const Slot *lookup(const Key &key) const {
+      if (m_size == 0) return nullptr;
+      auto const hash = detail::mix_hash(m_hash(key));
+      auto const b    = hash & m_bucket_mask;
+      for (auto i = m_offsets[b]; i < m_offsets[b + 1]; ++i) {
+        auto const &slot = m_slots[i];
+        if (slot.hash == hash && m_eq(slot.value.first, key)) return &slot;
+      }
+      return nullptr;
+    }
+
+    // Runs f(t) for each t in [0, thread_count), using the calling
+    // thread for t = 0, and rethrows the first exception raised.
+    template <class F>
+    static void run_on_threads(unsigned thread_count, F &&f) {
+      std::vector<std::thread> threads;
+      std::exception_ptr error;
+      std::mutex error_mutex;
+      auto guarded = [&](unsigned t) {
+        try {
+          f(t);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(error_mutex);
+          if (!error) error = std::current_exception();
+        }
+      };
+      for (unsigned t = 1; t < thread_count; ++t) {
+        threads.emplace_back(guarded, t);
+      }
+      guarded(0);
+      for (auto &th: threads) {
+        th.join();
+      }
+      if (error) std::rethrow_exception(error);
+    }
+
+    // Each thread owns a contiguous range of buckets, and therefore a contiguous range of the
+    // slot array, so threads never write to the same memory. The elements are first partitioned
+    // by bucket range: every thread hashes its own slice of the elements and counts how many
+    // fall into each range, the counts are turned into per-thread positions, and every thread
+    // scatters the indices of its slice into the partition. Each thread then counts and places
+    // only the elements of its own range, so no step visits all elements on every thread.
+    template <class Map>
+    void build(Map &&source, unsigned thread_count) {
+      auto const n = static_cast<size_type>(source.size());
+      if (n == 0) return;
+
+      using element_ptr = decltype(&*source.begin());
+      std::vector<element_ptr> elements;
+      elements.reserve(n);
+      for (auto &el: source) {
+        elements.push_back(&el);
+      }
+
+      size_type bucket_count = 1;
+      while (bucket_count < n) {
+        bucket_count *= 2;
+      }
+      m_bucket_mask = bucket_count - 1;
+      m_offsets.assign(bucket_count + 1, 0);
+      thread_count = static_cast<unsigned>(std::min<size_type>(thread_count, bucket_count));
+
+      // Thread t owns buckets [range_begin(t), range_begin(t + 1)).
+      auto const range_of    = [&](size_type b) { return static_cast<unsigned>(b * thread_count / bucket_count); };
+      auto const range_begin = [&](unsigned t) { return (t * bucket_count + thread_count - 1) / thread_count; };
+      auto const slice       = [&](unsigned t) { return std::make_pair(n * t / thread_count, n * (t + 1) / thread_count); };
+
+      std::vector<size_type> hashes(n);
+      // positions[t * thread_count + r] counts the elements of thread t's slice that fall into
+      // range r, and then holds the position in the partition of the first of them.
+      std::vector<size_type> positions(static_cast<size_type>(thread_count) * thread_count, 0);
+      run_on_threads(thread_count, [&](unsigned t) {
+        std::vector<size_type> counts(thread_count, 0);
+        auto const [first, last] = slice(t);
+        for (size_type i = first; i < last; ++i) {
+          hashes[i] = detail::mix_hash(m_hash(elements[i]->first));
+          ++counts[range_of(hashes[i] & m_bucket_mask)];
+        }
+        std::copy(counts.begin(), counts.end(), positions.begin() + t * thread_count);
+      });
+      std::vector<size_type> range_offsets(thread_count + 1, 0);
+      for (unsigned r = 0; r < thread_count; ++r) {
+        range_offsets[r + 1] = range_offsets[r];
+        for (unsigned t = 0; t < thread_count; ++t) {
+          auto const count = positions[t * thread_count + r];
+          positions[t * thread_count + r] = range_offsets[r + 1];
+          range_offsets[r + 1] += count;
+        }
+      }
+
+      std::vector<size_type> partition(n);
+      run_on_threads(thread_count, [&](unsigned t) {
+        std::vector<size_type> cursor(positions.begin() + t * thread_count, positions.begin() + (t + 1) * thread_count);
+        auto const [first, last] = slice(t);
+        for (size_type i = first; i < last; ++i) {
+          partition[cursor[range_of(hashes[i] & m_bucket_mask)]++] = i;
+        }
+      });
+      run_on_threads(thread_count, [&](unsigned r) {
+        for (auto p = range_offsets[r]; p < range_offsets[r + 1]; ++p) {
+          ++m_offsets[hashes[partition[p]] & m_bucket_mask];
+        }
+        auto offset = range_offsets[r];
+        for (auto b = range_begin(r); b < range_begin(r + 1); ++b) {
+          offset += std::exchange(m_offsets[b], offset);
+        }
+      });
+      m_offsets[bucket_count] = n;
+
+      m_slots = std::allocator<Slot>().allocate(n);
+      std::vector<unsigned char> constructed(n, 0);
+      try {
+        run_on_threads(thread_count, [&](unsigned r) {
+          auto const lo = range_begin(r);
+          std::vector<size_type> cursor(m_offsets.begin() + lo, m_offsets.begin() + range_begin(r + 1));
+          for (auto p = range_offsets[r]; p < range_offsets[r + 1]; ++p) {
+            auto const i   = partition[p];
+            auto const pos = cursor[(hashes[i] & m_bucket_mask) - lo]++;
+            if constexpr (std::is_rvalue_reference_v<Map &&>) {
+              ::new (static_cast<void *>(m_slots + pos)) Slot{hashes[i], value_type(elements[i]->first, std::move(elements[i]->second))};
+            } else {
+              ::new (static_cast<void *>(m_slots + pos)) Slot{hashes[i], value_type(elements[i]->first, elements[i]->second)};
+            }
+            constructed[pos] = 1;
+          }
+        });
+      } catch (...) {
+        for (size_type i = 0; i < n; ++i) {
+          if (constructed[i]) m_slots[i].~Slot();
+        }
+        std::allocator<Slot>().deallocate(m_slots, n);
+        m_slots = nullptr;
+        m_offsets.clear();
+        m_bucket_mask = 0;
+        throw;
+      }
+      m_size = n;
+    }
+
+    void release() noexcept {
+      if (m_slots == nullptr) return;
+      for (size_type i = 0; i < m_size; ++i) {
+        m_slots[i].~Slot();
+      }
+      std::allocator<Slot>().deallocate(m_slots, m_size);
+      m_slots = nullptr;
+      m_size  = 0;
+      m_offsets.clear();
+    }
+
+    Slot *m_slots{nullptr};
+    size_type m_size{0};
+    std::vector<size_type> m_offsets{};
+    size_type m_bucket_mask{0};
+    hasher m_hash{};
+    key_equal m_eq{};
+  };
+
+  // This class holds the current generation of a FrozenMap and allows it to be replaced
+  // atomically. Readers call load() to obtain a snapshot, which stays valid for as long as
+  // they hold it, and then query that snapshot without any further synchronization. New
+  // generations may be published with store(), or built on a background thread with
+  // rebuild_async().
+  //
+  // Where the standard library provides std::atomic<std::shared_ptr> (C++20), the current
+  // generation is held in one. Otherwise the std::atomic_load_explicit() and
+  // std::atomic_store_explicit() overloads for std::shared_ptr are used, which C++20 deprecates.
+  template <class Key, class Val, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>>
+  class AtomicFrozenMap {
+  public:
+    // ------------------------------ Member types ------------------------------ //
+    using frozen_map_type = FrozenMap<Key, Val, Hash, Pred>;
+    using snapshot_type   = std::shared_ptr<const frozen_map_type>;
+
+    // ------------------------------ Constructors ------------------------------ //
+    AtomicFrozenMap() : m_current(std::make_shared<const frozen_map_type>()) {}
+    explicit AtomicFrozenMap(frozen_map_type &&initial) : m_current(std::make_shared<const frozen_map_type>(std::move(initial))) {}
+
+    AtomicFrozenMap(const AtomicFrozenMap &)            = delete;
+    AtomicFrozenMap &operator=(const AtomicFrozenMap &) = delete;
+
+    ~AtomicFrozenMap() = default;
+
+    // ------------------------------- Accessors -------------------------------- //
+    // Returns the current generation.
+    snapshot_type load() const {
+#ifdef __cpp_lib_atomic_shared_ptr
+      return m_current.load(std::memory_order_acquire);
+#else
+      return std::atomic_load_explicit(&m_current, std::memory_order_acquire);
+#endif
+    }
+
+    // Returns the number of generations published since construction.
+    uint64_t generation() const noexcept { return m_generation.load(std::memory_order_acquire); }
+
+    // ------------------------------- Modifiers -------------------------------- //
+    // Publishes next as the current generation. Readers holding a
+    // snapshot of the previous generation are unaffected.
+    void store(frozen_map_type &&next) {
+      auto published = std::make_shared<const frozen_map_type>(std::move(next));
+#ifdef __cpp_lib_atomic_shared_ptr
+      m_current.store(std::move(published), std::memory_order_release);
+#else
+      std::atomic_store_explicit(&m_current, std::move(published), std::memory_order_release);
+#endif
+      m_generation.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    // Freezes source on a background thread, using up to thread_count threads, and publishes
+    // the result once it is complete. Source must provide freeze(unsigned), as UnorderedMap and
+    // ShardedUnorderedMap do, and must outlive the returned future.
+    template <class Source>
+    std::future<void> rebuild_async(const Source &source, unsigned thread_count = std::thread::hardware_concurrency()) {
+      return std::async(std::launch::async, [this, &source, thread_count]() { store(source.freeze(thread_count)); });
+    }
+
+  private:
+#ifdef __cpp_lib_atomic_shared_ptr
+    std::atomic<snapshot_type> m_current;
+#else
+    snapshot_type m_current;
+#endif
+    std::atomic<uint64_t> m_generation{0};
+  };
+
+} // namespace concurrency
+
+#endif // FROZEN_MAP_H
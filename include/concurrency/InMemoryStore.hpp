@@ -0,0 +1,113 @@
+#ifndef IN_MEMORY_STORE_H
+#define IN_MEMORY_STORE_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace concurrency {
+
+  // This class provides an in-process stand-in for a backing store such as a database, for use
+  // with ::concurrency::WriteBehindCache in tests and benchmarks. It implements the store
+  // interface the cache expects:
+  //
+  //   std::optional<Val> load(const Key &key);
+  //   void write(const std::vector<std::pair<Key, Val>> &batch);
+  //
+  // Every call to load() or write() sleeps for the configured latency, so that a benchmark can
+  // show the cost of round trips, and is counted. Writes can be made to fail in order to
+  // exercise error handling.
+  template <class Key, class Val, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>>
+  class InMemoryStore {
+  public:
+    using key_type    = Key;
+    using mapped_type = Val;
+    using map_type    = std::unordered_map<Key, Val, Hash, Pred>;
+
+    explicit InMemoryStore(std::chrono::microseconds latency = std::chrono::microseconds(0)) : m_latency(latency) {}
+
+    InMemoryStore(const InMemoryStore &)            = delete;
+    InMemoryStore &operator=(const InMemoryStore &) = delete;
+
+    // Returns the value stored for key, or nothing if there is none.
+    std::optional<Val> load(const Key &key) {
+      round_trip();
+      std::lock_guard<std::mutex> lock(m_mutex);
+      ++m_loads;
+      auto it = m_data.find(key);
+      if (it == m_data.end()) return std::nullopt;
+      return it->second;
+    }
+
+    // Stores every key-value pair in batch. Throws std::runtime_error, storing nothing,
+    // while writes are set to fail.
+    void write(const std::vector<std::pair<Key, Val>> &batch) {
+      round_trip();
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_fail_writes) throw std::runtime_error("::concurrency::InMemoryStore::write: write failed");
+      ++m_batches;
+      for (auto const &el: batch) {
+        m_data.insert_or_assign(el.first, el.second);
+      }
+      m_writes += batch.size();
+    }
+
+    // Stores a value directly, without latency or counting, for seeding tests.
+    void seed(const Key &key, const Val &value) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_data.insert_or_assign(key, value);
+    }
+
+    void fail_writes(bool fail) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_fail_writes = fail;
+    }
+
+    // Returns a copy of the stored data.
+    map_type data() const {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_data;
+    }
+
+    // Returns the number of calls to load().
+    uint64_t loads() const {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_loads;
+    }
+
+    // Returns the number of successful calls to write().
+    uint64_t batches() const {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_batches;
+    }
+
+    // Returns the number of key-value pairs written.
+    uint64_t writes() const {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_writes;
+    }
+
+  private:
+    void round_trip() const {
+      if (m_latency.count() > 0) std::this_thread::sleep_for(m_latency);
+    }
+
+    std::chrono::microseconds const m_latency;
+    mutable std::mutex m_mutex{};
+    map_type m_data{};
+    bool m_fail_writes{false};
+    uint64_t m_loads{0};
+    uint64_t m_batches{0};
+    uint64_t m_writes{0};
+  };
+
+} // namespace concurrency
+
+#endif // IN_MEMORY_STORE_H
@@ -0,0 +1,489 @@
+#ifndef MAP_SNAPSHOT_H
+#define MAP_SNAPSHOT_H
+
+#include <concurrency/FlatHashMap.hpp>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CONCURRENCY_POSIX_FILES 1
+#else
+#include <fstream>
+#include <mutex>
+#endif
+
+namespace concurrency {
+  namespace detail {
+    // Detects hash functions that choose shards with a shard_hash() member, such as
+    // ::concurrency::AffinityHash.
+    template <class Hash, class Key, class = void>
+    struct has_shard_hash : std::false_type {};
+
+    template <class Hash, class Key>
+    struct has_shard_hash<Hash, Key, std::void_t<decltype(std::declval<const Hash &>().shard_hash(std::declval<const Key &>()))>> : std::true_type {};
+
+    // Returns the index of the shard that key belongs to in a sharded map with shard_count
+    // shards and hash function hash.
+    template <class Hash, class Key>
+    std::size_t shard_index_of(const Hash &hash, const Key &key, std::size_t shard_count) {
+      if constexpr (has_shard_hash<Hash, Key>::value) {
+        return hash.shard_hash(key) % shard_count;
+      } else {
+        return hash(key) % shard_count;
+      }
+    }
+
+    // A snapshot file starts with a SnapshotHeader, followed by one SnapshotSection per
+    // shard. Each section points at the shard's bucket offsets and at its records, which
+    // are ordered by bucket in the same way as a FrozenMap's slots. Integers are stored in
+    // native byte order, so a snapshot can only be read on the kind of machine that wrote it.
+    constexpr char SnapshotMagic[8]          = "CMAPSNP";
+    constexpr uint32_t SnapshotFormatVersion = 1;
+    constexpr uint64_t SnapshotAlignment     = 64;
+
+    struct SnapshotHeader {
+      char magic[8];
+      uint32_t format_version;
+      uint32_t key_size;
+      uint32_t value_size;
+      uint32_t record_size;
+      uint64_t shard_count;
+      uint64_t element_count;
+    };
+
+    struct SnapshotSection {
+      uint64_t offsets_offset;
+      uint64_t records_offset;
+      uint64_t bucket_count;
+      uint64_t element_count;
+    };
+
+    template <class Key, class Val>
+    struct SnapshotRecord {
+      uint64_t hash;
+      Key key;
+      Val value;
+    };
+
+    template <class Key, class Val>
+    struct EncodedSnapshotSection {
+      std::vector<uint64_t> offsets{};
+      std::vector<SnapshotRecord<Key, Val>> records{};
+    };
+
+    inline uint64_t align_snapshot_offset(uint64_t offset) { return (offset + SnapshotAlignment - 1) / SnapshotAlignment * SnapshotAlignment; }
+
+    // Copies the elements of map into a snapshot section, bucketed by their mixed hash.
+    template <class Key, class Val, class Map, class Hash>
+    EncodedSnapshotSection<Key, Val> encode_snapshot_section(const Map &map, const Hash &hash) {
+      EncodedSnapshotSection<Key, Val> section;
+      auto const n          = static_cast<uint64_t>(map.size());
+      uint64_t bucket_count = 1;
+      while (bucket_count < n) {
+        bucket_count *= 2;
+      }
+      section.offsets.assign(bucket_count + 1, 0);
+
+      std::vector<std::pair<uint64_t, const typename Map::value_type *>> elements;
+      elements.reserve(n);
+      for (auto const &el: map) {
+        auto const h = static_cast<uint64_t>(mix_hash(hash(el.first)));
+        elements.emplace_back(h, &el);
+        ++section.offsets[(h & (bucket_count - 1)) + 1];
+      }
+      for (uint64_t b = 0; b < bucket_count; ++b) {
+        section.offsets[b + 1] += section.offsets[b];
+      }
+
+      std::vector<std::size_t> order(elements.size());
+      std::vector<uint64_t> next(section.offsets.begin(), section.offsets.end() - 1);
+      for (std::size_t i = 0; i < elements.size(); ++i) {
+        order[next[elements[i].first & (bucket_count - 1)]++] = i;
+      }
+      // The records are zeroed, padding included, and their members are then copied in one
+      // by one, so that no uninitialized bytes are written to the file.
+      section.records.resize(elements.size());
+      std::memset(static_cast<void *>(section.records.data()), 0, section.records.size() * sizeof(SnapshotRecord<Key, Val>));
+      for (std::size_t r = 0; r < order.size(); ++r) {
+        auto &record       = section.records[r];
+        auto const &source = elements[order[r]];
+        record.hash        = source.first;
+        std::memcpy(&record.key, &source.second->first, sizeof(Key));
+        std::memcpy(&record.value, &source.second->second, sizeof(Val));
+      }
+      return section;
+    }
+
+    // Returns a name next to path for a snapshot being written, unique to this call so that
+    // concurrent saves to the same path, from this or another process, never share a file.
+    inline std::string temporary_snapshot_path(const std::string &path) {
+      static std::atomic<uint64_t> next{0};
+#ifdef CONCURRENCY_POSIX_FILES
+      auto const process = static_cast<uint64_t>(::getpid());
+#else
+      auto const process = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+      return path + ".tmp." + std::to_string(process) + "." + std::to_string(next.fetch_add(1, std::memory_order_relaxed));
+    }
+
+    [[noreturn]] inline void throw_snapshot_io_error(const std::string &what) { throw std::system_error(errno, std::generic_category(), "::concurrency::MapSnapshot: " + what); }
+
+    // A file that may be written at arbitrary offsets from several threads at once.
+    class SnapshotWriter {
+    public:
+      explicit SnapshotWriter(const std::string &path) {
+#ifdef CONCURRENCY_POSIX_FILES
+        m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (m_fd < 0) throw_snapshot_io_error("cannot create " + path);
+#else
+        m_file.open(path, std::ios::binary | std::ios::trunc);
+        if (!m_file) throw_snapshot_io_error("cannot create " + path);
+#endif
+      }
+
+      SnapshotWriter(const SnapshotWriter &)            = delete;
+      SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+      ~SnapshotWriter() {
+#ifdef CONCURRENCY_POSIX_FILES
+        if (m_fd >= 0) (void) ::close(m_fd);
+#endif
+      }
+
+      void write_at(uint64_t offset, const void *data, std::size_t size) {
+        auto const *bytes = static_cast<const char *>(data);
+#ifdef CONCURRENCY_POSIX_FILES
+        while (size != 0) {
+          auto const written = ::pwrite(m_fd, bytes, size, static_cast<off_t>(offset));
+          if (written < 0) {
+            if (errno == EINTR) continue;
+            throw_snapshot_io_error("write failed");
+          }
+          bytes += written;
+          offset += static_cast<uint64_t>(written);
+          size -= static_cast<std::size_t>(written);
+        }
+#else
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_file.seekp(static_cast<std::streamoff>(offset));
+        m_file.write(bytes, static_cast<std::streamsize>(size));
+        if (!m_file) throw_snapshot_io_error("write failed");
+#endif
+      }
+
+      // Flushes the file to storage and closes it.
+      void close() {
+#ifdef CONCURRENCY_POSIX_FILES
+        if (::fsync(m_fd) != 0) throw_snapshot_io_error("fsync failed");
+        auto const fd = std::exchange(m_fd, -1);
+        if (::close(fd) != 0) throw_snapshot_io_error("close failed");
+#else
+        m_file.close();
+        if (!m_file) throw_snapshot_io_error("close failed");
+#endif
+      }
+
+    private:
+#ifdef CONCURRENCY_POSIX_FILES
+      int m_fd{-1};
+#else
+      std::ofstream m_file{};
+      std::mutex m_mutex{};
+#endif
+    };
+
+    // A read-only view of a whole file, memory-mapped where supported and read into memory
+    // elsewhere.
+    class MappedFile {
+    public:
+      explicit MappedFile(const std::string &path) {
+#ifdef CONCURRENCY_POSIX_FILES
+        int const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw_snapshot_io_error("cannot open " + path);
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+          auto const error = errno;
+          (void) ::close(fd);
+          errno = error;
+          throw_snapshot_io_error("cannot stat " + path);
+        }
+        m_size = static_cast<std::size_t>(st.st_size);
+        if (m_size != 0) {
+          void *data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+          if (data == MAP_FAILED) {
+            auto const error = errno;
+            (void) ::close(fd);
+            errno = error;
+            throw_snapshot_io_error("cannot map " + path);
+          }
+          m_data = static_cast<const unsigned char *>(data);
+        }
+        (void) ::close(fd);
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) throw_snapshot_io_error("cannot open " + path);
+        m_size = static_cast<std::size_t>(file.tellg());
+        m_buffer.reset(static_cast<unsigned char *>(::operator new(m_size + 1, std::align_val_t{SnapshotAlignment})));
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char *>(m_buffer.get()), static_cast<std::streamsize>(m_size))) throw_snapshot_io_error("cannot read " + path);
+        m_data = m_buffer.get();
+#endif
+      }
+
+      MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+
+      MappedFile &operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+          release();
+          m_data = std::exchange(other.m_data, nullptr);
+          m_size = std::exchange(other.m_size, 0);
+#ifndef CONCURRENCY_POSIX_FILES
+          m_buffer = std::move(other.m_buffer);
+#endif
+        }
+        return *this;
+      }
+
+      ~MappedFile() { release(); }
+
+      const unsigned char *data() const noexcept { return m_data; }
+      std::size_t size() const noexcept { return m_size; }
+
+    private:
+      void release() noexcept {
+#ifdef CONCURRENCY_POSIX_FILES
+        if (m_data != nullptr) (void) ::munmap(const_cast<unsigned char *>(m_data), m_size);
+#endif
+        m_data = nullptr;
+        m_size = 0;
+      }
+
+      const unsigned char *m_data{nullptr};
+      std::size_t m_size{0};
+#ifndef CONCURRENCY_POSIX_FILES
+      struct AlignedDelete {
+        void operator()(unsigned char *p) const { ::operator delete(p, std::align_val_t{SnapshotAlignment}); }
+      };
+      std::unique_ptr<unsigned char, AlignedDelete> m_buffer{};
+#endif
+    };
+
+    // Writes a snapshot of shard_count shards to path. run(f) must call f(i) once for every
+    // shard index i, possibly in parallel, and encode(i) must return the encoded section
+    // of shard i. The file is written under a temporary name and renamed over path once it
+    // is complete, so that an interrupted save never leaves a partial snapshot behind.
+    template <class Key, class Val, class Run, class Encode>
+    void write_snapshot(const std::string &path, uint32_t shard_count, Run &&run, Encode &&encode) {
+      using record_type = SnapshotRecord<Key, Val>;
+      static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Val>, "Snapshots require trivially copyable keys and values.");
+      static_assert(alignof(record_type) <= SnapshotAlignment, "Snapshot records must not be over-aligned.");
+
+      std::vector<EncodedSnapshotSection<Key, Val>> encoded(shard_count);
+      run([&](uint32_t i) { encoded[i] = encode(i); });
+
+      SnapshotHeader header{};
+      std::memcpy(header.magic, SnapshotMagic, sizeof(header.magic));
+      header.format_version = SnapshotFormatVersion;
+      header.key_size       = static_cast<uint32_t>(sizeof(Key));
+      header.value_size     = static_cast<uint32_t>(sizeof(Val));
+      header.record_size    = static_cast<uint32_t>(sizeof(record_type));
+      header.shard_count    = shard_count;
+
+      std::vector<SnapshotSection> sections(shard_count);
+      uint64_t offset = sizeof(SnapshotHeader) + shard_count * sizeof(SnapshotSection);
+      for (uint32_t i = 0; i < shard_count; ++i) {
+        auto &section          = sections[i];
+        section.bucket_count   = encoded[i].offsets.size() - 1;
+        section.element_count  = encoded[i].records.size();
+        section.offsets_offset = align_snapshot_offset(offset);
+        section.records_offset = align_snapshot_offset(section.offsets_offset + encoded[i].offsets.size() * sizeof(uint64_t));
+        offset                 = section.records_offset + section.element_count * sizeof(record_type);
+        header.element_count += section.element_count;
+      }
+
+      auto const temporary = temporary_snapshot_path(path);
+      try {
+        SnapshotWriter writer(temporary);
+        writer.write_at(0, &header, sizeof(header));
+        writer.write_at(sizeof(header), sections.data(), sections.size() * sizeof(SnapshotSection));
+        run([&](uint32_t i) {
+          auto &section = encoded[i];
+          writer.write_at(sections[i].offsets_offset, section.offsets.data(), section.offsets.size() * sizeof(uint64_t));
+          writer.write_at(sections[i].records_offset, section.records.data(), section.records.size() * sizeof(record_type));
+          section = {};
+        });
+        writer.close();
+#ifndef CONCURRENCY_POSIX_FILES
+        (void) std::remove(path.c_str());
+#endif
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) throw_snapshot_io_error("cannot rename " + temporary + " to " + path);
+      } catch (...) {
+        (void) std::remove(temporary.c_str());
+        throw;
+      }
+    }
+  } // namespace detail
+
+  // This class provides a read-only map served directly from a snapshot file written by
+  // UnorderedMap::save() or ShardedUnorderedMap::save(). The file is memory-mapped, so
+  // opening it only validates its section table and bucket offsets; elements are neither
+  // copied nor hashed, and their pages are read in as lookups touch them. Like FrozenMap, it never changes,
+  // so any number of threads may query it concurrently without locks.
+  //
+  // Key and Val must be trivially copyable, and Hash must be the hash function of the map
+  // that wrote the snapshot and must hash equal keys identically in every process. A file
+  // that does not match Key and Val, or is malformed, throws std::runtime_error; a file that
+  // cannot be read throws std::system_error.
+  template <class Key, class Val, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>>
+  class MappedSnapshot {
+    using record_type = detail::SnapshotRecord<Key, Val>;
+
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Val>, "MappedSnapshot requires trivially copyable keys and values.");
+
+  public:
+    // ------------------------------ Member types ------------------------------ //
+    using key_type    = Key;
+    using mapped_type = Val;
+    using size_type   = std::size_t;
+    using hasher      = Hash;
+    using key_equal   = Pred;
+
+    // ------------------------------ Constructors ------------------------------ //
+    explicit MappedSnapshot(const std::string &path, const Hash &hash = Hash(), const Pred &eq = Pred()) :
+        m_file(path), m_hash(hash), m_eq(eq) {
+      validate();
+    }
+
+    // -------------------------------- Capacity -------------------------------- //
+    bool empty() const noexcept { return size() == 0; }
+    size_type size() const noexcept { return static_cast<size_type>(header().element_count); }
+
+    // Returns the number of shards of the map that wrote the snapshot.
+    size_type shard_count() const noexcept { return static_cast<size_type>(header().shard_count); }
+
+    // Returns the number of elements in the given shard.
+    size_type shard_size(size_type shard) const { return static_cast<size_type>(section(shard).element_count); }
+
+    // ------------------------------ Accessors --------------------------------- //
+    // Returns a reference to the element mapped to the provided key.
+    // Does bounds checking.
+    const Val &at(const Key &key) const {
+      auto const *record = lookup(key);
+      if (record == nullptr) throw std::out_of_range("::concurrency::MappedSnapshot::at: key not found");
+      return record->value;
+    }
+
+    // Returns a pointer to the element mapped to the provided
+    // key, or nullptr if the key is not present.
+    const Val *get(const Key &key) const {
+      auto const *record = lookup(key);
+      return record == nullptr ? nullptr : &record->value;
+    }
+
+    size_type count(const Key &key) const { return lookup(key) == nullptr ? 0 : 1; }
+
+    // Returns a bool indicating whether or not the
+    // provided key is present in the map.
+    bool find(const Key &key) const { return lookup(key) != nullptr; }
+
+    // Calls f(key, value) for every element.
+    template <class F>
+    void for_each(F &&f) const {
+      for (size_type shard = 0; shard < shard_count(); ++shard) {
+        for_each_in_shard(shard, f);
+      }
+    }
+
+    // Calls f(key, value) for every element of the given shard.
+    template <class F>
+    void for_each_in_shard(size_type shard, F &&f) const {
+      auto const &s       = section(shard);
+      auto const *records = records_of(s);
+      for (uint64_t i = 0; i < s.element_count; ++i) {
+        f(records[i].key, records[i].value);
+      }
+    }
+
+    // ------------------------------- Observers -------------------------------- //
+    hasher hash_function() const { return m_hash; }
+
+    key_equal key_eq() const { return m_eq; }
+
+  private:
+    const detail::SnapshotHeader &header() const noexcept { return *reinterpret_cast<const detail::SnapshotHeader *>(m_file.data()); }
+
+    const detail::SnapshotSection &section(size_type shard) const {
+      if (shard >= shard_count()) throw std::out_of_range("::concurrency::MappedSnapshot: shard index out of range");
+      return reinterpret_cast<const detail::SnapshotSection *>(m_file.data() + sizeof(detail::SnapshotHeader))[shard];
+    }
+
+    const uint64_t *offsets_of(const detail::SnapshotSection &s) const noexcept { return reinterpret_cast<const uint64_t *>(m_file.data() + s.offsets_offset); }
+    const record_type *records_of(const detail::SnapshotSection &s) const noexcept { return reinterpret_cast<const record_type *>(m_file.data() + s.records_offset); }
+
+    const record_type *lookup(const Key &key) const {
+      if (empty()) return nullptr;
+      auto const &s       = section(detail::shard_index_of(m_hash, key, shard_count()));
+      auto const hash     = static_cast<uint64_t>(detail::mix_hash(m_hash(key)));
+      auto const b        = hash & (s.bucket_count - 1);
+      auto const *offsets = offsets_of(s);
+      auto const *records = records_of(s);
+      for (auto i = offsets[b]; i < offsets[b + 1]; ++i) {
+        if (records[i].hash == hash && m_eq(records[i].key, key)) return &records[i];
+      }
+      return nullptr;
+    }
+
+    // Checks that the file was written for Key and Val, and that every section lies within
+    // the file and is consistent with its bucket offsets.
+    void validate() const {
+      auto const fail = [](const char *what) { throw std::runtime_error(std::string("::concurrency::MappedSnapshot: ") + what); };
+      auto const size = static_cast<uint64_t>(m_file.size());
+      if (size < sizeof(detail::SnapshotHeader)) fail("file is too short");
+      auto const &h = header();
+      if (std::memcmp(h.magic, detail::SnapshotMagic, sizeof(h.magic)) != 0) fail("not a snapshot file");
+      if (h.format_version != detail::SnapshotFormatVersion) fail("unsupported format version");
+      if (h.key_size != sizeof(Key) || h.value_size != sizeof(Val) || h.record_size != sizeof(record_type)) fail("key or value type does not match");
+      if (h.shard_count == 0 || h.shard_count > (size - sizeof(detail::SnapshotHeader)) / sizeof(detail::SnapshotSection)) fail("bad shard table");
+
+      uint64_t total = 0;
+      for (size_type shard = 0; shard < shard_count(); ++shard) {
+        auto const &s = section(shard);
+        if (s.bucket_count == 0 || (s.bucket_count & (s.bucket_count - 1)) != 0) fail("bad bucket count");
+        if (s.offsets_offset % detail::SnapshotAlignment != 0 || s.records_offset % detail::SnapshotAlignment != 0) fail("misaligned section");
+        if (s.offsets_offset > size || s.bucket_count >= (size - s.offsets_offset) / sizeof(uint64_t)) fail("truncated section");
+        if (s.element_count != 0 && (s.records_offset > size || s.element_count > (size - s.records_offset) / sizeof(record_type))) fail("truncated section");
+        auto const *offsets = offsets_of(s);
+        if (offsets[0] != 0 || offsets[s.bucket_count] != s.element_count) fail("bad bucket offsets");
+        for (uint64_t b = 0; b < s.bucket_count; ++b) {
+          if (offsets[b] > offsets[b + 1]) fail("bad bucket offsets");
+        }
+        total += s.element_count;
+      }
+      if (total != h.element_count) fail("element count does not match");
+    }
+
+    detail::MappedFile m_file;
+    Hash m_hash;
+    Pred m_eq;
+  };
+
+} // namespace concurrency
+
+#endif // MAP_SNAPSHOT_H
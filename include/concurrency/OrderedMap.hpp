@@ -0,0 +1,345 @@
+#ifndef ORDERED_CONCURRENT_MAP_H
+#define ORDERED_CONCURRENT_MAP_H
+
+#include <concurrency/Epoch.hpp>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace concurrency {
+  constexpr int OrderedMapMaxLevel = 24;
+
+  // This class provides a thread-safe ordered map, kept in a skiplist that is searched without
+  // locks. Writers lock only the nodes next to the one they insert or erase, so writers to
+  // different parts of the map proceed in parallel, and readers never block writers or each
+  // other. It follows the lazy skiplist of Herlihy, Lev, Luchangco and Shavit: a node is
+  // logically erased by marking it before it is unlinked, and only counts as present once it
+  // is linked at every level.
+  //
+  // Lookups return copies, as with ::concurrency::UnorderedMap. visit_range() calls a function
+  // for every element in a key range, in ascending key order, without holding any lock while
+  // the function runs. It is not a snapshot: elements inserted or erased during the scan may
+  // or may not be visited, but every element present throughout the scan is visited once.
+  //
+  // Erased nodes may still be in use by concurrent searches, so they are retired to a
+  // ::concurrency::Epoch, which every search pins for its duration, and freed once every search
+  // that was in progress when they were unlinked has finished. Searches that start later do
+  // not hold them back, so erased nodes are reclaimed under a continuous stream of searches.
+  //
+  // http://people.csail.mit.edu/shanir/publications/LazySkipList.pdf
+  template <class Key, class Val, class Compare = std::less<Key>>
+  class OrderedMap {
+  public:
+    // ------------------------------ Member types ------------------------------ //
+    using key_type          = Key;
+    using mapped_type       = Val;
+    using value_type        = std::pair<const Key, Val>;
+    using size_type         = std::size_t;
+    using key_compare       = Compare;
+    using internal_map_type = std::map<Key, Val, Compare>;
+
+  private:
+    struct Node {
+      explicit Node(int h) : height(h), next(std::make_unique<std::atomic<Node *>[]>(h)) {
+        for (int i = 0; i < h; ++i) {
+          next[i].store(nullptr, std::memory_order_relaxed);
+        }
+      }
+      virtual ~Node() = default;
+
+      // Guards the node's links while a neighbour is inserted or erased, and its value.
+      std::mutex mutex{};
+      std::atomic_bool marked{false};
+      std::atomic_bool fully_linked{false};
+      int const height;
+      std::unique_ptr<std::atomic<Node *>[]> next;
+    };
+
+    struct Entry final : Node {
+      template <class M>
+      Entry(int h, const Key &k, M &&obj) : Node(h), key(k), value(std::forward<M>(obj)) {}
+
+      Key const key;
+      Val value;
+    };
+
+    // Marks the calling thread as searching the skiplist for its lifetime.
+    class SearchGuard {
+    public:
+      explicit SearchGuard(const OrderedMap &map) : m_guard(map.m_epoch.pin()) {}
+
+    private:
+      Epoch::guard m_guard;
+    };
+
+    using Links = std::array<Node *, OrderedMapMaxLevel>;
+
+  public:
+    // ------------------------------ Constructors ------------------------------ //
+    OrderedMap() = default;
+    explicit OrderedMap(const Compare &comp) : m_less(comp) {}
+    OrderedMap(std::initializer_list<value_type> ilist, const Compare &comp = Compare()) : m_less(comp) {
+      for (auto const &el: ilist) {
+        (void) insert(el.first, el.second);
+      }
+    }
+
+    OrderedMap(const OrderedMap &)            = delete;
+    OrderedMap &operator=(const OrderedMap &) = delete;
+
+    ~OrderedMap() {
+      auto *node = m_head.next[0].load(std::memory_order_relaxed);
+      while (node != nullptr) {
+        auto *next = node->next[0].load(std::memory_order_relaxed);
+        delete node;
+        node = next;
+      }
+    }
+
+    // -------------------------------- Capacity -------------------------------- //
+    bool empty() const noexcept { return size() == 0; }
+
+    size_type size() const noexcept { return m_size.load(std::memory_order_relaxed); }
+
+    // ------------------------------- Modifiers -------------------------------- //
+    // Inserts obj unless an element for k exists. Returns true if obj was inserted.
+    template <class M>
+    bool insert(const Key &k, M &&obj) {
+      return write(k, std::forward<M>(obj), false);
+    }
+
+    // Inserts or replaces the element for k. Returns true if no element for k existed.
+    template <class M>
+    bool insert_or_assign(const Key &k, M &&obj) {
+      return write(k, std::forward<M>(obj), true);
+    }
+
+    size_type erase(const Key &key) {
+      Entry *victim = nullptr;
+      {
+        SearchGuard guard(*this);
+        victim = unlink(key);
+      }
+      if (victim == nullptr) return 0;
+      m_size.fetch_sub(1, std::memory_order_relaxed);
+      m_epoch.retire(victim);
+      return 1;
+    }
+
+    // Erases every element. Elements inserted concurrently may remain.
+    void clear() {
+      for (auto const &el: data()) {
+        (void) erase(el.first);
+      }
+    }
+
+    // --------------------------------- Lookup --------------------------------- //
+    // Returns a copy of the element mapped to the provided key. Does bounds checking.
+    Val at(const Key &key) const {
+      SearchGuard guard(*this);
+      auto *entry = find_entry(key);
+      if (entry == nullptr) throw std::out_of_range("::concurrency::OrderedMap::at: key not found");
+      std::lock_guard<std::mutex> lock(entry->mutex);
+      return entry->value;
+    }
+
+    size_type count(const Key &key) const { return find(key) ? 1 : 0; }
+
+    // Returns a bool indicating whether or not the
+    // provided key is present in the map.
+    bool find(const Key &key) const {
+      SearchGuard guard(*this);
+      return find_entry(key) != nullptr;
+    }
+
+    bool contains(const Key &key) const { return find(key); }
+
+    // Calls f(const Key &, const Val &) for every element whose key is in [lo, hi), in
+    // ascending key order, and returns the number of elements visited. Each value is copied
+    // under its node's lock and f is called without holding any lock, so f may access the map.
+    template <class F>
+    size_type visit_range(const Key &lo, const Key &hi, F &&f) const {
+      SearchGuard guard(*this);
+      Links preds;
+      Links succs;
+      (void) search(lo, preds, succs);
+      size_type n = 0;
+      for (auto *node = succs[0]; node != nullptr; node = node->next[0].load(std::memory_order_acquire)) {
+        auto *entry = static_cast<Entry *>(node);
+        if (!m_less(entry->key, hi)) break;
+        if (!is_live(entry)) continue;
+        Val value = copy_value(*entry);
+        f(static_cast<const Key &>(entry->key), static_cast<const Val &>(value));
+        ++n;
+      }
+      return n;
+    }
+
+    // Returns a non-thread-safe copy of the elements of the map.
+    internal_map_type data() const {
+      SearchGuard guard(*this);
+      internal_map_type m(m_less);
+      for (auto *node = m_head.next[0].load(std::memory_order_acquire); node != nullptr; node = node->next[0].load(std::memory_order_acquire)) {
+        auto *entry = static_cast<Entry *>(node);
+        if (is_live(entry)) m.emplace_hint(m.end(), entry->key, copy_value(*entry));
+      }
+      return m;
+    }
+
+    // ------------------------------- Observers -------------------------------- //
+    key_compare key_comp() const { return m_less; }
+
+  private:
+    static bool is_live(const Node *node) noexcept { return node->fully_linked.load(std::memory_order_acquire) && !node->marked.load(std::memory_order_acquire); }
+
+    static Val copy_value(Entry &entry) {
+      std::lock_guard<std::mutex> lock(entry.mutex);
+      return entry.value;
+    }
+
+    static int random_height() {
+      static thread_local std::mt19937 rng(static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())));
+      auto bits  = rng();
+      int height = 1;
+      while (height < OrderedMapMaxLevel && (bits & 1) != 0) {
+        ++height;
+        bits >>= 1;
+      }
+      return height;
+    }
+
+    // Fills preds and succs with the nodes either side of key at every level, and returns
+    // the highest level at which a node with key was found, or -1. Callers must hold a
+    // SearchGuard.
+    int search(const Key &key, Links &preds, Links &succs) const {
+      int found = -1;
+      Node *pred = const_cast<Node *>(&m_head);
+      for (int level = OrderedMapMaxLevel - 1; level >= 0; --level) {
+        auto *curr = pred->next[level].load(std::memory_order_acquire);
+        while (curr != nullptr && m_less(static_cast<Entry *>(curr)->key, key)) {
+          pred = curr;
+          curr = pred->next[level].load(std::memory_order_acquire);
+        }
+        if (found == -1 && curr != nullptr && !m_less(key, static_cast<Entry *>(curr)->key)) found = level;
+        preds[level] = pred;
+        succs[level] = curr;
+      }
+      return found;
+    }
+
+    // Callers must hold a SearchGuard.
+    Entry *find_entry(const Key &key) const {
+      Links preds;
+      Links succs;
+      auto const found = search(key, preds, succs);
+      if (found == -1 || !is_live(succs[found])) return nullptr;
+      return static_cast<Entry *>(succs[found]);
+    }
+
+    // Locks the distinct predecessors of levels [0, height) into locks and checks that each
+    // is still live and still points to its successor. Callers must hold a SearchGuard.
+    static bool lock_and_validate(int height, const Links &preds, const Links &succs, std::array<std::unique_lock<std::mutex>, OrderedMapMaxLevel> &locks) {
+      Node *prev = nullptr;
+      for (int level = 0; level < height; ++level) {
+        auto *pred = preds[level];
+        auto *succ = succs[level];
+        if (pred != prev) {
+          locks[level] = std::unique_lock<std::mutex>(pred->mutex);
+          prev         = pred;
+        }
+        if (pred->marked.load(std::memory_order_acquire)) return false;
+        if (pred->next[level].load(std::memory_order_acquire) != succ) return false;
+      }
+      return true;
+    }
+
+    template <class M>
+    bool write(const Key &k, M &&obj, bool assign) {
+      SearchGuard guard(*this);
+      auto const height = random_height();
+      Links preds;
+      Links succs;
+      while (true) {
+        auto const found = search(k, preds, succs);
+        if (found != -1) {
+          auto *existing = static_cast<Entry *>(succs[found]);
+          if (existing->marked.load(std::memory_order_acquire)) continue;
+          while (!existing->fully_linked.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+          }
+          if (!assign) return false;
+          std::lock_guard<std::mutex> lock(existing->mutex);
+          if (existing->marked.load(std::memory_order_acquire)) continue;
+          existing->value = std::forward<M>(obj);
+          return false;
+        }
+        std::array<std::unique_lock<std::mutex>, OrderedMapMaxLevel> locks;
+        bool valid = lock_and_validate(height, preds, succs, locks);
+        for (int level = 0; valid && level < height; ++level) {
+          valid = succs[level] == nullptr || !succs[level]->marked.load(std::memory_order_acquire);
+        }
+        if (!valid) continue;
+        auto *entry = new Entry(height, k, std::forward<M>(obj));
+        for (int level = 0; level < height; ++level) {
+          entry->next[level].store(succs[level], std::memory_order_relaxed);
+        }
+        for (int level = 0; level < height; ++level) {
+          preds[level]->next[level].store(entry, std::memory_order_release);
+        }
+        entry->fully_linked.store(true, std::memory_order_release);
+        m_size.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+
+    // Marks and unlinks the entry for key, and returns it, or nullptr if there was none.
+    // Callers must hold a SearchGuard.
+    Entry *unlink(const Key &key) {
+      Entry *victim = nullptr;
+      std::unique_lock<std::mutex> victim_lock;
+      Links preds;
+      Links succs;
+      while (true) {
+        auto const found = search(key, preds, succs);
+        if (victim == nullptr) {
+          if (found == -1) return nullptr;
+          auto *candidate = static_cast<Entry *>(succs[found]);
+          // A node that is not yet linked at every level has not been inserted yet.
+          if (!candidate->fully_linked.load(std::memory_order_acquire) || candidate->height - 1 != found) return nullptr;
+          victim_lock = std::unique_lock<std::mutex>(candidate->mutex);
+          if (candidate->marked.load(std::memory_order_acquire)) return nullptr;
+          candidate->marked.store(true, std::memory_order_release);
+          victim = candidate;
+        }
+        std::array<std::unique_lock<std::mutex>, OrderedMapMaxLevel> locks;
+        Links expected;
+        for (int level = 0; level < victim->height; ++level) {
+          expected[level] = victim;
+        }
+        if (!lock_and_validate(victim->height, preds, expected, locks)) continue;
+        for (int level = victim->height - 1; level >= 0; --level) {
+          preds[level]->next[level].store(victim->next[level].load(std::memory_order_relaxed), std::memory_order_release);
+        }
+        return victim;
+      }
+    }
+
+    Compare m_less{};
+    Node m_head{OrderedMapMaxLevel};
+    std::atomic<size_type> m_size{0};
+    // Frees the retired nodes still pending when the map is destroyed.
+    mutable Epoch m_epoch{};
+  };
+
+} // namespace concurrency
+
+#endif // ORDERED_CONCURRENT_MAP_H
@@ -0,0 +1,94 @@
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace concurrency {
+  namespace detail {
+    // Returns a small integer that stays fixed for the calling thread. Threads are numbered
+    // in the order they first ask, so that up to N threads land on N distinct stripes of a
+    // striped structure indexed by this number modulo N.
+    inline uint32_t thread_stripe() noexcept {
+      static std::atomic<uint32_t> next{0};
+      static thread_local uint32_t const stripe = next.fetch_add(1, std::memory_order_relaxed);
+      return stripe;
+    }
+
+    // Rounds count up to a power of two, so that stripes can be picked with a mask.
+    inline std::size_t stripe_count_for(std::size_t count) noexcept {
+      std::size_t rounded = 1;
+      while (rounded < count) {
+        rounded *= 2;
+      }
+      return rounded;
+    }
+  } // namespace detail
+
+  // This class provides a counter for values that are updated far more often than they are
+  // read, in the style of Java's LongAdder. The count is split over cache-line-sized stripes
+  // and each thread adds to its own, so that increments from different threads do not
+  // contend. sum() adds up the stripes, and is therefore only exact if no thread is adding
+  // at the same time.
+  //
+  // The stripe count defaults to the number of hardware threads, rounded up to a power of
+  // two.
+  class ShardedCounter {
+    struct alignas(64) Stripe {
+      std::atomic<int64_t> value{0};
+    };
+
+  public:
+    // ------------------------------ Constructors ------------------------------ //
+    explicit ShardedCounter(std::size_t stripe_count = std::thread::hardware_concurrency())
+        : m_mask(detail::stripe_count_for(std::max<std::size_t>(1, stripe_count)) - 1), m_stripes(std::make_unique<Stripe[]>(m_mask + 1)) {}
+
+    ShardedCounter(const ShardedCounter &)            = delete;
+    ShardedCounter &operator=(const ShardedCounter &) = delete;
+
+    // -------------------------------- Updates --------------------------------- //
+    void add(int64_t delta) noexcept { m_stripes[detail::thread_stripe() & m_mask].value.fetch_add(delta, std::memory_order_relaxed); }
+
+    void increment() noexcept { add(1); }
+
+    void decrement() noexcept { add(-1); }
+
+    // Sets every stripe to zero. Adds that race with reset() may or may not be kept.
+    void reset() noexcept {
+      for (std::size_t i = 0; i <= m_mask; ++i) {
+        m_stripes[i].value.store(0, std::memory_order_relaxed);
+      }
+    }
+
+    // Returns the sum and sets every stripe to zero, without losing adds that race with it.
+    int64_t sum_and_reset() noexcept {
+      int64_t sum = 0;
+      for (std::size_t i = 0; i <= m_mask; ++i) {
+        sum += m_stripes[i].value.exchange(0, std::memory_order_relaxed);
+      }
+      return sum;
+    }
+
+    // --------------------------------- Reads ---------------------------------- //
+    int64_t sum() const noexcept {
+      int64_t sum = 0;
+      for (std::size_t i = 0; i <= m_mask; ++i) {
+        sum += m_stripes[i].value.load(std::memory_order_relaxed);
+      }
+      return sum;
+    }
+
+    std::size_t stripe_count() const noexcept { return m_mask + 1; }
+
+  private:
+    std::size_t const m_mask;
+    std::unique_ptr<Stripe[]> m_stripes;
+  };
+
+} // namespace concurrency
+
+#endif // SHARDED_COUNTER_H
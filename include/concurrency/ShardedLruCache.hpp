@@ -0,0 +1,256 @@
+#ifndef SHARDED_LRU_CACHE_H
+#define SHARDED_LRU_CACHE_H
+
+#include <concurrency/ShardedCounter.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace concurrency {
+  constexpr uint32_t DefaultLruCacheShardCount = 16;
+
+  // This class provides a sharded, thread-safe, fixed-capacity cache. Each shard holds at most
+  // capacity / ShardCount entries (rounded up) and, once full, evicts an entry to make room for
+  // every new one. Eviction approximates least-recently-used order with the CLOCK algorithm: a
+  // hit only sets the entry's reference bit, with a relaxed atomic store under the shard's shared
+  // lock, so readers never write to a shared list. An insertion into a full shard advances the
+  // shard's clock hand over its entries, clearing reference bits, until it reaches an entry that
+  // has not been referenced since the hand last passed it, and evicts that entry.
+  //
+  // Hits and misses are counted on ::concurrency::ShardedCounter stripes, so that lookups from
+  // different threads do not write to a shared cache line, and evictions are counted per shard
+  // under its write lock. Only get() and get_or_load() count hits and misses.
+  template <class Key,
+            class Val,
+            uint32_t ShardCount = DefaultLruCacheShardCount,
+            class Hash          = std::hash<Key>,
+            class Pred          = std::equal_to<Key>>
+  class ShardedLruCache {
+    static_assert(ShardCount != 0, "ShardCount template parameter must be non-zero.");
+
+  public:
+    // ------------------------------ Member types ------------------------------ //
+    using key_type    = Key;
+    using mapped_type = Val;
+    using value_type  = std::pair<const Key, Val>;
+    using size_type   = std::size_t;
+    using hasher      = Hash;
+    using key_equal   = Pred;
+
+  private:
+    struct Slot {
+      std::optional<std::pair<Key, Val>> entry{};
+      std::atomic_bool referenced{false};
+    };
+
+    struct alignas(64) Shard {
+      mutable std::shared_mutex mutex{};
+      std::unordered_map<Key, size_type, Hash, Pred> index{};
+      std::unique_ptr<Slot[]> slots{};
+      size_type capacity{0};
+      size_type used{0};
+      size_type hand{0};
+      std::vector<size_type> free{};
+      std::atomic<uint64_t> evictions{0};
+    };
+
+  public:
+    // ------------------------------ Constructors ------------------------------ //
+    // Creates a cache holding at least capacity entries in total, and at least one per shard.
+    explicit ShardedLruCache(size_type capacity) {
+      auto const per_shard = std::max<size_type>(1, (capacity + ShardCount - 1) / ShardCount);
+      for (auto &shard: m_shards) {
+        shard.slots    = std::make_unique<Slot[]>(per_shard);
+        shard.capacity = per_shard;
+        shard.index.reserve(per_shard);
+      }
+    }
+
+    ShardedLruCache(const ShardedLruCache &)            = delete;
+    ShardedLruCache &operator=(const ShardedLruCache &) = delete;
+
+    // -------------------------------- Capacity -------------------------------- //
+    size_type capacity() const noexcept { return m_shards[0].capacity * ShardCount; }
+
+    size_type size() const {
+      size_type n = 0;
+      for (auto const &shard: m_shards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        n += shard.index.size();
+      }
+      return n;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // ------------------------------- Modifiers -------------------------------- //
+    // Inserts or replaces the entry for key, evicting another entry from key's shard if it
+    // is full. Returns true if key was not already cached.
+    template <class M>
+    bool put(const Key &key, M &&obj) {
+      auto &shard = get_shard(key);
+      std::unique_lock<std::shared_mutex> lock(shard.mutex);
+      return put_locked(shard, key, std::forward<M>(obj)).second;
+    }
+
+    // Returns true if an entry was removed.
+    bool erase(const Key &key) {
+      auto &shard = get_shard(key);
+      std::unique_lock<std::shared_mutex> lock(shard.mutex);
+      auto it = shard.index.find(key);
+      if (it == shard.index.end()) return false;
+      shard.slots[it->second].entry.reset();
+      shard.free.push_back(it->second);
+      shard.index.erase(it);
+      return true;
+    }
+
+    // Removes every entry. Does not reset the counters.
+    void clear() {
+      for (auto &shard: m_shards) {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        for (size_type i = 0; i < shard.used; ++i) {
+          shard.slots[i].entry.reset();
+          shard.slots[i].referenced.store(false, std::memory_order_relaxed);
+        }
+        shard.index.clear();
+        shard.free.clear();
+        shard.used = 0;
+        shard.hand = 0;
+      }
+    }
+
+    // --------------------------------- Lookup --------------------------------- //
+    // Returns a copy of the value cached for key, marking it as recently used, or nothing on a miss.
+    std::optional<Val> get(const Key &key) {
+      auto &shard = get_shard(key);
+      std::shared_lock<std::shared_mutex> lock(shard.mutex);
+      auto it = shard.index.find(key);
+      if (it == shard.index.end()) {
+        m_misses.increment();
+        return std::nullopt;
+      }
+      m_hits.increment();
+      auto &slot = shard.slots[it->second];
+      touch(slot);
+      return slot.entry->second;
+    }
+
+    // Returns a copy of the value cached for key. On a miss, calls loader(key) without holding
+    // any lock and caches its result, unless another thread cached a value for key in the
+    // meantime, in which case that value is returned instead. Concurrent misses on the same
+    // key may therefore each call loader. Exceptions thrown by loader propagate, caching nothing.
+    template <class Loader>
+    Val get_or_load(const Key &key, Loader &&loader) {
+      if (auto cached = get(key)) return std::move(*cached);
+      Val loaded  = loader(key);
+      auto &shard = get_shard(key);
+      std::unique_lock<std::shared_mutex> lock(shard.mutex);
+      auto it = shard.index.find(key);
+      if (it != shard.index.end()) return shard.slots[it->second].entry->second;
+      return put_locked(shard, key, std::move(loaded)).first->second;
+    }
+
+    // Returns true if key is cached, without marking it as used or counting a hit or miss.
+    bool contains(const Key &key) const {
+      auto const &shard = get_shard(key);
+      std::shared_lock<std::shared_mutex> lock(shard.mutex);
+      return shard.index.find(key) != shard.index.end();
+    }
+
+    // ------------------------------- Statistics ------------------------------- //
+    uint64_t hits() const noexcept { return static_cast<uint64_t>(m_hits.sum()); }
+    uint64_t misses() const noexcept { return static_cast<uint64_t>(m_misses.sum()); }
+    uint64_t evictions() const noexcept {
+      uint64_t n = 0;
+      for (auto const &shard: m_shards) {
+        n += shard.evictions.load(std::memory_order_relaxed);
+      }
+      return n;
+    }
+
+    // ---------------------------------- Misc ---------------------------------- //
+    static constexpr uint32_t shard_count() noexcept { return ShardCount; }
+    hasher hash_function() const { return hasher(); }
+
+  private:
+    // Sets the reference bit only if it is clear, so that repeated hits on a hot entry
+    // do not keep dirtying its cache line.
+    static void touch(Slot &slot) noexcept {
+      if (!slot.referenced.load(std::memory_order_relaxed)) slot.referenced.store(true, std::memory_order_relaxed);
+    }
+
+    // Callers must hold the shard's write lock. Returns the entry for key and whether it
+    // was newly inserted.
+    template <class M>
+    std::pair<std::pair<Key, Val> *, bool> put_locked(Shard &shard, const Key &key, M &&obj) {
+      auto it = shard.index.find(key);
+      if (it != shard.index.end()) {
+        auto &slot         = shard.slots[it->second];
+        slot.entry->second = std::forward<M>(obj);
+        touch(slot);
+        return {&*slot.entry, false};
+      }
+      auto const idx = allocate_slot(shard);
+      auto &slot     = shard.slots[idx];
+      try {
+        slot.entry.emplace(key, std::forward<M>(obj));
+        slot.referenced.store(false, std::memory_order_relaxed);
+        shard.index.emplace(key, idx);
+      } catch (...) {
+        slot.entry.reset();
+        shard.free.push_back(idx);
+        throw;
+      }
+      return {&*slot.entry, true};
+    }
+
+    // Returns the index of an empty slot, evicting an entry if the shard is full. The slot
+    // must be filled, or returned to the free list, before the lock is released. Callers must
+    // hold the shard's write lock.
+    static size_type allocate_slot(Shard &shard) {
+      if (!shard.free.empty()) {
+        auto const idx = shard.free.back();
+        shard.free.pop_back();
+        return idx;
+      }
+      if (shard.used < shard.capacity) return shard.used++;
+      // Every slot is in use, so the hand finds a victim, or an empty slot, within two
+      // revolutions.
+      while (true) {
+        auto const idx = shard.hand;
+        shard.hand     = (shard.hand + 1) % shard.capacity;
+        auto &slot     = shard.slots[idx];
+        if (!slot.entry) return idx;
+        if (slot.referenced.load(std::memory_order_relaxed)) {
+          slot.referenced.store(false, std::memory_order_relaxed);
+          continue;
+        }
+        shard.index.erase(slot.entry->first);
+        slot.entry.reset();
+        shard.evictions.fetch_add(1, std::memory_order_relaxed);
+        return idx;
+      }
+    }
+
+    uint32_t get_shard_idx(const Key &key) const { return hash_function()(key) % ShardCount; }
+    Shard &get_shard(const Key &key) { return m_shards[get_shard_idx(key)]; }
+    const Shard &get_shard(const Key &key) const { return m_shards[get_shard_idx(key)]; }
+
+    std::array<Shard, ShardCount> m_shards{};
+    ShardedCounter m_hits{};
+    ShardedCounter m_misses{};
+  };
+
+} // namespace concurrency
+
+#endif // SHARDED_LRU_CACHE_H
@@ -1,11 +1,45 @@
 #ifndef SHARDED_UNORDERED_CONCURRENT_MAP
 #define SHARDED_UNORDERED_CONCURRENT_MAP
 
+#include <concurrency/ThreadPool.hpp>
 #include <concurrency/UnorderedMap.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace concurrency {
   constexpr uint32_t DefaultUnorderedMapShardCount = 32;
 
+  // A hash function for ShardedUnorderedMap that places keys in shards by affinity group, so
+  // that related keys can be updated under one lock with with_shard() or lock_shard().
+  // GroupOf extracts the group from a key, for example the tenant of a (tenant, id) pair.
+  // Buckets within a shard are still chosen by Hash over the whole key, but shards are
+  // chosen by GroupHash over the group alone, so every key of a group lands in one shard.
+  template <class Key,
+            class GroupOf,
+            class Hash      = std::hash<Key>,
+            class GroupHash = std::hash<std::decay_t<std::invoke_result_t<const GroupOf &, const Key &>>>>
+  struct AffinityHash {
+    std::size_t operator()(const Key &key) const { return hash(key); }
+
+    std::size_t shard_hash(const Key &key) const { return group_hash(group_of(key)); }
+
+    GroupOf group_of{};
+    Hash hash{};
+    GroupHash group_hash{};
+  };
+
   // This class provides a sharded, thread-safe, unordered map with most of the same
   // functionality as std::unordered_map. However, iterator access has been removed in order
   // to preserve thread-safety. No direct access to begin() or end() iterators is provided.
@@ -16,14 +50,30 @@ namespace concurrency {
   // counterpart of the same name are documented with comments, as are functions that
   // do not exist for std::unordered_map.
   //
+  // The InternalMap template parameter selects the container backing each shard. See
+  // ::concurrency::UnorderedMap for details.
+  //
+  // If Hash has a shard_hash() member, as ::concurrency::AffinityHash does, shards are
+  // chosen by shard_hash() instead of by the hash itself.
+  //
+  // Bulk operations that touch every shard, such as insert_or_assign_many(), data(), rehash(),
+  // and reserve(), have overloads taking a ::concurrency::ThreadPool, which work on the shards
+  // in parallel.
+  //
   // https://en.cppreference.com/w/cpp/container/unordered_map
   // TODO: Support emplace() and try_emplace().
-  template <class Key, class Val, uint32_t ShardCount = DefaultUnorderedMapShardCount, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>, class Allocator = std::allocator<std::pair<const Key, Val>>>
+  template <class Key,
+            class Val,
+            uint32_t ShardCount                   = DefaultUnorderedMapShardCount,
+            class Hash                            = std::hash<Key>,
+            class Pred                            = std::equal_to<Key>,
+            class Allocator                       = std::allocator<std::pair<const Key, Val>>,
+            template <class...> class InternalMap = std::unordered_map>
   class ShardedUnorderedMap {
   public:
     // ------------------------------ Member types ------------------------------ //
-    using self_type            = ShardedUnorderedMap<Key, Val, ShardCount, Hash, Pred, Allocator>;
-    using shard_type           = UnorderedMap<Key, Val, Hash, Pred, Allocator>;
+    using self_type            = ShardedUnorderedMap<Key, Val, ShardCount, Hash, Pred, Allocator, InternalMap>;
+    using shard_type           = UnorderedMap<Key, Val, Hash, Pred, Allocator, InternalMap>;
     using internal_map_type    = typename shard_type::internal_map_type;
     using key_type             = typename shard_type::key_type;
     using mapped_type          = typename shard_type::mapped_type;
@@ -42,6 +92,8 @@ namespace concurrency {
     using local_iterator       = typename shard_type::local_iterator;
     using const_local_iterator = typename shard_type::const_local_iterator;
     using node_type            = typename shard_type::node_type;
+    using frozen_map_type      = typename shard_type::frozen_map_type;
+    using snapshot_type        = typename shard_type::snapshot_type;
 
     // ------------------------------ Constructors ------------------------------ //
     ShardedUnorderedMap() { validate_shard_count(); }
@@ -128,9 +180,67 @@ namespace concurrency {
       return get_mutable_shard(k).insert_or_assign(k, obj);
     }
 
+    // Inserts obj if k is not present. Otherwise, replaces the element mapped to k with
+    // combine(element, obj). Returns true if obj was inserted.
+    template <class M, class F>
+    bool upsert(const Key &k, M &&obj, F &&combine) {
+      return get_mutable_shard(k).upsert(k, std::forward<M>(obj), std::forward<F>(combine));
+    }
+
+    // See ::concurrency::UnorderedMap::compare_exchange().
+    template <class M>
+    bool compare_exchange(const Key &k, Val &expected, M &&desired) {
+      return get_mutable_shard(k).compare_exchange(k, expected, std::forward<M>(desired));
+    }
+
+    // See ::concurrency::UnorderedMap::update_if_version().
+    template <class M>
+    bool update_if_version(const Key &k, uint64_t version, M &&obj) {
+      return get_mutable_shard(k).update_if_version(k, version, std::forward<M>(obj));
+    }
+
+    // Calls insert_or_assign() for every key-value pair in [first, last), grouped
+    // by shard so that each shard's write lock is taken only once.
+    template <class InputIt>
+    void insert_or_assign_many(InputIt first, InputIt last) {
+      auto groups = group_by_shard(first, last);
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        if (!groups[i].empty()) m_shards[i].insert_or_assign_many(std::make_move_iterator(groups[i].begin()), std::make_move_iterator(groups[i].end()));
+      }
+    }
+
+    // As above, but writes to the shards in parallel on executor.
+    template <class InputIt>
+    void insert_or_assign_many(InputIt first, InputIt last, ThreadPool &executor) {
+      auto groups = group_by_shard(first, last);
+      for_each_shard(executor, [this, &groups](uint32_t i) {
+        if (!groups[i].empty()) m_shards[i].insert_or_assign_many(std::make_move_iterator(groups[i].begin()), std::make_move_iterator(groups[i].end()));
+      });
+    }
+
+    // Calls upsert() for every key-value pair in [first, last), grouped by
+    // shard so that each shard's write lock is taken only once.
+    template <class InputIt, class F>
+    void upsert_many(InputIt first, InputIt last, F &&combine) {
+      auto groups = group_by_shard(first, last);
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        if (!groups[i].empty()) m_shards[i].upsert_many(std::make_move_iterator(groups[i].begin()), std::make_move_iterator(groups[i].end()), combine);
+      }
+    }
+
+    // As above, but writes to the shards in parallel on executor. combine
+    // may be called concurrently for elements of different shards.
+    template <class InputIt, class F>
+    void upsert_many(InputIt first, InputIt last, F &&combine, ThreadPool &executor) {
+      auto groups = group_by_shard(first, last);
+      for_each_shard(executor, [this, &groups, &combine](uint32_t i) {
+        if (!groups[i].empty()) m_shards[i].upsert_many(std::make_move_iterator(groups[i].begin()), std::make_move_iterator(groups[i].end()), combine);
+      });
+    }
+
     size_type erase(const Key &key) { return get_mutable_shard(key).erase(key); }
 
-    void swap(ShardedUnorderedMap<Key, Val, ShardCount, Hash, Pred, Allocator> &other) noexcept {
+    void swap(self_type &other) noexcept {
       for (uint32_t i = 0; i < ShardCount; ++i) {
         this->m_shards[i].swap(other.m_shards[i]);
       }
@@ -168,35 +278,35 @@ namespace concurrency {
       auto tmp = source;
       for (auto const &el: tmp) {
         if (find(el.first)) continue;
-        (void) insert(std::move(source.extract(el.first)));
+        (void) insert_foreign_node(source.extract(el.first));
       }
     }
     void merge(std::unordered_multimap<Key, Val, Hash, Pred, Allocator> &&source) {
       auto tmp = source;
       for (auto const &el: tmp) {
         if (find(el.first)) continue;
-        (void) insert(std::move(source.extract(el.first)));
+        (void) insert_foreign_node(source.extract(el.first));
       }
     }
-    void merge(UnorderedMap<Key, Val, Hash, Pred, Allocator> &source) {
+    void merge(shard_type &source) {
       for (auto const &el: source.data()) {
         if (find(el.first)) continue;
         (void) insert(std::move(source.extract(el.first)));
       }
     }
-    void merge(UnorderedMap<Key, Val, Hash, Pred, Allocator> &&source) {
+    void merge(shard_type &&source) {
       for (auto const &el: source.data()) {
         if (find(el.first)) continue;
         (void) insert(std::move(source.extract(el.first)));
       }
     }
-    void merge(ShardedUnorderedMap<Key, Val, ShardCount, Hash, Pred, Allocator> &source) {
+    void merge(self_type &source) {
       for (auto const &el: source.data()) {
         if (find(el.first)) continue;
         (void) insert(std::move(source.extract(el.first)));
       }
     }
-    void merge(ShardedUnorderedMap<Key, Val, ShardCount, Hash, Pred, Allocator> &&source) {
+    void merge(self_type &&source) {
       for (auto const &el: source.data()) {
         if (find(el.first)) continue;
         (void) insert(std::move(source.extract(el.first)));
@@ -226,6 +336,17 @@ namespace concurrency {
     // provided key is present in the map.
     bool find(const Key &key) const { return get_shard(key).find(key); }
 
+    // See ::concurrency::UnorderedMap::find_versioned().
+    std::optional<VersionedValue<Val>> find_versioned(const Key &key) const { return get_shard(key).find_versioned(key); }
+
+    // Returns a copy of the element mapped to the provided key, computing and inserting it
+    // with factory() if no element is present. Concurrent callers for the same key share a
+    // single computation. See ::concurrency::UnorderedMap::get_or_compute.
+    template <class F>
+    Val get_or_compute(const Key &key, F &&factory) {
+      return get_mutable_shard(key).get_or_compute(key, std::forward<F>(factory));
+    }
+
     // Returns a copy of the data in each
     // shard as a single non-thread-safe unordered_map.
     internal_map_type data() const {
@@ -236,6 +357,23 @@ namespace concurrency {
       return m;
     }
 
+    // As above, but copies the shards in parallel on executor.
+    internal_map_type data(ThreadPool &executor) const {
+      std::array<internal_map_type, ShardCount> parts;
+      for_each_shard(executor, [this, &parts](uint32_t i) { parts[i] = m_shards[i].data(); });
+      internal_map_type m;
+      for (auto &part: parts) {
+        m.merge(part);
+      }
+      return m;
+    }
+
+    // Returns an immutable, lock-free snapshot of the data in every shard, built
+    // using up to thread_count threads. See ::concurrency::FrozenMap.
+    frozen_map_type freeze(unsigned thread_count = std::thread::hardware_concurrency()) const {
+      return frozen_map_type(data(), thread_count);
+    }
+
     // ------------------------------ Hash Policy ------------------------------- //
     uint32_t shard_count() const noexcept { return ShardCount; }
 
@@ -278,6 +416,11 @@ namespace concurrency {
       }
     }
 
+    // As above, but rehashes the shards in parallel on executor.
+    void rehash(size_type count, ThreadPool &executor) {
+      for_each_shard(executor, [this, count](uint32_t i) { m_shards[i].rehash(count); });
+    }
+
     // For each shard, reserves space for at least the specified number of
     // elements and regenerates the hash table.
     void reserve(size_type count) {
@@ -286,6 +429,315 @@ namespace concurrency {
       }
     }
 
+    // As above, but reserves space in the shards in parallel on executor.
+    void reserve(size_type count, ThreadPool &executor) {
+      for_each_shard(executor, [this, count](uint32_t i) { m_shards[i].reserve(count); });
+    }
+
+    // ----------------------------- Bloom Filter ------------------------------- //
+    // Enables a counting Bloom filter in every shard, sized for a total of at least
+    // expected_elements. find(), count(), and at() consult the shard's filter before
+    // taking its read lock. See ::concurrency::UnorderedMap::enable_bloom_filter().
+    void enable_bloom_filter(size_type expected_elements = 0) {
+      for (auto &s: m_shards) {
+        s.enable_bloom_filter(expected_elements / ShardCount);
+      }
+    }
+
+    bool bloom_filter_enabled() const noexcept { return m_shards[0].bloom_filter_enabled(); }
+
+    // ----------------------------- Flat Combining ----------------------------- //
+    // Enables flat combining of single-element writes in every shard.
+    // See ::concurrency::UnorderedMap::enable_flat_combining().
+    void enable_flat_combining() {
+      for (auto &s: m_shards) {
+        s.enable_flat_combining();
+      }
+    }
+
+    bool flat_combining_enabled() const noexcept { return m_shards[0].flat_combining_enabled(); }
+
+    // ------------------------------- Versioning ------------------------------- //
+    // Enables version stamps in every shard.
+    // See ::concurrency::UnorderedMap::enable_versioning().
+    void enable_versioning() {
+      for (auto &s: m_shards) {
+        s.enable_versioning();
+      }
+    }
+
+    bool versioning_enabled() const { return m_shards[0].versioning_enabled(); }
+
+    // ---------------------------- Change Tracking ----------------------------- //
+    // Enables change logs in every shard, stamped by one clock so that a single epoch
+    // covers the whole map. See ::concurrency::UnorderedMap::enable_change_tracking().
+    void enable_change_tracking() {
+      auto clock = std::make_shared<std::atomic<uint64_t>>(1);
+      for (auto &s: m_shards) {
+        s.enable_change_tracking(clock);
+      }
+    }
+
+    bool change_tracking_enabled() const { return m_shards[0].change_tracking_enabled(); }
+
+    // Returns the changes made since epoch, one group per shard, each collected under its
+    // shard's read lock. Throws std::logic_error if change tracking is disabled.
+    MapDelta<Key, Val> changes_since(uint64_t epoch) const {
+      MapDelta<Key, Val> delta;
+      delta.epoch = m_shards[0].change_clock()->fetch_add(1, std::memory_order_relaxed);
+      delta.shards.reserve(ShardCount);
+      for (auto const &s: m_shards) {
+        delta.shards.push_back(s.collect_changes(epoch));
+      }
+      return delta;
+    }
+
+    // See ::concurrency::UnorderedMap::discard_changes_through().
+    void discard_changes_through(uint64_t epoch) {
+      for (auto &s: m_shards) {
+        s.discard_changes_through(epoch);
+      }
+    }
+
+    // Applies a delta taken from a map with the same Key, Val, and Hash, taking each shard's
+    // write lock once for all of the delta's changes to that shard. The source map may have
+    // a different number of shards.
+    void apply_delta(const MapDelta<Key, Val> &delta) {
+      apply_delta(delta, [](auto &&f) {
+        for (uint32_t i = 0; i < ShardCount; ++i) {
+          f(i);
+        }
+      });
+    }
+
+    // As above, but applies the changes to each shard in parallel on executor.
+    void apply_delta(const MapDelta<Key, Val> &delta, ThreadPool &executor) {
+      apply_delta(delta, [&executor](auto &&f) { for_each_shard(executor, f); });
+    }
+
+    // ------------------------------ Transactions ------------------------------ //
+    // The view of the map passed to a transaction's functor. It offers the operations of
+    // ::concurrency::UnorderedMap::write_view, for the keys the transaction was started with,
+    // and throws std::invalid_argument for keys in shards that the transaction did not lock.
+    class transaction_view {
+    public:
+      Val *find(const Key &k) { return view_for(k).find(k); }
+
+      Val &at(const Key &k) { return view_for(k).at(k); }
+
+      bool contains(const Key &k) { return view_for(k).contains(k); }
+
+      template <class M>
+      bool insert_or_assign(const Key &k, M &&obj) {
+        return view_for(k).insert_or_assign(k, std::forward<M>(obj));
+      }
+
+      template <class... Args>
+      bool try_emplace(const Key &k, Args &&...args) {
+        return view_for(k).try_emplace(k, std::forward<Args>(args)...);
+      }
+
+      template <class M, class F>
+      bool upsert(const Key &k, M &&obj, F &&combine) {
+        return view_for(k).upsert(k, std::forward<M>(obj), std::forward<F>(combine));
+      }
+
+      size_type erase(const Key &k) { return view_for(k).erase(k); }
+
+    private:
+      friend class ShardedUnorderedMap;
+
+      explicit transaction_view(const self_type &owner) : m_owner(&owner) {}
+
+      typename shard_type::write_view &view_for(const Key &k) {
+        auto &view = m_views[m_owner->get_shard_idx(k)];
+        if (!view) throw std::invalid_argument("::concurrency::ShardedUnorderedMap::transaction: key was not declared by the transaction");
+        return *view;
+      }
+
+      const self_type *m_owner;
+      std::array<std::optional<typename shard_type::write_view>, ShardCount> m_views{};
+    };
+
+    // Locks the shards of every key in keys, calls f(view) with a transaction_view of them,
+    // and returns its result once the locks are released, so that f can read and update
+    // several keys as one atomic step. Shards are locked in ascending order, and only once
+    // each, so that concurrent transactions cannot deadlock. f must not call other member
+    // functions of the map. Changes made before f throws are kept.
+    template <class F>
+    auto transaction(std::initializer_list<Key> keys, F &&f) {
+      return transaction(keys.begin(), keys.end(), std::forward<F>(f));
+    }
+
+    // As above, for the keys in [first, last).
+    template <class InputIt, class F>
+    auto transaction(InputIt first, InputIt last, F &&f) {
+      std::array<bool, ShardCount> involved{};
+      for (; first != last; ++first) {
+        involved[get_shard_idx(*first)] = true;
+      }
+      transaction_view view(*this);
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        if (involved[i]) view.m_views[i].emplace(m_shards[i].lock());
+      }
+      return std::forward<F>(f)(view);
+    }
+
+    // ------------------------------ Shard Access ------------------------------ //
+    // Holds the write lock of one shard for as long as it lives, so that a group of
+    // operations on keys in that shard takes the lock only once. It offers the operations
+    // of ::concurrency::UnorderedMap::write_view, which throw std::invalid_argument for keys
+    // that belong to another shard. mutable_map() is not checked: keys inserted through it
+    // must belong to the shard, as reported by shard_index().
+    class shard_guard {
+    public:
+      Val *find(const Key &k) { return checked(k).find(k); }
+
+      Val &at(const Key &k) { return checked(k).at(k); }
+
+      bool contains(const Key &k) { return checked(k).contains(k); }
+
+      size_type size() const noexcept { return m_view.size(); }
+
+      const internal_map_type &map() const noexcept { return m_view.map(); }
+
+      internal_map_type &mutable_map() { return m_view.mutable_map(); }
+
+      template <class M>
+      bool insert_or_assign(const Key &k, M &&obj) {
+        return checked(k).insert_or_assign(k, std::forward<M>(obj));
+      }
+
+      template <class... Args>
+      bool try_emplace(const Key &k, Args &&...args) {
+        return checked(k).try_emplace(k, std::forward<Args>(args)...);
+      }
+
+      template <class M, class F>
+      bool upsert(const Key &k, M &&obj, F &&combine) {
+        return checked(k).upsert(k, std::forward<M>(obj), std::forward<F>(combine));
+      }
+
+      size_type erase(const Key &k) { return checked(k).erase(k); }
+
+      uint32_t index() const noexcept { return m_index; }
+
+    private:
+      friend class ShardedUnorderedMap;
+
+      shard_guard(self_type &owner, uint32_t index) : m_owner(&owner), m_index(index), m_view(owner.m_shards.at(index).lock()) {}
+
+      typename shard_type::write_view &checked(const Key &k) {
+        if (m_owner->get_shard_idx(k) != m_index) throw std::invalid_argument("::concurrency::ShardedUnorderedMap::shard_guard: key belongs to another shard");
+        return m_view;
+      }
+
+      const self_type *m_owner;
+      uint32_t m_index;
+      typename shard_type::write_view m_view;
+    };
+
+    // Returns the index of the shard that key belongs to.
+    uint32_t shard_index(const Key &key) const { return get_shard_idx(key); }
+
+    // Locks the shard at index and returns a guard that unlocks it when destroyed. Throws
+    // std::out_of_range if index is not less than ShardCount. The map's other member
+    // functions must not be called for keys in the shard while the guard is alive.
+    shard_guard lock_shard(uint32_t index) { return shard_guard(*this, index); }
+
+    // Locks the shard of key, calls f(guard) with a shard_guard for it, and returns the
+    // result of f once the lock is released.
+    template <class F>
+    auto with_shard(const Key &key, F &&f) {
+      auto guard = lock_shard(get_shard_idx(key));
+      return std::forward<F>(f)(guard);
+    }
+
+    // ------------------------- Asynchronous Operations ------------------------ //
+    // Each operation waits only for the lock of its key's shard, so waiters queue per shard.
+    // See ::concurrency::UnorderedMap::async_insert().
+    auto async_insert(value_type value) {
+      auto &shard = get_mutable_shard(value.first);
+      return shard.async_insert(std::move(value));
+    }
+    auto co_insert(value_type value) {
+      auto &shard = get_mutable_shard(value.first);
+      return shard.co_insert(std::move(value));
+    }
+
+    template <class M>
+    auto async_insert_or_assign(Key k, M obj) {
+      auto &shard = get_mutable_shard(k);
+      return shard.async_insert_or_assign(std::move(k), std::move(obj));
+    }
+    template <class M>
+    auto co_insert_or_assign(Key k, M obj) {
+      auto &shard = get_mutable_shard(k);
+      return shard.co_insert_or_assign(std::move(k), std::move(obj));
+    }
+
+    auto async_erase(Key key) {
+      auto &shard = get_mutable_shard(key);
+      return shard.async_erase(std::move(key));
+    }
+    auto co_erase(Key key) {
+      auto &shard = get_mutable_shard(key);
+      return shard.co_erase(std::move(key));
+    }
+
+    auto async_find(Key key) const {
+      auto &shard = get_shard(key);
+      return shard.async_find(std::move(key));
+    }
+    auto co_find(Key key) const {
+      auto &shard = get_shard(key);
+      return shard.co_find(std::move(key));
+    }
+
+    auto async_at(Key key) const {
+      auto &shard = get_shard(key);
+      return shard.async_at(std::move(key));
+    }
+    auto co_at(Key key) const {
+      auto &shard = get_shard(key);
+      return shard.co_at(std::move(key));
+    }
+
+    // ------------------------------- Snapshots -------------------------------- //
+    // Writes the map to a binary snapshot file at path, with one section per shard. Each
+    // shard is copied out under its own read lock, so the snapshot is only consistent across
+    // shards if the map is not written to in the meantime. See
+    // ::concurrency::UnorderedMap::save().
+    void save(const std::string &path) const {
+      save_snapshot(path, [](auto &&f) {
+        for (uint32_t i = 0; i < ShardCount; ++i) {
+          f(i);
+        }
+      });
+    }
+
+    // As above, but copies out and writes the shards in parallel on executor.
+    void save(const std::string &path, ThreadPool &executor) const {
+      save_snapshot(path, [&executor](auto &&f) { for_each_shard(executor, f); });
+    }
+
+    // Replaces the contents of the map with those of the snapshot at path, one shard at a
+    // time. A snapshot written with the same ShardCount is loaded section by section, into
+    // the shard each section came from; otherwise its elements are redistributed.
+    // See ::concurrency::UnorderedMap::load().
+    void load(const std::string &path) {
+      load_snapshot(snapshot_type(path, hash_function(), key_eq()), [](auto &&f) {
+        for (uint32_t i = 0; i < ShardCount; ++i) {
+          f(i);
+        }
+      });
+    }
+
+    // As above, but builds the shards in parallel on executor.
+    void load(const std::string &path, ThreadPool &executor) {
+      load_snapshot(snapshot_type(path, hash_function(), key_eq()), [&executor](auto &&f) { for_each_shard(executor, f); });
+    }
+
     // ------------------------------- Observers -------------------------------- //
     hasher hash_function() const { return m_shards.at(0).hash_function(); }
 
@@ -296,39 +748,133 @@ namespace concurrency {
 
     void validate_shard_count() const { static_assert(ShardCount != 0, "ShardCount template parameter must be non-zero."); }
 
-    uint32_t get_shard_idx(Key const &key) const { return hash_function()(key) % ShardCount; }
-    uint32_t get_shard_idx(Key const &&key) const { return hash_function()(key) % ShardCount; }
+    uint32_t get_shard_idx(Key const &key) const { return shard_hash(key) % ShardCount; }
+    uint32_t get_shard_idx(Key const &&key) const { return shard_hash(key) % ShardCount; }
+
+    std::size_t shard_hash(Key const &key) const {
+      if constexpr (detail::has_shard_hash<hasher, Key>::value) {
+        return hash_function().shard_hash(key);
+      } else {
+        return hash_function()(key);
+      }
+    }
     shard_type &get_mutable_shard(Key const &key) { return m_shards.at(get_shard_idx(key)); }
     shard_type &get_mutable_shard(Key const &&key) { return m_shards.at(get_shard_idx(key)); }
     const shard_type &get_shard(Key const &key) const { return m_shards.at(get_shard_idx(key)); }
     const shard_type &get_shard(Key const &&key) const { return m_shards.at(get_shard_idx(key)); }
+
+    // Calls f(i) for the index of every shard, one shard per task on executor.
+    template <class F>
+    static void for_each_shard(ThreadPool &executor, F &&f) {
+      executor.parallel_for(uint32_t{0}, ShardCount, std::forward<F>(f), uint32_t{1});
+    }
+
+    // Groups the changes in delta by the shard they belong to in this map, and applies each
+    // group with run(f), which calls f(i) for every shard index i.
+    template <class Run>
+    void apply_delta(const MapDelta<Key, Val> &delta, Run &&run) {
+      std::vector<bool> reset;
+      std::array<std::vector<const std::pair<Key, Val> *>, ShardCount> upserts;
+      std::array<std::vector<const Key *>, ShardCount> erased;
+      for (auto const &shard: delta.shards) {
+        reset.push_back(shard.reset);
+        for (auto const &el: shard.upserts) {
+          upserts[get_shard_idx(el.first)].push_back(&el);
+        }
+        for (auto const &k: shard.erased) {
+          erased[get_shard_idx(k)].push_back(&k);
+        }
+      }
+      bool const any_reset = std::find(reset.begin(), reset.end(), true) != reset.end();
+      run([&](uint32_t i) {
+        if (any_reset || !upserts[i].empty() || !erased[i].empty()) m_shards[i].apply_changes(reset, upserts[i], erased[i]);
+      });
+    }
+
+    // Writes a snapshot whose sections are encoded and written by run(f), which calls f(i)
+    // for every shard index i.
+    template <class Run>
+    void save_snapshot(const std::string &path, Run &&run) const {
+      detail::write_snapshot<Key, Val>(path, ShardCount, run, [this](uint32_t i) { return m_shards[i].encode_snapshot(); });
+    }
+
+    // Builds every shard from snapshot and swaps it in. run(f) calls f(i) for every shard
+    // index i.
+    template <class Run>
+    void load_snapshot(const snapshot_type &snapshot, Run &&run) {
+      if (snapshot.shard_count() == ShardCount) {
+        run([this, &snapshot](uint32_t i) {
+          internal_map_type loaded;
+          loaded.reserve(snapshot.shard_size(i));
+          snapshot.for_each_in_shard(i, [&loaded](const Key &k, const Val &v) { loaded.emplace(k, v); });
+          m_shards[i].swap(loaded);
+        });
+        return;
+      }
+      std::array<internal_map_type, ShardCount> parts;
+      snapshot.for_each([this, &parts](const Key &k, const Val &v) { parts[get_shard_idx(k)].emplace(k, v); });
+      run([this, &parts](uint32_t i) { m_shards[i].swap(parts[i]); });
+    }
+
+    // Copies, or moves if given move iterators, the key-value pairs in [first, last)
+    // into one batch per shard.
+    template <class InputIt>
+    std::array<std::vector<std::pair<Key, Val>>, ShardCount> group_by_shard(InputIt first, InputIt last) const {
+      std::array<std::vector<std::pair<Key, Val>>, ShardCount> groups;
+      for (; first != last; ++first) {
+        auto &&el = *first;
+        groups[get_shard_idx(el.first)].emplace_back(std::forward<decltype(el)>(el));
+      }
+      return groups;
+    }
+
+    // Inserts the element owned by a node handle extracted from a std::unordered_multimap,
+    // whose node type only matches node_type when the shards are backed by std::unordered_map.
+    template <class ForeignNode>
+    bool insert_foreign_node(ForeignNode &&nh) {
+      if constexpr (std::is_same_v<std::decay_t<ForeignNode>, node_type>) {
+        return insert(std::move(nh));
+      } else {
+        if (nh.empty()) return false;
+        return get_mutable_shard(nh.key()).try_emplace(nh.key(), std::move(nh.mapped()));
+      }
+    }
   };
 
-  template <class Key, class T, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc>
-  bool operator==(const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &rhs) {
+  template <class Key, class T, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc, template <class...> class InternalMap>
+  bool operator==(const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc, InternalMap> &lhs, const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc, InternalMap> &rhs) {
     return lhs.data() == rhs.data();
   }
 
-  template <class Key, class T, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc>
-  bool operator!=(const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &rhs) {
+  template <class Key, class T, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc, template <class...> class InternalMap>
+  bool operator!=(const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc, InternalMap> &lhs, const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc, InternalMap> &rhs) {
     return !(lhs == rhs);
   }
 
-  template <class Key, class T, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc>
-  bool operator==(const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &&rhs) {
+  template <class Key, class T, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc, template <class...> class InternalMap>
+  bool operator==(const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc, InternalMap> &lhs, const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc, InternalMap> &&rhs) {
     return lhs.data() == rhs.data();
   }
 
-  template <class Key, class T, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc>
-  bool operator!=(const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &&rhs) {
+  template <class Key, class T, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc, template <class...> class InternalMap>
+  bool operator!=(const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc, InternalMap> &lhs, const ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc, InternalMap> &&rhs) {
     return !(lhs == rhs);
   }
 
   // Specializes the std::swap algorithm for ::concurrency::ShardedUnorderedMap. Swaps the contents of lhs and rhs. Calls lhs.swap(rhs).
-  template <class Key, class T, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc>
-  void swap(::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &lhs, ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &rhs) noexcept {
+  template <class Key, class T, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc, template <class...> class InternalMap>
+  void swap(::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc, InternalMap> &lhs, ::concurrency::ShardedUnorderedMap<Key, T, ShardCount, Hash, KeyEqual, Alloc, InternalMap> &rhs) noexcept {
     lhs.swap(rhs);
   }
 
+  // A ::concurrency::ShardedUnorderedMap whose shards are backed by ::concurrency::FlatHashMap rather than std::unordered_map.
+  template <class Key,
+            class Val,
+            uint32_t ShardCount = DefaultUnorderedMapShardCount,
+            class Hash          = std::hash<Key>,
+            class Pred          = std::equal_to<Key>,
+            class Allocator     = std::allocator<std::pair<const Key, Val>>>
+  using ShardedFlatUnorderedMap = ShardedUnorderedMap<Key, Val, ShardCount, Hash, Pred, Allocator, FlatHashMap>;
+
 } // namespace concurrency
 #endif // SHARDED_UNORDERED_CONCURRENT_MAP
\ No newline at end of file
@@ -0,0 +1,267 @@
+#ifndef SHARDED_UNORDERED_CONCURRENT_MULTIMAP
+#define SHARDED_UNORDERED_CONCURRENT_MULTIMAP
+
+#include <concurrency/UnorderedMultimap.hpp>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace concurrency {
+  constexpr uint32_t DefaultUnorderedMultimapShardCount = 32;
+
+  // This class provides a sharded, thread-safe, unordered multimap with most of the same
+  // functionality as std::unordered_multimap. Elements are distributed over ShardCount
+  // ::concurrency::UnorderedMultimap shards by the hash of their key, so every value mapped to
+  // a key lives in the same shard and visit_all(), count(), erase() and erase_one() each lock
+  // exactly one shard. Iterator access has been removed in order to preserve thread-safety.
+  //
+  // https://en.cppreference.com/w/cpp/container/unordered_multimap
+  template <class Key,
+            class Val,
+            uint32_t ShardCount = DefaultUnorderedMultimapShardCount,
+            class Hash          = std::hash<Key>,
+            class Pred          = std::equal_to<Key>,
+            class Allocator     = std::allocator<std::pair<const Key, Val>>>
+  class ShardedUnorderedMultimap {
+  public:
+    // ------------------------------ Member types ------------------------------ //
+    using self_type         = ShardedUnorderedMultimap<Key, Val, ShardCount, Hash, Pred, Allocator>;
+    using shard_type        = UnorderedMultimap<Key, Val, Hash, Pred, Allocator>;
+    using internal_map_type = typename shard_type::internal_map_type;
+    using key_type          = typename shard_type::key_type;
+    using mapped_type       = typename shard_type::mapped_type;
+    using value_type        = typename shard_type::value_type;
+    using size_type         = typename shard_type::size_type;
+    using difference_type   = typename shard_type::difference_type;
+    using hasher            = typename shard_type::hasher;
+    using key_equal         = typename shard_type::key_equal;
+    using allocator_type    = typename shard_type::allocator_type;
+    using node_type         = typename shard_type::node_type;
+
+    // ------------------------------ Constructors ------------------------------ //
+    ShardedUnorderedMultimap() { validate_shard_count(); }
+    ShardedUnorderedMultimap(const ShardedUnorderedMultimap &other) {
+      validate_shard_count();
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        m_shards[i] = other.m_shards[i];
+      }
+    }
+    ShardedUnorderedMultimap(ShardedUnorderedMultimap &&other) {
+      validate_shard_count();
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        m_shards[i] = other.m_shards[i];
+      }
+    }
+    ShardedUnorderedMultimap(std::initializer_list<value_type> ilist) {
+      validate_shard_count();
+      insert(ilist);
+    }
+
+    ShardedUnorderedMultimap &operator=(const ShardedUnorderedMultimap &other) {
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        m_shards[i] = other.m_shards[i];
+      }
+      return *this;
+    }
+    ShardedUnorderedMultimap &operator=(ShardedUnorderedMultimap &&other) {
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        m_shards[i] = other.m_shards[i];
+      }
+      return *this;
+    }
+    ShardedUnorderedMultimap &operator=(std::initializer_list<value_type> ilist) {
+      this->insert(ilist);
+      return *this;
+    }
+
+    ~ShardedUnorderedMultimap() = default;
+
+    allocator_type get_allocator() const { return m_shards.at(0).get_allocator(); }
+
+    // -------------------------------- Capacity -------------------------------- //
+    bool empty() const noexcept {
+      for (auto &s: m_shards) {
+        if (!s.empty()) return false;
+      }
+      return true;
+    }
+
+    size_type size() const noexcept {
+      size_type size = 0;
+      for (auto &s: m_shards) {
+        size += s.size();
+      }
+      return size;
+    }
+
+    // ------------------------------- Modifiers -------------------------------- //
+    void clear() noexcept {
+      for (auto &s: m_shards) {
+        s.clear();
+      }
+    }
+
+    // Always inserts, as with std::unordered_multimap, and returns nothing.
+    void insert(const value_type &value) { get_mutable_shard(value.first).insert(value); }
+    void insert(value_type &&value) { get_mutable_shard(value.first).insert(std::move(value)); }
+    template <class P>
+    void insert(P &&value) {
+      value_type v(std::forward<P>(value));
+      insert(std::move(v));
+    }
+    void insert(std::initializer_list<value_type> ilist) { insert(ilist.begin(), ilist.end()); }
+    // Inserts every element in [first, last), grouped by shard so that
+    // each shard's write lock is taken only once.
+    template <class InputIt>
+    void insert(InputIt first, InputIt last) {
+      std::array<std::vector<std::pair<Key, Val>>, ShardCount> groups;
+      for (; first != last; ++first) {
+        auto &&el = *first;
+        groups[get_shard_idx(el.first)].emplace_back(std::forward<decltype(el)>(el));
+      }
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        if (!groups[i].empty()) m_shards[i].insert(std::make_move_iterator(groups[i].begin()), std::make_move_iterator(groups[i].end()));
+      }
+    }
+    void insert(node_type &&nh) {
+      if (nh.empty()) return;
+      get_mutable_shard(nh.key()).insert(std::move(nh));
+    }
+
+    template <class... Args>
+    void emplace(Args &&...args) {
+      value_type v(std::forward<Args>(args)...);
+      insert(std::move(v));
+    }
+
+    // Removes every value mapped to key and returns the number removed.
+    size_type erase(const Key &key) { return get_mutable_shard(key).erase(key); }
+
+    // Removes the first value mapped to key for which pred(value) returns true, and returns a
+    // bool indicating whether one was removed. See ::concurrency::UnorderedMultimap::erase_one.
+    template <class P>
+    bool erase_one(const Key &key, P &&pred) {
+      return get_mutable_shard(key).erase_one(key, std::forward<P>(pred));
+    }
+
+    void swap(self_type &other) noexcept {
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        this->m_shards[i].swap(other.m_shards[i]);
+      }
+    }
+
+    // Extracts one of the elements mapped to k.
+    node_type extract(const Key &k) { return get_mutable_shard(k).extract(k); }
+
+    // Moves every element of source into the multimap, leaving source empty.
+    void merge(internal_map_type &source) {
+      while (!source.empty()) {
+        insert(source.extract(source.begin()));
+      }
+    }
+    void merge(internal_map_type &&source) { merge(source); }
+
+    // --------------------------------- Lookup --------------------------------- //
+    // Returns the number of values mapped to key.
+    size_type count(const Key &key) const { return get_shard(key).count(key); }
+
+    // Returns a bool indicating whether or not any value
+    // is mapped to the provided key.
+    bool find(const Key &key) const { return get_shard(key).find(key); }
+
+    bool contains(const Key &key) const { return find(key); }
+
+    // Calls f(const Val &) for every value mapped to key while holding the read lock of its
+    // shard, and returns the number of values visited. See ::concurrency::UnorderedMultimap::visit_all.
+    template <class F>
+    size_type visit_all(const Key &key, F &&f) const {
+      return get_shard(key).visit_all(key, std::forward<F>(f));
+    }
+
+    // Returns a copy of the data in each
+    // shard as a single non-thread-safe unordered_multimap.
+    internal_map_type data() const {
+      internal_map_type m;
+      for (auto &shard: m_shards) {
+        m.merge(shard.data());
+      }
+      return m;
+    }
+
+    // ------------------------------ Hash Policy ------------------------------- //
+    uint32_t shard_count() const noexcept { return ShardCount; }
+
+    // Averaged load factor across all shards.
+    float load_factor() const {
+      float lf = 0;
+      for (auto &s: m_shards) {
+        lf += s.load_factor();
+      }
+      return lf / ShardCount;
+    }
+
+    // Returns the current maximum load factor
+    // allowed for all shards.
+    float max_load_factor() const { return m_shards.at(0).max_load_factor(); }
+
+    // Sets the maximum load factor allowed
+    // for all shards.
+    void max_load_factor(float ml) {
+      for (auto &s: m_shards) {
+        s.max_load_factor(ml);
+      }
+    }
+
+    // For each shard, reserves at least the specified number of buckets
+    // and regenerates the hash table.
+    void rehash(size_type count) {
+      for (auto &s: m_shards) {
+        s.rehash(count);
+      }
+    }
+
+    // For each shard, reserves space for at least the specified number of
+    // elements and regenerates the hash table.
+    void reserve(size_type count) {
+      for (auto &s: m_shards) {
+        s.reserve(count);
+      }
+    }
+
+    // ------------------------------- Observers -------------------------------- //
+    hasher hash_function() const { return m_shards.at(0).hash_function(); }
+
+    key_equal key_eq() const { return m_shards.at(0).key_eq(); }
+
+  private:
+    std::array<shard_type, ShardCount> m_shards{};
+
+    void validate_shard_count() const { static_assert(ShardCount != 0, "ShardCount template parameter must be non-zero."); }
+
+    uint32_t get_shard_idx(Key const &key) const { return hash_function()(key) % ShardCount; }
+    shard_type &get_mutable_shard(Key const &key) { return m_shards.at(get_shard_idx(key)); }
+    const shard_type &get_shard(Key const &key) const { return m_shards.at(get_shard_idx(key)); }
+  };
+
+  template <class Key, class T, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc>
+  bool operator==(const ::concurrency::ShardedUnorderedMultimap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::ShardedUnorderedMultimap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &rhs) {
+    return lhs.data() == rhs.data();
+  }
+
+  template <class Key, class T, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc>
+  bool operator!=(const ::concurrency::ShardedUnorderedMultimap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::ShardedUnorderedMultimap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &rhs) {
+    return !(lhs == rhs);
+  }
+
+  // Specializes the std::swap algorithm for ::concurrency::ShardedUnorderedMultimap. Swaps the contents of lhs and rhs. Calls lhs.swap(rhs).
+  template <class Key, class T, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc>
+  void swap(::concurrency::ShardedUnorderedMultimap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &lhs, ::concurrency::ShardedUnorderedMultimap<Key, T, ShardCount, Hash, KeyEqual, Alloc> &rhs) noexcept {
+    lhs.swap(rhs);
+  }
+
+} // namespace concurrency
+
+#endif // SHARDED_UNORDERED_CONCURRENT_MULTIMAP
@@ -0,0 +1,286 @@
+#ifndef SHARDED_UNORDERED_CONCURRENT_SET
+#define SHARDED_UNORDERED_CONCURRENT_SET
+
+#include <concurrency/UnorderedSet.hpp>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace concurrency {
+  constexpr uint32_t DefaultUnorderedSetShardCount = 32;
+
+  // This class provides a sharded, thread-safe, unordered set with most of the same
+  // functionality as std::unordered_set. Keys are distributed over ShardCount
+  // ::concurrency::UnorderedSet shards in the same way as ::concurrency::ShardedUnorderedMap
+  // distributes its elements. Iterator access has been removed in order to preserve
+  // thread-safety.
+  //
+  // insert_many() and contains_many() group their keys by shard, so that each shard's lock is
+  // acquired once per call rather than once per key.
+  //
+  // https://en.cppreference.com/w/cpp/container/unordered_set
+  template <class Key,
+            uint32_t ShardCount = DefaultUnorderedSetShardCount,
+            class Hash          = std::hash<Key>,
+            class Pred          = std::equal_to<Key>,
+            class Allocator     = std::allocator<Key>>
+  class ShardedUnorderedSet {
+  public:
+    // ------------------------------ Member types ------------------------------ //
+    using self_type         = ShardedUnorderedSet<Key, ShardCount, Hash, Pred, Allocator>;
+    using shard_type        = UnorderedSet<Key, Hash, Pred, Allocator>;
+    using internal_set_type = typename shard_type::internal_set_type;
+    using key_type          = typename shard_type::key_type;
+    using value_type        = typename shard_type::value_type;
+    using size_type         = typename shard_type::size_type;
+    using difference_type   = typename shard_type::difference_type;
+    using hasher            = typename shard_type::hasher;
+    using key_equal         = typename shard_type::key_equal;
+    using allocator_type    = typename shard_type::allocator_type;
+    using node_type         = typename shard_type::node_type;
+
+    // ------------------------------ Constructors ------------------------------ //
+    ShardedUnorderedSet() { validate_shard_count(); }
+    ShardedUnorderedSet(const ShardedUnorderedSet &other) {
+      validate_shard_count();
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        m_shards[i] = other.m_shards[i];
+      }
+    }
+    ShardedUnorderedSet(ShardedUnorderedSet &&other) {
+      validate_shard_count();
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        m_shards[i] = other.m_shards[i];
+      }
+    }
+    ShardedUnorderedSet(std::initializer_list<value_type> ilist) {
+      validate_shard_count();
+      insert(ilist);
+    }
+
+    ShardedUnorderedSet &operator=(const ShardedUnorderedSet &other) {
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        m_shards[i] = other.m_shards[i];
+      }
+      return *this;
+    }
+    ShardedUnorderedSet &operator=(ShardedUnorderedSet &&other) {
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        m_shards[i] = other.m_shards[i];
+      }
+      return *this;
+    }
+    ShardedUnorderedSet &operator=(std::initializer_list<value_type> ilist) {
+      this->insert(ilist);
+      return *this;
+    }
+
+    ~ShardedUnorderedSet() = default;
+
+    allocator_type get_allocator() const { return m_shards.at(0).get_allocator(); }
+
+    // -------------------------------- Capacity -------------------------------- //
+    bool empty() const noexcept {
+      for (auto &s: m_shards) {
+        if (!s.empty()) return false;
+      }
+      return true;
+    }
+
+    size_type size() const noexcept {
+      size_type size = 0;
+      for (auto &s: m_shards) {
+        size += s.size();
+      }
+      return size;
+    }
+
+    // ------------------------------- Modifiers -------------------------------- //
+    void clear() noexcept {
+      for (auto &s: m_shards) {
+        s.clear();
+      }
+    }
+
+    bool insert(const value_type &value) { return get_mutable_shard(value).insert(value); }
+    bool insert(value_type &&value) { return get_mutable_shard(value).insert(std::move(value)); }
+    void insert(std::initializer_list<value_type> ilist) { (void) insert_many(ilist.begin(), ilist.end()); }
+    template <class InputIt>
+    void insert(InputIt first, InputIt last) {
+      (void) insert_many(first, last);
+    }
+    bool insert(node_type &&nh) {
+      if (nh.empty()) return false;
+      return get_mutable_shard(nh.value()).insert(std::move(nh));
+    }
+
+    // Inserts every key in [first, last), grouped by shard so that each shard's lock is
+    // taken only once, and returns the number of keys that were not already present.
+    template <class InputIt>
+    size_type insert_many(InputIt first, InputIt last) {
+      std::array<std::vector<Key>, ShardCount> groups;
+      for (; first != last; ++first) {
+        auto &&key = *first;
+        groups[get_shard_idx(key)].emplace_back(std::forward<decltype(key)>(key));
+      }
+      size_type inserted = 0;
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        if (!groups[i].empty()) inserted += m_shards[i].insert_many(std::make_move_iterator(groups[i].begin()), std::make_move_iterator(groups[i].end()));
+      }
+      return inserted;
+    }
+
+    template <class... Args>
+    bool emplace(Args &&...args) {
+      Key key(std::forward<Args>(args)...);
+      return insert(std::move(key));
+    }
+
+    size_type erase(const Key &key) { return get_mutable_shard(key).erase(key); }
+
+    void swap(self_type &other) noexcept {
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        this->m_shards[i].swap(other.m_shards[i]);
+      }
+    }
+
+    node_type extract(const Key &k) { return get_mutable_shard(k).extract(k); }
+
+    void merge(internal_set_type &source) {
+      auto tmp = source;
+      for (auto const &key: tmp) {
+        if (find(key)) continue;
+        (void) insert(source.extract(key));
+      }
+    }
+    void merge(internal_set_type &&source) { merge(source); }
+
+    // --------------------------------- Lookup --------------------------------- //
+    size_type count(const Key &key) const { return get_shard(key).count(key); }
+
+    // Returns a bool indicating whether or not the
+    // provided key is present in the set.
+    bool find(const Key &key) const { return get_shard(key).find(key); }
+
+    bool contains(const Key &key) const { return find(key); }
+
+    // Writes, to the range beginning at d_first, a bool for every key in [first, last)
+    // indicating whether it is present, in the order of the keys. The keys are grouped by
+    // shard so that each shard's lock is taken only once. Returns an iterator past the last
+    // bool written.
+    template <class ForwardIt, class OutputIt>
+    OutputIt contains_many(ForwardIt first, ForwardIt last, OutputIt d_first) const {
+      std::array<std::vector<std::reference_wrapper<const Key>>, ShardCount> keys;
+      std::array<std::vector<size_type>, ShardCount> positions;
+      size_type n = 0;
+      for (; first != last; ++first, ++n) {
+        const Key &key = *first;
+        auto const idx = get_shard_idx(key);
+        keys[idx].emplace_back(key);
+        positions[idx].push_back(n);
+      }
+      std::vector<char> found(n, false);
+      std::vector<char> shard_found;
+      for (uint32_t i = 0; i < ShardCount; ++i) {
+        if (keys[i].empty()) continue;
+        shard_found.resize(keys[i].size());
+        (void) m_shards[i].contains_many(keys[i].begin(), keys[i].end(), shard_found.begin());
+        for (size_type j = 0; j < positions[i].size(); ++j) {
+          found[positions[i][j]] = shard_found[j];
+        }
+      }
+      for (auto f: found) {
+        *d_first = f != 0;
+        ++d_first;
+      }
+      return d_first;
+    }
+
+    // Returns a copy of the data in each
+    // shard as a single non-thread-safe unordered_set.
+    internal_set_type data() const {
+      internal_set_type s;
+      for (auto &shard: m_shards) {
+        s.merge(shard.data());
+      }
+      return s;
+    }
+
+    // ------------------------------ Hash Policy ------------------------------- //
+    uint32_t shard_count() const noexcept { return ShardCount; }
+
+    // Averaged load factor across all shards.
+    float load_factor() const {
+      float lf = 0;
+      for (auto &s: m_shards) {
+        lf += s.load_factor();
+      }
+      return lf / ShardCount;
+    }
+
+    // Returns the current maximum load factor
+    // allowed for all shards.
+    float max_load_factor() const { return m_shards.at(0).max_load_factor(); }
+
+    // Sets the maximum load factor allowed
+    // for all shards.
+    void max_load_factor(float ml) {
+      for (auto &s: m_shards) {
+        s.max_load_factor(ml);
+      }
+    }
+
+    // For each shard, reserves at least the specified number of buckets
+    // and regenerates the hash table.
+    void rehash(size_type count) {
+      for (auto &s: m_shards) {
+        s.rehash(count);
+      }
+    }
+
+    // For each shard, reserves space for at least the specified number of
+    // elements and regenerates the hash table.
+    void reserve(size_type count) {
+      for (auto &s: m_shards) {
+        s.reserve(count);
+      }
+    }
+
+    // ------------------------------- Observers -------------------------------- //
+    hasher hash_function() const { return m_shards.at(0).hash_function(); }
+
+    key_equal key_eq() const { return m_shards.at(0).key_eq(); }
+
+  private:
+    std::array<shard_type, ShardCount> m_shards{};
+
+    void validate_shard_count() const { static_assert(ShardCount != 0, "ShardCount template parameter must be non-zero."); }
+
+    uint32_t get_shard_idx(Key const &key) const { return hash_function()(key) % ShardCount; }
+    shard_type &get_mutable_shard(Key const &key) { return m_shards.at(get_shard_idx(key)); }
+    const shard_type &get_shard(Key const &key) const { return m_shards.at(get_shard_idx(key)); }
+  };
+
+  template <class Key, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc>
+  bool operator==(const ::concurrency::ShardedUnorderedSet<Key, ShardCount, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::ShardedUnorderedSet<Key, ShardCount, Hash, KeyEqual, Alloc> &rhs) {
+    return lhs.data() == rhs.data();
+  }
+
+  template <class Key, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc>
+  bool operator!=(const ::concurrency::ShardedUnorderedSet<Key, ShardCount, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::ShardedUnorderedSet<Key, ShardCount, Hash, KeyEqual, Alloc> &rhs) {
+    return !(lhs == rhs);
+  }
+
+  // Specializes the std::swap algorithm for ::concurrency::ShardedUnorderedSet. Swaps the contents of lhs and rhs. Calls lhs.swap(rhs).
+  template <class Key, uint32_t ShardCount, class Hash, class KeyEqual, class Alloc>
+  void swap(::concurrency::ShardedUnorderedSet<Key, ShardCount, Hash, KeyEqual, Alloc> &lhs, ::concurrency::ShardedUnorderedSet<Key, ShardCount, Hash, KeyEqual, Alloc> &rhs) noexcept {
+    lhs.swap(rhs);
+  }
+
+} // namespace concurrency
+
+#endif // SHARDED_UNORDERED_CONCURRENT_SET
@@ -0,0 +1,591 @@
+#ifndef STRIPED_UNORDERED_CONCURRENT_MAP_H
+#define STRIPED_UNORDERED_CONCURRENT_MAP_H
+
+#include <concurrency/FlatHashMap.hpp>
+#include <concurrency/FrozenMap.hpp>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace concurrency {
+  constexpr std::size_t DefaultStripeCount = 16;
+
+  // This class provides a thread-safe, unordered map with the same interface as
+  // ::concurrency::UnorderedMap, but which guards its hash table with an array of stripe locks
+  // rather than a single std::shared_mutex. Every key belongs to one stripe, and each stripe
+  // owns a contiguous range of the table's buckets, so writers to keys in different stripes
+  // proceed in parallel without sharing any cache lines. Readers take their stripe's lock in
+  // shared mode.
+  //
+  // The table grows as a whole: when a stripe exceeds the maximum load factor, one thread
+  // takes every stripe lock, in order, and doubles the number of buckets in every stripe.
+  // Operations that touch the whole map, such as clear() and data(), do the same.
+  //
+  // Unlike ::concurrency::UnorderedMap, node handles (extract() and insert(node_type &&)) are
+  // not supported, since elements are stored in the map's own nodes rather than in those of
+  // a standard container. size() sums per-stripe counters without locking, so it may not
+  // reflect writes that are in progress on other threads.
+  //
+  // StripeCount must be a power of two.
+  template <class Key,
+            class Val,
+            class Hash              = std::hash<Key>,
+            class Pred              = std::equal_to<Key>,
+            class Allocator         = std::allocator<std::pair<const Key, Val>>,
+            std::size_t StripeCount = DefaultStripeCount>
+  class StripedUnorderedMap {
+    static_assert(StripeCount != 0 && (StripeCount & (StripeCount - 1)) == 0, "StripeCount template parameter must be a power of two.");
+
+    struct Node {
+      template <class... Args>
+      explicit Node(std::size_t h, Args &&...args) : hash(h), value(std::forward<Args>(args)...) {}
+
+      Node *next{nullptr};
+      std::size_t hash;
+      std::pair<const Key, Val> value;
+    };
+
+    using node_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using node_traits    = std::allocator_traits<node_allocator>;
+
+  public:
+    // ------------------------------ Member types ------------------------------ //
+    using mutex_type        = std::shared_mutex;
+    using read_lock         = std::shared_lock<mutex_type>;
+    using write_lock        = std::unique_lock<mutex_type>;
+    using self_type         = StripedUnorderedMap<Key, Val, Hash, Pred, Allocator, StripeCount>;
+    using internal_map_type = std::unordered_map<Key, Val, Hash, Pred, Allocator>;
+    using key_type          = Key;
+    using mapped_type       = Val;
+    using value_type        = std::pair<const Key, Val>;
+    using size_type         = std::size_t;
+    using difference_type   = std::ptrdiff_t;
+    using hasher            = Hash;
+    using key_equal         = Pred;
+    using allocator_type    = Allocator;
+    using reference         = value_type &;
+    using const_reference   = const value_type &;
+    using pointer           = typename std::allocator_traits<Allocator>::pointer;
+    using const_pointer     = typename std::allocator_traits<Allocator>::const_pointer;
+    using frozen_map_type   = FrozenMap<Key, Val, Hash, Pred>;
+
+  private:
+    struct alignas(64) Stripe {
+      mutable mutex_type mutex{};
+      std::atomic<size_type> count{0};
+    };
+
+    using read_locks  = std::array<read_lock, StripeCount>;
+    using write_locks = std::array<write_lock, StripeCount>;
+
+  public:
+    // ------------------------------ Constructors ------------------------------ //
+    StripedUnorderedMap() : m_buckets(StripeCount, nullptr) {}
+    StripedUnorderedMap(const StripedUnorderedMap &other) : m_buckets(StripeCount, nullptr) {
+      auto other_locks = other.lock_all_for_reading();
+      copy_from(other);
+    }
+    StripedUnorderedMap(StripedUnorderedMap &&other) : m_buckets(StripeCount, nullptr) {
+      auto other_locks = other.lock_all_for_writing();
+      steal_from(other);
+    }
+    StripedUnorderedMap(std::initializer_list<value_type> ilist) : m_buckets(StripeCount, nullptr) { insert(ilist); }
+
+    StripedUnorderedMap &operator=(const StripedUnorderedMap &other) {
+      if (this == &other) return *this;
+      auto [first, second] = ordered(*this, other);
+      auto first_locks     = first->lock_all_for_writing();
+      auto second_locks    = second->lock_all_for_writing();
+      destroy_nodes();
+      copy_from(other);
+      return *this;
+    }
+    StripedUnorderedMap &operator=(StripedUnorderedMap &&other) noexcept {
+      if (this == &other) return *this;
+      auto [first, second] = ordered(*this, other);
+      auto first_locks     = first->lock_all_for_writing();
+      auto second_locks    = second->lock_all_for_writing();
+      destroy_nodes();
+      steal_from(other);
+      return *this;
+    }
+    StripedUnorderedMap &operator=(std::initializer_list<value_type> ilist) {
+      this->insert(ilist);
+      return *this;
+    }
+
+    ~StripedUnorderedMap() { destroy_nodes(); }
+
+    allocator_type get_allocator() const { return allocator_type(m_alloc); }
+
+    // -------------------------------- Capacity -------------------------------- //
+    bool empty() const noexcept { return size() == 0; }
+
+    size_type size() const noexcept {
+      size_type size = 0;
+      for (auto const &stripe: m_stripes) {
+        size += stripe.count.load(std::memory_order_relaxed);
+      }
+      return size;
+    }
+
+    size_type max_size() const noexcept { return node_traits::max_size(m_alloc); }
+
+    // ------------------------------- Modifiers -------------------------------- //
+
+    void clear() noexcept {
+      auto locks = lock_all_for_writing();
+      destroy_nodes();
+    }
+
+    bool insert(const value_type &value) { return emplace_key(value.first, value.second); }
+    bool insert(value_type &&value) { return emplace_key(value.first, std::move(value.second)); }
+    template <class P>
+    bool insert(P &&value) {
+      return emplace(std::forward<P>(value));
+    }
+    void insert(std::initializer_list<value_type> ilist) {
+      for (auto const &el: ilist) {
+        (void) insert(el);
+      }
+    }
+
+    template <class M>
+    bool insert_or_assign(const Key &k, M &&obj) {
+      return assign_key(k, std::forward<M>(obj));
+    }
+    template <class M>
+    bool insert_or_assign(Key &&k, M &&obj) {
+      return assign_key(std::move(k), std::forward<M>(obj));
+    }
+
+    template <class... Args>
+    bool emplace(Args &&...args) {
+      // The key is only known once the element is constructed, so build the node first.
+      Node *node       = create_node(0, std::forward<Args>(args)...);
+      node->hash       = hash_of(node->value.first);
+      bool grow        = false;
+      bool inserted    = false;
+      size_type stripe = stripe_of(node->hash);
+      {
+        auto lock = lock_stripe_for_writing(stripe);
+        if (find_node(node->value.first, node->hash) == nullptr) {
+          link(node);
+          inserted = true;
+          grow     = overloaded(stripe);
+        }
+      }
+      if (!inserted) destroy_node(node);
+      if (grow) grow_table();
+      return inserted;
+    }
+
+    template <class... Args>
+    bool try_emplace(const Key &k, Args &&...args) {
+      return emplace_key(k, std::forward<Args>(args)...);
+    }
+    template <class... Args>
+    bool try_emplace(Key &&k, Args &&...args) {
+      return emplace_key(std::move(k), std::forward<Args>(args)...);
+    }
+
+    size_type erase(const Key &key) {
+      auto const h = hash_of(key);
+      Node *node   = nullptr;
+      {
+        auto lock = lock_stripe_for_writing(stripe_of(h));
+        node      = unlink(key, h);
+      }
+      if (node == nullptr) return 0;
+      destroy_node(node);
+      return 1;
+    }
+
+    void swap(self_type &other) noexcept {
+      if (this == &other) return;
+      auto [first, second] = ordered(*this, other);
+      auto first_locks     = first->lock_all_for_writing();
+      auto second_locks    = second->lock_all_for_writing();
+      m_buckets.swap(other.m_buckets);
+      std::swap(m_stripe_buckets, other.m_stripe_buckets);
+      std::swap(m_max_load_factor, other.m_max_load_factor);
+      for (std::size_t s = 0; s < StripeCount; ++s) {
+        auto const count = m_stripes[s].count.load(std::memory_order_relaxed);
+        m_stripes[s].count.store(other.m_stripes[s].count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        other.m_stripes[s].count.store(count, std::memory_order_relaxed);
+      }
+    }
+
+    void swap(internal_map_type &other) {
+      auto locks    = lock_all_for_writing();
+      auto previous = copy_to_internal_map();
+      destroy_nodes();
+      for (auto &el: other) {
+        auto const h = hash_of(el.first);
+        link(create_node(h, el.first, std::move(el.second)));
+      }
+      rehash_locked(0);
+      other.swap(previous);
+    }
+
+    void merge(internal_map_type &source) {
+      for (auto it = source.begin(); it != source.end();) {
+        if (emplace_key(it->first, std::move(it->second))) {
+          it = source.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+    void merge(internal_map_type &&source) { merge(source); }
+    void merge(self_type &source) {
+      for (auto const &el: source.data()) {
+        if (find(el.first)) continue;
+        if (source.erase(el.first)) (void) insert(el);
+      }
+    }
+    void merge(self_type &&source) { merge(source); }
+
+    // ------------------------------ Accessors --------------------------------- //
+    // Returns a copy of the element mapped to
+    // the provided key. Does bounds checking.
+    Val at(const Key &key) const {
+      auto const h = hash_of(key);
+      auto lock    = lock_stripe_for_reading(stripe_of(h));
+      auto *node   = find_node(key, h);
+      if (node == nullptr) throw std::out_of_range("::concurrency::StripedUnorderedMap::at: key not found");
+      return node->value.second;
+    }
+
+    // Returns a copy of the element mapped to
+    // the provided key. If no element is present,
+    // a new one is default constructed.
+    Val operator[](const Key &key) { return subscript(key); }
+    // Returns a copy of the element mapped to
+    // the provided key. If no element is present,
+    // a new one is default constructed.
+    Val operator[](Key &&key) { return subscript(std::move(key)); }
+
+    size_type count(const Key &key) const { return find(key) ? 1 : 0; }
+
+    // Returns a bool indicating whether or not the
+    // provided key is present in the map.
+    bool find(const Key &key) const {
+      auto const h = hash_of(key);
+      auto lock    = lock_stripe_for_reading(stripe_of(h));
+      return find_node(key, h) != nullptr;
+    }
+
+    // Returns a non-thread-safe copy of the data in every stripe.
+    internal_map_type data() const {
+      auto locks = lock_all_for_reading();
+      return copy_to_internal_map();
+    }
+
+    // Returns an immutable, lock-free snapshot of the map, built
+    // using up to thread_count threads. See ::concurrency::FrozenMap.
+    frozen_map_type freeze(unsigned thread_count = 1) const { return frozen_map_type(data(), thread_count, m_hash, m_eq); }
+
+    // --------------------------- Bucket Interface ----------------------------- //
+    size_type bucket_count() const {
+      auto lock = lock_stripe_for_reading(0);
+      return m_buckets.size();
+    }
+
+    // ------------------------------ Hash Policy ------------------------------- //
+    size_type stripe_count() const noexcept { return StripeCount; }
+
+    float load_factor() const { return static_cast<float>(size()) / static_cast<float>(bucket_count()); }
+
+    float max_load_factor() const {
+      auto lock = lock_stripe_for_reading(0);
+      return m_max_load_factor;
+    }
+
+    // Throws std::invalid_argument unless ml is positive.
+    void max_load_factor(float ml) {
+      if (!(ml > 0.0f)) throw std::invalid_argument("::concurrency::StripedUnorderedMap::max_load_factor: must be positive");
+      std::lock_guard<std::mutex> resize_lock(m_resize_mutex);
+      auto locks        = lock_all_for_writing();
+      m_max_load_factor = ml;
+      rehash_locked(0);
+    }
+
+    void rehash(size_type count) {
+      std::lock_guard<std::mutex> resize_lock(m_resize_mutex);
+      auto locks = lock_all_for_writing();
+      rehash_locked(count);
+    }
+
+    void reserve(size_type count) { rehash(static_cast<size_type>(std::ceil(count / max_load_factor()))); }
+
+    // ------------------------------- Observers -------------------------------- //
+    hasher hash_function() const { return m_hash; }
+
+    key_equal key_eq() const { return m_eq; }
+
+  private:
+    std::size_t hash_of(const Key &key) const { return detail::mix_hash(m_hash(key)); }
+
+    static size_type stripe_of(std::size_t hash) noexcept { return hash & (StripeCount - 1); }
+
+    // Each stripe owns m_stripe_buckets consecutive buckets, so that writers in different
+    // stripes never write to the same cache line. Callers must hold the key's stripe lock.
+    Node *&bucket_of(std::size_t hash) { return m_buckets[stripe_of(hash) * m_stripe_buckets + ((hash / StripeCount) & (m_stripe_buckets - 1))]; }
+    Node *bucket_of(std::size_t hash) const { return m_buckets[stripe_of(hash) * m_stripe_buckets + ((hash / StripeCount) & (m_stripe_buckets - 1))]; }
+
+    read_lock lock_stripe_for_reading(size_type stripe) const { return read_lock(m_stripes[stripe].mutex); }
+    write_lock lock_stripe_for_writing(size_type stripe) const { return write_lock(m_stripes[stripe].mutex); }
+
+    // Lock every stripe, in order, which excludes every other operation on the map.
+    read_locks lock_all_for_reading() const {
+      read_locks locks;
+      for (std::size_t s = 0; s < StripeCount; ++s) {
+        locks[s] = read_lock(m_stripes[s].mutex);
+      }
+      return locks;
+    }
+    write_locks lock_all_for_writing() const {
+      write_locks locks;
+      for (std::size_t s = 0; s < StripeCount; ++s) {
+        locks[s] = write_lock(m_stripes[s].mutex);
+      }
+      return locks;
+    }
+
+    // Orders two maps by address, so that operations locking both never deadlock.
+    static std::pair<const self_type *, const self_type *> ordered(const self_type &lhs, const self_type &rhs) {
+      if (std::less<const self_type *>()(&lhs, &rhs)) return {&lhs, &rhs};
+      return {&rhs, &lhs};
+    }
+
+    // Callers must hold the stripe lock for at least reading.
+    Node *find_node(const Key &key, std::size_t hash) const {
+      for (Node *node = bucket_of(hash); node != nullptr; node = node->next) {
+        if (node->hash == hash && m_eq(node->value.first, key)) return node;
+      }
+      return nullptr;
+    }
+
+    // Callers must hold the stripe lock for writing.
+    void link(Node *node) {
+      auto &head = bucket_of(node->hash);
+      node->next = head;
+      head       = node;
+      m_stripes[stripe_of(node->hash)].count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Callers must hold the stripe lock for writing.
+    Node *unlink(const Key &key, std::size_t hash) {
+      for (Node **slot = &bucket_of(hash); *slot != nullptr; slot = &(*slot)->next) {
+        Node *node = *slot;
+        if (node->hash == hash && m_eq(node->value.first, key)) {
+          *slot = node->next;
+          m_stripes[stripe_of(hash)].count.fetch_sub(1, std::memory_order_relaxed);
+          return node;
+        }
+      }
+      return nullptr;
+    }
+
+    template <class... Args>
+    Node *create_node(std::size_t hash, Args &&...args) {
+      Node *node = node_traits::allocate(m_alloc, 1);
+      try {
+        node_traits::construct(m_alloc, node, hash, std::forward<Args>(args)...);
+      } catch (...) {
+        node_traits::deallocate(m_alloc, node, 1);
+        throw;
+      }
+      return node;
+    }
+
+    void destroy_node(Node *node) noexcept {
+      node_traits::destroy(m_alloc, node);
+      node_traits::deallocate(m_alloc, node, 1);
+    }
+
+    // Callers must hold every stripe lock for writing.
+    void destroy_nodes() noexcept {
+      for (auto &head: m_buckets) {
+        while (head != nullptr) {
+          Node *next = head->next;
+          destroy_node(head);
+          head = next;
+        }
+      }
+      for (auto &stripe: m_stripes) {
+        stripe.count.store(0, std::memory_order_relaxed);
+      }
+    }
+
+    // Callers must hold every stripe lock of both maps, and this map must be empty.
+    void copy_from(const self_type &other) {
+      m_max_load_factor = other.m_max_load_factor;
+      m_stripe_buckets  = other.m_stripe_buckets;
+      m_buckets.assign(other.m_buckets.size(), nullptr);
+      for (auto const *head: other.m_buckets) {
+        for (auto const *node = head; node != nullptr; node = node->next) {
+          link(create_node(node->hash, node->value));
+        }
+      }
+    }
+
+    // Callers must hold every stripe lock of both maps, and this map must be empty.
+    void steal_from(self_type &other) {
+      m_max_load_factor = other.m_max_load_factor;
+      m_stripe_buckets  = std::exchange(other.m_stripe_buckets, 1);
+      m_buckets         = std::exchange(other.m_buckets, std::vector<Node *>(StripeCount, nullptr));
+      for (std::size_t s = 0; s < StripeCount; ++s) {
+        m_stripes[s].count.store(other.m_stripes[s].count.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+      }
+    }
+
+    // Callers must hold every stripe lock for at least reading.
+    internal_map_type copy_to_internal_map() const {
+      internal_map_type m(size(), m_hash, m_eq, allocator_type(m_alloc));
+      for (auto const *head: m_buckets) {
+        for (auto const *node = head; node != nullptr; node = node->next) {
+          m.insert(node->value);
+        }
+      }
+      return m;
+    }
+
+    // Callers must hold the stripe lock.
+    bool overloaded(size_type stripe) const { return m_stripes[stripe].count.load(std::memory_order_relaxed) > m_stripe_buckets * m_max_load_factor; }
+
+    // Doubles the number of buckets per stripe. If another thread is already resizing, its
+    // resize will do, and if the overloaded stripe has since been resized, there is nothing
+    // to do.
+    void grow_table() {
+      std::unique_lock<std::mutex> resize_lock(m_resize_mutex, std::try_to_lock);
+      if (!resize_lock.owns_lock()) return;
+      auto locks = lock_all_for_writing();
+      for (std::size_t s = 0; s < StripeCount; ++s) {
+        if (overloaded(s)) {
+          rehash_locked(m_buckets.size() * 2);
+          return;
+        }
+      }
+    }
+
+    // Redistributes the nodes over at least bucket_count buckets, and enough buckets to stay
+    // within the maximum load factor. Callers must hold every stripe lock for writing.
+    void rehash_locked(size_type bucket_count) {
+      size_type stripe_buckets = 1;
+      while (stripe_buckets * StripeCount < bucket_count) {
+        stripe_buckets *= 2;
+      }
+      for (std::size_t s = 0; s < StripeCount; ++s) {
+        while (m_stripes[s].count.load(std::memory_order_relaxed) > stripe_buckets * m_max_load_factor) {
+          stripe_buckets *= 2;
+        }
+      }
+      if (stripe_buckets == m_stripe_buckets) return;
+
+      std::vector<Node *> previous(stripe_buckets * StripeCount, nullptr);
+      previous.swap(m_buckets);
+      m_stripe_buckets = stripe_buckets;
+      for (auto *head: previous) {
+        while (head != nullptr) {
+          Node *next   = head->next;
+          auto &bucket = bucket_of(head->hash);
+          head->next   = bucket;
+          bucket       = head;
+          head         = next;
+        }
+      }
+    }
+
+    template <class K, class... Args>
+    bool emplace_key(K &&key, Args &&...args) {
+      auto const h = hash_of(key);
+      bool grow    = false;
+      {
+        auto lock = lock_stripe_for_writing(stripe_of(h));
+        if (find_node(key, h) != nullptr) return false;
+        link(create_node(h, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<Args>(args)...)));
+        grow = overloaded(stripe_of(h));
+      }
+      if (grow) grow_table();
+      return true;
+    }
+
+    template <class K, class M>
+    bool assign_key(K &&key, M &&obj) {
+      auto const h = hash_of(key);
+      bool grow    = false;
+      {
+        auto lock = lock_stripe_for_writing(stripe_of(h));
+        if (auto *node = find_node(key, h)) {
+          node->value.second = std::forward<M>(obj);
+          return false;
+        }
+        link(create_node(h, std::forward<K>(key), std::forward<M>(obj)));
+        grow = overloaded(stripe_of(h));
+      }
+      if (grow) grow_table();
+      return true;
+    }
+
+    template <class K>
+    Val subscript(K &&key) {
+      auto const h = hash_of(key);
+      {
+        auto lock = lock_stripe_for_reading(stripe_of(h));
+        if (auto const *node = find_node(key, h)) return node->value.second;
+      }
+      auto lock = lock_stripe_for_writing(stripe_of(h));
+      if (auto const *node = find_node(key, h)) return node->value.second;
+      Node *node = create_node(h, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple());
+      link(node);
+      Val value = node->value.second;
+      if (overloaded(stripe_of(h))) {
+        lock.unlock();
+        grow_table();
+      }
+      return value;
+    }
+
+    std::array<Stripe, StripeCount> m_stripes{};
+    std::vector<Node *> m_buckets;
+    size_type m_stripe_buckets{1};
+    float m_max_load_factor{1.0f};
+    std::mutex m_resize_mutex{};
+    hasher m_hash{};
+    key_equal m_eq{};
+    node_allocator m_alloc{};
+  };
+
+  template <class Key, class T, class Hash, class KeyEqual, class Alloc, std::size_t StripeCount>
+  bool operator==(const ::concurrency::StripedUnorderedMap<Key, T, Hash, KeyEqual, Alloc, StripeCount> &lhs, const ::concurrency::StripedUnorderedMap<Key, T, Hash, KeyEqual, Alloc, StripeCount> &rhs) {
+    return lhs.data() == rhs.data();
+  }
+
+  template <class Key, class T, class Hash, class KeyEqual, class Alloc, std::size_t StripeCount>
+  bool operator!=(const ::concurrency::StripedUnorderedMap<Key, T, Hash, KeyEqual, Alloc, StripeCount> &lhs, const ::concurrency::StripedUnorderedMap<Key, T, Hash, KeyEqual, Alloc, StripeCount> &rhs) {
+    return !(lhs == rhs);
+  }
+
+  // Specializes the std::swap algorithm for ::concurrency::StripedUnorderedMap. Swaps the contents of lhs and rhs. Calls lhs.swap(rhs).
+  template <class Key, class T, class Hash, class KeyEqual, class Alloc, std::size_t StripeCount>
+  void swap(::concurrency::StripedUnorderedMap<Key, T, Hash, KeyEqual, Alloc, StripeCount> &lhs, ::concurrency::StripedUnorderedMap<Key, T, Hash, KeyEqual, Alloc, StripeCount> &rhs) noexcept {
+    lhs.swap(rhs);
+  }
+
+} // namespace concurrency
+
+#endif // STRIPED_UNORDERED_CONCURRENT_MAP_H
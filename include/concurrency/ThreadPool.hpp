@@ -0,0 +1,333 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace concurrency {
+  constexpr std::size_t ThreadPoolInitialDequeCapacity = 256;
+  constexpr unsigned ThreadPoolChunksPerThread         = 4;
+
+  namespace detail {
+    // A Chase-Lev work-stealing deque. The owning thread pushes and takes at the bottom, as a
+    // stack, while any other thread may steal from the top, so the owner works on its most
+    // recent, cache-warm tasks and thieves take the oldest, typically largest, ones. The buffer
+    // grows as needed; outgrown buffers may still be read by thieves and are kept until the
+    // deque is destroyed.
+    //
+    // Sequentially consistent operations take the place of the fences in the C11 version of
+    // the algorithm, so that it can be checked with ThreadSanitizer.
+    //
+    // https://fzn.fr/readings/ppopp13.pdf
+    template <class T>
+    class WorkStealingDeque {
+      static_assert(std::is_trivially_copyable_v<T>, "WorkStealingDeque elements must be trivially copyable.");
+
+      struct Buffer {
+        explicit Buffer(std::size_t capacity) : mask(capacity - 1), slots(std::make_unique<std::atomic<T>[]>(capacity)) {}
+
+        T get(int64_t i) const noexcept { return slots[static_cast<std::size_t>(i) & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T value) noexcept { slots[static_cast<std::size_t>(i) & mask].store(value, std::memory_order_relaxed); }
+
+        std::size_t const mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+      };
+
+    public:
+      explicit WorkStealingDeque(std::size_t capacity = ThreadPoolInitialDequeCapacity) {
+        std::size_t rounded = 2;
+        while (rounded < capacity) {
+          rounded *= 2;
+        }
+        m_buffers.push_back(std::make_unique<Buffer>(rounded));
+        m_buffer.store(m_buffers.back().get(), std::memory_order_relaxed);
+      }
+
+      WorkStealingDeque(const WorkStealingDeque &)            = delete;
+      WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+      // Must only be called by the owning thread.
+      void push(T value) {
+        auto const b = m_bottom.load(std::memory_order_relaxed);
+        auto const t = m_top.load(std::memory_order_acquire);
+        auto *buffer = m_buffer.load(std::memory_order_relaxed);
+        if (b - t > static_cast<int64_t>(buffer->mask)) buffer = grow(buffer, t, b);
+        buffer->put(b, value);
+        m_bottom.store(b + 1, std::memory_order_release);
+      }
+
+      // Must only be called by the owning thread.
+      bool take(T &value) {
+        auto const b = m_bottom.load(std::memory_order_relaxed) - 1;
+        auto *buffer = m_buffer.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_seq_cst);
+        auto t = m_top.load(std::memory_order_seq_cst);
+        if (t > b) {
+          m_bottom.store(b + 1, std::memory_order_relaxed);
+          return false;
+        }
+        value = buffer->get(b);
+        if (t < b) return true;
+        // Last element: race thieves for it.
+        bool const won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+      }
+
+      // May be called by any thread. Fails if the deque is empty or another thread took
+      // the element first.
+      bool steal(T &value) {
+        auto t       = m_top.load(std::memory_order_seq_cst);
+        auto const b = m_bottom.load(std::memory_order_seq_cst);
+        if (t >= b) return false;
+        auto *buffer = m_buffer.load(std::memory_order_acquire);
+        auto const v = buffer->get(t);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return false;
+        value = v;
+        return true;
+      }
+
+      // May report an element that is being taken as still present.
+      bool empty() const noexcept { return m_top.load(std::memory_order_acquire) >= m_bottom.load(std::memory_order_acquire); }
+
+    private:
+      Buffer *grow(Buffer *old, int64_t t, int64_t b) {
+        m_buffers.push_back(std::make_unique<Buffer>((old->mask + 1) * 2));
+        auto *buffer = m_buffers.back().get();
+        for (auto i = t; i < b; ++i) {
+          buffer->put(i, old->get(i));
+        }
+        m_buffer.store(buffer, std::memory_order_release);
+        return buffer;
+      }
+
+      alignas(64) std::atomic<int64_t> m_top{0};
+      alignas(64) std::atomic<int64_t> m_bottom{0};
+      std::atomic<Buffer *> m_buffer{nullptr};
+      std::vector<std::unique_ptr<Buffer>> m_buffers{};
+    };
+  } // namespace detail
+
+  // This class provides a fixed-size pool of worker threads that balance their load by work
+  // stealing. Each worker has its own Chase-Lev deque: tasks submitted from a worker go on
+  // its own deque, tasks submitted from other threads go on a shared queue, and a worker
+  // that runs out of tasks takes from the shared queue or steals the oldest task of another
+  // worker before going to sleep.
+  //
+  // submit() returns a std::future for the result of a task. parallel_for() splits an index
+  // range into chunks and returns once every index has been processed; the calling thread
+  // runs tasks while it waits, so parallel_for() may be nested inside pool tasks.
+  //
+  // If pin_threads is set, worker i is pinned to CPU i modulo the number of hardware threads.
+  // Pinning is only supported on Linux and is ignored elsewhere. The destructor runs every
+  // task that was submitted before it was called.
+  class ThreadPool {
+    class Task {
+    public:
+      virtual ~Task()    = default;
+      virtual void run() = 0;
+    };
+
+    template <class F>
+    class TaskImpl final : public Task {
+    public:
+      template <class G>
+      explicit TaskImpl(G &&g) : m_f(std::forward<G>(g)) {}
+      void run() override { m_f(); }
+
+    private:
+      F m_f;
+    };
+
+    struct alignas(64) Worker {
+      detail::WorkStealingDeque<Task *> deque{};
+      std::thread thread{};
+    };
+
+  public:
+    // ------------------------------ Constructors ------------------------------ //
+    explicit ThreadPool(unsigned thread_count = std::thread::hardware_concurrency(), bool pin_threads = false) {
+      thread_count = std::max(1u, thread_count);
+      for (unsigned i = 0; i < thread_count; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+      }
+      for (unsigned i = 0; i < thread_count; ++i) {
+        m_workers[i]->thread = std::thread(&ThreadPool::run_worker, this, i);
+        if (pin_threads) pin(m_workers[i]->thread, i);
+      }
+    }
+
+    ThreadPool(const ThreadPool &)            = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+      }
+      m_wakeup.notify_all();
+      for (auto &worker: m_workers) {
+        worker->thread.join();
+      }
+    }
+
+    unsigned thread_count() const noexcept { return static_cast<unsigned>(m_workers.size()); }
+
+    // --------------------------------- Tasks ---------------------------------- //
+    // Runs f() on the pool and returns a future for its result, or for the exception it throws.
+    template <class F>
+    auto submit(F &&f) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+      using result_type = std::invoke_result_t<std::decay_t<F>>;
+      std::packaged_task<result_type()> task(std::forward<F>(f));
+      auto future = task.get_future();
+      post([task = std::move(task)]() mutable { task(); });
+      return future;
+    }
+
+    // Runs f() on the pool without providing a way to wait for it. f() must not throw.
+    template <class F>
+    void post(F &&f) {
+      std::unique_ptr<Task> task = std::make_unique<TaskImpl<std::decay_t<F>>>(std::forward<F>(f));
+      m_pending.fetch_add(1, std::memory_order_seq_cst);
+      if (auto *worker = current_worker()) {
+        worker->deque.push(task.release());
+      } else {
+        std::lock_guard<std::mutex> lock(m_injection_mutex);
+        m_injection.push_back(task.get());
+        (void) task.release();
+      }
+      if (m_sleeping.load(std::memory_order_seq_cst) != 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wakeup.notify_one();
+      }
+    }
+
+    // Calls f(i) for every i in [first, last), in chunks of grain indices, and returns once
+    // every call has finished. A grain of 0 picks one that gives each thread several chunks.
+    // Rethrows the first exception thrown by f, after every chunk has finished.
+    template <class Index, class F>
+    void parallel_for(Index first, Index last, F &&f, Index grain = 0) {
+      static_assert(std::is_integral_v<Index>, "parallel_for requires an integral index type.");
+      if (!(first < last)) return;
+      auto const n = static_cast<std::size_t>(last - first);
+      auto step    = static_cast<std::size_t>(grain);
+      if (step == 0) step = std::max<std::size_t>(1, n / (thread_count() * ThreadPoolChunksPerThread));
+      auto const chunks = (n + step - 1) / step;
+
+      std::atomic<std::size_t> remaining{chunks};
+      std::exception_ptr error;
+      std::mutex error_mutex;
+      for (std::size_t c = 0; c < chunks; ++c) {
+        auto const lo = first + static_cast<Index>(c * step);
+        auto const hi = first + static_cast<Index>(std::min(n, (c + 1) * step));
+        post([&f, &remaining, &error, &error_mutex, lo, hi]() {
+          try {
+            for (auto i = lo; i < hi; ++i) {
+              f(i);
+            }
+          } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) error = std::current_exception();
+          }
+          remaining.fetch_sub(1, std::memory_order_acq_rel);
+        });
+      }
+      while (remaining.load(std::memory_order_acquire) != 0) {
+        if (!run_one(current_worker())) std::this_thread::yield();
+      }
+      if (error) std::rethrow_exception(error);
+    }
+
+  private:
+    Worker *current_worker() const noexcept { return t_pool == this ? m_workers[t_index].get() : nullptr; }
+
+    // Runs one task, preferring the given worker's own deque, then the shared queue, then
+    // the other workers' deques. Returns false if no task was found.
+    bool run_one(Worker *self) {
+      Task *task = nullptr;
+      if (self != nullptr && self->deque.take(task)) return run(task);
+      {
+        std::lock_guard<std::mutex> lock(m_injection_mutex);
+        if (!m_injection.empty()) {
+          task = m_injection.front();
+          m_injection.pop_front();
+        }
+      }
+      if (task != nullptr) return run(task);
+      static thread_local std::minstd_rand rng(static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())));
+      auto const start = rng();
+      for (std::size_t i = 0; i < m_workers.size(); ++i) {
+        auto &victim = *m_workers[(start + i) % m_workers.size()];
+        if (&victim != self && victim.deque.steal(task)) return run(task);
+      }
+      return false;
+    }
+
+    bool run(Task *task) {
+      m_pending.fetch_sub(1, std::memory_order_seq_cst);
+      std::unique_ptr<Task> owned(task);
+      owned->run();
+      return true;
+    }
+
+    void run_worker(unsigned index) {
+      t_pool     = this;
+      t_index    = index;
+      auto *self = m_workers[index].get();
+      while (true) {
+        if (run_one(self)) continue;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+        m_wakeup.wait(lock, [this]() { return m_pending.load(std::memory_order_seq_cst) != 0 || m_stopping; });
+        m_sleeping.fetch_sub(1, std::memory_order_seq_cst);
+        if (m_stopping && m_pending.load(std::memory_order_seq_cst) == 0) return;
+      }
+    }
+
+    static void pin(std::thread &thread, unsigned index) {
+#if defined(__linux__)
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(index % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+      (void) pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+#else
+      (void) thread;
+      (void) index;
+#endif
+    }
+
+    static inline thread_local const ThreadPool *t_pool = nullptr;
+    static inline thread_local unsigned t_index         = 0;
+
+    std::vector<std::unique_ptr<Worker>> m_workers{};
+    std::mutex m_injection_mutex{};
+    std::deque<Task *> m_injection{};
+    std::atomic<std::size_t> m_pending{0};
+    std::atomic<uint32_t> m_sleeping{0};
+    std::mutex m_mutex{};
+    std::condition_variable m_wakeup{};
+    bool m_stopping{false};
+  };
+
+} // namespace concurrency
+
+#endif // THREAD_POOL_H
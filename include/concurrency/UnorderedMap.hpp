@@ -1,10 +1,61 @@
 #ifndef UNORDERED_CONCURRENT_MAP_H
 #define UNORDERED_CONCURRENT_MAP_H
 
+#include <concurrency/AsyncSharedMutex.hpp>
+#include <concurrency/BloomFilter.hpp>
+#include <concurrency/FlatCombiner.hpp>
+#include <concurrency/FlatHashMap.hpp>
+#include <concurrency/FrozenMap.hpp>
+#include <concurrency/MapSnapshot.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <shared_mutex>
+#include <stdexcept>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace concurrency {
+  constexpr std::size_t VersionStampCount = 256;
+
+  // An element copied out of a map together with its version stamp.
+  // See ::concurrency::UnorderedMap::find_versioned().
+  template <class Val>
+  struct VersionedValue {
+    Val value;
+    uint64_t version;
+  };
+
+  // The changes made to a map since an epoch, as returned by UnorderedMap::changes_since()
+  // and ShardedUnorderedMap::changes_since(), grouped by the shard of the map they were taken
+  // from. Pass epoch to the next call to receive the changes made after this delta.
+  template <class Key, class Val>
+  struct MapDelta {
+    struct Shard {
+      // Set if the shard's contents were replaced wholesale, or its log was discarded, since
+      // the epoch. upserts then holds every element of the shard, and any other key of the
+      // shard has been erased.
+      bool reset{false};
+      std::vector<std::pair<Key, Val>> upserts{};
+      std::vector<Key> erased{};
+    };
+
+    uint64_t epoch{0};
+    std::vector<Shard> shards{};
+
+    bool empty() const noexcept {
+      for (auto const &shard: shards) {
+        if (shard.reset || !shard.upserts.empty() || !shard.erased.empty()) return false;
+      }
+      return true;
+    }
+  };
 
   // This class provides a thread-safe unordered map with most of the same functionality as
   // std::unordered_map. However, iterator access has been removed in order to preserve
@@ -16,16 +67,25 @@ namespace concurrency {
   // counterpart of the same name are documented with comments, as are functions that
   // do not exist for std::unordered_map.
   //
+  // The InternalMap template parameter selects the container that backs the map. It defaults
+  // to std::unordered_map, but any template providing the same interface may be used, such as
+  // ::concurrency::FlatHashMap (see also ::concurrency::FlatUnorderedMap).
+  //
   // https://en.cppreference.com/w/cpp/container/unordered_map
-  template <class Key, class Val, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>, class Allocator = std::allocator<std::pair<const Key, Val>>>
+  template <class Key,
+            class Val,
+            class Hash                            = std::hash<Key>,
+            class Pred                            = std::equal_to<Key>,
+            class Allocator                       = std::allocator<std::pair<const Key, Val>>,
+            template <class...> class InternalMap = std::unordered_map>
   class UnorderedMap {
   public:
     // ------------------------------ Member types ------------------------------ //
-    using mutex_type           = std::shared_mutex;
+    using mutex_type           = AsyncSharedMutex;
     using read_lock            = std::shared_lock<mutex_type>;
     using write_lock           = std::unique_lock<mutex_type>;
-    using self_type            = UnorderedMap<Key, Val, Hash, Pred, Allocator>;
-    using internal_map_type    = std::unordered_map<Key, Val, Hash, Pred, Allocator>;
+    using self_type            = UnorderedMap<Key, Val, Hash, Pred, Allocator, InternalMap>;
+    using internal_map_type    = InternalMap<Key, Val, Hash, Pred, Allocator>;
     using key_type             = typename internal_map_type::key_type;
     using mapped_type          = typename internal_map_type::mapped_type;
     using value_type           = typename internal_map_type::value_type;
@@ -43,6 +103,8 @@ namespace concurrency {
     using local_iterator       = typename internal_map_type::local_iterator;
     using const_local_iterator = typename internal_map_type::const_local_iterator;
     using node_type            = typename internal_map_type::node_type;
+    using frozen_map_type      = FrozenMap<Key, Val, Hash, Pred>;
+    using snapshot_type        = MappedSnapshot<Key, Val, Hash, Pred>;
 
     // This member type intentionally excluded, as it is not used in this implementation.
     // using insert_return_type   = typename internal_map_type::insert_return_type;
@@ -52,21 +114,39 @@ namespace concurrency {
     UnorderedMap(const UnorderedMap &other) {
       auto lock = lock_for_writing();
       m_map     = std::move(other.data());
+      if (other.bloom_filter_enabled()) rebuild_filter(0);
+      if (other.flat_combining_enabled()) m_combiner.enable();
+      if (other.versioning_enabled()) m_versions = std::make_unique<uint64_t[]>(VersionStampCount);
     }
     UnorderedMap(UnorderedMap &&other) {
       auto lock = lock_for_writing();
       m_map     = std::move(other.data());
+      if (other.bloom_filter_enabled()) rebuild_filter(0);
+      if (other.flat_combining_enabled()) m_combiner.enable();
+      if (other.versioning_enabled()) m_versions = std::make_unique<uint64_t[]>(VersionStampCount);
     }
     UnorderedMap(std::initializer_list<value_type> ilist) { insert(ilist); }
 
     UnorderedMap &operator=(const UnorderedMap &other) {
-      auto lock   = lock_for_writing();
-      this->m_map = other.data();
+      auto lock      = lock_for_writing();
+      auto displaced = filter_hashes();
+      this->m_map    = other.data();
+      replace_filter_hashes(displaced);
+      if (other.bloom_filter_enabled() && !bloom_filter_enabled()) rebuild_filter(0);
+      if (other.flat_combining_enabled()) m_combiner.enable();
+      if (other.versioning_enabled() && !m_versions) m_versions = std::make_unique<uint64_t[]>(VersionStampCount);
+      record_reset();
       return *this;
     }
     UnorderedMap &operator=(UnorderedMap &&other) noexcept {
-      auto lock   = lock_for_writing();
-      this->m_map = std::move(other.data());
+      auto lock      = lock_for_writing();
+      auto displaced = filter_hashes();
+      this->m_map    = std::move(other.data());
+      replace_filter_hashes(displaced);
+      if (other.bloom_filter_enabled() && !bloom_filter_enabled()) rebuild_filter(0);
+      if (other.flat_combining_enabled()) m_combiner.enable();
+      if (other.versioning_enabled() && !m_versions) m_versions = std::make_unique<uint64_t[]>(VersionStampCount);
+      record_reset();
       return *this;
     }
     UnorderedMap &operator=(std::initializer_list<value_type> ilist) {
@@ -102,102 +182,187 @@ namespace concurrency {
     void clear() noexcept {
       auto lock = lock_for_writing();
       m_map.clear();
+      record_reset();
+      m_filter.clear();
     }
 
     bool insert(const value_type &value) {
-      auto lock = lock_for_writing();
-      return m_map.insert(value).second;
+      return apply_write([&]() { return record_insert(m_map.insert(value)); });
     }
     bool insert(value_type &&value) {
-      auto lock = lock_for_writing();
-      return m_map.insert(value).second;
+      return apply_write([&]() { return record_insert(m_map.insert(value)); });
     }
     template <class P>
     bool insert(P &&value) {
-      auto lock = lock_for_writing();
-      return m_map.insert(value).second;
+      return apply_write([&]() { return record_insert(m_map.insert(value)); });
     }
     void insert(std::initializer_list<value_type> ilist) {
       auto lock = lock_for_writing();
-      (void) m_map.insert(ilist);
+      for (auto const &el: ilist) {
+        (void) record_insert(m_map.insert(el));
+      }
     }
     bool insert(node_type &&nh) {
-      auto lock = lock_for_writing();
-      return m_map.insert(std::move(nh)).inserted;
+      return apply_write([&]() {
+        auto result = m_map.insert(std::move(nh));
+        if (!result.inserted) return false;
+        return record_insert(std::make_pair(result.position, true));
+      });
     }
 
     template <class M>
     bool insert_or_assign(const Key &k, M &&obj) {
-      auto lock = lock_for_writing();
-      return m_map.insert_or_assign(k, obj).second;
+      return apply_write([&]() { return record_insert_or_assign(m_map.insert_or_assign(k, obj)); });
     }
     template <class M>
     bool insert_or_assign(Key &&k, M &&obj) {
-      auto lock = lock_for_writing();
-      return m_map.insert_or_assign(k, obj).second;
+      return apply_write([&]() { return record_insert_or_assign(m_map.insert_or_assign(k, obj)); });
     }
 
     template <class... Args>
     bool emplace(Args &&...args) {
-      auto lock = lock_for_writing();
-      return m_map.emplace(args...).second;
+      return apply_write([&]() { return record_insert(m_map.emplace(args...)); });
     }
 
     template <class... Args>
     bool try_emplace(const Key &k, Args &&...args) {
-      auto lock = lock_for_writing();
-      return m_map.try_emplace(k, args...).second;
+      return apply_write([&]() { return record_insert(m_map.try_emplace(k, args...)); });
     }
     template <class... Args>
     bool try_emplace(Key &&k, Args &&...args) {
-      auto lock = lock_for_writing();
-      return m_map.try_emplace(k, args...).second;
+      return apply_write([&]() { return record_insert(m_map.try_emplace(k, args...)); });
+    }
+
+    // Inserts obj if k is not present. Otherwise, replaces the element mapped to k with
+    // combine(element, obj). Returns true if obj was inserted.
+    template <class M, class F>
+    bool upsert(const Key &k, M &&obj, F &&combine) {
+      return apply_write([&]() { return upsert_locked(k, std::forward<M>(obj), combine); });
+    }
+
+    // Replaces the element mapped to k with desired if it compares equal to expected, and
+    // returns true. Otherwise, copies the element into expected and returns false. Also
+    // returns false, leaving expected unchanged, if k is not present.
+    template <class M>
+    bool compare_exchange(const Key &k, Val &expected, M &&desired) {
+      return apply_write([&]() {
+        auto it = m_map.find(k);
+        if (it == m_map.end()) return false;
+        if (!(it->second == expected)) {
+          expected = it->second;
+          return false;
+        }
+        it->second = std::forward<M>(desired);
+        record_write(k);
+        return true;
+      });
+    }
+
+    // Replaces the element mapped to k with obj and returns true, if k is present and its
+    // version stamp still equals version, as returned by find_versioned(). Otherwise returns
+    // false, and the caller should read the element again and retry. Throws
+    // std::logic_error if versioning is disabled.
+    template <class M>
+    bool update_if_version(const Key &k, uint64_t version, M &&obj) {
+      return apply_write([&]() {
+        auto const slot = version_slot(k);
+        auto it         = m_map.find(k);
+        if (it == m_map.end() || m_versions[slot] != version) return false;
+        it->second = std::forward<M>(obj);
+        record_write(k);
+        return true;
+      });
+    }
+
+    // Calls insert_or_assign() for every key-value pair in [first, last),
+    // taking the write lock only once.
+    template <class InputIt>
+    void insert_or_assign_many(InputIt first, InputIt last) {
+      apply_write([&]() {
+        for (; first != last; ++first) {
+          auto &&el = *first;
+          (void) record_insert_or_assign(m_map.insert_or_assign(el.first, std::forward<decltype(el)>(el).second));
+        }
+      });
+    }
+
+    // Calls upsert() for every key-value pair in [first, last),
+    // taking the write lock only once.
+    template <class InputIt, class F>
+    void upsert_many(InputIt first, InputIt last, F &&combine) {
+      apply_write([&]() {
+        for (; first != last; ++first) {
+          auto &&el = *first;
+          (void) upsert_locked(el.first, std::forward<decltype(el)>(el).second, combine);
+        }
+      });
     }
 
     size_type erase(const Key &key) {
-      auto lock = lock_for_writing();
-      return m_map.erase(key);
+      return apply_write([&]() {
+        auto const erased = m_map.erase(key);
+        for (size_type i = 0; i < erased; ++i) {
+          m_filter.remove(m_filter_hash(key));
+        }
+        if (erased != 0) record_write(key);
+        return erased;
+      });
     }
 
-    void swap(UnorderedMap<Key, Val, Hash, Pred, Allocator> &other) noexcept {
+    // Exchanges the contents of the two maps. Each Bloom filter moves along with the
+    // elements it describes, so a filter enabled on only one of the maps changes sides.
+    void swap(self_type &other) noexcept {
       auto lhs_lock = this->lock_for_writing();
       auto rhs_lock = other.lock_for_writing();
       this->m_map.swap(other.m_map);
+      this->m_filter.swap(other.m_filter);
+      this->record_reset();
+      other.record_reset();
     }
 
-    void swap(internal_map_type &other) noexcept {
-      auto lock = lock_for_writing();
+    // Exchanges the contents of the map with other. The Bloom filter, if enabled, is
+    // repopulated from the new contents, which may allocate.
+    void swap(internal_map_type &other) {
+      auto lock  = lock_for_writing();
+      auto prior = filter_hashes();
       m_map.swap(other);
+      replace_filter_hashes(prior);
+      record_reset();
     }
 
     node_type extract(const Key &k) {
       auto lock = lock_for_writing();
-      return m_map.extract(k);
+      auto nh   = m_map.extract(k);
+      if (!nh.empty()) {
+        m_filter.remove(m_filter_hash(k));
+        record_write(k);
+      }
+      return nh;
     }
 
     void merge(internal_map_type &source) {
       auto lock = lock_for_writing();
-      m_map.merge(source);
+      filter_merge(source);
     }
     void merge(internal_map_type &&source) {
       auto lock = lock_for_writing();
-      m_map.merge(source);
+      filter_merge(source);
     }
     void merge(std::unordered_multimap<Key, Val, Hash, Pred, Allocator> &source) {
       auto lock = lock_for_writing();
-      m_map.merge(source);
+      filter_merge(source);
     }
     void merge(std::unordered_multimap<Key, Val, Hash, Pred, Allocator> &&source) {
       auto lock = lock_for_writing();
-      m_map.merge(source);
+      filter_merge(source);
     }
-    void merge(UnorderedMap<Key, Val, Hash, Pred, Allocator> &source) {
+    void merge(self_type &source) {
       for (auto const &el: source.data()) {
         if (find(el.first)) continue;
         (void) insert(std::move(source.extract(el.first)));
       }
     }
-    void merge(UnorderedMap<Key, Val, Hash, Pred, Allocator> &&source) {
+    void merge(self_type &&source) {
       for (auto const &el: source.data()) {
         if (find(el.first)) continue;
         (void) insert(std::move(source.extract(el.first)));
@@ -208,12 +373,14 @@ namespace concurrency {
     // Returns a copy of the element mapped to
     // the provided key. Does bounds checking.
     Val at(const Key &key) const {
+      if (filter_rejects(key)) throw std::out_of_range("::concurrency::UnorderedMap::at: key not found");
       auto lock = lock_for_reading();
       return m_map.at(key);
     }
     // Returns a copy of the element mapped to
     // the provided key. Does bounds checking.
     Val at(const Key &&key) const {
+      if (filter_rejects(key)) throw std::out_of_range("::concurrency::UnorderedMap::at: key not found");
       auto lock = lock_for_reading();
       return m_map.at(key);
     }
@@ -223,19 +390,26 @@ namespace concurrency {
     // a new one is default constructed.
     Val operator[](const Key &key) {
       if (this->find(key)) return this->at(key);
-      auto lock = lock_for_writing();
-      return m_map[key];
+      return apply_write([&]() {
+        auto result = m_map.try_emplace(key);
+        (void) record_insert(result);
+        return result.first->second;
+      });
     }
     // Returns a copy of the element mapped to
     // the provided key. If no element is present,
     // a new one is default constructed.
     Val operator[](Key &&key) {
       if (this->find(key)) return this->at(key);
-      auto lock = lock_for_writing();
-      return m_map[key];
+      return apply_write([&]() {
+        auto result = m_map.try_emplace(key);
+        (void) record_insert(result);
+        return result.first->second;
+      });
     }
 
     size_type count(const Key &key) const {
+      if (filter_rejects(key)) return 0;
       auto lock = lock_for_reading();
       return m_map.count(key);
     }
@@ -243,16 +417,82 @@ namespace concurrency {
     // Returns a bool indicating whether or not the
     // provided key is present in the map.
     bool find(const Key &key) const {
+      if (filter_rejects(key)) return false;
       auto lock = lock_for_reading();
       return m_map.find(key) != m_map.end();
     }
 
+    // Returns a copy of the element mapped to key together with its version stamp, or
+    // nothing if no element is present. Throws std::logic_error if versioning is disabled.
+    std::optional<VersionedValue<Val>> find_versioned(const Key &key) const {
+      auto lock       = lock_for_reading();
+      auto const slot = version_slot(key);
+      auto it         = m_map.find(key);
+      if (it == m_map.end()) return std::nullopt;
+      return VersionedValue<Val>{it->second, m_versions[slot]};
+    }
+
+    // Returns a copy of the element mapped to the provided key. If no element is present,
+    // the first caller computes one with factory(), without holding the map's lock, and
+    // inserts it, while concurrent callers for the same key wait for that result instead of
+    // computing their own. If factory() throws, every waiting caller receives the exception
+    // and nothing is inserted, so the next caller computes again. If an element for key is
+    // inserted by other means during the computation, that element is kept and returned.
+    // factory() must not call get_or_compute() for the same key.
+    template <class F>
+    Val get_or_compute(const Key &key, F &&factory) {
+      if (!filter_rejects(key)) {
+        auto lock = lock_for_reading();
+        auto it   = m_map.find(key);
+        if (it != m_map.end()) return it->second;
+      }
+      std::promise<Val> promise;
+      {
+        std::unique_lock<std::mutex> lock(m_in_flight_mutex);
+        auto pending = m_in_flight.find(key);
+        if (pending != m_in_flight.end()) {
+          auto result = pending->second;
+          lock.unlock();
+          return result.get();
+        }
+        // A computation may have completed between the lookup above and taking the lock.
+        {
+          auto read = lock_for_reading();
+          auto it   = m_map.find(key);
+          if (it != m_map.end()) return it->second;
+        }
+        m_in_flight.emplace(key, promise.get_future().share());
+      }
+      try {
+        Val computed = factory();
+        Val result   = apply_write([&]() -> Val {
+          auto inserted = m_map.try_emplace(key, std::move(computed));
+          (void) record_insert(inserted);
+          return inserted.first->second;
+        });
+        promise.set_value(result);
+        finish_computation(key);
+        return result;
+      } catch (...) {
+        promise.set_exception(std::current_exception());
+        finish_computation(key);
+        throw;
+      }
+    }
+
     // Returns a non-thread-safe copy of the underlying map.
     internal_map_type data() const {
       auto lock = lock_for_reading();
       return m_map;
     }
 
+    // Returns an immutable, lock-free snapshot of the map, built
+    // using up to thread_count threads. See ::concurrency::FrozenMap.
+    frozen_map_type freeze(unsigned thread_count = 1) const {
+      auto lock = lock_for_reading();
+      return frozen_map_type(m_map, thread_count, m_map.hash_function(), m_map.key_eq());
+    }
+
     // --------------------------- Bucket Interface ----------------------------- //
     size_type bucket_count() const {
       auto lock = lock_for_reading();
@@ -295,6 +535,235 @@ namespace concurrency {
     void reserve(size_type count) {
       auto lock = lock_for_writing();
       m_map.reserve(count);
+      if (bloom_filter_enabled() && count > m_filter.capacity()) rebuild_filter(count);
+    }
+
+    // ----------------------------- Bloom Filter ------------------------------- //
+    // Enables a counting Bloom filter sized for at least expected_elements, which find(),
+    // count(), and at() consult before taking the read lock. Lookups of absent keys then
+    // usually cost a single cache line read and no lock, in exchange for roughly 8 bytes
+    // per element and slightly slower writes. The filter grows along with the map.
+    // See ::concurrency::CountingBloomFilter.
+    void enable_bloom_filter(size_type expected_elements = 0) {
+      auto lock = lock_for_writing();
+      rebuild_filter(expected_elements);
+    }
+
+    bool bloom_filter_enabled() const noexcept { return m_filter.enabled(); }
+
+    // ----------------------------- Flat Combining ----------------------------- //
+    // Enables flat combining for single-element writes: insert(), insert_or_assign(),
+    // emplace(), try_emplace(), erase(), and operator[]. A writer publishes its operation,
+    // and whichever writer holds the write lock applies every published operation in one
+    // pass, which reduces contention on the lock when many threads write to the same map.
+    // See ::concurrency::FlatCombiner.
+    void enable_flat_combining() {
+      auto lock = lock_for_writing();
+      m_combiner.enable();
+    }
+
+    bool flat_combining_enabled() const noexcept { return m_combiner.enabled(); }
+
+    // ------------------------------- Versioning ------------------------------- //
+    // Enables version stamps for optimistic concurrency: read an element and its stamp with
+    // find_versioned(), compute a new value without holding any lock, then write it with
+    // update_if_version(), which fails if the element was written in the meantime. Every
+    // write to an element advances its stamp. Keys share VersionStampCount stamps by hash,
+    // so a write to another key may make an update fail spuriously, but an update never
+    // succeeds over an intervening write to its own key.
+    void enable_versioning() {
+      auto lock = lock_for_writing();
+      if (!m_versions) m_versions = std::make_unique<uint64_t[]>(VersionStampCount);
+    }
+
+    bool versioning_enabled() const {
+      auto lock = lock_for_reading();
+      return m_versions != nullptr;
+    }
+
+    // ---------------------------- Change Tracking ----------------------------- //
+    // Enables a log of the keys written since each epoch, for keeping replicas in sync.
+    // changes_since(epoch) returns the current element of every key written after epoch,
+    // or the key alone if it has since been erased, and a new epoch to pass to the next call.
+    // Only the latest write to each key is kept. The first call, with epoch 0, returns the
+    // whole map. Operations that replace the contents wholesale, such as clear(), swap(), and
+    // assignment, make the next delta report the whole map again. Copies of the map do not
+    // track changes.
+    void enable_change_tracking() { enable_change_tracking(std::make_shared<std::atomic<uint64_t>>(1)); }
+
+    bool change_tracking_enabled() const {
+      auto lock = lock_for_reading();
+      return m_changes != nullptr;
+    }
+
+    // Throws std::logic_error if change tracking is disabled.
+    MapDelta<Key, Val> changes_since(uint64_t epoch) const {
+      MapDelta<Key, Val> delta;
+      delta.epoch = change_clock()->fetch_add(1, std::memory_order_relaxed);
+      delta.shards.push_back(collect_changes(epoch));
+      return delta;
+    }
+
+    // Frees the log of writes made up to and including epoch, once every replica has seen
+    // them. A later call to changes_since() with an earlier epoch returns the whole map.
+    void discard_changes_through(uint64_t epoch) {
+      auto lock = lock_for_writing();
+      if (!m_changes) throw std::logic_error("::concurrency::UnorderedMap: change tracking is not enabled");
+      for (auto it = m_changes->written.begin(); it != m_changes->written.end();) {
+        it = it->second <= epoch ? m_changes->written.erase(it) : std::next(it);
+      }
+      m_changes->reset_epoch = std::max(m_changes->reset_epoch, epoch);
+    }
+
+    // Applies a delta taken from a map with the same Key, Val, and Hash, under one write
+    // lock. The source map may have any number of shards.
+    void apply_delta(const MapDelta<Key, Val> &delta) {
+      std::vector<const std::pair<Key, Val> *> upserts;
+      std::vector<const Key *> erased;
+      std::vector<bool> reset;
+      for (auto const &shard: delta.shards) {
+        reset.push_back(shard.reset);
+        for (auto const &el: shard.upserts) {
+          upserts.push_back(&el);
+        }
+        for (auto const &k: shard.erased) {
+          erased.push_back(&k);
+        }
+      }
+      apply_changes(reset, upserts, erased);
+    }
+
+    // ------------------------------ Locked Views ------------------------------ //
+    // Holds the map's write lock for as long as it lives, and gives direct access to the
+    // elements in the meantime: find() and at() return references into the map rather than
+    // copies, so that several reads and writes can be made as one atomic step. References
+    // obtained through a view must not be used after it is destroyed, and the map's own
+    // member functions must not be called while the calling thread holds a view of it.
+    class write_view {
+    public:
+      // Returns a pointer to the element mapped to k, or nullptr if there is none.
+      // The element may be modified through the pointer, so its version stamp is advanced.
+      Val *find(const Key &k) {
+        auto it = m_owner->m_map.find(k);
+        if (it == m_owner->m_map.end()) return nullptr;
+        m_owner->record_write(k);
+        return &it->second;
+      }
+
+      // Returns a reference to the element mapped to k. Does bounds checking. The element may
+      // be modified through the reference, so its version stamp is advanced.
+      Val &at(const Key &k) {
+        auto &element = m_owner->m_map.at(k);
+        m_owner->record_write(k);
+        return element;
+      }
+
+      bool contains(const Key &k) const { return m_owner->m_map.find(k) != m_owner->m_map.end(); }
+
+      size_type size() const noexcept { return m_owner->m_map.size(); }
+
+      // Returns the underlying map, for reads the view does not wrap, such as iteration.
+      const internal_map_type &map() const noexcept { return m_owner->m_map; }
+
+      // Returns the underlying map for writing. Writes made through it bypass the Bloom
+      // filter, so this throws std::logic_error if the filter is enabled. Every version stamp
+      // is advanced.
+      internal_map_type &mutable_map() {
+        if (m_owner->bloom_filter_enabled()) throw std::logic_error("::concurrency::UnorderedMap::write_view::mutable_map: Bloom filter is enabled");
+        m_owner->record_reset();
+        return m_owner->m_map;
+      }
+
+      template <class M>
+      bool insert_or_assign(const Key &k, M &&obj) {
+        return m_owner->record_insert_or_assign(m_owner->m_map.insert_or_assign(k, std::forward<M>(obj)));
+      }
+
+      template <class... Args>
+      bool try_emplace(const Key &k, Args &&...args) {
+        return m_owner->record_insert(m_owner->m_map.try_emplace(k, std::forward<Args>(args)...));
+      }
+
+      // Inserts obj if k is not present. Otherwise, replaces the element mapped to k with
+      // combine(element, obj). Returns true if obj was inserted.
+      template <class M, class F>
+      bool upsert(const Key &k, M &&obj, F &&combine) {
+        return m_owner->upsert_locked(k, std::forward<M>(obj), combine);
+      }
+
+      size_type erase(const Key &k) {
+        auto const erased = m_owner->m_map.erase(k);
+        for (size_type i = 0; i < erased; ++i) {
+          m_owner->m_filter.remove(m_owner->m_filter_hash(k));
+        }
+        if (erased != 0) m_owner->record_write(k);
+        return erased;
+      }
+
+    private:
+      friend class UnorderedMap;
+
+      explicit write_view(UnorderedMap &owner) : m_owner(&owner), m_lock(owner.lock_for_writing()) {}
+
+      UnorderedMap *m_owner;
+      write_lock m_lock;
+    };
+
+    // Takes the write lock and returns a view that releases it when destroyed.
+    write_view lock() { return write_view(*this); }
+
+    // ------------------------- Asynchronous Operations ------------------------ //
+    // These functions never block on the map's lock. The async_ functions return a
+    // std::future for the operation's result, which is completed at once if the lock is free,
+    // and otherwise by the thread that next unlocks the map. The co_ functions perform the
+    // same operations but return an awaitable, and require C++20 coroutines: co_await runs
+    // the operation at once if the lock is free, and otherwise suspends the coroutine until
+    // a thread unlocking the map resumes it, holding the lock, on that thread. Waiters are
+    // served in the order they queued. See ::concurrency::AsyncSharedMutex.
+    //
+    // The operations bypass flat combining, and take their arguments by value.
+    auto async_insert(value_type value) { return insert_async<false>(std::move(value)); }
+    auto co_insert(value_type value) { return insert_async<true>(std::move(value)); }
+
+    template <class M>
+    auto async_insert_or_assign(Key k, M obj) {
+      return insert_or_assign_async<false>(std::move(k), std::move(obj));
+    }
+    template <class M>
+    auto co_insert_or_assign(Key k, M obj) {
+      return insert_or_assign_async<true>(std::move(k), std::move(obj));
+    }
+
+    auto async_erase(Key key) { return erase_async<false>(std::move(key)); }
+    auto co_erase(Key key) { return erase_async<true>(std::move(key)); }
+
+    // Produces true if an element is mapped to key.
+    auto async_find(Key key) const { return find_async<false>(std::move(key)); }
+    auto co_find(Key key) const { return find_async<true>(std::move(key)); }
+
+    // Produces a copy of the element mapped to key, or throws std::out_of_range.
+    auto async_at(Key key) const { return at_async<false>(std::move(key)); }
+    auto co_at(Key key) const { return at_async<true>(std::move(key)); }
+
+    // ------------------------------- Snapshots -------------------------------- //
+    // Writes the map to a binary snapshot file at path, replacing any file there once the
+    // new one is complete. The elements are copied out under the read lock, and written
+    // after it is released. Key and Val must be trivially copyable. Throws std::system_error
+    // if the file cannot be written. See ::concurrency::MappedSnapshot for reading a
+    // snapshot without loading it.
+    void save(const std::string &path) const {
+      detail::write_snapshot<Key, Val>(path, 1, [](auto &&f) { f(0); }, [this](uint32_t) { return encode_snapshot(); });
+    }
+
+    // Replaces the contents of the map with those of the snapshot at path, which must have
+    // been written with the same Key, Val, and Hash. Throws std::runtime_error if it was not,
+    // or std::system_error if it cannot be read.
+    void load(const std::string &path) {
+      snapshot_type snapshot(path, hash_function(), key_eq());
+      internal_map_type loaded;
+      loaded.reserve(snapshot.size());
+      snapshot.for_each([&loaded](const Key &k, const Val &v) { loaded.emplace(k, v); });
+      swap(loaded);
     }
 
     // ------------------------------- Observers -------------------------------- //
@@ -303,6 +772,17 @@ namespace concurrency {
     key_equal key_eq() const { return m_map.key_eq(); }
 
   private:
+    template <class, class, uint32_t, class, class, class, template <class...> class>
+    friend class ShardedUnorderedMap;
+
+    // The keys written since change tracking was enabled, each with the clock value of its
+    // latest write, and the clock value of the latest wholesale replacement.
+    struct ChangeLog {
+      std::shared_ptr<std::atomic<uint64_t>> clock{};
+      std::unordered_map<Key, uint64_t, Hash, Pred> written{};
+      uint64_t reset_epoch{0};
+    };
+
     // Returns a locked read_lock that prevents concurrent write access to
     // the underlying map.
     read_lock lock_for_reading() const { return read_lock(m_mutex); }
@@ -311,36 +791,291 @@ namespace concurrency {
     // underlying map.
     write_lock lock_for_writing() const { return write_lock(m_mutex); }
 
+    // Calls f() while holding the write lock, or hands it to the thread that is
+    // combining writes if flat combining is enabled, and returns its result.
+    template <class F>
+    auto apply_write(F &&f) {
+      return m_combiner.apply(m_mutex, std::forward<F>(f));
+    }
+
+    // Returns an operation that calls f() once the lock is held, exclusively or shared: an
+    // awaitable if Awaitable, and otherwise a std::future. See the asynchronous operations
+    // above.
+    template <bool Awaitable, class F>
+    auto make_async(bool exclusive, F &&f) const {
+      if constexpr (Awaitable) {
+        return AsyncLockOperation<std::decay_t<F>>(m_mutex, exclusive, std::forward<F>(f));
+      } else {
+        return lock_async_future(m_mutex, exclusive, std::forward<F>(f));
+      }
+    }
+
+    template <bool Awaitable>
+    auto insert_async(value_type value) {
+      return make_async<Awaitable>(true, [this, value = std::move(value)]() mutable { return record_insert(m_map.insert(std::move(value))); });
+    }
+
+    template <bool Awaitable, class M>
+    auto insert_or_assign_async(Key k, M obj) {
+      return make_async<Awaitable>(true, [this, k = std::move(k), obj = std::move(obj)]() mutable { return record_insert_or_assign(m_map.insert_or_assign(std::move(k), std::move(obj))); });
+    }
+
+    template <bool Awaitable>
+    auto erase_async(Key key) {
+      return make_async<Awaitable>(true, [this, key = std::move(key)]() {
+        auto const erased = m_map.erase(key);
+        for (size_type i = 0; i < erased; ++i) {
+          m_filter.remove(m_filter_hash(key));
+        }
+        if (erased != 0) record_write(key);
+        return erased;
+      });
+    }
+
+    template <bool Awaitable>
+    auto find_async(Key key) const {
+      return make_async<Awaitable>(false, [this, key = std::move(key)]() { return m_map.find(key) != m_map.end(); });
+    }
+
+    template <bool Awaitable>
+    auto at_async(Key key) const {
+      return make_async<Awaitable>(false, [this, key = std::move(key)]() -> Val { return m_map.at(key); });
+    }
+
+    void enable_change_tracking(std::shared_ptr<std::atomic<uint64_t>> clock) {
+      auto lock = lock_for_writing();
+      if (m_changes) return;
+      m_changes              = std::make_unique<ChangeLog>();
+      m_changes->clock       = std::move(clock);
+      m_changes->reset_epoch = m_changes->clock->load(std::memory_order_relaxed);
+    }
+
+    // Returns the clock whose value stamps each logged write. changes_since() advances it
+    // before collecting, so any write it does not see is stamped later than the epoch it
+    // returns. Throws std::logic_error if change tracking is disabled.
+    std::shared_ptr<std::atomic<uint64_t>> change_clock() const {
+      auto lock = lock_for_reading();
+      if (!m_changes) throw std::logic_error("::concurrency::UnorderedMap: change tracking is not enabled");
+      return m_changes->clock;
+    }
+
+    // Returns the changes logged after epoch, under the read lock.
+    typename MapDelta<Key, Val>::Shard collect_changes(uint64_t epoch) const {
+      auto lock = lock_for_reading();
+      if (!m_changes) throw std::logic_error("::concurrency::UnorderedMap: change tracking is not enabled");
+      typename MapDelta<Key, Val>::Shard shard;
+      if (epoch < m_changes->reset_epoch) {
+        shard.reset = true;
+        shard.upserts.assign(m_map.begin(), m_map.end());
+        return shard;
+      }
+      for (auto const &[key, stamp]: m_changes->written) {
+        if (stamp <= epoch) continue;
+        auto it = m_map.find(key);
+        if (it == m_map.end()) {
+          shard.erased.push_back(key);
+        } else {
+          shard.upserts.emplace_back(*it);
+        }
+      }
+      return shard;
+    }
+
+    // Applies changes from a delta whose source map had reset.size() shards, under one write
+    // lock. First erases every key whose source shard was reset, then the erased keys, and
+    // then assigns the upserts.
+    void apply_changes(const std::vector<bool> &reset, const std::vector<const std::pair<Key, Val> *> &upserts, const std::vector<const Key *> &erased) {
+      auto view = lock();
+      if (std::find(reset.begin(), reset.end(), true) != reset.end()) {
+        std::vector<Key> stale;
+        for (auto const &el: view.map()) {
+          if (reset[detail::shard_index_of(m_filter_hash, el.first, reset.size())]) stale.push_back(el.first);
+        }
+        for (auto const &k: stale) {
+          (void) view.erase(k);
+        }
+      }
+      for (auto const *k: erased) {
+        (void) view.erase(*k);
+      }
+      for (auto const *el: upserts) {
+        (void) view.insert_or_assign(el->first, el->second);
+      }
+    }
+
+    // Copies the elements into a snapshot section under the read lock.
+    detail::EncodedSnapshotSection<Key, Val> encode_snapshot() const {
+      auto lock = lock_for_reading();
+      return detail::encode_snapshot_section<Key, Val>(m_map, m_map.hash_function());
+    }
+
+    // Forgets the finished get_or_compute() call for key. Its waiters hold
+    // their own references to the result.
+    void finish_computation(const Key &key) {
+      std::lock_guard<std::mutex> lock(m_in_flight_mutex);
+      m_in_flight.erase(key);
+    }
+
+    // Callers must hold the write lock.
+    template <class M, class F>
+    bool upsert_locked(const Key &k, M &&obj, F &combine) {
+      auto it = m_map.find(k);
+      if (it == m_map.end()) return record_insert(m_map.try_emplace(k, std::forward<M>(obj)));
+      it->second = combine(it->second, obj);
+      record_write(k);
+      return false;
+    }
+
+    // Returns true if the Bloom filter is enabled and key is definitely absent.
+    // Safe to call without holding any lock.
+    bool filter_rejects(const Key &key) const { return m_filter.enabled() && !m_filter.may_contain(m_filter_hash(key)); }
+
+    // Records the insertion of the element at result.first, if one took place: advances its
+    // version stamp, logs it, and adds its key to the Bloom filter, growing the filter if
+    // needed. Returns whether an element was inserted. Callers must hold the write lock.
+    template <class InsertResult>
+    bool record_insert(const InsertResult &result) {
+      if (!result.second) return false;
+      record_write(result.first->first);
+      if (!bloom_filter_enabled()) return true;
+      m_filter.add(m_filter_hash(result.first->first));
+      if (m_filter.needs_growth()) rebuild_filter(m_filter.size() * 2);
+      return true;
+    }
+
+    // As record_insert(), but for insert_or_assign(), which writes the element at
+    // result.first whether or not it was inserted. Callers must hold the write lock.
+    template <class InsertResult>
+    bool record_insert_or_assign(const InsertResult &result) {
+      if (!result.second) record_write(result.first->first);
+      return record_insert(result);
+    }
+
+    // Replaces the Bloom filter's table with one sized for at least expected_elements
+    // and holding every key in the map. Callers must hold the write lock.
+    void rebuild_filter(size_type expected_elements) {
+      m_filter.rebuild(std::max(expected_elements, m_map.size()), m_map.begin(), m_map.end(), [this](auto const &el) { return m_filter_hash(el.first); });
+    }
+
+    // Returns the filter hash of every key in the map, or nothing if the Bloom filter
+    // is disabled. Used with replace_filter_hashes() around operations that replace the
+    // contents of the map wholesale. Callers must hold the write lock.
+    std::vector<std::size_t> filter_hashes() const {
+      std::vector<std::size_t> hashes;
+      if (!bloom_filter_enabled()) return hashes;
+      hashes.reserve(m_map.size());
+      for (auto const &el: m_map) {
+        hashes.push_back(m_filter_hash(el.first));
+      }
+      return hashes;
+    }
+
+    // Adds every key now in the map to the Bloom filter, and only then removes the
+    // displaced hashes, so that concurrent readers never see a false negative for a
+    // key that was present both before and after. Callers must hold the write lock.
+    void replace_filter_hashes(const std::vector<std::size_t> &displaced) {
+      if (!bloom_filter_enabled()) return;
+      if (m_map.size() > m_filter.capacity()) {
+        rebuild_filter(m_map.size() * 2);
+        return;
+      }
+      for (auto const &el: m_map) {
+        m_filter.add(m_filter_hash(el.first));
+      }
+      for (auto const hash: displaced) {
+        m_filter.remove(hash);
+      }
+    }
+
+    // Merges source into the map. Every key in source is added to the Bloom filter up
+    // front, and the keys left behind in source are removed again afterwards.
+    // Callers must hold the write lock.
+    template <class Source>
+    void filter_merge(Source &source) {
+      record_reset();
+      if (!bloom_filter_enabled()) {
+        m_map.merge(source);
+        return;
+      }
+      for (auto const &el: source) {
+        m_filter.add(m_filter_hash(el.first));
+      }
+      m_map.merge(source);
+      for (auto const &el: source) {
+        m_filter.remove(m_filter_hash(el.first));
+      }
+      if (m_filter.needs_growth()) rebuild_filter(m_filter.size() * 2);
+    }
+
+    // Returns the index of the version stamp shared by key. Throws std::logic_error if
+    // versioning is disabled. Callers must hold a lock.
+    std::size_t version_slot(const Key &key) const {
+      if (!m_versions) throw std::logic_error("::concurrency::UnorderedMap: versioning is not enabled");
+      return detail::mix_hash(m_filter_hash(key)) % VersionStampCount;
+    }
+
+    // Records a write to key: advances its version stamp, if versioning is enabled, and
+    // logs it, if change tracking is enabled. Callers must hold the write lock.
+    void record_write(const Key &key) {
+      if (m_versions) ++m_versions[detail::mix_hash(m_filter_hash(key)) % VersionStampCount];
+      if (m_changes) m_changes->written[key] = m_changes->clock->load(std::memory_order_relaxed);
+    }
+
+    // Records an operation that replaced the contents of the map wholesale: advances every
+    // version stamp and, if change tracking is enabled, makes changes_since() report the
+    // whole map to callers that have not seen it since. Callers must hold the write lock.
+    void record_reset() noexcept {
+      if (m_changes) {
+        m_changes->written.clear();
+        m_changes->reset_epoch = m_changes->clock->load(std::memory_order_relaxed);
+      }
+      if (!m_versions) return;
+      for (std::size_t i = 0; i < VersionStampCount; ++i) {
+        ++m_versions[i];
+      }
+    }
+
     mutable mutex_type m_mutex{};
     internal_map_type m_map{};
+    CountingBloomFilter m_filter{};
+    FlatCombiner<> m_combiner{};
+    hasher m_filter_hash{};
+    std::unique_ptr<uint64_t[]> m_versions{};
+    std::unique_ptr<ChangeLog> m_changes{};
+    std::mutex m_in_flight_mutex{};
+    std::unordered_map<Key, std::shared_future<Val>, Hash, Pred> m_in_flight{};
   };
 
-  template <class Key, class T, class Hash, class KeyEqual, class Alloc>
-  bool operator==(const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc> &rhs) {
+  template <class Key, class T, class Hash, class KeyEqual, class Alloc, template <class...> class InternalMap>
+  bool operator==(const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc, InternalMap> &lhs, const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc, InternalMap> &rhs) {
     return lhs.data() == rhs.data();
   }
 
-  template <class Key, class T, class Hash, class KeyEqual, class Alloc>
-  bool operator!=(const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc> &rhs) {
+  template <class Key, class T, class Hash, class KeyEqual, class Alloc, template <class...> class InternalMap>
+  bool operator!=(const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc, InternalMap> &lhs, const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc, InternalMap> &rhs) {
     return !(lhs == rhs);
   }
 
-  template <class Key, class T, class Hash, class KeyEqual, class Alloc>
-  bool operator==(const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc> &&rhs) {
+  template <class Key, class T, class Hash, class KeyEqual, class Alloc, template <class...> class InternalMap>
+  bool operator==(const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc, InternalMap> &lhs, const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc, InternalMap> &&rhs) {
     return lhs.data() == rhs.data();
   }
 
-  template <class Key, class T, class Hash, class KeyEqual, class Alloc>
-  bool operator!=(const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc> &&rhs) {
+  template <class Key, class T, class Hash, class KeyEqual, class Alloc, template <class...> class InternalMap>
+  bool operator!=(const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc, InternalMap> &lhs, const ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc, InternalMap> &&rhs) {
     return !(lhs == rhs);
   }
 
   // Specializes the std::swap algorithm for ::concurrency::UnorderedMap. Swaps the contents of lhs and rhs. Calls lhs.swap(rhs).
-  template <class Key, class T, class Hash, class KeyEqual, class Alloc>
-  void swap(::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc> &lhs, ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc> &rhs) noexcept {
+  template <class Key, class T, class Hash, class KeyEqual, class Alloc, template <class...> class InternalMap>
+  void swap(::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc, InternalMap> &lhs, ::concurrency::UnorderedMap<Key, T, Hash, KeyEqual, Alloc, InternalMap> &rhs) noexcept {
     lhs.swap(rhs);
   }
 
+  // A ::concurrency::UnorderedMap backed by a ::concurrency::FlatHashMap rather than a std::unordered_map.
+  template <class Key, class Val, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>, class Allocator = std::allocator<std::pair<const Key, Val>>>
+  using FlatUnorderedMap = UnorderedMap<Key, Val, Hash, Pred, Allocator, FlatHashMap>;
+
 } // namespace concurrency
 
 #endif // UNORDERED_CONCURRENT_MAP_H
\ No newline at end of file
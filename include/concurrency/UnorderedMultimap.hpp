@@ -0,0 +1,277 @@
+#ifndef UNORDERED_CONCURRENT_MULTIMAP_H
+#define UNORDERED_CONCURRENT_MULTIMAP_H
+
+#include <initializer_list>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace concurrency {
+
+  // This class provides a thread-safe unordered multimap with most of the same functionality as
+  // std::unordered_multimap, guarded by a single reader-writer lock in the same way as
+  // ::concurrency::UnorderedMap. Iterator access has been removed in order to preserve
+  // thread-safety, so the values mapped to a key are reached through visit_all() and
+  // erase_one() rather than equal_range(), without being copied out of the map.
+  //
+  // Functions which behave differently than their std::unordered_multimap counterpart of the
+  // same name are documented with comments, as are functions that do not exist for
+  // std::unordered_multimap.
+  //
+  // https://en.cppreference.com/w/cpp/container/unordered_multimap
+  template <class Key,
+            class Val,
+            class Hash      = std::hash<Key>,
+            class Pred      = std::equal_to<Key>,
+            class Allocator = std::allocator<std::pair<const Key, Val>>>
+  class UnorderedMultimap {
+  public:
+    // ------------------------------ Member types ------------------------------ //
+    using mutex_type        = std::shared_mutex;
+    using read_lock         = std::shared_lock<mutex_type>;
+    using write_lock        = std::unique_lock<mutex_type>;
+    using self_type         = UnorderedMultimap<Key, Val, Hash, Pred, Allocator>;
+    using internal_map_type = std::unordered_multimap<Key, Val, Hash, Pred, Allocator>;
+    using key_type          = typename internal_map_type::key_type;
+    using mapped_type       = typename internal_map_type::mapped_type;
+    using value_type        = typename internal_map_type::value_type;
+    using size_type         = typename internal_map_type::size_type;
+    using difference_type   = typename internal_map_type::difference_type;
+    using hasher            = typename internal_map_type::hasher;
+    using key_equal         = typename internal_map_type::key_equal;
+    using allocator_type    = typename internal_map_type::allocator_type;
+    using node_type         = typename internal_map_type::node_type;
+
+    // ------------------------------ Constructors ------------------------------ //
+    UnorderedMultimap() = default;
+    UnorderedMultimap(const UnorderedMultimap &other) : m_map(other.data()) {}
+    UnorderedMultimap(UnorderedMultimap &&other) : m_map(other.data()) {}
+    UnorderedMultimap(std::initializer_list<value_type> ilist) : m_map(ilist) {}
+
+    UnorderedMultimap &operator=(const UnorderedMultimap &other) {
+      auto copy = other.data();
+      auto lock = lock_for_writing();
+      m_map     = std::move(copy);
+      return *this;
+    }
+    UnorderedMultimap &operator=(UnorderedMultimap &&other) {
+      auto copy = other.data();
+      auto lock = lock_for_writing();
+      m_map     = std::move(copy);
+      return *this;
+    }
+    UnorderedMultimap &operator=(std::initializer_list<value_type> ilist) {
+      this->insert(ilist);
+      return *this;
+    }
+
+    ~UnorderedMultimap() = default;
+
+    allocator_type get_allocator() const { return m_map.get_allocator(); }
+
+    // -------------------------------- Capacity -------------------------------- //
+    bool empty() const noexcept {
+      auto lock = lock_for_reading();
+      return m_map.empty();
+    }
+
+    size_type size() const noexcept {
+      auto lock = lock_for_reading();
+      return m_map.size();
+    }
+
+    size_type max_size() const noexcept { return m_map.max_size(); }
+
+    // ------------------------------- Modifiers -------------------------------- //
+    void clear() noexcept {
+      auto lock = lock_for_writing();
+      m_map.clear();
+    }
+
+    // Always inserts, as with std::unordered_multimap, and returns nothing.
+    void insert(const value_type &value) {
+      auto lock = lock_for_writing();
+      m_map.insert(value);
+    }
+    void insert(value_type &&value) {
+      auto lock = lock_for_writing();
+      m_map.insert(std::move(value));
+    }
+    template <class P>
+    void insert(P &&value) {
+      auto lock = lock_for_writing();
+      m_map.insert(std::forward<P>(value));
+    }
+    void insert(std::initializer_list<value_type> ilist) {
+      auto lock = lock_for_writing();
+      m_map.insert(ilist);
+    }
+    // Inserts every element in [first, last) while holding the lock once.
+    template <class InputIt>
+    void insert(InputIt first, InputIt last) {
+      auto lock = lock_for_writing();
+      m_map.insert(first, last);
+    }
+    void insert(node_type &&nh) {
+      auto lock = lock_for_writing();
+      m_map.insert(std::move(nh));
+    }
+
+    template <class... Args>
+    void emplace(Args &&...args) {
+      auto lock = lock_for_writing();
+      m_map.emplace(std::forward<Args>(args)...);
+    }
+
+    // Removes every value mapped to key and returns the number removed.
+    size_type erase(const Key &key) {
+      auto lock = lock_for_writing();
+      return m_map.erase(key);
+    }
+
+    // Removes the first value mapped to key for which pred(value) returns true, and returns
+    // a bool indicating whether one was removed. pred is called while holding the write lock
+    // and must not access the multimap.
+    template <class P>
+    bool erase_one(const Key &key, P &&pred) {
+      auto lock  = lock_for_writing();
+      auto range = m_map.equal_range(key);
+      for (auto it = range.first; it != range.second; ++it) {
+        if (pred(static_cast<const Val &>(it->second))) {
+          m_map.erase(it);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void swap(self_type &other) noexcept {
+      if (this == &other) return;
+      auto lhs_lock = this->lock_for_writing();
+      auto rhs_lock = other.lock_for_writing();
+      this->m_map.swap(other.m_map);
+    }
+
+    void swap(internal_map_type &other) noexcept {
+      auto lock = lock_for_writing();
+      m_map.swap(other);
+    }
+
+    // Extracts one of the elements mapped to k.
+    node_type extract(const Key &k) {
+      auto lock = lock_for_writing();
+      return m_map.extract(k);
+    }
+
+    void merge(internal_map_type &source) {
+      auto lock = lock_for_writing();
+      m_map.merge(source);
+    }
+    void merge(internal_map_type &&source) {
+      auto lock = lock_for_writing();
+      m_map.merge(source);
+    }
+
+    // --------------------------------- Lookup --------------------------------- //
+    // Returns the number of values mapped to key.
+    size_type count(const Key &key) const {
+      auto lock = lock_for_reading();
+      return m_map.count(key);
+    }
+
+    // Returns a bool indicating whether or not any value
+    // is mapped to the provided key.
+    bool find(const Key &key) const {
+      auto lock = lock_for_reading();
+      return m_map.find(key) != m_map.end();
+    }
+
+    bool contains(const Key &key) const { return find(key); }
+
+    // Calls f(const Val &) for every value mapped to key, in no particular order, and returns
+    // the number of values visited. f is called while holding the read lock, so it may run
+    // concurrently with other readers and must not access the multimap.
+    template <class F>
+    size_type visit_all(const Key &key, F &&f) const {
+      auto lock   = lock_for_reading();
+      auto range  = m_map.equal_range(key);
+      size_type n = 0;
+      for (auto it = range.first; it != range.second; ++it, ++n) {
+        f(static_cast<const Val &>(it->second));
+      }
+      return n;
+    }
+
+    // Returns a non-thread-safe copy of the underlying multimap.
+    internal_map_type data() const {
+      auto lock = lock_for_reading();
+      return m_map;
+    }
+
+    // --------------------------- Bucket Interface ----------------------------- //
+    size_type bucket_count() const {
+      auto lock = lock_for_reading();
+      return m_map.bucket_count();
+    }
+
+    size_type max_bucket_count() const { return m_map.max_bucket_count(); }
+
+    // ------------------------------ Hash Policy ------------------------------- //
+    float load_factor() const {
+      auto lock = lock_for_reading();
+      return m_map.load_factor();
+    }
+
+    float max_load_factor() const {
+      auto lock = lock_for_reading();
+      return m_map.max_load_factor();
+    }
+
+    void max_load_factor(float ml) {
+      auto lock = lock_for_writing();
+      m_map.max_load_factor(ml);
+    }
+
+    void rehash(size_type count) {
+      auto lock = lock_for_writing();
+      m_map.rehash(count);
+    }
+
+    void reserve(size_type count) {
+      auto lock = lock_for_writing();
+      m_map.reserve(count);
+    }
+
+    // ------------------------------- Observers -------------------------------- //
+    hasher hash_function() const { return m_map.hash_function(); }
+
+    key_equal key_eq() const { return m_map.key_eq(); }
+
+  private:
+    read_lock lock_for_reading() const { return read_lock(m_mutex); }
+    write_lock lock_for_writing() const { return write_lock(m_mutex); }
+
+    mutable mutex_type m_mutex{};
+    internal_map_type m_map{};
+  };
+
+  template <class Key, class T, class Hash, class KeyEqual, class Alloc>
+  bool operator==(const ::concurrency::UnorderedMultimap<Key, T, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::UnorderedMultimap<Key, T, Hash, KeyEqual, Alloc> &rhs) {
+    return lhs.data() == rhs.data();
+  }
+
+  template <class Key, class T, class Hash, class KeyEqual, class Alloc>
+  bool operator!=(const ::concurrency::UnorderedMultimap<Key, T, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::UnorderedMultimap<Key, T, Hash, KeyEqual, Alloc> &rhs) {
+    return !(lhs == rhs);
+  }
+
+  // Specializes the std::swap algorithm for ::concurrency::UnorderedMultimap. Swaps the contents of lhs and rhs. Calls lhs.swap(rhs).
+  template <class Key, class T, class Hash, class KeyEqual, class Alloc>
+  void swap(::concurrency::UnorderedMultimap<Key, T, Hash, KeyEqual, Alloc> &lhs, ::concurrency::UnorderedMultimap<Key, T, Hash, KeyEqual, Alloc> &rhs) noexcept {
+    lhs.swap(rhs);
+  }
+
+} // namespace concurrency
+
+#endif // UNORDERED_CONCURRENT_MULTIMAP_H
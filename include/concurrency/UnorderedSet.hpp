@@ -0,0 +1,256 @@
+#ifndef UNORDERED_CONCURRENT_SET_H
+#define UNORDERED_CONCURRENT_SET_H
+
+#include <initializer_list>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_set>
+
+namespace concurrency {
+
+  // This class provides a thread-safe unordered set with most of the same functionality as
+  // std::unordered_set, guarded by a single reader-writer lock in the same way as
+  // ::concurrency::UnorderedMap. Iterator access has been removed in order to preserve
+  // thread-safety, and find() returns a bool rather than an iterator.
+  //
+  // Functions which behave differently than their std::unordered_set counterpart of the same
+  // name are documented with comments, as are functions that do not exist for
+  // std::unordered_set. insert_many() and contains_many() apply a whole range of keys under a
+  // single acquisition of the lock.
+  //
+  // https://en.cppreference.com/w/cpp/container/unordered_set
+  template <class Key, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>, class Allocator = std::allocator<Key>>
+  class UnorderedSet {
+  public:
+    // ------------------------------ Member types ------------------------------ //
+    using mutex_type        = std::shared_mutex;
+    using read_lock         = std::shared_lock<mutex_type>;
+    using write_lock        = std::unique_lock<mutex_type>;
+    using self_type         = UnorderedSet<Key, Hash, Pred, Allocator>;
+    using internal_set_type = std::unordered_set<Key, Hash, Pred, Allocator>;
+    using key_type          = typename internal_set_type::key_type;
+    using value_type        = typename internal_set_type::value_type;
+    using size_type         = typename internal_set_type::size_type;
+    using difference_type   = typename internal_set_type::difference_type;
+    using hasher            = typename internal_set_type::hasher;
+    using key_equal         = typename internal_set_type::key_equal;
+    using allocator_type    = typename internal_set_type::allocator_type;
+    using node_type         = typename internal_set_type::node_type;
+
+    // ------------------------------ Constructors ------------------------------ //
+    UnorderedSet() = default;
+    UnorderedSet(const UnorderedSet &other) : m_set(other.data()) {}
+    UnorderedSet(UnorderedSet &&other) : m_set(other.data()) {}
+    UnorderedSet(std::initializer_list<value_type> ilist) : m_set(ilist) {}
+
+    UnorderedSet &operator=(const UnorderedSet &other) {
+      auto copy = other.data();
+      auto lock = lock_for_writing();
+      m_set     = std::move(copy);
+      return *this;
+    }
+    UnorderedSet &operator=(UnorderedSet &&other) {
+      auto copy = other.data();
+      auto lock = lock_for_writing();
+      m_set     = std::move(copy);
+      return *this;
+    }
+    UnorderedSet &operator=(std::initializer_list<value_type> ilist) {
+      this->insert(ilist);
+      return *this;
+    }
+
+    ~UnorderedSet() = default;
+
+    allocator_type get_allocator() const { return m_set.get_allocator(); }
+
+    // -------------------------------- Capacity -------------------------------- //
+    bool empty() const noexcept {
+      auto lock = lock_for_reading();
+      return m_set.empty();
+    }
+
+    size_type size() const noexcept {
+      auto lock = lock_for_reading();
+      return m_set.size();
+    }
+
+    size_type max_size() const noexcept { return m_set.max_size(); }
+
+    // ------------------------------- Modifiers -------------------------------- //
+    void clear() noexcept {
+      auto lock = lock_for_writing();
+      m_set.clear();
+    }
+
+    // Returns a bool indicating whether or not the key was inserted.
+    bool insert(const value_type &value) {
+      auto lock = lock_for_writing();
+      return m_set.insert(value).second;
+    }
+    // Returns a bool indicating whether or not the key was inserted.
+    bool insert(value_type &&value) {
+      auto lock = lock_for_writing();
+      return m_set.insert(std::move(value)).second;
+    }
+    void insert(std::initializer_list<value_type> ilist) {
+      auto lock = lock_for_writing();
+      m_set.insert(ilist);
+    }
+    template <class InputIt>
+    void insert(InputIt first, InputIt last) {
+      (void) insert_many(first, last);
+    }
+    // Returns a bool indicating whether or not the node's key was inserted.
+    bool insert(node_type &&nh) {
+      auto lock = lock_for_writing();
+      return m_set.insert(std::move(nh)).inserted;
+    }
+
+    // Inserts every key in [first, last) while holding the lock once, and returns the
+    // number of keys that were not already present.
+    template <class InputIt>
+    size_type insert_many(InputIt first, InputIt last) {
+      auto lock         = lock_for_writing();
+      size_type const n = m_set.size();
+      m_set.insert(first, last);
+      return m_set.size() - n;
+    }
+
+    // Returns a bool indicating whether or not the key was inserted.
+    template <class... Args>
+    bool emplace(Args &&...args) {
+      auto lock = lock_for_writing();
+      return m_set.emplace(std::forward<Args>(args)...).second;
+    }
+
+    size_type erase(const Key &key) {
+      auto lock = lock_for_writing();
+      return m_set.erase(key);
+    }
+
+    void swap(self_type &other) noexcept {
+      if (this == &other) return;
+      auto lhs_lock = this->lock_for_writing();
+      auto rhs_lock = other.lock_for_writing();
+      this->m_set.swap(other.m_set);
+    }
+
+    void swap(internal_set_type &other) noexcept {
+      auto lock = lock_for_writing();
+      m_set.swap(other);
+    }
+
+    node_type extract(const Key &k) {
+      auto lock = lock_for_writing();
+      return m_set.extract(k);
+    }
+
+    void merge(internal_set_type &source) {
+      auto lock = lock_for_writing();
+      m_set.merge(source);
+    }
+    void merge(internal_set_type &&source) {
+      auto lock = lock_for_writing();
+      m_set.merge(source);
+    }
+
+    // --------------------------------- Lookup --------------------------------- //
+    size_type count(const Key &key) const {
+      auto lock = lock_for_reading();
+      return m_set.count(key);
+    }
+
+    // Returns a bool indicating whether or not the
+    // provided key is present in the set.
+    bool find(const Key &key) const {
+      auto lock = lock_for_reading();
+      return m_set.find(key) != m_set.end();
+    }
+
+    bool contains(const Key &key) const { return find(key); }
+
+    // Writes, to the range beginning at d_first, a bool for every key in [first, last)
+    // indicating whether it is present, while holding the lock once. Returns an
+    // iterator past the last bool written.
+    template <class InputIt, class OutputIt>
+    OutputIt contains_many(InputIt first, InputIt last, OutputIt d_first) const {
+      auto lock = lock_for_reading();
+      for (; first != last; ++first, ++d_first) {
+        *d_first = m_set.find(static_cast<const Key &>(*first)) != m_set.end();
+      }
+      return d_first;
+    }
+
+    // Returns a non-thread-safe copy of the underlying set.
+    internal_set_type data() const {
+      auto lock = lock_for_reading();
+      return m_set;
+    }
+
+    // --------------------------- Bucket Interface ----------------------------- //
+    size_type bucket_count() const {
+      auto lock = lock_for_reading();
+      return m_set.bucket_count();
+    }
+
+    size_type max_bucket_count() const { return m_set.max_bucket_count(); }
+
+    // ------------------------------ Hash Policy ------------------------------- //
+    float load_factor() const {
+      auto lock = lock_for_reading();
+      return m_set.load_factor();
+    }
+
+    float max_load_factor() const {
+      auto lock = lock_for_reading();
+      return m_set.max_load_factor();
+    }
+
+    void max_load_factor(float ml) {
+      auto lock = lock_for_writing();
+      m_set.max_load_factor(ml);
+    }
+
+    void rehash(size_type count) {
+      auto lock = lock_for_writing();
+      m_set.rehash(count);
+    }
+
+    void reserve(size_type count) {
+      auto lock = lock_for_writing();
+      m_set.reserve(count);
+    }
+
+    // ------------------------------- Observers -------------------------------- //
+    hasher hash_function() const { return m_set.hash_function(); }
+
+    key_equal key_eq() const { return m_set.key_eq(); }
+
+  private:
+    read_lock lock_for_reading() const { return read_lock(m_mutex); }
+    write_lock lock_for_writing() const { return write_lock(m_mutex); }
+
+    mutable mutex_type m_mutex{};
+    internal_set_type m_set{};
+  };
+
+  template <class Key, class Hash, class KeyEqual, class Alloc>
+  bool operator==(const ::concurrency::UnorderedSet<Key, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::UnorderedSet<Key, Hash, KeyEqual, Alloc> &rhs) {
+    return lhs.data() == rhs.data();
+  }
+
+  template <class Key, class Hash, class KeyEqual, class Alloc>
+  bool operator!=(const ::concurrency::UnorderedSet<Key, Hash, KeyEqual, Alloc> &lhs, const ::concurrency::UnorderedSet<Key, Hash, KeyEqual, Alloc> &rhs) {
+    return !(lhs == rhs);
+  }
+
+  // Specializes the std::swap algorithm for ::concurrency::UnorderedSet. Swaps the contents of lhs and rhs. Calls lhs.swap(rhs).
+  template <class Key, class Hash, class KeyEqual, class Alloc>
+  void swap(::concurrency::UnorderedSet<Key, Hash, KeyEqual, Alloc> &lhs, ::concurrency::UnorderedSet<Key, Hash, KeyEqual, Alloc> &rhs) noexcept {
+    lhs.swap(rhs);
+  }
+
+} // namespace concurrency
+
+#endif // UNORDERED_CONCURRENT_SET_H
@@ -0,0 +1,218 @@
+#ifndef WRITE_BEHIND_CACHE_H
+#define WRITE_BEHIND_CACHE_H
+
+#include <concurrency/ShardedUnorderedMap.hpp>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace concurrency {
+  constexpr std::size_t DefaultWriteBehindMaxDirty = 1024;
+  constexpr std::chrono::milliseconds DefaultWriteBehindFlushInterval{10};
+
+  // This class provides a read-through, write-behind cache in front of a backing store, kept
+  // in a ::concurrency::ShardedUnorderedMap. Store must provide
+  //
+  //   std::optional<Val> load(const Key &key);
+  //   void write(const std::vector<std::pair<Key, Val>> &batch);
+  //
+  // and is never called with a lock on the cache held. ::concurrency::InMemoryStore is an
+  // in-process stand-in.
+  //
+  // get() loads missing keys through Store::load(), with concurrent misses on the same key
+  // sharing one load (see UnorderedMap::get_or_compute). put() updates the cache at once and
+  // marks the key dirty in its shard's write queue, where later writes to the same key replace
+  // earlier ones. A background thread writes each shard's dirty entries to the store in one
+  // batch every flush interval, or sooner once a shard holds max_dirty dirty keys. Writers
+  // block while their shard's queue is full, which bounds memory when the store falls behind.
+  //
+  // Batches that fail are requeued, behind any newer writes to the same keys, and retried on
+  // the next flush; the first failure is rethrown by the next call to flush(). The cache never
+  // evicts, so every key loaded or written stays cached until the cache is destroyed, which
+  // flushes once more and discards any error.
+  template <class Key,
+            class Val,
+            class Store,
+            uint32_t ShardCount = DefaultUnorderedMapShardCount,
+            class Hash          = std::hash<Key>,
+            class Pred          = std::equal_to<Key>>
+  class WriteBehindCache {
+  public:
+    using key_type    = Key;
+    using mapped_type = Val;
+    using size_type   = std::size_t;
+    using store_type  = Store;
+    using map_type    = ShardedUnorderedMap<Key, Val, ShardCount, Hash, Pred>;
+
+  private:
+    struct alignas(64) WriteQueue {
+      // Held while updating both the cache and the queue, so that they agree on the
+      // order of writes to each key.
+      std::mutex mutex{};
+      std::condition_variable not_full{};
+      std::unordered_map<Key, Val, Hash, Pred> dirty{};
+      // Held while a batch is taken from the queue and written, so that the batches
+      // of a shard reach the store in order.
+      std::mutex write_mutex{};
+    };
+
+  public:
+    // ------------------------------ Constructors ------------------------------ //
+    // Starts the background writer. store must outlive the cache.
+    explicit WriteBehindCache(Store &store, size_type max_dirty = DefaultWriteBehindMaxDirty, std::chrono::milliseconds flush_interval = DefaultWriteBehindFlushInterval)
+        : m_store(store), m_max_dirty(max_dirty == 0 ? 1 : max_dirty), m_flush_interval(flush_interval), m_flusher(&WriteBehindCache::run_flusher, this) {}
+
+    WriteBehindCache(const WriteBehindCache &)            = delete;
+    WriteBehindCache &operator=(const WriteBehindCache &) = delete;
+
+    ~WriteBehindCache() {
+      {
+        std::lock_guard<std::mutex> lock(m_flusher_mutex);
+        m_stopping = true;
+      }
+      m_wakeup.notify_one();
+      m_flusher.join();
+      for (auto &queue: m_queues) {
+        write_queue(queue);
+      }
+    }
+
+    // --------------------------------- Lookup --------------------------------- //
+    // Returns a copy of the value for key, loading it from the store if it is not cached.
+    // Throws std::out_of_range if the store has no value for key, and propagates exceptions
+    // thrown by the store; neither outcome is cached.
+    Val get(const Key &key) {
+      return m_cache.get_or_compute(key, [this, &key]() {
+        auto loaded = m_store.load(key);
+        if (!loaded) throw std::out_of_range("::concurrency::WriteBehindCache::get: key not found");
+        return std::move(*loaded);
+      });
+    }
+
+    // Returns true if key is cached, without consulting the store.
+    bool cached(const Key &key) const { return m_cache.find(key); }
+
+    // ------------------------------- Modifiers -------------------------------- //
+    // Caches obj for k and queues it to be written to the store. Blocks while k's shard
+    // has max_dirty other keys waiting to be written.
+    template <class M>
+    void put(const Key &k, M &&obj) {
+      auto &queue = m_queues[get_shard_idx(k)];
+      std::unique_lock<std::mutex> lock(queue.mutex);
+      if (queue.dirty.size() >= m_max_dirty && queue.dirty.find(k) == queue.dirty.end()) {
+        request_flush();
+        queue.not_full.wait(lock, [&]() { return queue.dirty.size() < m_max_dirty || queue.dirty.find(k) != queue.dirty.end(); });
+      }
+      (void) m_cache.insert_or_assign(k, obj);
+      queue.dirty.insert_or_assign(k, std::forward<M>(obj));
+      if (queue.dirty.size() >= m_max_dirty) request_flush();
+    }
+
+    // Writes every dirty entry to the store, shard by shard, and returns once the writes
+    // queued before the call have been attempted. Rethrows the first store failure since
+    // the previous call to flush(), if any.
+    void flush() {
+      for (auto &queue: m_queues) {
+        write_queue(queue);
+      }
+      std::exception_ptr error;
+      {
+        std::lock_guard<std::mutex> lock(m_error_mutex);
+        std::swap(error, m_error);
+      }
+      if (error) std::rethrow_exception(error);
+    }
+
+    // Returns the number of keys waiting to be written.
+    size_type dirty() const {
+      size_type n = 0;
+      for (auto &queue: m_queues) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        n += queue.dirty.size();
+      }
+      return n;
+    }
+
+    // ---------------------------------- Misc ---------------------------------- //
+    // Returns the underlying cache, which may be read directly. Writing to it bypasses the store.
+    map_type &cache() noexcept { return m_cache; }
+
+  private:
+    // Takes the queue's dirty entries and writes them to the store as one batch. If the
+    // store throws, the entries are requeued unless they have been rewritten meanwhile.
+    void write_queue(WriteQueue &queue) {
+      std::lock_guard<std::mutex> write_lock(queue.write_mutex);
+      std::vector<std::pair<Key, Val>> batch;
+      {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.dirty.empty()) return;
+        batch.reserve(queue.dirty.size());
+        for (auto &el: queue.dirty) {
+          batch.emplace_back(el.first, std::move(el.second));
+        }
+        queue.dirty.clear();
+      }
+      queue.not_full.notify_all();
+      try {
+        m_store.write(batch);
+      } catch (...) {
+        {
+          std::lock_guard<std::mutex> lock(m_error_mutex);
+          if (!m_error) m_error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (auto &el: batch) {
+          queue.dirty.try_emplace(std::move(el.first), std::move(el.second));
+        }
+      }
+    }
+
+    void request_flush() {
+      {
+        std::lock_guard<std::mutex> lock(m_flusher_mutex);
+        m_flush_requested = true;
+      }
+      m_wakeup.notify_one();
+    }
+
+    void run_flusher() {
+      std::unique_lock<std::mutex> lock(m_flusher_mutex);
+      while (!m_stopping) {
+        m_wakeup.wait_for(lock, m_flush_interval, [this]() { return m_stopping || m_flush_requested; });
+        m_flush_requested = false;
+        lock.unlock();
+        for (auto &queue: m_queues) {
+          write_queue(queue);
+        }
+        lock.lock();
+      }
+    }
+
+    uint32_t get_shard_idx(const Key &key) const { return m_cache.hash_function()(key) % ShardCount; }
+
+    Store &m_store;
+    size_type const m_max_dirty;
+    std::chrono::milliseconds const m_flush_interval;
+    map_type m_cache{};
+    mutable std::array<WriteQueue, ShardCount> m_queues{};
+    std::mutex m_error_mutex{};
+    std::exception_ptr m_error{};
+    std::mutex m_flusher_mutex{};
+    std::condition_variable m_wakeup{};
+    bool m_stopping{false};
+    bool m_flush_requested{false};
+    std::thread m_flusher;
+  };
+
+} // namespace concurrency
+
+#endif // WRITE_BEHIND_CACHE_H
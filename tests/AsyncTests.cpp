@@ -0,0 +1,218 @@
+#include <concurrency/ShardedUnorderedMap.hpp>
+#include <concurrency/UnorderedMap.hpp>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+  using ::concurrency::ShardedUnorderedMap;
+  using ::concurrency::UnorderedMap;
+
+  // Calls the asynchronous operations that return a std::future.
+  struct Futures {
+    template <class Map>
+    static auto insert(Map &m, typename Map::value_type value) {
+      return m.async_insert(std::move(value));
+    }
+    template <class Map, class M>
+    static auto insert_or_assign(Map &m, typename Map::key_type k, M obj) {
+      return m.async_insert_or_assign(std::move(k), std::move(obj));
+    }
+    template <class Map>
+    static auto erase(Map &m, typename Map::key_type key) {
+      return m.async_erase(std::move(key));
+    }
+    template <class Map>
+    static auto find(const Map &m, typename Map::key_type key) {
+      return m.async_find(std::move(key));
+    }
+    template <class Map>
+    static auto at(const Map &m, typename Map::key_type key) {
+      return m.async_at(std::move(key));
+    }
+  };
+
+#ifdef CONCURRENCY_COROUTINES
+  // A coroutine that starts at once and destroys itself when it finishes.
+  struct Detached {
+    struct promise_type {
+      Detached get_return_object() { return {}; }
+      std::suspend_never initial_suspend() noexcept { return {}; }
+      std::suspend_never final_suspend() noexcept { return {}; }
+      void return_void() {}
+      void unhandled_exception() { std::terminate(); }
+    };
+  };
+
+  template <class Make, class R>
+  Detached await_into(Make make, std::promise<R> promise) {
+    try {
+      promise.set_value(co_await make());
+    } catch (...) {
+      promise.set_exception(std::current_exception());
+    }
+  }
+
+  // Awaits make() in a coroutine and returns a future for the result.
+  template <class Make>
+  auto run_async(Make make) {
+    using result_type = decltype(std::declval<decltype(make())>().await_resume());
+    std::promise<result_type> promise;
+    auto future = promise.get_future();
+    (void) await_into(make, std::move(promise));
+    return future;
+  }
+
+  // Awaits the asynchronous operations that return an awaitable, each in its own coroutine.
+  struct Awaitables {
+    template <class Map>
+    static auto insert(Map &m, typename Map::value_type value) {
+      return run_async([&]() { return m.co_insert(std::move(value)); });
+    }
+    template <class Map, class M>
+    static auto insert_or_assign(Map &m, typename Map::key_type k, M obj) {
+      return run_async([&]() { return m.co_insert_or_assign(std::move(k), std::move(obj)); });
+    }
+    template <class Map>
+    static auto erase(Map &m, typename Map::key_type key) {
+      return run_async([&]() { return m.co_erase(std::move(key)); });
+    }
+    template <class Map>
+    static auto find(const Map &m, typename Map::key_type key) {
+      return run_async([&]() { return m.co_find(std::move(key)); });
+    }
+    template <class Map>
+    static auto at(const Map &m, typename Map::key_type key) {
+      return run_async([&]() { return m.co_at(std::move(key)); });
+    }
+  };
+
+  using AsyncModes = ::testing::Types<Futures, Awaitables>;
+#else
+  using AsyncModes = ::testing::Types<Futures>;
+#endif
+
+  template <class Future>
+  bool is_ready(const Future &future) {
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  }
+
+  template <class T>
+  class AsyncTests : public ::testing::Test {};
+  TYPED_TEST_SUITE(AsyncTests, AsyncModes);
+
+  TYPED_TEST(AsyncTests, UncontendedOperationsCompleteAtOnce) {
+    UnorderedMap<int, std::string> m;
+    auto inserted = TypeParam::insert(m, {1, "one"});
+    ASSERT_TRUE(is_ready(inserted));
+    ASSERT_TRUE(inserted.get());
+    ASSERT_FALSE(TypeParam::insert_or_assign(m, 1, std::string("uno")).get());
+    ASSERT_TRUE(TypeParam::find(m, 1).get());
+    ASSERT_EQ("uno", TypeParam::at(m, 1).get());
+    ASSERT_EQ(1, TypeParam::erase(m, 1).get());
+    ASSERT_FALSE(TypeParam::find(m, 1).get());
+    auto missing = TypeParam::at(m, 1);
+    ASSERT_THROW((void) missing.get(), std::out_of_range);
+  }
+
+  TYPED_TEST(AsyncTests, WaitersRunInOrderWhenTheLockIsReleased) {
+    UnorderedMap<int, std::string> m{{1, "one"}};
+    m.enable_versioning();
+    auto const before = m.find_versioned(1)->version;
+    std::future<bool> assigned;
+    std::future<std::string> read;
+    std::future<std::size_t> erased;
+    {
+      auto view = m.lock();
+      assigned  = TypeParam::insert_or_assign(m, 1, std::string("uno"));
+      read      = TypeParam::at(m, 1);
+      erased    = TypeParam::erase(m, 2);
+      ASSERT_FALSE(is_ready(assigned));
+      ASSERT_FALSE(is_ready(read));
+      view.at(1) = "eins";
+    }
+    // The waiters are granted by the thread releasing the lock, before unlock returns.
+    ASSERT_TRUE(is_ready(assigned));
+    ASSERT_TRUE(is_ready(read));
+    ASSERT_TRUE(is_ready(erased));
+    ASSERT_FALSE(assigned.get());
+    ASSERT_EQ("uno", read.get());
+    ASSERT_EQ(0, erased.get());
+    ASSERT_NE(before, m.find_versioned(1)->version);
+  }
+
+  TYPED_TEST(AsyncTests, ShardedWaitersQueuePerShard) {
+    ShardedUnorderedMap<int, int, 4> m{{0, 0}, {1, 1}};
+    std::future<bool> blocked;
+    {
+      auto guard = m.lock_shard(0);
+      blocked    = TypeParam::insert(m, {4, 4});
+      ASSERT_FALSE(is_ready(blocked));
+      auto other = TypeParam::at(m, 1);
+      ASSERT_TRUE(is_ready(other));
+      ASSERT_EQ(1, other.get());
+    }
+    ASSERT_TRUE(is_ready(blocked));
+    ASSERT_TRUE(blocked.get());
+    ASSERT_EQ(4, m.at(4));
+  }
+
+  TYPED_TEST(AsyncTests, WaitersAreGrantedWhenAnotherThreadUnlocks) {
+    UnorderedMap<int, int> m;
+    std::promise<void> locked;
+    std::promise<void> release;
+    std::thread holder([&]() {
+      auto view = m.lock();
+      locked.set_value();
+      release.get_future().wait();
+    });
+    locked.get_future().wait();
+    auto runner = TypeParam::insert_or_assign(m, 1, 1);
+    auto read   = TypeParam::find(m, 1);
+    ASSERT_FALSE(is_ready(runner));
+    release.set_value();
+    holder.join();
+    ASSERT_TRUE(runner.get());
+    ASSERT_TRUE(read.get());
+  }
+
+  // Asynchronous and blocking writers from several threads must not lose writes or leave
+  // waiters behind.
+  TYPED_TEST(AsyncTests, ConcurrentAsyncAndBlockingWrites) {
+    ShardedUnorderedMap<int, int, 4> m;
+    constexpr int thread_count = 4;
+    constexpr int per_thread   = 1000;
+    std::vector<std::vector<std::future<bool>>> results(thread_count);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+      threads.emplace_back([&m, &results, t]() {
+        for (int i = 0; i < per_thread; ++i) {
+          int const key = t * per_thread + i;
+          if (t % 2 == 0) {
+            results[t].push_back(TypeParam::insert_or_assign(m, key, key));
+          } else {
+            (void) m.insert_or_assign(key, key);
+          }
+          (void) m.find(i % 8);
+        }
+      });
+    }
+    for (auto &t: threads) {
+      t.join();
+    }
+    for (auto &futures: results) {
+      for (auto &future: futures) {
+        ASSERT_TRUE(future.get());
+      }
+    }
+    ASSERT_EQ(thread_count * per_thread, m.size());
+  }
+
+} // namespace
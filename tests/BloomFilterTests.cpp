@@ -0,0 +1,166 @@
+#include <concurrency/BloomFilter.hpp>
+#include <concurrency/ShardedUnorderedMap.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+  using ::concurrency::CountingBloomFilter;
+  using ::concurrency::ShardedFlatUnorderedMap;
+  using ::concurrency::ShardedUnorderedMap;
+  using ::concurrency::UnorderedMap;
+
+  class BloomFilterTests : public ::testing::Test {};
+
+  TEST_F(BloomFilterTests, DisabledFilterAcceptsEverything) {
+    CountingBloomFilter filter;
+    ASSERT_FALSE(filter.enabled());
+    ASSERT_TRUE(filter.may_contain(42));
+    filter.add(42);
+    filter.remove(42);
+    ASSERT_EQ(0, filter.size());
+  }
+
+  TEST_F(BloomFilterTests, NoFalseNegativesAndFewFalsePositives) {
+    std::vector<std::size_t> hashes;
+    for (std::size_t i = 0; i < 10'000; ++i) {
+      hashes.push_back(std::hash<std::size_t>()(i));
+    }
+    CountingBloomFilter filter;
+    filter.rebuild(hashes.size(), hashes.begin(), hashes.end(), [](std::size_t h) { return h; });
+    ASSERT_TRUE(filter.enabled());
+    ASSERT_EQ(hashes.size(), filter.size());
+    for (auto const h: hashes) {
+      ASSERT_TRUE(filter.may_contain(h));
+    }
+    std::size_t false_positives = 0;
+    for (std::size_t i = 10'000; i < 110'000; ++i) {
+      false_positives += filter.may_contain(std::hash<std::size_t>()(i));
+    }
+    ASSERT_LT(false_positives, 5'000);
+  }
+
+  TEST_F(BloomFilterTests, RemoveClearsCounters) {
+    CountingBloomFilter filter;
+    std::vector<std::size_t> none;
+    filter.rebuild(64, none.begin(), none.end(), [](std::size_t h) { return h; });
+    for (std::size_t i = 0; i < 64; ++i) {
+      filter.add(i);
+    }
+    for (std::size_t i = 0; i < 64; ++i) {
+      filter.remove(i);
+    }
+    ASSERT_EQ(0, filter.size());
+    for (std::size_t i = 0; i < 64; ++i) {
+      ASSERT_FALSE(filter.may_contain(i));
+    }
+  }
+
+  TEST_F(BloomFilterTests, MapStaysConsistentThroughModifiers) {
+    UnorderedMap<std::string, int> m{{"a", 1}};
+    m.enable_bloom_filter();
+    ASSERT_TRUE(m.bloom_filter_enabled());
+    for (int i = 0; i < 2'000; ++i) {
+      ASSERT_TRUE(m.insert({std::to_string(i), i}));
+    }
+    for (int i = 0; i < 2'000; i += 2) {
+      ASSERT_EQ(1, m.erase(std::to_string(i)));
+    }
+    for (int i = 0; i < 2'000; ++i) {
+      ASSERT_EQ(static_cast<size_t>(i % 2), m.count(std::to_string(i)));
+    }
+    ASSERT_THROW(m.at("0"), std::out_of_range);
+    ASSERT_EQ(1, m.at("a"));
+
+    std::unordered_map<std::string, int> other{{"b", 2}, {"a", 3}};
+    m.merge(other);
+    ASSERT_TRUE(m.find("b"));
+    ASSERT_EQ(1, other.size());
+
+    std::unordered_map<std::string, int> replacement{{"c", 3}};
+    m.swap(replacement);
+    ASSERT_TRUE(m.find("c"));
+    ASSERT_FALSE(m.find("a"));
+
+    auto copy = m;
+    ASSERT_TRUE(copy.bloom_filter_enabled());
+    ASSERT_TRUE(copy.find("c"));
+
+    m.clear();
+    ASSERT_FALSE(m.find("c"));
+    ASSERT_EQ(0, m["c"]);
+    ASSERT_TRUE(m.find("c"));
+  }
+
+  TEST_F(BloomFilterTests, SwapMovesFiltersWithTheirElements) {
+    UnorderedMap<int, int> filtered;
+    UnorderedMap<int, int> plain;
+    filtered.enable_bloom_filter();
+    for (int i = 0; i < 1'000; ++i) {
+      filtered.insert({i, i});
+      plain.insert({-1 - i, i});
+    }
+    filtered.swap(plain);
+    ASSERT_FALSE(filtered.bloom_filter_enabled());
+    ASSERT_TRUE(plain.bloom_filter_enabled());
+    for (int i = 0; i < 1'000; ++i) {
+      ASSERT_TRUE(filtered.find(-1 - i));
+      ASSERT_TRUE(plain.find(i));
+      ASSERT_FALSE(plain.find(-1 - i));
+    }
+    swap(filtered, plain);
+    ASSERT_TRUE(filtered.bloom_filter_enabled());
+    ASSERT_TRUE(filtered.insert({1'000, 0}));
+    ASSERT_TRUE(filtered.find(1'000));
+    ASSERT_EQ(1'001, filtered.size());
+  }
+
+  TEST_F(BloomFilterTests, ShardedMapFiltersEveryShard) {
+    ShardedFlatUnorderedMap<int, int> m;
+    m.enable_bloom_filter(1'000);
+    for (int i = 0; i < 1'000; ++i) {
+      m.insert({i, i});
+    }
+    for (int i = 0; i < 1'000; ++i) {
+      ASSERT_TRUE(m.find(i));
+      ASSERT_FALSE(m.find(i + 1'000));
+    }
+    ASSERT_EQ(0, m.count(-1));
+  }
+
+  // Readers must never miss a key that is present for the whole test, even while
+  // writers churn other keys and force the filter to grow.
+  TEST_F(BloomFilterTests, ConcurrentReadersNeverMissStableKeys) {
+    ShardedUnorderedMap<int, int, 4> m;
+    m.enable_bloom_filter();
+    for (int i = 0; i < 100; ++i) {
+      m.insert({i, i});
+    }
+    std::atomic_bool done = false;
+    std::atomic_int misses = 0;
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t) {
+      readers.emplace_back([&]() {
+        while (!done) {
+          for (int i = 0; i < 100; ++i) {
+            if (!m.find(i)) ++misses;
+          }
+        }
+      });
+    }
+    for (int i = 100; i < 20'000; ++i) {
+      m.insert({i, i});
+      if (i % 3 == 0) m.erase(i);
+    }
+    done = true;
+    for (auto &th: readers) {
+      th.join();
+    }
+    ASSERT_EQ(0, misses);
+  }
+
+} // namespace
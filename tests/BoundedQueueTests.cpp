@@ -0,0 +1,187 @@
+#include <concurrency/BoundedQueue.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  using ::concurrency::BoundedQueue;
+
+  struct NoDefault {
+    explicit NoDefault(int v) : value(v) {}
+    int value;
+  };
+
+  TEST(BoundedQueueTests, CapacityIsRoundedUpToPowerOfTwo) {
+    ASSERT_EQ(2, BoundedQueue<int>(0).capacity());
+    ASSERT_EQ(8, BoundedQueue<int>(5).capacity());
+    ASSERT_EQ(1024, BoundedQueue<int>().capacity());
+  }
+
+  TEST(BoundedQueueTests, TryPushAndTryPopAreFifo) {
+    BoundedQueue<std::string> q(4);
+    ASSERT_TRUE(q.empty());
+    std::string value;
+    ASSERT_FALSE(q.try_pop(value));
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_TRUE(q.try_push(std::to_string(i)));
+    }
+    ASSERT_TRUE(q.full());
+    ASSERT_EQ(4, q.size());
+    std::string rejected = "rejected";
+    ASSERT_FALSE(q.try_push(std::move(rejected)));
+    ASSERT_EQ("rejected", rejected);
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_TRUE(q.try_pop(value));
+      ASSERT_EQ(std::to_string(i), value);
+    }
+    ASSERT_TRUE(q.empty());
+  }
+
+  TEST(BoundedQueueTests, WrapsAroundManyTimes) {
+    BoundedQueue<int> q(2);
+    for (int i = 0; i < 1000; ++i) {
+      ASSERT_TRUE(q.try_push(i));
+      auto value = q.pop();
+      ASSERT_TRUE(value.has_value());
+      ASSERT_EQ(i, *value);
+    }
+  }
+
+  TEST(BoundedQueueTests, BatchesStopAtCapacity) {
+    BoundedQueue<int> q(8);
+    std::vector<int> in(10);
+    std::iota(in.begin(), in.end(), 0);
+    auto next = q.try_push_n(in.begin(), in.end());
+    ASSERT_EQ(in.begin() + 8, next);
+    std::vector<int> out(10, -1);
+    ASSERT_EQ(3, q.try_pop_n(out.begin(), 3));
+    ASSERT_EQ(in.end(), q.try_push_n(next, in.end()));
+    ASSERT_EQ(7, q.try_pop_n(out.begin() + 3, 10));
+    ASSERT_EQ(in, out);
+    ASSERT_EQ(0, q.try_pop_n(out.begin(), 10));
+  }
+
+  TEST(BoundedQueueTests, SupportsTypesWithoutDefaultConstructor) {
+    BoundedQueue<NoDefault> q(4);
+    ASSERT_TRUE(q.try_push(NoDefault(7)));
+    auto value = q.pop();
+    ASSERT_TRUE(value.has_value());
+    ASSERT_EQ(7, value->value);
+  }
+
+  TEST(BoundedQueueTests, DestroysElementsLeftInQueue) {
+    auto tracked = std::make_shared<int>(0);
+    {
+      BoundedQueue<std::shared_ptr<int>> q(4);
+      ASSERT_TRUE(q.try_push(tracked));
+      ASSERT_TRUE(q.try_push(tracked));
+      std::shared_ptr<int> popped;
+      ASSERT_TRUE(q.try_pop(popped));
+      ASSERT_EQ(3, tracked.use_count());
+    }
+    ASSERT_EQ(1, tracked.use_count());
+  }
+
+  TEST(BoundedQueueTests, CloseRejectsPushesAndDrains) {
+    BoundedQueue<int> q(4);
+    ASSERT_TRUE(q.push(1));
+    q.close();
+    ASSERT_TRUE(q.closed());
+    ASSERT_FALSE(q.push(2));
+    ASSERT_FALSE(q.try_push(2));
+    auto value = q.pop();
+    ASSERT_TRUE(value.has_value());
+    ASSERT_EQ(1, *value);
+    ASSERT_FALSE(q.pop().has_value());
+    std::vector<int> out(4);
+    ASSERT_EQ(0, q.pop_n(out.begin(), out.size()));
+  }
+
+  TEST(BoundedQueueTests, CloseWakesSleepingConsumers) {
+    BoundedQueue<int> q(4);
+    std::thread consumer([&q]() { ASSERT_FALSE(q.pop().has_value()); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    q.close();
+    consumer.join();
+  }
+
+  TEST(BoundedQueueTests, BlockingPushWaitsForRoom) {
+    BoundedQueue<int> q(2);
+    ASSERT_TRUE(q.push(0));
+    ASSERT_TRUE(q.push(1));
+    std::thread producer([&q]() { ASSERT_TRUE(q.push(2)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    for (int i = 0; i < 3; ++i) {
+      auto value = q.pop();
+      ASSERT_TRUE(value.has_value());
+      ASSERT_EQ(i, *value);
+    }
+    producer.join();
+  }
+
+  // Every element pushed by several producers must be popped exactly once by
+  // several consumers, through both the single and batch interfaces.
+  void run_pipeline(bool batched) {
+    constexpr int producer_count = 3;
+    constexpr int consumer_count = 3;
+    constexpr int per_producer   = 20'000;
+    BoundedQueue<int> q(64);
+    std::vector<std::atomic<int>> seen(producer_count * per_producer);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producer_count; ++p) {
+      producers.emplace_back([&q, p, batched]() {
+        std::vector<int> batch;
+        for (int i = 0; i < per_producer; ++i) {
+          auto const value = p * per_producer + i;
+          if (!batched) {
+            ASSERT_TRUE(q.push(value));
+            continue;
+          }
+          batch.push_back(value);
+          if (batch.size() == 16 || i + 1 == per_producer) {
+            ASSERT_EQ(batch.end(), q.push_n(batch.begin(), batch.end()));
+            batch.clear();
+          }
+        }
+      });
+    }
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < consumer_count; ++c) {
+      consumers.emplace_back([&q, &seen, batched]() {
+        std::vector<int> out(16);
+        while (true) {
+          if (!batched) {
+            auto value = q.pop();
+            if (!value) return;
+            seen[*value].fetch_add(1);
+            continue;
+          }
+          auto const n = q.pop_n(out.begin(), out.size());
+          if (n == 0) return;
+          for (std::size_t i = 0; i < n; ++i) {
+            seen[out[i]].fetch_add(1);
+          }
+        }
+      });
+    }
+    for (auto &p: producers) {
+      p.join();
+    }
+    q.close();
+    for (auto &c: consumers) {
+      c.join();
+    }
+    for (std::size_t i = 0; i < seen.size(); ++i) {
+      ASSERT_EQ(1, seen[i].load()) << i;
+    }
+  }
+
+  TEST(BoundedQueueTests, ConcurrentProducersAndConsumers) { run_pipeline(false); }
+
+  TEST(BoundedQueueTests, ConcurrentBatchedProducersAndConsumers) { run_pipeline(true); }
+
+} // namespace
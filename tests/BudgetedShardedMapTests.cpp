@@ -0,0 +1,107 @@
+#include <concurrency/BudgetedShardedMap.hpp>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  using ::concurrency::BudgetedShardedMap;
+
+  struct StringSizer {
+    std::size_t operator()(const int &, const std::string &value) const noexcept { return value.size(); }
+  };
+
+  using TestMap = BudgetedShardedMap<int, std::string, 1, StringSizer>;
+
+  class BudgetedShardedMapTests : public ::testing::Test {};
+
+  TEST_F(BudgetedShardedMapTests, ChargesEntriesThroughTheSizer) {
+    TestMap m(100);
+    ASSERT_EQ(100, m.budget());
+    ASSERT_TRUE(m.insert(1, std::string(10, 'a')));
+    ASSERT_FALSE(m.insert(1, std::string(20, 'b')));
+    ASSERT_EQ(10, m.bytes());
+    ASSERT_FALSE(m.insert_or_assign(1, std::string(30, 'c')));
+    ASSERT_EQ(30, m.bytes());
+    ASSERT_EQ(std::string(30, 'c'), m.at(1));
+    ASSERT_EQ(1, m.erase(1));
+    ASSERT_EQ(0, m.erase(1));
+    ASSERT_EQ(0, m.bytes());
+    ASSERT_THROW(m.at(1), std::out_of_range);
+    ASSERT_EQ(0, m.evictions());
+  }
+
+  TEST_F(BudgetedShardedMapTests, EvictsToStayWithinBudget) {
+    TestMap m(1'000);
+    for (int i = 0; i < 1'000; ++i) {
+      m.insert_or_assign(i, std::string(1 + i % 50, 'x'));
+      ASSERT_LE(m.bytes(), m.budget());
+    }
+    ASSERT_GT(m.evictions(), 0);
+    ASSERT_TRUE(m.find(999));
+    std::size_t total = 0;
+    for (int i = 0; i < 1'000; ++i) {
+      if (m.find(i)) total += 1 + i % 50;
+    }
+    ASSERT_EQ(total, m.bytes());
+  }
+
+  TEST_F(BudgetedShardedMapTests, PrefersEvictingLeastRecentlyUsed) {
+    TestMap m(1'000);
+    for (int i = 0; i < 100; ++i) {
+      m.insert_or_assign(i, std::string(10, 'x'));
+    }
+    // Keep the first half hot while the second half grows cold.
+    int hot_survivors = 0;
+    for (int i = 100; i < 150; ++i) {
+      for (int k = 0; k < 50; ++k) {
+        if (m.find(k)) (void) m.at(k);
+      }
+      m.insert_or_assign(i, std::string(10, 'x'));
+    }
+    for (int k = 0; k < 50; ++k) {
+      hot_survivors += m.find(k) ? 1 : 0;
+    }
+    ASSERT_GT(hot_survivors, 40);
+  }
+
+  TEST_F(BudgetedShardedMapTests, OversizedEntryEvictsTheRestOfItsShard) {
+    TestMap m(100);
+    m.insert_or_assign(1, std::string(50, 'a'));
+    m.insert_or_assign(2, std::string(500, 'b'));
+    ASSERT_EQ(1, m.size());
+    ASSERT_TRUE(m.find(2));
+    m.clear();
+    ASSERT_TRUE(m.empty());
+    ASSERT_EQ(0, m.bytes());
+  }
+
+  TEST_F(BudgetedShardedMapTests, DefaultSizerChargesEveryEntry) {
+    BudgetedShardedMap<int, int, 4> m(4 * 10 * (sizeof(std::pair<const int, int>) + 3 * sizeof(void *)));
+    for (int i = 0; i < 1'000; ++i) {
+      m.insert(i, i);
+    }
+    ASSERT_LE(m.size(), 40);
+    ASSERT_LE(m.bytes(), m.budget());
+  }
+
+  TEST_F(BudgetedShardedMapTests, ConcurrentWritersStayWithinBudget) {
+    BudgetedShardedMap<int, std::string, 4, StringSizer> m(4'000);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+      workers.emplace_back([&m, t]() {
+        for (int i = 0; i < 5'000; ++i) {
+          auto const key = t * 5'000 + i;
+          m.insert_or_assign(key, std::string(1 + key % 64, 'x'));
+          if (m.find(key / 2)) (void) m.count(key / 2);
+        }
+      });
+    }
+    for (auto &w: workers) {
+      w.join();
+    }
+    ASSERT_LE(m.bytes(), m.budget());
+  }
+
+} // namespace
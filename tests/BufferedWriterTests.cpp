@@ -0,0 +1,178 @@
+#include <concurrency/BufferedWriter.hpp>
+#include <concurrency/ShardedUnorderedMap.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+  using ::concurrency::BufferedWriter;
+  using ::concurrency::ShardedUnorderedMap;
+  using ::concurrency::UnorderedMap;
+
+  class BufferedWriterTests : public ::testing::Test {};
+
+  TEST_F(BufferedWriterTests, UpsertCombinesWithExistingValue) {
+    UnorderedMap<std::string, int> m;
+    auto add = [](int a, int b) { return a + b; };
+    ASSERT_TRUE(m.upsert("foo", 1, add));
+    ASSERT_FALSE(m.upsert("foo", 2, add));
+    ASSERT_EQ(3, m.at("foo"));
+  }
+
+  TEST_F(BufferedWriterTests, BatchedWritesReachEveryShard) {
+    ShardedUnorderedMap<int, int, 4> m;
+    m.enable_bloom_filter();
+    std::vector<std::pair<int, int>> values;
+    for (int i = 0; i < 100; ++i) {
+      values.emplace_back(i, i);
+    }
+    m.insert_or_assign_many(values.begin(), values.end());
+    m.upsert_many(values.begin(), values.end(), [](int a, int b) { return a * b; });
+    ASSERT_EQ(100, m.size());
+    for (int i = 0; i < 100; ++i) {
+      ASSERT_EQ(i * i, m.at(i));
+    }
+  }
+
+  TEST_F(BufferedWriterTests, WritesAreCoalescedUntilFlushed) {
+    ShardedUnorderedMap<std::string, int, 2> m;
+    {
+      BufferedWriter<decltype(m)> writer(m, 100, std::chrono::hours(1));
+      writer.upsert("foo", 1);
+      writer.upsert("foo", 2);
+      writer.insert_or_assign("bar", 5);
+      writer.insert_or_assign("bar", 7);
+      ASSERT_EQ(2, writer.pending());
+      ASSERT_EQ(0, m.size());
+      writer.flush();
+      ASSERT_EQ(0, writer.pending());
+      ASSERT_EQ(3, m.at("foo"));
+      ASSERT_EQ(7, m.at("bar"));
+
+      writer.upsert("foo", 10);
+      writer.insert_or_assign("bar", 1);
+      ASSERT_EQ(3, m.at("foo"));
+    }
+    // The destructor flushes the remaining writes.
+    ASSERT_EQ(13, m.at("foo"));
+    ASSERT_EQ(1, m.at("bar"));
+  }
+
+  TEST_F(BufferedWriterTests, FlushesWhenThresholdsAreReached) {
+    ShardedUnorderedMap<int, int, 2> m;
+    BufferedWriter<decltype(m)> by_size(m, 3, std::chrono::hours(1));
+    by_size.upsert(1, 1);
+    by_size.upsert(2, 1);
+    ASSERT_EQ(0, m.size());
+    by_size.upsert(3, 1);
+    ASSERT_EQ(0, by_size.pending());
+    ASSERT_EQ(3, m.size());
+
+    BufferedWriter<decltype(m)> by_time(m, 100, std::chrono::milliseconds(1));
+    by_time.upsert(4, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    by_time.upsert(5, 1);
+    ASSERT_EQ(0, by_time.pending());
+    ASSERT_EQ(5, m.size());
+  }
+
+  // A thread that writes far less often than max_delay must not leave its writes buffered
+  // until it has written some larger number of times.
+  TEST_F(BufferedWriterTests, SlowWritersFlushWithinMaxDelay) {
+    ShardedUnorderedMap<int, int, 2> m;
+    BufferedWriter<decltype(m)> writer(m, 1'000, std::chrono::milliseconds(20));
+    for (int i = 0; i < 6; i += 2) {
+      writer.upsert(i, 1);
+      ASSERT_EQ(1, writer.pending());
+      std::this_thread::sleep_for(std::chrono::milliseconds(25));
+      // The previous write is overdue, so this one flushes both.
+      writer.upsert(i + 1, 1);
+      ASSERT_EQ(0, writer.pending());
+      ASSERT_EQ(i + 2, m.size());
+    }
+  }
+
+  struct CaseInsensitiveHash {
+    std::size_t operator()(const std::string &s) const {
+      std::string lower(s);
+      std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+      return std::hash<std::string>()(lower);
+    }
+  };
+
+  struct CaseInsensitiveEqual {
+    bool operator()(const std::string &a, const std::string &b) const {
+      return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](unsigned char x, unsigned char y) { return std::tolower(x) == std::tolower(y); });
+    }
+  };
+
+  TEST_F(BufferedWriterTests, KeysCoalesceWithTheMapsHashAndEquality) {
+    ShardedUnorderedMap<std::string, int, 2, CaseInsensitiveHash, CaseInsensitiveEqual> m;
+    BufferedWriter<decltype(m)> writer(m, 100, std::chrono::hours(1));
+    writer.upsert("Foo", 1);
+    writer.upsert("foo", 2);
+    writer.insert_or_assign("BAR", 3);
+    writer.insert_or_assign("bar", 4);
+    ASSERT_EQ(2, writer.pending());
+    writer.flush();
+    ASSERT_EQ(2, m.size());
+    ASSERT_EQ(3, m.at("FOO"));
+    ASSERT_EQ(4, m.at("Bar"));
+  }
+
+  struct FlakyAdd {
+    bool *fail;
+    int operator()(int a, int b) const {
+      if (*fail) throw std::runtime_error("combine failed");
+      return a + b;
+    }
+  };
+
+  TEST_F(BufferedWriterTests, FailedFlushesKeepUnappliedWrites) {
+    ShardedUnorderedMap<int, int, 2> m;
+    (void) m.insert({1, 10});
+    bool fail = false;
+    BufferedWriter<decltype(m), FlakyAdd> writer(m, 100, std::chrono::hours(1), FlakyAdd{&fail});
+    writer.upsert(1, 5);
+    writer.insert_or_assign(2, 7);
+    fail = true;
+    ASSERT_THROW(writer.flush(), std::runtime_error);
+    ASSERT_EQ(7, m.at(2));
+    ASSERT_EQ(10, m.at(1));
+    ASSERT_EQ(1, writer.pending());
+    fail = false;
+    writer.flush();
+    ASSERT_EQ(0, writer.pending());
+    ASSERT_EQ(15, m.at(1));
+  }
+
+  TEST_F(BufferedWriterTests, ConcurrentWritersLoseNoUpdates) {
+    ShardedUnorderedMap<int, int, 4> m;
+    constexpr int threads    = 4;
+    constexpr int per_thread = 20'000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back([&m]() {
+        BufferedWriter<decltype(m)> writer(m, 64);
+        for (int i = 0; i < per_thread; ++i) {
+          writer.upsert(i % 100, 1);
+        }
+      });
+    }
+    for (auto &w: workers) {
+      w.join();
+    }
+    ASSERT_EQ(100, m.size());
+    for (int key = 0; key < 100; ++key) {
+      ASSERT_EQ(threads * per_thread / 100, m.at(key));
+    }
+  }
+
+} // namespace
@@ -0,0 +1,241 @@
+#include <concurrency/ShardedUnorderedMap.hpp>
+#include <concurrency/ThreadPool.hpp>
+#include <concurrency/UnorderedMap.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace {
+  using ::concurrency::MapDelta;
+  using ::concurrency::ShardedUnorderedMap;
+  using ::concurrency::ThreadPool;
+  using ::concurrency::UnorderedMap;
+
+  template <class T>
+  class ChangeTrackingTests : public ::testing::Test {};
+
+  using MapTypes = ::testing::Types<UnorderedMap<int, std::string>, ShardedUnorderedMap<int, std::string, 4>>;
+  TYPED_TEST_SUITE(ChangeTrackingTests, MapTypes);
+
+  template <class Delta>
+  std::size_t upsert_count(const Delta &delta) {
+    std::size_t n = 0;
+    for (auto const &shard: delta.shards) {
+      n += shard.upserts.size();
+    }
+    return n;
+  }
+
+  template <class Delta>
+  std::vector<int> erased_keys(const Delta &delta) {
+    std::vector<int> keys;
+    for (auto const &shard: delta.shards) {
+      keys.insert(keys.end(), shard.erased.begin(), shard.erased.end());
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+  }
+
+  template <class Delta>
+  bool any_reset(const Delta &delta) {
+    return std::any_of(delta.shards.begin(), delta.shards.end(), [](auto const &shard) { return shard.reset; });
+  }
+
+  TYPED_TEST(ChangeTrackingTests, TrackingMustBeEnabled) {
+    TypeParam m{{1, "one"}};
+    ASSERT_FALSE(m.change_tracking_enabled());
+    ASSERT_THROW((void) m.changes_since(0), std::logic_error);
+    ASSERT_THROW(m.discard_changes_through(0), std::logic_error);
+    m.enable_change_tracking();
+    ASSERT_TRUE(m.change_tracking_enabled());
+  }
+
+  TYPED_TEST(ChangeTrackingTests, DeltasHoldOnlyTheLatestChanges) {
+    TypeParam m;
+    for (int i = 0; i < 100; ++i) {
+      (void) m.insert({i, std::to_string(i)});
+    }
+    m.enable_change_tracking();
+    auto full = m.changes_since(0);
+    ASSERT_TRUE(any_reset(full));
+    ASSERT_EQ(100, upsert_count(full));
+
+    auto delta = m.changes_since(full.epoch);
+    ASSERT_TRUE(delta.empty());
+
+    (void) m.insert_or_assign(1, "uno");
+    (void) m.insert_or_assign(1, "eins");
+    (void) m.insert({200, "200"});
+    (void) m.erase(2);
+    (void) m.erase(200);
+    (void) m.upsert(3, "!", [](const std::string &a, const std::string &b) { return a + b; });
+    delta = m.changes_since(delta.epoch);
+    ASSERT_FALSE(any_reset(delta));
+    ASSERT_EQ(2, upsert_count(delta));
+    ASSERT_EQ((std::vector<int>{2, 200}), erased_keys(delta));
+    for (auto const &shard: delta.shards) {
+      for (auto const &el: shard.upserts) {
+        ASSERT_EQ(el.first == 1 ? "eins" : "3!", el.second);
+      }
+    }
+    ASSERT_TRUE(m.changes_since(delta.epoch).empty());
+  }
+
+  TYPED_TEST(ChangeTrackingTests, ConditionalWritesAreTracked) {
+    TypeParam m{{1, "one"}, {2, "two"}};
+    m.enable_versioning();
+    m.enable_change_tracking();
+    auto delta = m.changes_since(0);
+
+    auto const versioned = m.find_versioned(1);
+    ASSERT_TRUE(versioned.has_value());
+    ASSERT_TRUE(m.update_if_version(1, versioned->version, "uno"));
+    std::string expected = "two";
+    ASSERT_TRUE(m.compare_exchange(2, expected, "dos"));
+    delta = m.changes_since(delta.epoch);
+    ASSERT_FALSE(any_reset(delta));
+    ASSERT_EQ(2, upsert_count(delta));
+    for (auto const &shard: delta.shards) {
+      for (auto const &el: shard.upserts) {
+        ASSERT_EQ(el.first == 1 ? "uno" : "dos", el.second);
+      }
+    }
+
+    // Failed conditional writes change nothing and are not logged.
+    ASSERT_FALSE(m.update_if_version(1, versioned->version, "eins"));
+    expected = "two";
+    ASSERT_FALSE(m.compare_exchange(2, expected, "zwei"));
+    ASSERT_TRUE(m.changes_since(delta.epoch).empty());
+  }
+
+  TYPED_TEST(ChangeTrackingTests, FailedInsertsAreNotTracked) {
+    TypeParam m{{1, "one"}};
+    m.enable_change_tracking();
+    auto delta = m.changes_since(0);
+    ASSERT_FALSE(m.insert({1, "eins"}));
+    if constexpr (std::is_same_v<TypeParam, UnorderedMap<int, std::string>>) {
+      ASSERT_FALSE(m.emplace(1, "eins"));
+      ASSERT_FALSE(m.try_emplace(1, "eins"));
+    }
+    ASSERT_TRUE(m.changes_since(delta.epoch).empty());
+    ASSERT_FALSE(m.insert_or_assign(1, "uno"));
+    ASSERT_EQ(1, upsert_count(m.changes_since(delta.epoch)));
+  }
+
+  TYPED_TEST(ChangeTrackingTests, WholesaleWritesResetTheDelta) {
+    TypeParam m{{1, "one"}, {2, "two"}};
+    m.enable_change_tracking();
+    auto delta = m.changes_since(0);
+    m.clear();
+    (void) m.insert({3, "three"});
+    delta = m.changes_since(delta.epoch);
+    ASSERT_TRUE(any_reset(delta));
+    ASSERT_EQ(1, upsert_count(delta));
+
+    TypeParam replica{{1, "one"}, {2, "two"}, {9, "nine"}};
+    replica.apply_delta(delta);
+    ASSERT_TRUE(m == replica);
+  }
+
+  TYPED_TEST(ChangeTrackingTests, DiscardedChangesForceAFullDelta) {
+    TypeParam m;
+    m.enable_change_tracking();
+    auto const first = m.changes_since(0);
+    (void) m.insert({1, "one"});
+    auto const second = m.changes_since(first.epoch);
+    (void) m.insert({2, "two"});
+    m.discard_changes_through(second.epoch);
+
+    auto const current = m.changes_since(second.epoch);
+    ASSERT_FALSE(any_reset(current));
+    ASSERT_EQ(1, upsert_count(current));
+    auto const stale = m.changes_since(first.epoch);
+    ASSERT_TRUE(any_reset(stale));
+    ASSERT_EQ(2, upsert_count(stale));
+  }
+
+  // A replica that applies every delta must converge on the primary, whichever kind of
+  // map and shard count it uses.
+  TYPED_TEST(ChangeTrackingTests, ReplicasConverge) {
+    TypeParam primary;
+    primary.enable_change_tracking();
+    TypeParam replica;
+    UnorderedMap<int, std::string> single;
+    ShardedUnorderedMap<int, std::string, 7> resharded;
+    std::mt19937 rng(7);
+    uint64_t epoch = 0;
+    for (int round = 0; round < 20; ++round) {
+      for (int i = 0; i < 200; ++i) {
+        int const key = static_cast<int>(rng() % 300);
+        switch (rng() % 4) {
+        case 0: (void) primary.erase(key); break;
+        case 1: (void) primary.insert({key, "i" + std::to_string(round)}); break;
+        default: (void) primary.insert_or_assign(key, "a" + std::to_string(round)); break;
+        }
+      }
+      if (round == 10) primary = TypeParam{{1, "reset"}};
+      auto const delta = primary.changes_since(epoch);
+      epoch            = delta.epoch;
+      replica.apply_delta(delta);
+      single.apply_delta(delta);
+      resharded.apply_delta(delta);
+      ASSERT_TRUE(primary.data() == replica.data()) << round;
+      ASSERT_TRUE(primary.data() == single.data()) << round;
+      ASSERT_TRUE(primary.data() == resharded.data()) << round;
+    }
+  }
+
+  // Deltas taken while writers run must still bring a replica up to date once the
+  // writers stop.
+  TYPED_TEST(ChangeTrackingTests, ConcurrentWritesAreNotMissed) {
+    TypeParam primary;
+    primary.enable_change_tracking();
+    TypeParam replica;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 3; ++t) {
+      writers.emplace_back([&primary, t]() {
+        for (int i = 0; i < 3000; ++i) {
+          int const key = (i * 31 + t) % 500;
+          if (i % 5 == 0) {
+            (void) primary.erase(key);
+          } else {
+            (void) primary.insert_or_assign(key, std::to_string(t * 10000 + i));
+          }
+        }
+      });
+    }
+    uint64_t epoch = 0;
+    for (int i = 0; i < 50; ++i) {
+      auto const delta = primary.changes_since(epoch);
+      epoch            = delta.epoch;
+      replica.apply_delta(delta);
+      primary.discard_changes_through(epoch > 3 ? epoch - 3 : 0);
+    }
+    for (auto &t: writers) {
+      t.join();
+    }
+    replica.apply_delta(primary.changes_since(epoch));
+    ASSERT_TRUE(primary.data() == replica.data());
+  }
+
+  TEST(ShardedChangeTrackingTests, AppliesShardBatchesInParallel) {
+    ShardedUnorderedMap<int, int, 8> primary;
+    primary.enable_change_tracking();
+    for (int i = 0; i < 1000; ++i) {
+      (void) primary.insert({i, i});
+    }
+    auto const delta = primary.changes_since(0);
+    ASSERT_EQ(8, delta.shards.size());
+    ThreadPool pool(4);
+    ShardedUnorderedMap<int, int, 8> replica;
+    replica.apply_delta(delta, pool);
+    ASSERT_TRUE(primary == replica);
+  }
+
+} // namespace
@@ -0,0 +1,89 @@
+#include <concurrency/DelegatedShardedMap.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  using ::concurrency::DelegatedShardedMap;
+  using ::concurrency::FlatHashMap;
+
+  class DelegatedShardedMapTests : public ::testing::Test {};
+
+  TEST_F(DelegatedShardedMapTests, SingleKeyOperations) {
+    DelegatedShardedMap<std::string, int> m{{"a", 1}};
+    ASSERT_TRUE(m.insert({"b", 2}).get());
+    ASSERT_FALSE(m.insert({"b", 3}).get());
+    ASSERT_FALSE(m.insert_or_assign("b", 4).get());
+    ASSERT_EQ(4, m.at("b").get());
+    ASSERT_TRUE(m.find("a").get());
+    ASSERT_EQ(1, m.count("a").get());
+    ASSERT_THROW(m.at("c").get(), std::out_of_range);
+    ASSERT_EQ(1, m.erase("a").get());
+    ASSERT_FALSE(m.find("a").get());
+    ASSERT_EQ(1, m.size());
+    m.clear();
+    ASSERT_TRUE(m.empty());
+  }
+
+  TEST_F(DelegatedShardedMapTests, SubmitAndPost) {
+    DelegatedShardedMap<int, int, 2, std::hash<int>, std::equal_to<int>, std::allocator<std::pair<const int, int>>, FlatHashMap> m;
+    ASSERT_EQ(2, m.shard_count());
+    auto incremented = m.submit(7, [](auto &shard) { return ++shard[7]; });
+    ASSERT_EQ(1, incremented.get());
+    ASSERT_THROW(m.submit(7, [](auto &) -> int { throw std::runtime_error("boom"); }).get(), std::runtime_error);
+
+    std::atomic_int delivered = 0;
+    m.post(7, [&delivered](auto &shard) { delivered = shard.at(7); });
+    m.post(8, [](auto &) { throw std::runtime_error("discarded"); });
+    ASSERT_EQ(1, m.at(7).get());
+    while (delivered == 0) {
+      std::this_thread::yield();
+    }
+    ASSERT_EQ(1, delivered);
+  }
+
+  // Many producers share a small queue, so that submitting often has to wait for room.
+  TEST_F(DelegatedShardedMapTests, ConcurrentProducers) {
+    DelegatedShardedMap<int, int> m(8);
+    constexpr int producers  = 4;
+    constexpr int per_thread = 5'000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < producers; ++t) {
+      threads.emplace_back([&m, t]() {
+        for (int i = 0; i < per_thread; ++i) {
+          m.post(i, [](auto &shard) { shard.clear(); });
+          (void) m.insert_or_assign(t * per_thread + i, i);
+        }
+        for (int i = 0; i < per_thread; ++i) {
+          m.submit(t * per_thread + i, [](auto &shard) { return shard.size(); }).get();
+        }
+      });
+    }
+    for (auto &th: threads) {
+      th.join();
+    }
+    m.clear();
+    for (int i = 0; i < per_thread; ++i) {
+      m.insert({i, i});
+    }
+    auto const snapshot = m.data();
+    ASSERT_EQ(static_cast<size_t>(per_thread), snapshot.size());
+    ASSERT_EQ(static_cast<size_t>(per_thread), m.size());
+  }
+
+  // Pending operations are still applied when the map is destroyed.
+  TEST_F(DelegatedShardedMapTests, DestructionDrainsQueues) {
+    std::atomic_int applied = 0;
+    {
+      DelegatedShardedMap<int, int, 2> m;
+      for (int i = 0; i < 1'000; ++i) {
+        m.post(i, [&applied](auto &) { ++applied; });
+      }
+    }
+    ASSERT_EQ(1'000, applied);
+  }
+
+} // namespace
@@ -0,0 +1,199 @@
+#include <concurrency/Epoch.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+  using ::concurrency::Epoch;
+
+  struct Node {
+    static constexpr uint64_t Live = 0x1badc0de;
+
+    explicit Node(uint64_t v, std::atomic<int> &live) : value(v), live_count(live) { live_count.fetch_add(1, std::memory_order_relaxed); }
+    ~Node() {
+      magic = 0;
+      live_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    uint64_t magic = Live;
+    uint64_t value;
+    std::atomic<int> &live_count;
+  };
+
+  // Advances the epoch far enough to free everything retired before the call, provided
+  // no thread is pinned.
+  void drain(Epoch &epoch) {
+    for (int i = 0; i < 3; ++i) {
+      (void) epoch.reclaim();
+    }
+  }
+
+  TEST(EpochTests, PinnedThreadsDelayReclamation) {
+    Epoch epoch;
+    std::atomic<int> live{0};
+    auto *node = new Node(1, live);
+
+    std::atomic_bool pinned{false};
+    std::atomic_bool release{false};
+    std::thread reader([&]() {
+      auto guard = epoch.pin();
+      pinned     = true;
+      while (!release) {
+        std::this_thread::yield();
+      }
+    });
+    while (!pinned) {
+      std::this_thread::yield();
+    }
+
+    epoch.retire(node);
+    drain(epoch);
+    ASSERT_EQ(1, live);
+    ASSERT_EQ(1, epoch.pending());
+
+    release = true;
+    reader.join();
+    drain(epoch);
+    ASSERT_EQ(0, live);
+    ASSERT_EQ(0, epoch.pending());
+  }
+
+  TEST(EpochTests, GuardsNest) {
+    Epoch epoch;
+    std::atomic<int> live{0};
+    std::thread([&]() {
+      auto outer = epoch.pin();
+      {
+        auto inner = epoch.pin();
+      }
+      epoch.retire(new Node(1, live));
+      drain(epoch);
+      ASSERT_EQ(1, live);
+      auto moved = std::move(outer);
+      drain(epoch);
+      ASSERT_EQ(1, live);
+    }).join();
+    drain(epoch);
+    ASSERT_EQ(0, live);
+  }
+
+  TEST(EpochTests, CustomDeleters) {
+    Epoch epoch;
+    std::atomic<int> live{0};
+    int deleted = 0;
+    epoch.retire(new Node(1, live), [&deleted](Node *n) {
+      ++deleted;
+      delete n;
+    });
+    int *array = new int[16];
+    epoch.retire(array, std::default_delete<int[]>());
+    epoch.retire(static_cast<Node *>(nullptr));
+    ASSERT_EQ(2, epoch.pending());
+    drain(epoch);
+    ASSERT_EQ(1, deleted);
+    ASSERT_EQ(0, live);
+  }
+
+  TEST(EpochTests, RetiringReclaimsPeriodically) {
+    Epoch epoch;
+    std::atomic<int> live{0};
+    for (std::size_t i = 0; i < 10 * ::concurrency::EpochReclaimInterval; ++i) {
+      epoch.retire(new Node(i, live));
+    }
+    ASSERT_LT(epoch.pending(), 3 * ::concurrency::EpochReclaimInterval);
+    ASSERT_EQ(epoch.pending(), live);
+  }
+
+  TEST(EpochTests, ExitedThreadsHandOverTheirObjects) {
+    Epoch epoch;
+    std::atomic<int> live{0};
+    std::thread([&]() {
+      epoch.retire(new Node(1, live));
+      epoch.retire(new Node(2, live));
+    }).join();
+    ASSERT_EQ(2, live);
+    ASSERT_EQ(0, epoch.pending());
+    drain(epoch);
+    ASSERT_EQ(0, live);
+  }
+
+  TEST(EpochTests, DestructionFreesPendingObjects) {
+    std::atomic<int> live{0};
+    {
+      Epoch epoch;
+      auto guard = epoch.pin();
+      epoch.retire(new Node(1, live));
+      std::thread([&]() { epoch.retire(new Node(2, live)); }).join();
+    }
+    ASSERT_EQ(0, live);
+
+    // Threads may outlive the Epochs they used, and a new Epoch must not pick up their
+    // stale records.
+    std::thread worker([&live]() {
+      for (int i = 0; i < 100; ++i) {
+        Epoch epoch;
+        auto guard = epoch.pin();
+        epoch.retire(new Node(i, live));
+        ASSERT_EQ(1, epoch.pending());
+      }
+    });
+    worker.join();
+    ASSERT_EQ(0, live);
+  }
+
+  // Readers follow a shared pointer that writers keep replacing and retiring. A reader
+  // must never see a node that has been destroyed, and every node must be freed in the
+  // end.
+  TEST(EpochTests, HeavyChurn) {
+    constexpr int ReaderCount     = 4;
+    constexpr int WriterCount     = 3;
+    constexpr int WritesPerWriter = 20000;
+
+    std::atomic<int> live{0};
+    {
+      Epoch epoch;
+      std::atomic<Node *> head{new Node(0, live)};
+      std::atomic_bool done{false};
+      std::atomic<uint64_t> reads{0};
+
+      std::vector<std::thread> threads;
+      for (int t = 0; t < ReaderCount; ++t) {
+        threads.emplace_back([&]() {
+          uint64_t n = 0;
+          while (!done.load(std::memory_order_relaxed)) {
+            auto guard       = epoch.pin();
+            Node const *node = head.load(std::memory_order_acquire);
+            ASSERT_EQ(Node::Live, node->magic);
+            ++n;
+          }
+          reads.fetch_add(n, std::memory_order_relaxed);
+        });
+      }
+      std::vector<std::thread> writers;
+      for (int t = 0; t < WriterCount; ++t) {
+        writers.emplace_back([&, t]() {
+          for (int i = 0; i < WritesPerWriter; ++i) {
+            Node *old = head.exchange(new Node(static_cast<uint64_t>(t) * WritesPerWriter + i, live), std::memory_order_acq_rel);
+            epoch.retire(old);
+          }
+        });
+      }
+      for (auto &w: writers) {
+        w.join();
+      }
+      done = true;
+      for (auto &t: threads) {
+        t.join();
+      }
+      ASSERT_LT(0, reads);
+      drain(epoch);
+      ASSERT_EQ(1, live);
+      delete head.load();
+    }
+    ASSERT_EQ(0, live);
+  }
+
+} // namespace
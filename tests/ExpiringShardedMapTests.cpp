@@ -0,0 +1,161 @@
+#include <concurrency/ExpiringShardedMap.hpp>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  using ::concurrency::ExpiringShardedMap;
+  using ::concurrency::detail::TimingWheel;
+  using namespace std::chrono_literals;
+
+  // A clock that only moves when told to, so that expiry can be tested deterministically.
+  struct ManualClock {
+    using duration                  = std::chrono::milliseconds;
+    using rep                       = duration::rep;
+    using period                    = duration::period;
+    using time_point                = std::chrono::time_point<ManualClock>;
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept { return current; }
+    static void advance(duration d) noexcept { current += d; }
+
+    static inline time_point current{};
+  };
+
+  using TestMap = ExpiringShardedMap<std::string, int, 4, std::hash<std::string>, std::equal_to<std::string>, ManualClock>;
+
+  class ExpiringShardedMapTests : public ::testing::Test {};
+
+  TEST_F(ExpiringShardedMapTests, TimingWheelFiresAtDeadline) {
+    TimingWheel<int> wheel;
+    std::vector<uint64_t> deadlines{1, 63, 64, 65, 4'095, 4'096, 300'000, 20'000'000};
+    for (auto d: deadlines) {
+      wheel.schedule(static_cast<int>(d % 1'000'000'007), d);
+    }
+    ASSERT_EQ(deadlines.size(), wheel.size());
+    for (auto d: deadlines) {
+      std::vector<int> fired;
+      ASSERT_EQ(0, wheel.advance(d - 1, [&fired](int v, uint64_t) { fired.push_back(v); }));
+      ASSERT_EQ(1, wheel.advance(d, [&fired](int v, uint64_t) { fired.push_back(v); }));
+      ASSERT_EQ(static_cast<int>(d % 1'000'000'007), fired.at(0));
+    }
+    ASSERT_EQ(0, wheel.size());
+    wheel.schedule(7, 0);
+    ASSERT_EQ(1, wheel.advance(wheel.now() + 1, [](int, uint64_t) {}));
+  }
+
+  TEST_F(ExpiringShardedMapTests, EntriesExpire) {
+    TestMap m(10ms);
+    ASSERT_TRUE(m.insert("foo", 1, 100ms));
+    ASSERT_FALSE(m.insert("foo", 2, 100ms));
+    ASSERT_TRUE(m.insert_or_assign("bar", 3, 50ms));
+    ASSERT_TRUE(m.find("foo"));
+    ASSERT_EQ(1, m.at("foo"));
+    ASSERT_EQ(2, m.size());
+
+    ManualClock::advance(50ms);
+    ASSERT_FALSE(m.find("bar"));
+    ASSERT_EQ(0, m.count("bar"));
+    ASSERT_THROW(m.at("bar"), std::out_of_range);
+    ASSERT_TRUE(m.find("foo"));
+    ASSERT_EQ(1, m.expire());
+    ASSERT_EQ(1, m.size());
+
+    // Expired entries may be overwritten by insert().
+    ASSERT_TRUE(m.insert_or_assign("bar", 4, 50ms));
+    ManualClock::advance(60ms);
+    ASSERT_FALSE(m.find("foo"));
+    ASSERT_FALSE(m.touch("foo", 1s));
+    ASSERT_TRUE(m.insert("foo", 5, 10ms));
+    ASSERT_EQ(5, m.at("foo"));
+  }
+
+  TEST_F(ExpiringShardedMapTests, RewrittenEntriesKeepTheirNewExpiry) {
+    TestMap m(10ms);
+    ASSERT_TRUE(m.insert_or_assign("session", 1, 100ms));
+    ManualClock::advance(80ms);
+    ASSERT_TRUE(m.touch("session", 100ms));
+    ManualClock::advance(80ms);
+    ASSERT_EQ(0, m.expire());
+    ASSERT_EQ(1, m.at("session"));
+    ASSERT_FALSE(m.insert_or_assign("session", 2, 1h));
+    ManualClock::advance(30min);
+    ASSERT_EQ(0, m.expire());
+    ASSERT_EQ(2, m.at("session"));
+    ManualClock::advance(30min);
+    ASSERT_EQ(1, m.expire());
+    ASSERT_EQ(0, m.size());
+  }
+
+  // A session touched on every request must keep a single item on the wheel, however often
+  // it is touched.
+  TEST_F(ExpiringShardedMapTests, TouchesDoNotGrowTheWheel) {
+    TestMap m(10ms);
+    ASSERT_TRUE(m.insert_or_assign("session", 1, 100ms));
+    for (int i = 0; i < 10'000; ++i) {
+      ASSERT_TRUE(m.touch("session", 100ms));
+      if (i % 2 == 0) {
+        ASSERT_FALSE(m.insert_or_assign("session", i, 100ms));
+      }
+      if (i % 100 == 0) ManualClock::advance(1ms);
+      ASSERT_EQ(1, m.scheduled());
+    }
+    ManualClock::advance(99ms);
+    ASSERT_EQ(0, m.expire());
+    ASSERT_EQ(1, m.scheduled());
+    ASSERT_TRUE(m.find("session"));
+    ManualClock::advance(1ms);
+    ASSERT_EQ(1, m.expire());
+    ASSERT_EQ(0, m.scheduled());
+
+    // Bringing the expiry forward schedules an earlier item, and drops the later one.
+    ASSERT_TRUE(m.insert_or_assign("session", 1, 1h));
+    ASSERT_FALSE(m.insert_or_assign("session", 2, 20ms));
+    ASSERT_EQ(2, m.scheduled());
+    ManualClock::advance(20ms);
+    ASSERT_EQ(1, m.expire());
+    ASSERT_EQ(1, m.scheduled());
+    ManualClock::advance(1h);
+    ASSERT_EQ(0, m.expire());
+    ASSERT_EQ(0, m.scheduled());
+  }
+
+  TEST_F(ExpiringShardedMapTests, EraseAndClear) {
+    TestMap m;
+    m.insert_or_assign("foo", 1, 1s);
+    m.insert_or_assign("bar", 2, 1s);
+    ASSERT_EQ(1, m.erase("foo"));
+    ASSERT_EQ(0, m.erase("foo"));
+    m.clear();
+    ASSERT_EQ(0, m.size());
+    ManualClock::advance(2s);
+    ASSERT_EQ(0, m.expire());
+  }
+
+  TEST_F(ExpiringShardedMapTests, ConcurrentWritersAndSweeper) {
+    ExpiringShardedMap<int, int, 8> m(1ms);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+      workers.emplace_back([&m, t]() {
+        for (int i = 0; i < 5'000; ++i) {
+          m.insert_or_assign(t * 5'000 + i, i, std::chrono::microseconds(i % 3 == 0 ? 0 : 10'000'000));
+          if (i % 100 == 0) m.expire();
+        }
+      });
+    }
+    for (auto &w: workers) {
+      w.join();
+    }
+    std::this_thread::sleep_for(2ms);
+    m.expire();
+    for (int key = 0; key < 20'000; ++key) {
+      ASSERT_EQ(key % 5'000 % 3 != 0, m.find(key));
+    }
+    ASSERT_EQ(20'000 - 4 * 1'667, m.size());
+  }
+
+} // namespace
@@ -0,0 +1,141 @@
+#include <concurrency/FlatCombiner.hpp>
+#include <concurrency/ShardedUnorderedMap.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  using ::concurrency::FlatCombiner;
+  using ::concurrency::ShardedUnorderedMap;
+  using ::concurrency::UnorderedMap;
+
+  class FlatCombinerTests : public ::testing::Test {};
+
+  TEST_F(FlatCombinerTests, DisabledCombinerLocksDirectly) {
+    FlatCombiner<> combiner;
+    std::mutex mutex;
+    ASSERT_FALSE(combiner.enabled());
+    ASSERT_EQ(42, combiner.apply(mutex, []() { return 42; }));
+    combiner.enable();
+    ASSERT_TRUE(combiner.enabled());
+    ASSERT_EQ("foo", combiner.apply(mutex, []() { return std::string("foo"); }));
+  }
+
+  TEST_F(FlatCombinerTests, ExceptionsReachThePublisher) {
+    FlatCombiner<4> combiner;
+    std::mutex mutex;
+    combiner.enable();
+    ASSERT_THROW(combiner.apply(mutex, []() -> int { throw std::runtime_error("boom"); }), std::runtime_error);
+    combiner.apply(mutex, []() {});
+  }
+
+  // Increments a plain counter from many threads; the combiner must apply every operation
+  // exactly once and only while the mutex is held.
+  TEST_F(FlatCombinerTests, EveryOperationAppliedOnce) {
+    FlatCombiner<2> combiner;
+    std::mutex mutex;
+    combiner.enable();
+    uint64_t counter         = 0;
+    constexpr int threads    = 8;
+    constexpr int per_thread = 10'000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back([&]() {
+        for (int i = 0; i < per_thread; ++i) {
+          combiner.apply(mutex, [&counter]() { return ++counter; });
+        }
+      });
+    }
+    for (auto &w: workers) {
+      w.join();
+    }
+    ASSERT_EQ(static_cast<uint64_t>(threads * per_thread), counter);
+  }
+
+  // A mutex that counts failed attempts to take it.
+  struct CountingMutex {
+    void lock() { mutex.lock(); }
+    bool try_lock() {
+      if (mutex.try_lock()) return true;
+      failed.fetch_add(1);
+      return false;
+    }
+    void unlock() { mutex.unlock(); }
+
+    std::mutex mutex;
+    std::atomic<int> failed{0};
+  };
+
+  // An operation published while the lock holder runs its own must be applied by the
+  // holder before it releases the lock, rather than by its publisher taking the lock later.
+  TEST_F(FlatCombinerTests, HolderAppliesOperationsPublishedDuringItsOwn) {
+    FlatCombiner<4> combiner;
+    CountingMutex mutex;
+    combiner.enable();
+    std::atomic<bool> holding{false};
+    std::thread::id applied_on;
+    std::thread holder([&]() {
+      combiner.apply(mutex, [&]() {
+        holding.store(true);
+        // The waiter publishes right after its first attempt to take the lock fails.
+        while (mutex.failed.load() == 0) {
+          std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      });
+    });
+    while (!holding.load()) {
+      std::this_thread::yield();
+    }
+    combiner.apply(mutex, [&]() { applied_on = std::this_thread::get_id(); });
+    auto const holder_id = holder.get_id();
+    holder.join();
+    ASSERT_EQ(holder_id, applied_on);
+  }
+
+  TEST_F(FlatCombinerTests, MapWritesThroughCombiner) {
+    ShardedUnorderedMap<int, int, 2> m;
+    m.enable_flat_combining();
+    m.enable_bloom_filter();
+    ASSERT_TRUE(m.flat_combining_enabled());
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+      workers.emplace_back([&m, t]() {
+        for (int i = 0; i < 2'000; ++i) {
+          ASSERT_TRUE(m.insert({t * 2'000 + i, i}));
+          ASSERT_FALSE(m.insert_or_assign(t * 2'000 + i, -i));
+          if (i % 2 == 0) {
+            ASSERT_EQ(1, m.erase(t * 2'000 + i));
+          }
+        }
+      });
+    }
+    for (auto &w: workers) {
+      w.join();
+    }
+    ASSERT_EQ(4'000, m.size());
+    for (int key = 0; key < 8'000; ++key) {
+      ASSERT_EQ(key % 2 == 1, m.find(key));
+      if (key % 2 == 1) {
+        ASSERT_EQ(-(key % 2'000), m.at(key));
+      }
+    }
+  }
+
+  TEST_F(FlatCombinerTests, SubscriptAndEmplace) {
+    UnorderedMap<std::string, std::string> m;
+    m.enable_flat_combining();
+    ASSERT_EQ("", m["a"]);
+    ASSERT_TRUE(m.emplace("b", "c"));
+    ASSERT_TRUE(m.try_emplace("d", 2, 'e'));
+    ASSERT_EQ("ee", m.at("d"));
+    auto copy = m;
+    ASSERT_EQ(m, copy);
+  }
+
+} // namespace
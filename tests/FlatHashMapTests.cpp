@@ -0,0 +1,96 @@
+#include <concurrency/FlatHashMap.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <unordered_map>
+
+namespace {
+  using ::concurrency::FlatHashMap;
+
+  class FlatHashMapTests : public ::testing::Test {};
+
+  TEST_F(FlatHashMapTests, InsertFindErase) {
+    FlatHashMap<int, int> m;
+    constexpr int count = 10'000;
+    for (int i = 0; i < count; ++i) {
+      ASSERT_TRUE(m.insert({i, i * 2}).second);
+    }
+    ASSERT_EQ(static_cast<size_t>(count), m.size());
+    for (int i = 0; i < count; ++i) {
+      auto it = m.find(i);
+      ASSERT_NE(m.end(), it);
+      ASSERT_EQ(i * 2, it->second);
+    }
+    ASSERT_EQ(m.end(), m.find(count));
+    for (int i = 0; i < count; i += 2) {
+      ASSERT_EQ(1, m.erase(i));
+    }
+    ASSERT_EQ(static_cast<size_t>(count / 2), m.size());
+    for (int i = 0; i < count; ++i) {
+      ASSERT_EQ(static_cast<size_t>(i % 2), m.count(i));
+    }
+  }
+
+  // Repeated insert/erase cycles leave tombstones behind; the table must
+  // keep finding every live key and must not grow without bound.
+  TEST_F(FlatHashMapTests, TombstoneChurn) {
+    FlatHashMap<int, int> m;
+    for (int round = 0; round < 50; ++round) {
+      for (int i = 0; i < 100; ++i) {
+        ASSERT_TRUE(m.insert({round * 100 + i, i}).second);
+      }
+      for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(1, m.erase(round * 100 + i));
+      }
+    }
+    ASSERT_TRUE(m.empty());
+    ASSERT_LE(m.bucket_count(), 1024);
+  }
+
+  TEST_F(FlatHashMapTests, IterationVisitsEveryElement) {
+    FlatHashMap<std::string, int> m;
+    std::unordered_map<std::string, int> expected;
+    for (int i = 0; i < 500; ++i) {
+      m.insert_or_assign(std::to_string(i), i);
+      expected[std::to_string(i)] = i;
+    }
+    size_t visited = 0;
+    for (auto const &[key, val]: m) {
+      ASSERT_EQ(expected.at(key), val);
+      ++visited;
+    }
+    ASSERT_EQ(expected.size(), visited);
+  }
+
+  TEST_F(FlatHashMapTests, ReserveAvoidsRehash) {
+    FlatHashMap<int, int> m;
+    m.reserve(1000);
+    auto const buckets = m.bucket_count();
+    ASSERT_LE(1000.0f / buckets, m.max_load_factor());
+    for (int i = 0; i < 1000; ++i) {
+      m[i] = i;
+    }
+    ASSERT_EQ(buckets, m.bucket_count());
+  }
+
+  TEST_F(FlatHashMapTests, MergeFromStdContainer) {
+    std::unordered_multimap<int, int> source{{1, 1}, {1, 2}, {2, 2}};
+    FlatHashMap<int, int> m{{2, 3}};
+    m.merge(source);
+    ASSERT_EQ(2, m.size());
+    ASSERT_EQ(3, m.at(2));
+    ASSERT_EQ(2, source.size());
+    ASSERT_EQ(1, source.count(2));
+  }
+
+  TEST_F(FlatHashMapTests, CopyAndMove) {
+    FlatHashMap<std::string, std::string> m{{"foo", "bar"}, {"baz", "qux"}};
+    auto copy = m;
+    ASSERT_EQ(m, copy);
+    auto moved = std::move(copy);
+    ASSERT_EQ(m, moved);
+    ASSERT_TRUE(copy.empty());
+    moved.clear();
+    ASSERT_NE(m, moved);
+  }
+
+} // namespace
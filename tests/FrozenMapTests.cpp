@@ -0,0 +1,141 @@
+#include <concurrency/FrozenMap.hpp>
+#include <concurrency/ShardedUnorderedMap.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+  using ::concurrency::AtomicFrozenMap;
+  using ::concurrency::FrozenMap;
+  using ::concurrency::ShardedUnorderedMap;
+  using ::concurrency::UnorderedMap;
+
+  class FrozenMapTests : public ::testing::Test {};
+
+  TEST_F(FrozenMapTests, LookupMatchesSource) {
+    std::unordered_map<int, int> source;
+    for (int i = 0; i < 10'000; ++i) {
+      source[i * 7] = i;
+    }
+    FrozenMap<int, int> frozen(source);
+    ASSERT_EQ(source.size(), frozen.size());
+    ASSERT_GE(frozen.bucket_count(), frozen.size());
+    for (auto const &[key, val]: source) {
+      ASSERT_TRUE(frozen.find(key));
+      ASSERT_EQ(val, frozen.at(key));
+      ASSERT_EQ(val, *frozen.get(key));
+    }
+    ASSERT_FALSE(frozen.find(1));
+    ASSERT_EQ(0, frozen.count(1));
+    ASSERT_EQ(nullptr, frozen.get(1));
+    ASSERT_THROW(frozen.at(1), std::out_of_range);
+  }
+
+  TEST_F(FrozenMapTests, ParallelBuildMatchesSerialBuild) {
+    std::unordered_map<std::string, int> source;
+    for (int i = 0; i < 5'000; ++i) {
+      source[std::to_string(i)] = i;
+    }
+    FrozenMap<std::string, int> serial(source);
+    for (unsigned threads: {2u, 3u, 4u, 7u}) {
+      FrozenMap<std::string, int> parallel(source, threads);
+      ASSERT_EQ(serial.size(), parallel.size());
+      size_t visited = 0;
+      for (auto const &[key, val]: parallel) {
+        ASSERT_EQ(val, serial.at(key));
+        ++visited;
+      }
+      ASSERT_EQ(source.size(), visited);
+      // Every build lays out the elements in the same order.
+      ASSERT_TRUE(std::equal(serial.begin(), serial.end(), parallel.begin()));
+    }
+
+    // More threads than buckets.
+    std::unordered_map<int, int> small{{1, 1}, {2, 2}, {3, 3}};
+    FrozenMap<int, int> frozen(small, 16);
+    ASSERT_EQ(3, frozen.size());
+    for (auto const &[key, val]: small) {
+      ASSERT_EQ(val, frozen.at(key));
+    }
+  }
+
+  TEST_F(FrozenMapTests, EmptyAndInitializerList) {
+    FrozenMap<int, std::string> empty;
+    ASSERT_TRUE(empty.empty());
+    ASSERT_FALSE(empty.find(0));
+    ASSERT_EQ(empty.begin(), empty.end());
+
+    FrozenMap<int, std::string> frozen{{1, "one"}, {2, "two"}, {1, "uno"}};
+    ASSERT_EQ(2, frozen.size());
+    ASSERT_EQ("one", frozen.at(1));
+    auto moved = std::move(frozen);
+    ASSERT_TRUE(frozen.empty());
+    ASSERT_EQ("two", moved.at(2));
+  }
+
+  TEST_F(FrozenMapTests, FreezeWrappers) {
+    UnorderedMap<int, int> map;
+    ShardedUnorderedMap<int, int> sharded;
+    for (int i = 0; i < 1'000; ++i) {
+      map.insert({i, -i});
+      sharded.insert({i, -i});
+    }
+    auto const frozen         = map.freeze();
+    auto const frozen_sharded = sharded.freeze(4);
+    map.clear();
+    sharded.clear();
+    ASSERT_EQ(1'000, frozen.size());
+    ASSERT_EQ(1'000, frozen_sharded.size());
+    for (int i = 0; i < 1'000; ++i) {
+      ASSERT_EQ(-i, frozen.at(i));
+      ASSERT_EQ(-i, frozen_sharded.at(i));
+    }
+  }
+
+  TEST_F(FrozenMapTests, AtomicSwapKeepsOldSnapshotsAlive) {
+    ShardedUnorderedMap<int, int> source{{1, 1}};
+    AtomicFrozenMap<int, int> current(source.freeze(2));
+    auto const old = current.load();
+    ASSERT_EQ(0, current.generation());
+
+    source.insert_or_assign(1, 2);
+    source.insert({2, 2});
+    current.rebuild_async(source, 2).get();
+    ASSERT_EQ(1, current.generation());
+    ASSERT_EQ(2, current.load()->at(1));
+    ASSERT_EQ(2, current.load()->size());
+    ASSERT_EQ(1, old->at(1));
+    ASSERT_FALSE(old->find(2));
+  }
+
+  TEST_F(FrozenMapTests, ConcurrentReadersDuringRebuild) {
+    UnorderedMap<int, int> source;
+    for (int i = 0; i < 1'000; ++i) {
+      source.insert({i, i});
+    }
+    AtomicFrozenMap<int, int> current(source.freeze());
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+      readers.emplace_back([&current]() {
+        for (int round = 0; round < 200; ++round) {
+          auto const snapshot = current.load();
+          for (int i = 0; i < 1'000; i += 97) {
+            ASSERT_TRUE(snapshot->find(i));
+          }
+        }
+      });
+    }
+    for (int gen = 0; gen < 10; ++gen) {
+      source.insert({1'000 + gen, gen});
+      current.store(source.freeze());
+    }
+    for (auto &th: readers) {
+      th.join();
+    }
+    ASSERT_EQ(1'010, current.load()->size());
+  }
+
+} // namespace
@@ -0,0 +1,91 @@
+#include <concurrency/ShardedUnorderedMap.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  using ::concurrency::ShardedUnorderedMap;
+  using ::concurrency::UnorderedMap;
+
+  class GetOrComputeTests : public ::testing::Test {};
+
+  TEST_F(GetOrComputeTests, ComputesOnlyOnMiss) {
+    UnorderedMap<std::string, int> m{{"foo", 1}};
+    int calls = 0;
+    ASSERT_EQ(1, m.get_or_compute("foo", [&calls]() { return ++calls; }));
+    ASSERT_EQ(1, m.get_or_compute("bar", [&calls]() { return ++calls; }));
+    ASSERT_EQ(1, m.get_or_compute("bar", [&calls]() { return ++calls; }));
+    ASSERT_EQ(1, calls);
+    ASSERT_EQ(1, m.at("bar"));
+  }
+
+  TEST_F(GetOrComputeTests, ConcurrentCallersShareOneComputation) {
+    ShardedUnorderedMap<int, std::string, 4> m;
+    m.enable_bloom_filter();
+    std::atomic_int calls{0};
+    std::atomic_bool go{false};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 16; ++t) {
+      workers.emplace_back([&]() {
+        while (!go.load()) {
+          std::this_thread::yield();
+        }
+        auto const value = m.get_or_compute(42, [&calls]() {
+          ++calls;
+          std::this_thread::sleep_for(std::chrono::milliseconds(50));
+          return std::string("expensive");
+        });
+        ASSERT_EQ("expensive", value);
+      });
+    }
+    go.store(true);
+    for (auto &w: workers) {
+      w.join();
+    }
+    ASSERT_EQ(1, calls.load());
+    ASSERT_EQ("expensive", m.at(42));
+  }
+
+  TEST_F(GetOrComputeTests, FailuresArePropagatedAndNotCached) {
+    ShardedUnorderedMap<int, int, 2> m;
+    std::atomic_bool go{false};
+    std::atomic_int failures{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+      workers.emplace_back([&]() {
+        while (!go.load()) {
+          std::this_thread::yield();
+        }
+        try {
+          (void) m.get_or_compute(7, []() -> int {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            throw std::runtime_error("backing store unavailable");
+          });
+        } catch (const std::runtime_error &) {
+          ++failures;
+        }
+      });
+    }
+    go.store(true);
+    for (auto &w: workers) {
+      w.join();
+    }
+    ASSERT_EQ(4, failures.load());
+    ASSERT_FALSE(m.find(7));
+    ASSERT_EQ(8, m.get_or_compute(7, []() { return 8; }));
+  }
+
+  TEST_F(GetOrComputeTests, ExistingElementWinsOverComputedOne) {
+    UnorderedMap<int, int> m;
+    ASSERT_EQ(1, m.get_or_compute(3, [&m]() {
+      m.insert({3, 1});
+      return 2;
+    }));
+    ASSERT_EQ(1, m.at(3));
+  }
+
+} // namespace
@@ -0,0 +1,277 @@
+#include <concurrency/MapSnapshot.hpp>
+#include <concurrency/ShardedUnorderedMap.hpp>
+#include <concurrency/ThreadPool.hpp>
+#include <concurrency/UnorderedMap.hpp>
+#include <gtest/gtest.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+  using ::concurrency::AffinityHash;
+  using ::concurrency::MappedSnapshot;
+  using ::concurrency::ShardedUnorderedMap;
+  using ::concurrency::ThreadPool;
+  using ::concurrency::UnorderedMap;
+
+  struct Point {
+    int32_t x;
+    int32_t y;
+    double weight;
+  };
+
+  class MapSnapshotTests : public ::testing::Test {
+  protected:
+    void TearDown() override { (void) std::remove(path.c_str()); }
+
+    std::string path = ::testing::TempDir() + "concurrency_map_snapshot_" + ::testing::UnitTest::GetInstance()->current_test_info()->name();
+  };
+
+  TEST_F(MapSnapshotTests, UnorderedMapRoundTrip) {
+    UnorderedMap<int, Point> m;
+    for (int i = 0; i < 1000; ++i) {
+      (void) m.insert({i, Point{i, -i, i / 2.0}});
+    }
+    m.save(path);
+
+    UnorderedMap<int, Point> loaded{{5000, Point{0, 0, 0}}};
+    loaded.enable_bloom_filter();
+    loaded.load(path);
+    ASSERT_EQ(1000, loaded.size());
+    ASSERT_FALSE(loaded.find(5000));
+    for (int i = 0; i < 1000; ++i) {
+      auto const p = loaded.at(i);
+      ASSERT_EQ(-i, p.y);
+      ASSERT_EQ(i / 2.0, p.weight);
+    }
+  }
+
+  TEST_F(MapSnapshotTests, ShardedRoundTripInParallel) {
+    ThreadPool pool(4);
+    ShardedUnorderedMap<uint64_t, uint64_t, 8> m;
+    for (uint64_t i = 0; i < 20000; ++i) {
+      (void) m.insert({i * 7919, i});
+    }
+    m.save(path, pool);
+
+    ShardedUnorderedMap<uint64_t, uint64_t, 8> loaded;
+    loaded.load(path, pool);
+    ASSERT_TRUE(m == loaded);
+
+    ShardedUnorderedMap<uint64_t, uint64_t, 8> sequential;
+    sequential.load(path);
+    ASSERT_TRUE(m == sequential);
+  }
+
+  TEST_F(MapSnapshotTests, LoadsIntoADifferentShardCount) {
+    ShardedUnorderedMap<int, int, 4> m;
+    for (int i = 0; i < 500; ++i) {
+      (void) m.insert({i, i * i});
+    }
+    m.save(path);
+
+    ShardedUnorderedMap<int, int, 7> resharded;
+    resharded.load(path);
+    ASSERT_EQ(500, resharded.size());
+    for (int i = 0; i < 500; ++i) {
+      ASSERT_EQ(i * i, resharded.at(i));
+    }
+    UnorderedMap<int, int> single;
+    single.load(path);
+    ASSERT_EQ(500, single.size());
+    ASSERT_EQ(49, single.at(7));
+  }
+
+  TEST_F(MapSnapshotTests, MappedSnapshotServesLookups) {
+    ShardedUnorderedMap<int, Point, 4> m;
+    for (int i = 0; i < 300; ++i) {
+      (void) m.insert({i, Point{i, i + 1, 0.5}});
+    }
+    m.save(path);
+
+    decltype(m)::snapshot_type snapshot(path);
+    ASSERT_EQ(300, snapshot.size());
+    ASSERT_EQ(4, snapshot.shard_count());
+    ASSERT_TRUE(snapshot.find(42));
+    ASSERT_EQ(1, snapshot.count(42));
+    ASSERT_EQ(43, snapshot.at(42).y);
+    ASSERT_EQ(nullptr, snapshot.get(300));
+    ASSERT_THROW((void) snapshot.at(-1), std::out_of_range);
+    long sum = 0;
+    snapshot.for_each([&sum](const int &k, const Point &p) { sum += k + p.x; });
+    ASSERT_EQ(2 * (299 * 300 / 2), sum);
+
+    // Lookups may run concurrently without locks.
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&snapshot]() {
+        for (int i = 0; i < 300; ++i) {
+          ASSERT_EQ(i, snapshot.at(i).x);
+        }
+      });
+    }
+    for (auto &t: threads) {
+      t.join();
+    }
+  }
+
+  TEST_F(MapSnapshotTests, MappedSnapshotFollowsShardHash) {
+    struct TenantKey {
+      int tenant;
+      int id;
+      bool operator==(const TenantKey &other) const { return tenant == other.tenant && id == other.id; }
+    };
+    struct TenantKeyHash {
+      std::size_t operator()(const TenantKey &k) const { return std::hash<int>()(k.tenant) * 31 + std::hash<int>()(k.id); }
+    };
+    struct TenantOf {
+      int operator()(const TenantKey &k) const { return k.tenant; }
+    };
+    using Hash = AffinityHash<TenantKey, TenantOf, TenantKeyHash>;
+
+    ShardedUnorderedMap<TenantKey, int, 16, Hash> m;
+    for (int tenant = 0; tenant < 10; ++tenant) {
+      for (int id = 0; id < 10; ++id) {
+        (void) m.insert({{tenant, id}, tenant * 100 + id});
+      }
+    }
+    m.save(path);
+    decltype(m)::snapshot_type snapshot(path);
+    ASSERT_EQ(907, snapshot.at({9, 7}));
+    ASSERT_FALSE(snapshot.find({10, 0}));
+  }
+
+  TEST_F(MapSnapshotTests, EmptyMapRoundTrip) {
+    ShardedUnorderedMap<int, int, 4> m;
+    m.save(path);
+    MappedSnapshot<int, int> snapshot(path);
+    ASSERT_TRUE(snapshot.empty());
+    ASSERT_FALSE(snapshot.find(1));
+
+    ShardedUnorderedMap<int, int, 4> loaded{{1, 1}};
+    loaded.load(path);
+    ASSERT_TRUE(loaded.empty());
+  }
+
+  TEST_F(MapSnapshotTests, RejectsMismatchedAndCorruptFiles) {
+    ASSERT_THROW((void) (MappedSnapshot<int, int>(path)), std::system_error);
+
+    UnorderedMap<int, int> m{{1, 1}, {2, 2}};
+    m.save(path);
+    ASSERT_THROW((void) (MappedSnapshot<int64_t, int>(path)), std::runtime_error);
+    ASSERT_THROW((void) (MappedSnapshot<int, double>(path)), std::runtime_error);
+
+    std::string bytes;
+    {
+      std::ifstream in(path, std::ios::binary);
+      bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto const rewrite = [this](const std::string &contents) {
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    };
+    rewrite(bytes.substr(0, bytes.size() - 1));
+    ASSERT_THROW((void) (MappedSnapshot<int, int>(path)), std::runtime_error);
+    rewrite("not a snapshot");
+    ASSERT_THROW((void) (MappedSnapshot<int, int>(path)), std::runtime_error);
+    auto corrupt = bytes;
+    corrupt[0]   = 'X';
+    rewrite(corrupt);
+    UnorderedMap<int, int> loaded{{3, 3}};
+    ASSERT_THROW(loaded.load(path), std::runtime_error);
+    ASSERT_EQ(3, loaded.at(3));
+  }
+
+  TEST_F(MapSnapshotTests, RecordPaddingIsZeroed) {
+    using record_type = ::concurrency::detail::SnapshotRecord<int, Point>;
+    constexpr std::size_t padding_begin = offsetof(record_type, key) + sizeof(int);
+    constexpr std::size_t padding_end   = offsetof(record_type, value);
+    static_assert(padding_begin < padding_end, "The record is expected to hold padding.");
+
+    UnorderedMap<int, Point> m;
+    for (int i = 0; i < 100; ++i) {
+      (void) m.insert({i, Point{i, i, i / 2.0}});
+    }
+    m.save(path);
+    std::string bytes;
+    {
+      std::ifstream in(path, std::ios::binary);
+      bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    ::concurrency::detail::SnapshotSection section;
+    std::memcpy(&section, bytes.data() + sizeof(::concurrency::detail::SnapshotHeader), sizeof(section));
+    ASSERT_EQ(100, section.element_count);
+    for (uint64_t r = 0; r < section.element_count; ++r) {
+      auto const record = section.records_offset + r * sizeof(record_type);
+      for (auto b = padding_begin; b < padding_end; ++b) {
+        ASSERT_EQ('\0', bytes[record + b]) << r;
+      }
+    }
+  }
+
+  // Saves to the same path from several threads must not share a temporary file, so
+  // every save succeeds and the survivor is one complete snapshot.
+  TEST_F(MapSnapshotTests, ConcurrentSavesToOnePath) {
+    constexpr int threads = 4;
+    std::vector<std::thread> savers;
+    for (int t = 0; t < threads; ++t) {
+      savers.emplace_back([this, t]() {
+        UnorderedMap<int, int> m;
+        for (int i = 0; i < 1000; ++i) {
+          (void) m.insert({i, t});
+        }
+        for (int round = 0; round < 20; ++round) {
+          EXPECT_NO_THROW(m.save(path));
+        }
+      });
+    }
+    for (auto &s: savers) {
+      s.join();
+    }
+    UnorderedMap<int, int> loaded;
+    loaded.load(path);
+    ASSERT_EQ(1000, loaded.size());
+    auto const saver = loaded.at(0);
+    for (int i = 0; i < 1000; ++i) {
+      ASSERT_EQ(saver, loaded.at(i));
+    }
+  }
+
+  // Saving while other threads write must produce a loadable snapshot holding every
+  // element that was present throughout.
+  TEST_F(MapSnapshotTests, SaveUnderConcurrentWrites) {
+    ShardedUnorderedMap<int, int, 8> m;
+    for (int i = 0; i < 1000; ++i) {
+      (void) m.insert({i, i});
+    }
+    ThreadPool pool(2);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 2; ++t) {
+      writers.emplace_back([&m, t]() {
+        for (int i = 0; i < 5000; ++i) {
+          (void) m.insert_or_assign(1000 + t * 5000 + i, i);
+        }
+      });
+    }
+    for (int round = 0; round < 5; ++round) {
+      m.save(path, pool);
+      ShardedUnorderedMap<int, int, 8> loaded;
+      loaded.load(path);
+      for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(i, loaded.at(i));
+      }
+    }
+    for (auto &t: writers) {
+      t.join();
+    }
+  }
+
+} // namespace
@@ -0,0 +1,188 @@
+#include <concurrency/OrderedMap.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+  using ::concurrency::OrderedMap;
+
+  std::vector<std::pair<int, std::string>> range_of(const OrderedMap<int, std::string> &m, int lo, int hi) {
+    std::vector<std::pair<int, std::string>> visited;
+    auto n = m.visit_range(lo, hi, [&visited](const int &k, const std::string &v) { visited.emplace_back(k, v); });
+    EXPECT_EQ(n, visited.size());
+    return visited;
+  }
+
+  TEST(OrderedMapTests, InsertFindErase) {
+    OrderedMap<int, std::string> m{{2, "two"}, {1, "one"}};
+    ASSERT_EQ(2, m.size());
+    ASSERT_TRUE(m.insert(3, "three"));
+    ASSERT_FALSE(m.insert(3, "drei"));
+    ASSERT_EQ("three", m.at(3));
+    ASSERT_FALSE(m.insert_or_assign(3, "drei"));
+    ASSERT_EQ("drei", m.at(3));
+    ASSERT_TRUE(m.find(1));
+    ASSERT_TRUE(m.contains(2));
+    ASSERT_EQ(1, m.count(3));
+    ASSERT_FALSE(m.find(4));
+    ASSERT_THROW((void) m.at(4), std::out_of_range);
+    ASSERT_EQ(1, m.erase(2));
+    ASSERT_EQ(0, m.erase(2));
+    ASSERT_FALSE(m.find(2));
+    ASSERT_EQ(2, m.size());
+    m.clear();
+    ASSERT_TRUE(m.empty());
+    ASSERT_FALSE(m.find(1));
+  }
+
+  TEST(OrderedMapTests, VisitRangeIsOrderedAndHalfOpen) {
+    OrderedMap<int, std::string> m;
+    for (int i = 99; i >= 0; --i) {
+      ASSERT_TRUE(m.insert(i * 2, std::to_string(i * 2)));
+    }
+    auto visited = range_of(m, 11, 21);
+    ASSERT_EQ((std::vector<std::pair<int, std::string>>{{12, "12"}, {14, "14"}, {16, "16"}, {18, "18"}, {20, "20"}}), visited);
+    ASSERT_EQ(0, range_of(m, 500, 600).size());
+    ASSERT_EQ(0, range_of(m, 7, 7).size());
+    ASSERT_EQ(100, range_of(m, -1, 1000).size());
+  }
+
+  TEST(OrderedMapTests, CustomComparator) {
+    OrderedMap<int, int, std::greater<int>> m;
+    for (int i = 0; i < 10; ++i) {
+      (void) m.insert(i, i);
+    }
+    std::vector<int> keys;
+    (void) m.visit_range(7, 3, [&keys](const int &k, const int &) { keys.push_back(k); });
+    ASSERT_EQ((std::vector<int>{7, 6, 5, 4}), keys);
+    auto data = m.data();
+    ASSERT_EQ(9, data.begin()->first);
+  }
+
+  TEST(OrderedMapTests, DataMatchesStdMap) {
+    OrderedMap<int, int> m;
+    std::map<int, int> expected;
+    for (int i = 0; i < 1000; ++i) {
+      auto const k = (i * 7919) % 1009;
+      (void) m.insert_or_assign(k, i);
+      expected[k] = i;
+      if (i % 3 == 0) {
+        ASSERT_EQ(expected.erase(k / 2), m.erase(k / 2));
+      }
+    }
+    ASSERT_EQ(expected, m.data());
+    ASSERT_EQ(expected.size(), m.size());
+  }
+
+  TEST(OrderedMapTests, ConcurrentWritersAndRangeScans) {
+    OrderedMap<int, int> m;
+    constexpr int thread_count = 4;
+    constexpr int per_thread   = 2000;
+    std::atomic<bool> stop{false};
+    std::thread scanner([&]() {
+      while (!stop.load()) {
+        int previous = -1;
+        (void) m.visit_range(0, thread_count * per_thread, [&previous](const int &k, const int &v) {
+          ASSERT_LT(previous, k);
+          ASSERT_EQ(k, v);
+          previous = k;
+        });
+      }
+    });
+    std::vector<std::thread> writers;
+    for (int t = 0; t < thread_count; ++t) {
+      writers.emplace_back([&m, t]() {
+        for (int i = t; i < thread_count * per_thread; i += thread_count) {
+          ASSERT_TRUE(m.insert(i, i));
+        }
+        for (int i = t; i < thread_count * per_thread; i += 2 * thread_count) {
+          ASSERT_EQ(1, m.erase(i));
+        }
+      });
+    }
+    for (auto &w: writers) {
+      w.join();
+    }
+    stop.store(true);
+    scanner.join();
+    ASSERT_EQ(thread_count * per_thread / 2, m.size());
+    auto data = m.data();
+    ASSERT_EQ(m.size(), data.size());
+    for (auto const &el: data) {
+      ASSERT_EQ(1, (el.first / thread_count) % 2) << el.first;
+    }
+  }
+
+  // Counts the instances alive, so that tests can tell when erased values are freed.
+  struct Counted {
+    Counted() { alive.fetch_add(1); }
+    Counted(const Counted &) { alive.fetch_add(1); }
+    Counted &operator=(const Counted &) = default;
+    ~Counted() { alive.fetch_sub(1); }
+
+    static inline std::atomic<int> alive{0};
+  };
+
+  // Erased nodes must be freed even if a search is in progress at every moment. Each round
+  // starts a range scan that stays inside its callback until the next round has started one,
+  // so the map never goes quiet.
+  TEST(OrderedMapTests, ErasedNodesAreFreedWhileSearchesContinue) {
+    OrderedMap<int, Counted> m;
+    ASSERT_TRUE(m.insert(0, Counted()));
+    constexpr int rounds    = 10;
+    constexpr int per_round = 100;
+    std::vector<std::promise<void>> releases(rounds);
+    std::vector<std::thread> scanners;
+    for (int r = 0; r < rounds; ++r) {
+      std::promise<void> started;
+      auto release = releases[r].get_future();
+      scanners.emplace_back([&m, &started, release = std::move(release)]() mutable {
+        (void) m.visit_range(0, 1, [&](const int &, const Counted &) {
+          started.set_value();
+          release.wait();
+        });
+      });
+      started.get_future().wait();
+      if (r > 0) releases[r - 1].set_value();
+      for (int i = 1; i <= per_round; ++i) {
+        ASSERT_TRUE(m.insert(r * per_round + i, Counted()));
+        ASSERT_EQ(1, m.erase(r * per_round + i));
+      }
+    }
+    // The last scan is still in progress.
+    EXPECT_LT(Counted::alive.load(), rounds * per_round / 2);
+    releases.back().set_value();
+    for (auto &s: scanners) {
+      s.join();
+    }
+  }
+
+  TEST(OrderedMapTests, ConcurrentWritesToSameKeys) {
+    OrderedMap<int, int> m;
+    constexpr int thread_count = 4;
+    std::atomic<int> inserted{0};
+    std::atomic<int> erased{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+      threads.emplace_back([&]() {
+        for (int i = 0; i < 2000; ++i) {
+          if (m.insert(i % 64, i)) inserted.fetch_add(1);
+          erased.fetch_add(static_cast<int>(m.erase((i * 7) % 64)));
+        }
+      });
+    }
+    for (auto &t: threads) {
+      t.join();
+    }
+    ASSERT_EQ(static_cast<std::size_t>(inserted.load() - erased.load()), m.size());
+    ASSERT_EQ(m.size(), m.data().size());
+  }
+
+} // namespace
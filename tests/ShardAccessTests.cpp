@@ -0,0 +1,116 @@
+#include <concurrency/ShardedUnorderedMap.hpp>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+  using ::concurrency::AffinityHash;
+  using ::concurrency::ShardedUnorderedMap;
+
+  // Keys of the form (tenant, id), co-located by tenant.
+  using TenantKey = std::pair<int, int>;
+
+  struct TenantKeyHash {
+    std::size_t operator()(const TenantKey &k) const { return std::hash<int>()(k.first) * 31 + std::hash<int>()(k.second); }
+  };
+
+  struct TenantOf {
+    int operator()(const TenantKey &k) const { return k.first; }
+  };
+
+  using TenantMap = ShardedUnorderedMap<TenantKey, std::string, 16, AffinityHash<TenantKey, TenantOf, TenantKeyHash>>;
+
+  class ShardAccessTests : public ::testing::Test {};
+
+  TEST_F(ShardAccessTests, WithShardRunsGroupUnderOneLock) {
+    ShardedUnorderedMap<int, int, 1> m{{1, 1}};
+    auto const sum = m.with_shard(1, [](auto &shard) {
+      shard.at(1) += 1;
+      (void) shard.try_emplace(2, 20);
+      (void) shard.upsert(2, 2, [](const int &a, const int &b) { return a + b; });
+      (void) shard.insert_or_assign(3, 30);
+      (void) shard.erase(3);
+      int total = 0;
+      for (auto const &el: shard.map()) {
+        total += el.second;
+      }
+      return total;
+    });
+    ASSERT_EQ(24, sum);
+    ASSERT_EQ(2, m.at(1));
+    ASSERT_EQ(22, m.at(2));
+    ASSERT_FALSE(m.find(3));
+  }
+
+  TEST_F(ShardAccessTests, GuardRejectsKeysOfOtherShards) {
+    ShardedUnorderedMap<int, int, 4> m;
+    ASSERT_EQ(1, m.shard_index(1));
+    {
+      auto guard = m.lock_shard(1);
+      ASSERT_EQ(1, guard.index());
+      ASSERT_TRUE(guard.try_emplace(5, 5));
+      ASSERT_THROW((void) guard.try_emplace(2, 2), std::invalid_argument);
+      ASSERT_EQ(nullptr, guard.find(9));
+      ASSERT_EQ(1, guard.size());
+    }
+    ASSERT_THROW((void) m.lock_shard(4), std::out_of_range);
+    ASSERT_EQ(5, m.at(5));
+  }
+
+  TEST_F(ShardAccessTests, MutableMapRequiresBloomFilterOff) {
+    ShardedUnorderedMap<int, int, 2> m;
+    {
+      auto guard = m.lock_shard(0);
+      guard.mutable_map().emplace(4, 4);
+    }
+    ASSERT_EQ(4, m.at(4));
+    m.enable_bloom_filter();
+    auto guard = m.lock_shard(0);
+    ASSERT_THROW((void) guard.mutable_map(), std::logic_error);
+  }
+
+  TEST_F(ShardAccessTests, AffinityHashCoLocatesGroups) {
+    TenantMap m;
+    for (int tenant = 0; tenant < 8; ++tenant) {
+      for (int id = 0; id < 50; ++id) {
+        ASSERT_EQ(m.shard_index({tenant, 0}), m.shard_index({tenant, id}));
+      }
+    }
+    m.with_shard({3, 0}, [](auto &shard) {
+      for (int id = 0; id < 10; ++id) {
+        (void) shard.insert_or_assign({3, id}, std::to_string(id));
+      }
+    });
+    ASSERT_EQ(10, m.size());
+    ASSERT_EQ("7", m.at({3, 7}));
+    ASSERT_FALSE(m.find({4, 7}));
+  }
+
+  TEST_F(ShardAccessTests, ConcurrentGuardsAndPlainWrites) {
+    ShardedUnorderedMap<int, int, 4> m;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&m, t]() {
+        for (int i = 0; i < 2000; ++i) {
+          if (t % 2 == 0) {
+            m.with_shard(i % 4, [](auto &shard) { (void) shard.upsert(shard.index(), 1, [](const int &a, const int &b) { return a + b; }); });
+          } else {
+            (void) m.upsert(i % 4, 1, [](const int &a, const int &b) { return a + b; });
+          }
+        }
+      });
+    }
+    for (auto &t: threads) {
+      t.join();
+    }
+    int total = 0;
+    for (int k = 0; k < 4; ++k) {
+      total += m.at(k);
+    }
+    ASSERT_EQ(8000, total);
+  }
+
+} // namespace
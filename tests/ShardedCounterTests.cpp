@@ -0,0 +1,107 @@
+#include <concurrency/CounterMap.hpp>
+#include <concurrency/ShardedCounter.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+  using ::concurrency::CounterMap;
+  using ::concurrency::ShardedCounter;
+
+  TEST(ShardedCounterTests, StripeCountIsRoundedUpToPowerOfTwo) {
+    ASSERT_EQ(1, ShardedCounter(0).stripe_count());
+    ASSERT_EQ(8, ShardedCounter(5).stripe_count());
+    ASSERT_EQ(8, CounterMap<int>(8).stripe_count());
+  }
+
+  TEST(ShardedCounterTests, AddSumAndReset) {
+    ShardedCounter c(4);
+    ASSERT_EQ(0, c.sum());
+    c.increment();
+    c.add(10);
+    c.decrement();
+    ASSERT_EQ(10, c.sum());
+    ASSERT_EQ(10, c.sum_and_reset());
+    ASSERT_EQ(0, c.sum());
+    c.add(-3);
+    ASSERT_EQ(-3, c.sum());
+    c.reset();
+    ASSERT_EQ(0, c.sum());
+  }
+
+  TEST(ShardedCounterTests, ConcurrentIncrementsAreNotLost) {
+    ShardedCounter c(2);
+    std::atomic<int64_t> drained{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&c]() {
+        for (int i = 0; i < 50'000; ++i) {
+          c.increment();
+        }
+      });
+    }
+    threads.emplace_back([&c, &drained]() {
+      for (int i = 0; i < 100; ++i) {
+        drained.fetch_add(c.sum_and_reset());
+      }
+    });
+    for (auto &t: threads) {
+      t.join();
+    }
+    ASSERT_EQ(200'000, drained.load() + c.sum());
+  }
+
+  TEST(ShardedCounterTests, CounterMapSumsAcrossStripes) {
+    CounterMap<std::string> m(4);
+    ASSERT_EQ(0, m.sum("missing"));
+    m.increment("a");
+    m.add("b", 5);
+    m.decrement("b");
+    std::vector<std::string> keys{"a", "a", "c"};
+    m.add_many(keys.begin(), keys.end());
+    ASSERT_EQ(3, m.sum("a"));
+    ASSERT_EQ(4, m.sum("b"));
+    ASSERT_EQ(1, m.sum("c"));
+    ASSERT_EQ(8, m.total());
+    ASSERT_EQ((std::unordered_map<std::string, int64_t>{{"a", 3}, {"b", 4}, {"c", 1}}), m.data());
+    ASSERT_TRUE(m.erase("a"));
+    ASSERT_FALSE(m.erase("a"));
+    ASSERT_EQ(0, m.sum("a"));
+    m.clear();
+    ASSERT_EQ(0, m.total());
+    ASSERT_TRUE(m.data().empty());
+  }
+
+  TEST(ShardedCounterTests, CounterMapConcurrentIncrements) {
+    constexpr int thread_count = 6;
+    constexpr int key_count    = 100;
+    constexpr int per_thread   = 20'000;
+    CounterMap<int> m(4);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+      threads.emplace_back([&m]() {
+        for (int i = 0; i < per_thread; ++i) {
+          m.increment(i % key_count);
+        }
+      });
+    }
+    threads.emplace_back([&m]() {
+      for (int i = 0; i < 100; ++i) {
+        (void) m.sum(i % key_count);
+      }
+    });
+    for (auto &t: threads) {
+      t.join();
+    }
+    auto const data = m.data();
+    ASSERT_EQ(static_cast<std::size_t>(key_count), data.size());
+    for (auto const &el: data) {
+      ASSERT_EQ(thread_count * per_thread / key_count, el.second) << el.first;
+    }
+    ASSERT_EQ(thread_count * per_thread, m.total());
+  }
+
+} // namespace
@@ -0,0 +1,131 @@
+#include <concurrency/ShardedLruCache.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  using ::concurrency::ShardedLruCache;
+
+  class ShardedLruCacheTests : public ::testing::Test {};
+
+  TEST_F(ShardedLruCacheTests, GetAndPut) {
+    ShardedLruCache<std::string, int, 4> cache(100);
+    ASSERT_EQ(100, cache.capacity());
+    ASSERT_TRUE(cache.empty());
+    ASSERT_FALSE(cache.get("foo"));
+    ASSERT_TRUE(cache.put("foo", 1));
+    ASSERT_FALSE(cache.put("foo", 2));
+    ASSERT_EQ(2, cache.get("foo").value());
+    ASSERT_TRUE(cache.contains("foo"));
+    ASSERT_EQ(1, cache.size());
+    ASSERT_EQ(1, cache.hits());
+    ASSERT_EQ(1, cache.misses());
+    ASSERT_TRUE(cache.erase("foo"));
+    ASSERT_FALSE(cache.erase("foo"));
+    ASSERT_FALSE(cache.contains("foo"));
+    ASSERT_EQ(0, cache.evictions());
+  }
+
+  TEST_F(ShardedLruCacheTests, EvictsUnreferencedEntriesFirst) {
+    ShardedLruCache<int, int, 1> cache(4);
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_TRUE(cache.put(i, i));
+    }
+    ASSERT_TRUE(cache.get(0));
+    ASSERT_TRUE(cache.get(2));
+    ASSERT_TRUE(cache.put(4, 4));
+    ASSERT_EQ(4, cache.size());
+    ASSERT_EQ(1, cache.evictions());
+    ASSERT_TRUE(cache.contains(0));
+    ASSERT_FALSE(cache.contains(1));
+    ASSERT_TRUE(cache.contains(2));
+    ASSERT_TRUE(cache.put(5, 5));
+    ASSERT_FALSE(cache.contains(3));
+    ASSERT_TRUE(cache.contains(4));
+    ASSERT_TRUE(cache.contains(5));
+  }
+
+  TEST_F(ShardedLruCacheTests, ErasedSlotsAreReusedBeforeEvicting) {
+    ShardedLruCache<int, int, 1> cache(2);
+    cache.put(1, 1);
+    cache.put(2, 2);
+    cache.erase(1);
+    cache.put(3, 3);
+    ASSERT_EQ(0, cache.evictions());
+    cache.clear();
+    ASSERT_TRUE(cache.empty());
+    cache.put(4, 4);
+    cache.put(5, 5);
+    cache.put(6, 6);
+    ASSERT_EQ(2, cache.size());
+    ASSERT_EQ(1, cache.evictions());
+  }
+
+  // A value that cannot be constructed from a negative number.
+  struct NonNegative {
+    NonNegative(int v) : value(v) {
+      if (v < 0) throw std::invalid_argument("negative");
+    }
+    int value;
+  };
+
+  TEST_F(ShardedLruCacheTests, FailedInsertionsReturnTheirSlot) {
+    ShardedLruCache<int, NonNegative, 1> cache(2);
+    ASSERT_THROW(cache.put(1, -1), std::invalid_argument);
+    ASSERT_TRUE(cache.put(2, 2));
+    ASSERT_TRUE(cache.put(3, 3));
+    ASSERT_EQ(2, cache.size());
+    ASSERT_EQ(0, cache.evictions());
+
+    // The victim evicted to make room is gone, but its slot is reused.
+    ASSERT_THROW(cache.put(4, -4), std::invalid_argument);
+    ASSERT_EQ(1, cache.size());
+    ASSERT_EQ(1, cache.evictions());
+    ASSERT_TRUE(cache.put(5, 5));
+    ASSERT_EQ(1, cache.evictions());
+    for (int i = 6; i < 20; ++i) {
+      ASSERT_TRUE(cache.put(i, i));
+      ASSERT_EQ(2, cache.size());
+    }
+    ASSERT_EQ(19, cache.get(19)->value);
+  }
+
+  TEST_F(ShardedLruCacheTests, GetOrLoadCallsLoaderOnlyOnMiss) {
+    ShardedLruCache<int, std::string, 2> cache(10);
+    int loads   = 0;
+    auto loader = [&loads](int key) {
+      ++loads;
+      return std::to_string(key);
+    };
+    ASSERT_EQ("7", cache.get_or_load(7, loader));
+    ASSERT_EQ("7", cache.get_or_load(7, loader));
+    ASSERT_EQ(1, loads);
+    ASSERT_EQ(1, cache.hits());
+    ASSERT_EQ(1, cache.misses());
+    ASSERT_THROW(cache.get_or_load(8, [](int) -> std::string { throw std::runtime_error("unavailable"); }), std::runtime_error);
+    ASSERT_FALSE(cache.contains(8));
+  }
+
+  TEST_F(ShardedLruCacheTests, ConcurrentAccessStaysWithinCapacity) {
+    ShardedLruCache<int, int, 8> cache(256);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+      workers.emplace_back([&cache, t]() {
+        for (int i = 0; i < 20'000; ++i) {
+          auto const key = (i * 7 + t) % 1'000;
+          ASSERT_EQ(key * 2, cache.get_or_load(key, [](int k) { return k * 2; }));
+        }
+      });
+    }
+    for (auto &w: workers) {
+      w.join();
+    }
+    ASSERT_LE(cache.size(), cache.capacity());
+    ASSERT_EQ(80'000, cache.hits() + cache.misses());
+    ASSERT_GT(cache.evictions(), 0);
+  }
+
+} // namespace
@@ -0,0 +1,150 @@
+#include <concurrency/StripedUnorderedMap.hpp>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+  using ::concurrency::StripedUnorderedMap;
+
+  class StripedUnorderedMapTests : public ::testing::Test {};
+
+  TEST_F(StripedUnorderedMapTests, InsertFindErase) {
+    StripedUnorderedMap<int, int> m;
+    for (int i = 0; i < 10'000; ++i) {
+      ASSERT_TRUE(m.insert({i, i * 2}));
+    }
+    ASSERT_FALSE(m.insert({0, 1}));
+    ASSERT_EQ(10'000, m.size());
+    ASSERT_LE(m.load_factor(), m.max_load_factor());
+    for (int i = 0; i < 10'000; ++i) {
+      ASSERT_EQ(i * 2, m.at(i));
+    }
+    ASSERT_THROW(m.at(-1), std::out_of_range);
+    for (int i = 0; i < 10'000; i += 2) {
+      ASSERT_EQ(1, m.erase(i));
+    }
+    ASSERT_EQ(0, m.erase(0));
+    for (int i = 0; i < 10'000; ++i) {
+      ASSERT_EQ(static_cast<size_t>(i % 2), m.count(i));
+    }
+  }
+
+  TEST_F(StripedUnorderedMapTests, Modifiers) {
+    StripedUnorderedMap<std::string, std::string> m{{"a", "1"}};
+    ASSERT_FALSE(m.insert_or_assign("a", "2"));
+    ASSERT_TRUE(m.insert_or_assign("b", "3"));
+    ASSERT_EQ("2", m.at("a"));
+    ASSERT_TRUE(m.emplace("c", "4"));
+    ASSERT_FALSE(m.emplace("c", "5"));
+    ASSERT_TRUE(m.try_emplace("d", 3, 'x'));
+    ASSERT_EQ("xxx", m.at("d"));
+    ASSERT_EQ("", m["e"]);
+    ASSERT_EQ(5, m.size());
+
+    std::unordered_map<std::string, std::string> source{{"a", "9"}, {"f", "6"}};
+    m.merge(source);
+    ASSERT_EQ("2", m.at("a"));
+    ASSERT_EQ("6", m.at("f"));
+    ASSERT_EQ(1, source.size());
+
+    std::unordered_map<std::string, std::string> replacement{{"z", "26"}};
+    m.swap(replacement);
+    ASSERT_EQ(1, m.size());
+    ASSERT_EQ(6, replacement.size());
+    ASSERT_EQ("26", m.at("z"));
+
+    m.clear();
+    ASSERT_TRUE(m.empty());
+    ASSERT_FALSE(m.find("z"));
+  }
+
+  TEST_F(StripedUnorderedMapTests, CopyMoveAndSwap) {
+    StripedUnorderedMap<int, int> m;
+    for (int i = 0; i < 1'000; ++i) {
+      m.insert({i, i});
+    }
+    auto copy = m;
+    ASSERT_EQ(m, copy);
+    auto moved = std::move(copy);
+    ASSERT_EQ(m, moved);
+    ASSERT_TRUE(copy.empty());
+    copy.insert({1, 1});
+    ASSERT_TRUE(copy.find(1));
+
+    StripedUnorderedMap<int, int> other{{-1, -1}};
+    swap(moved, other);
+    ASSERT_EQ(1, moved.size());
+    ASSERT_EQ(m, other);
+    ASSERT_EQ(m.data(), other.data());
+    ASSERT_EQ(1'000, m.freeze().size());
+  }
+
+  TEST_F(StripedUnorderedMapTests, ReserveAvoidsRehash) {
+    StripedUnorderedMap<int, int, std::hash<int>, std::equal_to<int>, std::allocator<std::pair<const int, int>>, 4> m;
+    ASSERT_EQ(4, m.stripe_count());
+    m.reserve(4'000);
+    auto const buckets = m.bucket_count();
+    ASSERT_GE(buckets, 4'000);
+    for (int i = 0; i < 2'000; ++i) {
+      m.insert({i, i});
+    }
+    ASSERT_EQ(buckets, m.bucket_count());
+    m.rehash(buckets * 4);
+    ASSERT_EQ(buckets * 4, m.bucket_count());
+    for (int i = 0; i < 2'000; ++i) {
+      ASSERT_TRUE(m.find(i));
+    }
+  }
+
+  TEST_F(StripedUnorderedMapTests, MaxLoadFactorMustBePositive) {
+    StripedUnorderedMap<int, int> m{{1, 1}, {2, 2}};
+    auto const previous = m.max_load_factor();
+    ASSERT_THROW(m.max_load_factor(0.0f), std::invalid_argument);
+    ASSERT_THROW(m.max_load_factor(-1.0f), std::invalid_argument);
+    ASSERT_EQ(previous, m.max_load_factor());
+    m.max_load_factor(0.25f);
+    ASSERT_EQ(0.25f, m.max_load_factor());
+    ASSERT_LE(m.load_factor(), 0.25f);
+    ASSERT_EQ(2, m.at(2));
+  }
+
+  // Writers insert disjoint keys concurrently, forcing several resizes along the way,
+  // while readers look up keys that are present throughout.
+  TEST_F(StripedUnorderedMapTests, ConcurrentWritersAndResize) {
+    StripedUnorderedMap<int, int> m;
+    constexpr int per_thread = 5'000;
+    constexpr int writers    = 4;
+    for (int i = 0; i < 100; ++i) {
+      m.insert({-1 - i, i});
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < writers; ++t) {
+      threads.emplace_back([&m, t]() {
+        for (int i = 0; i < per_thread; ++i) {
+          m.insert({t * per_thread + i, i});
+          if (i % 4 == 0) m.erase(t * per_thread + i);
+        }
+      });
+    }
+    threads.emplace_back([&m]() {
+      for (int round = 0; round < 50; ++round) {
+        for (int i = 0; i < 100; ++i) {
+          ASSERT_TRUE(m.find(-1 - i));
+        }
+      }
+    });
+    for (auto &th: threads) {
+      th.join();
+    }
+    ASSERT_EQ(100 + writers * per_thread * 3 / 4, m.size());
+    for (int t = 0; t < writers; ++t) {
+      for (int i = 0; i < per_thread; ++i) {
+        ASSERT_EQ(i % 4 != 0, m.find(t * per_thread + i));
+      }
+    }
+  }
+
+} // namespace
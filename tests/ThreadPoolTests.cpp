@@ -0,0 +1,184 @@
+#include <concurrency/ShardedUnorderedMap.hpp>
+#include <concurrency/ThreadPool.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+  using ::concurrency::ShardedUnorderedMap;
+  using ::concurrency::ThreadPool;
+  using ::concurrency::detail::WorkStealingDeque;
+
+  TEST(ThreadPoolTests, DequeIsLifoForOwnerAndFifoForThieves) {
+    WorkStealingDeque<int> d(2);
+    ASSERT_TRUE(d.empty());
+    for (int i = 0; i < 10; ++i) {
+      d.push(i);
+    }
+    int value = -1;
+    ASSERT_TRUE(d.steal(value));
+    ASSERT_EQ(0, value);
+    ASSERT_TRUE(d.take(value));
+    ASSERT_EQ(9, value);
+    for (int i = 8; i >= 1; --i) {
+      ASSERT_TRUE(d.take(value));
+      ASSERT_EQ(i, value);
+    }
+    ASSERT_FALSE(d.take(value));
+    ASSERT_FALSE(d.steal(value));
+    ASSERT_TRUE(d.empty());
+  }
+
+  // Every pushed element must come out exactly once, whether the owner takes it or a
+  // thief steals it, while the buffer grows under the thieves.
+  TEST(ThreadPoolTests, DequeElementsAreTakenOrStolenOnce) {
+    constexpr int total = 50'000;
+    WorkStealingDeque<int> d(2);
+    std::vector<std::atomic<int>> seen(total);
+    std::atomic<bool> done{false};
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < 3; ++t) {
+      thieves.emplace_back([&]() {
+        int value;
+        while (!done.load() || !d.empty()) {
+          if (d.steal(value)) seen[value].fetch_add(1);
+        }
+      });
+    }
+    int value;
+    for (int i = 0; i < total; ++i) {
+      d.push(i);
+      if (i % 3 == 0 && d.take(value)) seen[value].fetch_add(1);
+    }
+    while (d.take(value)) {
+      seen[value].fetch_add(1);
+    }
+    done.store(true);
+    for (auto &t: thieves) {
+      t.join();
+    }
+    for (int i = 0; i < total; ++i) {
+      ASSERT_EQ(1, seen[i].load()) << i;
+    }
+  }
+
+  TEST(ThreadPoolTests, SubmitReturnsResultsAndExceptions) {
+    ThreadPool pool(2);
+    ASSERT_EQ(2, pool.thread_count());
+    auto sum   = pool.submit([]() { return 40 + 2; });
+    auto text  = pool.submit([s = std::string("moved")]() { return s; });
+    auto error = pool.submit([]() -> int { throw std::runtime_error("boom"); });
+    ASSERT_EQ(42, sum.get());
+    ASSERT_EQ("moved", text.get());
+    ASSERT_THROW(error.get(), std::runtime_error);
+  }
+
+  TEST(ThreadPoolTests, PostAcceptsLvalueCallables) {
+    std::atomic<int> count{0};
+    {
+      ThreadPool pool(2);
+      auto increment = [&count]() { count.fetch_add(1); };
+      for (int i = 0; i < 100; ++i) {
+        pool.post(increment);
+      }
+    }
+    ASSERT_EQ(100, count.load());
+  }
+
+  TEST(ThreadPoolTests, DestructorRunsTasksSpawnedByTasks) {
+    std::atomic<int> count{0};
+    {
+      ThreadPool pool(3);
+      for (int i = 0; i < 10; ++i) {
+        pool.post([&pool, &count]() {
+          for (int j = 0; j < 10; ++j) {
+            pool.post([&count]() { count.fetch_add(1); });
+          }
+        });
+      }
+    }
+    ASSERT_EQ(100, count.load());
+  }
+
+  TEST(ThreadPoolTests, ParallelForVisitsEveryIndexOnce) {
+    ThreadPool pool(4);
+    for (int64_t grain: {0, 1, 7, 1000}) {
+      std::vector<std::atomic<int>> seen(1000);
+      pool.parallel_for(int64_t{0}, int64_t{1000}, [&seen](int64_t i) { seen[i].fetch_add(1); }, grain);
+      for (std::size_t i = 0; i < seen.size(); ++i) {
+        ASSERT_EQ(1, seen[i].load()) << "grain " << grain << ", index " << i;
+      }
+    }
+    bool called = false;
+    pool.parallel_for(5, 5, [&called](int) { called = true; });
+    ASSERT_FALSE(called);
+  }
+
+  TEST(ThreadPoolTests, ParallelForCanBeNested) {
+    ThreadPool pool(2);
+    std::atomic<int> count{0};
+    pool.parallel_for(0, 16, [&](int) { pool.parallel_for(0, 16, [&count](int) { count.fetch_add(1); }, 1); }, 1);
+    ASSERT_EQ(256, count.load());
+  }
+
+  TEST(ThreadPoolTests, ParallelForRethrowsAfterAllChunksFinish) {
+    ThreadPool pool(4);
+    std::atomic<int> count{0};
+    ASSERT_THROW(pool.parallel_for(0, 100,
+                                   [&count](int i) {
+                                     count.fetch_add(1);
+                                     if (i == 50) throw std::logic_error("fifty");
+                                   },
+                                   1),
+                 std::logic_error);
+    ASSERT_EQ(100, count.load());
+  }
+
+  TEST(ThreadPoolTests, ManySubmittersAndPinnedThreads) {
+    ThreadPool pool(4, true);
+    std::atomic<int> count{0};
+    std::vector<std::thread> submitters;
+    for (int t = 0; t < 4; ++t) {
+      submitters.emplace_back([&pool, &count]() {
+        std::vector<std::future<void>> futures;
+        for (int i = 0; i < 2000; ++i) {
+          futures.push_back(pool.submit([&count]() { count.fetch_add(1); }));
+        }
+        for (auto &f: futures) {
+          f.get();
+        }
+      });
+    }
+    for (auto &t: submitters) {
+      t.join();
+    }
+    ASSERT_EQ(8000, count.load());
+  }
+
+  TEST(ThreadPoolTests, ShardedMapBulkOperationsAcceptExecutor) {
+    ThreadPool pool(4);
+    ShardedUnorderedMap<int, int> m;
+    m.reserve(1000, pool);
+    std::vector<std::pair<int, int>> in;
+    for (int i = 0; i < 1000; ++i) {
+      in.emplace_back(i, i);
+    }
+    m.insert_or_assign_many(in.begin(), in.end(), pool);
+    ASSERT_EQ(1000, m.size());
+    m.upsert_many(in.begin(), in.end(), [](const int &existing, const int &value) { return existing + value; }, pool);
+    m.rehash(4096, pool);
+    auto data = m.data(pool);
+    ASSERT_EQ(1000, data.size());
+    for (int i = 0; i < 1000; ++i) {
+      ASSERT_EQ(2 * i, data.at(i));
+    }
+    ASSERT_EQ(m.data(), data);
+  }
+
+} // namespace
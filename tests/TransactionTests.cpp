@@ -0,0 +1,103 @@
+#include <concurrency/ShardedUnorderedMap.hpp>
+#include <gtest/gtest.h>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  using ::concurrency::ShardedUnorderedMap;
+  using ::concurrency::UnorderedMap;
+
+  class TransactionTests : public ::testing::Test {};
+
+  TEST_F(TransactionTests, WriteViewGivesReferencesUnderLock) {
+    UnorderedMap<std::string, int> m{{"a", 1}};
+    m.enable_bloom_filter();
+    {
+      auto view = m.lock();
+      ASSERT_EQ(1, view.size());
+      view.at("a") += 10;
+      ASSERT_EQ(nullptr, view.find("b"));
+      ASSERT_TRUE(view.try_emplace("b", 2));
+      ASSERT_FALSE(view.try_emplace("b", 3));
+      ASSERT_FALSE(view.insert_or_assign("a", 12));
+      ASSERT_EQ(1, view.erase("b"));
+      ASSERT_FALSE(view.contains("b"));
+      ASSERT_THROW((void) view.at("b"), std::out_of_range);
+      ASSERT_TRUE(view.insert_or_assign("c", 3));
+    }
+    ASSERT_EQ(12, m.at("a"));
+    ASSERT_FALSE(m.find("b"));
+    ASSERT_TRUE(m.find("c"));
+  }
+
+  TEST_F(TransactionTests, MovesValueBetweenKeys) {
+    ShardedUnorderedMap<std::string, int, 8> m{{"from", 5}};
+    auto const moved = m.transaction({"from", "to"}, [](auto &tx) {
+      auto *value = tx.find("from");
+      if (value == nullptr) return false;
+      (void) tx.insert_or_assign("to", *value);
+      return tx.erase("from") == 1;
+    });
+    ASSERT_TRUE(moved);
+    ASSERT_FALSE(m.find("from"));
+    ASSERT_EQ(5, m.at("to"));
+  }
+
+  TEST_F(TransactionTests, KeysSharingAShardLockItOnce) {
+    ShardedUnorderedMap<int, int, 1> m;
+    m.transaction({1, 2, 3}, [](auto &tx) {
+      for (int k = 1; k <= 3; ++k) {
+        (void) tx.try_emplace(k, k);
+      }
+    });
+    ASSERT_EQ(3, m.size());
+  }
+
+  TEST_F(TransactionTests, UndeclaredKeysAreRejected) {
+    ShardedUnorderedMap<int, int, 4> m;
+    ASSERT_THROW(m.transaction({0}, [](auto &tx) { (void) tx.try_emplace(1, 1); }), std::invalid_argument);
+    // The locks must have been released by the exception.
+    ASSERT_TRUE(m.insert({0, 0}));
+    ASSERT_EQ(1, m.size());
+  }
+
+  // Transfers between random accounts must preserve the total, and concurrent transactions
+  // over overlapping shards must not deadlock.
+  TEST_F(TransactionTests, ConcurrentTransfersPreserveTotal) {
+    constexpr int accounts = 64;
+    ShardedUnorderedMap<int, int, 8> m;
+    for (int i = 0; i < accounts; ++i) {
+      (void) m.insert({i, 100});
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&m, t]() {
+        for (int i = 0; i < 5000; ++i) {
+          int const from = (i * 7 + t) % accounts;
+          int const to   = (i * 13 + t * 5 + 1) % accounts;
+          std::vector<int> keys{to, from};
+          m.transaction(keys.begin(), keys.end(), [from, to](auto &tx) {
+            if (from == to || tx.at(from) == 0) return;
+            --tx.at(from);
+            ++tx.at(to);
+          });
+        }
+      });
+    }
+    int total = 0;
+    for (int i = 0; i < 100; ++i) {
+      total = m.transaction({0, 1}, [](auto &tx) { return tx.at(0) + tx.at(1); });
+      ASSERT_GE(total, 0);
+    }
+    for (auto &t: threads) {
+      t.join();
+    }
+    auto const data = m.data();
+    total           = std::accumulate(data.begin(), data.end(), 0, [](int sum, auto const &el) { return sum + el.second; });
+    ASSERT_EQ(accounts * 100, total);
+  }
+
+} // namespace
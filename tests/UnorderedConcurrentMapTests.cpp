@@ -6,6 +6,8 @@
 #include <type_traits>
 
 namespace {
+  using ::concurrency::FlatUnorderedMap;
+  using ::concurrency::ShardedFlatUnorderedMap;
   using ::concurrency::ShardedUnorderedMap;
   using ::concurrency::UnorderedMap;
 
@@ -272,8 +274,8 @@ namespace {
     // insert_or_assign(Key &&k, M &&obj)
     {
       map_type m;
-      key_type k;
-      mapped_type v;
+      key_type k{};
+      mapped_type v{};
 
       ASSERT_TRUE(m.empty());
       ASSERT_TRUE(m.insert_or_assign(std::move(k), std::move(v)));
@@ -782,7 +784,14 @@ namespace {
       ShardedUnorderedMap<int32_t, std::string>,                                               //
       ShardedUnorderedMap<int64_t, std::string>,                                               //
       ShardedUnorderedMap<Foo, int16_t, ::concurrency::DefaultUnorderedMapShardCount, FooHash>, //
-      ShardedUnorderedMap<int16_t, Foo>>;                                                      //
+      ShardedUnorderedMap<int16_t, Foo>,                                                       //
+      FlatUnorderedMap<std::string, uint32_t>,                                                 //
+      FlatUnorderedMap<int32_t, std::string>,                                                  //
+      FlatUnorderedMap<Foo, int16_t, FooHash>,                                                 //
+      FlatUnorderedMap<int16_t, Foo>,                                                          //
+      ShardedFlatUnorderedMap<std::string, std::string>,                                       //
+      ShardedFlatUnorderedMap<int64_t, size_t>,                                                //
+      ShardedFlatUnorderedMap<int16_t, Foo>>;                                                  //
 
   INSTANTIATE_TYPED_TEST_SUITE_P(TypedTests, CommonConcurrentUnorderedMapTests, Types);
 
@@ -0,0 +1,133 @@
+#include <concurrency/ShardedUnorderedMultimap.hpp>
+#include <concurrency/UnorderedMultimap.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+  using ::concurrency::ShardedUnorderedMultimap;
+  using ::concurrency::UnorderedMultimap;
+
+  template <typename map_type>
+  class UnorderedMultimapTests : public ::testing::Test {};
+
+  using MultimapTypes = ::testing::Types<UnorderedMultimap<std::string, int>, ShardedUnorderedMultimap<std::string, int>, ShardedUnorderedMultimap<std::string, int, 3>>;
+  TYPED_TEST_SUITE(UnorderedMultimapTests, MultimapTypes);
+
+  template <typename map_type>
+  std::vector<int> values_of(const map_type &m, const std::string &key) {
+    std::vector<int> values;
+    auto n = m.visit_all(key, [&values](const int &v) { values.push_back(v); });
+    EXPECT_EQ(n, values.size());
+    std::sort(values.begin(), values.end());
+    return values;
+  }
+
+  TYPED_TEST(UnorderedMultimapTests, InsertCountFind) {
+    TypeParam m{{"tag", 1}, {"tag", 2}, {"other", 3}};
+    m.insert({"tag", 2});
+    m.insert(std::make_pair(std::string("tag"), 4));
+    m.emplace("other", 5);
+    ASSERT_EQ(6, m.size());
+    ASSERT_EQ(4, m.count("tag"));
+    ASSERT_EQ(2, m.count("other"));
+    ASSERT_EQ(0, m.count("missing"));
+    ASSERT_TRUE(m.find("tag"));
+    ASSERT_TRUE(m.contains("other"));
+    ASSERT_FALSE(m.find("missing"));
+  }
+
+  TYPED_TEST(UnorderedMultimapTests, VisitAllSeesEveryValue) {
+    TypeParam m;
+    std::vector<std::pair<std::string, int>> elements;
+    for (int i = 0; i < 100; ++i) {
+      elements.emplace_back(std::to_string(i % 7), i);
+    }
+    m.insert(elements.begin(), elements.end());
+    ASSERT_EQ(100, m.size());
+    auto values = values_of(m, "3");
+    ASSERT_EQ(14, values.size());
+    for (std::size_t j = 0; j < values.size(); ++j) {
+      ASSERT_EQ(static_cast<int>(3 + 7 * j), values[j]);
+    }
+    ASSERT_EQ(0, m.visit_all("missing", [](const int &) { FAIL(); }));
+  }
+
+  TYPED_TEST(UnorderedMultimapTests, EraseAndEraseOne) {
+    TypeParam m{{"tag", 1}, {"tag", 2}, {"tag", 2}, {"other", 3}};
+    ASSERT_TRUE(m.erase_one("tag", [](const int &v) { return v == 2; }));
+    ASSERT_EQ((std::vector<int>{1, 2}), values_of(m, "tag"));
+    ASSERT_FALSE(m.erase_one("tag", [](const int &v) { return v == 5; }));
+    ASSERT_FALSE(m.erase_one("missing", [](const int &) { return true; }));
+    ASSERT_EQ(2, m.erase("tag"));
+    ASSERT_EQ(0, m.erase("tag"));
+    ASSERT_EQ(1, m.size());
+    m.clear();
+    ASSERT_TRUE(m.empty());
+  }
+
+  TYPED_TEST(UnorderedMultimapTests, ExtractAndMerge) {
+    TypeParam m{{"tag", 1}, {"tag", 2}};
+    auto nh = m.extract("tag");
+    ASSERT_FALSE(nh.empty());
+    ASSERT_EQ(1, m.count("tag"));
+    m.insert(std::move(nh));
+    ASSERT_EQ(2, m.count("tag"));
+    std::unordered_multimap<std::string, int> source{{"tag", 3}, {"new", 4}, {"new", 5}};
+    m.merge(source);
+    ASSERT_TRUE(source.empty());
+    ASSERT_EQ(3, m.count("tag"));
+    ASSERT_EQ(2, m.count("new"));
+  }
+
+  TYPED_TEST(UnorderedMultimapTests, CopySwapAndEquality) {
+    TypeParam m1{{"a", 1}, {"a", 2}};
+    TypeParam m2(m1);
+    ASSERT_TRUE(m1 == m2);
+    m2.insert({"b", 3});
+    ASSERT_TRUE(m1 != m2);
+    swap(m1, m2);
+    ASSERT_EQ(3, m1.size());
+    ASSERT_EQ(2, m2.size());
+    auto data = m1.data();
+    ASSERT_EQ(2, data.count("a"));
+    ASSERT_EQ(1, data.count("b"));
+  }
+
+  TYPED_TEST(UnorderedMultimapTests, ConcurrentIndexUpdates) {
+    TypeParam m;
+    constexpr int thread_count = 4;
+    constexpr int per_thread   = 500;
+    std::atomic<bool> stop{false};
+    std::thread reader([&]() {
+      while (!stop.load()) {
+        (void) m.visit_all("tag", [](const int &v) { ASSERT_GE(v, 0); });
+      }
+    });
+    std::vector<std::thread> writers;
+    for (int t = 0; t < thread_count; ++t) {
+      writers.emplace_back([&m, t]() {
+        for (int i = 0; i < per_thread; ++i) {
+          m.insert({"tag", t * per_thread + i});
+          m.insert({std::to_string(i % 10), i});
+        }
+        for (int i = 0; i < per_thread; i += 2) {
+          ASSERT_TRUE(m.erase_one("tag", [v = t * per_thread + i](const int &x) { return x == v; }));
+        }
+      });
+    }
+    for (auto &w: writers) {
+      w.join();
+    }
+    stop.store(true);
+    reader.join();
+    ASSERT_EQ(thread_count * per_thread / 2, m.count("tag"));
+    ASSERT_EQ(thread_count * per_thread / 10, m.count("7"));
+  }
+
+} // namespace
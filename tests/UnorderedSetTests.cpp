@@ -0,0 +1,106 @@
+#include <concurrency/ShardedUnorderedSet.hpp>
+#include <concurrency/UnorderedSet.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+  using ::concurrency::ShardedUnorderedSet;
+  using ::concurrency::UnorderedSet;
+
+  template <typename set_type>
+  class UnorderedSetTests : public ::testing::Test {};
+
+  using SetTypes = ::testing::Types<UnorderedSet<std::string>, ShardedUnorderedSet<std::string>, ShardedUnorderedSet<std::string, 3>>;
+  TYPED_TEST_SUITE(UnorderedSetTests, SetTypes);
+
+  TYPED_TEST(UnorderedSetTests, InsertFindErase) {
+    TypeParam s{"foo", "bar"};
+    ASSERT_EQ(2, s.size());
+    ASSERT_TRUE(s.insert("baz"));
+    ASSERT_FALSE(s.insert("foo"));
+    ASSERT_TRUE(s.emplace(3, 'q'));
+    ASSERT_TRUE(s.find("qqq"));
+    ASSERT_TRUE(s.contains("baz"));
+    ASSERT_EQ(1, s.count("bar"));
+    ASSERT_EQ(1, s.erase("bar"));
+    ASSERT_EQ(0, s.erase("bar"));
+    ASSERT_FALSE(s.find("bar"));
+    ASSERT_EQ(3, s.size());
+    s.clear();
+    ASSERT_TRUE(s.empty());
+  }
+
+  TYPED_TEST(UnorderedSetTests, InsertMany) {
+    TypeParam s{"a"};
+    std::vector<std::string> keys{"a", "b", "c", "b", "d"};
+    ASSERT_EQ(3, s.insert_many(keys.begin(), keys.end()));
+    ASSERT_EQ(4, s.size());
+    ASSERT_EQ(0, s.insert_many(keys.begin(), keys.end()));
+  }
+
+  TYPED_TEST(UnorderedSetTests, ContainsManyPreservesOrder) {
+    TypeParam s;
+    std::vector<std::string> present;
+    for (int i = 0; i < 100; i += 2) {
+      present.push_back(std::to_string(i));
+    }
+    s.insert(present.begin(), present.end());
+    std::vector<std::string> queries;
+    for (int i = 0; i < 100; ++i) {
+      queries.push_back(std::to_string(i));
+    }
+    std::vector<bool> found(queries.size());
+    auto end = s.contains_many(queries.begin(), queries.end(), found.begin());
+    ASSERT_EQ(found.end(), end);
+    for (int i = 0; i < 100; ++i) {
+      ASSERT_EQ(i % 2 == 0, found[i]) << i;
+    }
+  }
+
+  TYPED_TEST(UnorderedSetTests, CopySwapMergeAndExtract) {
+    TypeParam s{"foo", "bar"};
+    TypeParam copy = s;
+    ASSERT_TRUE(copy == s);
+    TypeParam other{"baz"};
+    s.swap(other);
+    ASSERT_TRUE(s.find("baz"));
+    ASSERT_FALSE(s.find("foo"));
+    auto nh = other.extract("foo");
+    ASSERT_FALSE(nh.empty());
+    ASSERT_TRUE(s.insert(std::move(nh)));
+    ASSERT_EQ(1, other.size());
+    typename TypeParam::internal_set_type source{"foo", "qux"};
+    s.merge(source);
+    ASSERT_EQ(3, s.size());
+    ASSERT_EQ(1, source.size());
+    ASSERT_TRUE(source.count("foo"));
+    ASSERT_TRUE(s != copy);
+  }
+
+  TYPED_TEST(UnorderedSetTests, ConcurrentInsertMany) {
+    TypeParam s;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+      workers.emplace_back([&s]() {
+        std::vector<std::string> keys;
+        for (int i = 0; i < 1'000; ++i) {
+          keys.push_back(std::to_string(i));
+        }
+        (void) s.insert_many(keys.begin(), keys.end());
+        std::vector<char> found(keys.size());
+        s.contains_many(keys.begin(), keys.end(), found.begin());
+        for (auto f: found) {
+          ASSERT_TRUE(f);
+        }
+      });
+    }
+    for (auto &w: workers) {
+      w.join();
+    }
+    ASSERT_EQ(1'000, s.size());
+  }
+
+} // namespace
@@ -0,0 +1,158 @@
+#include <concurrency/ShardedUnorderedMap.hpp>
+#include <concurrency/UnorderedMap.hpp>
+#include <gtest/gtest.h>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace {
+  using ::concurrency::ShardedUnorderedMap;
+  using ::concurrency::UnorderedMap;
+
+  template <class T>
+  class VersionedUpdateTests : public ::testing::Test {};
+
+  using MapTypes = ::testing::Types<UnorderedMap<int, std::string>, ShardedUnorderedMap<int, std::string, 4>>;
+  TYPED_TEST_SUITE(VersionedUpdateTests, MapTypes);
+
+  TYPED_TEST(VersionedUpdateTests, CompareExchange) {
+    TypeParam m{{1, "one"}};
+    std::string expected = "uno";
+    ASSERT_FALSE(m.compare_exchange(1, expected, "eins"));
+    ASSERT_EQ("one", expected);
+    ASSERT_TRUE(m.compare_exchange(1, expected, "eins"));
+    ASSERT_EQ("eins", m.at(1));
+    expected = "two";
+    ASSERT_FALSE(m.compare_exchange(2, expected, "zwei"));
+    ASSERT_EQ("two", expected);
+    ASSERT_FALSE(m.find(2));
+  }
+
+  TYPED_TEST(VersionedUpdateTests, VersioningMustBeEnabled) {
+    TypeParam m{{1, "one"}};
+    ASSERT_FALSE(m.versioning_enabled());
+    ASSERT_THROW((void) m.find_versioned(1), std::logic_error);
+    ASSERT_THROW((void) m.update_if_version(1, 0, "uno"), std::logic_error);
+    m.enable_versioning();
+    ASSERT_TRUE(m.versioning_enabled());
+    ASSERT_TRUE(m.find_versioned(1).has_value());
+    ASSERT_FALSE(m.find_versioned(2).has_value());
+  }
+
+  TYPED_TEST(VersionedUpdateTests, UpdateFailsAfterInterveningWrites) {
+    TypeParam m{{1, "one"}};
+    m.enable_versioning();
+    auto read = m.find_versioned(1);
+    ASSERT_EQ("one", read->value);
+    ASSERT_TRUE(m.update_if_version(1, read->version, "uno"));
+    ASSERT_FALSE(m.update_if_version(1, read->version, "eins"));
+    ASSERT_EQ("uno", m.at(1));
+
+    // Every kind of write to the key must invalidate a version read before it.
+    std::vector<std::function<void(TypeParam &)>> writes{
+        [](TypeParam &m) { (void) m.insert_or_assign(1, "a"); },
+        [](TypeParam &m) { (void) m.upsert(1, "b", [](const std::string &x, const std::string &y) { return x + y; }); },
+        [](TypeParam &m) {
+          std::string expected = m.at(1);
+          (void) m.compare_exchange(1, expected, "c");
+        },
+        [](TypeParam &m) {
+          (void) m.erase(1);
+          (void) m.insert({1, "d"});
+        },
+        [](TypeParam &m) {
+          auto nh = m.extract(1);
+          (void) m.insert(std::move(nh));
+        },
+        [](TypeParam &m) {
+          m.clear();
+          (void) m.insert({1, "e"});
+        },
+    };
+    for (std::size_t i = 0; i < writes.size(); ++i) {
+      read = m.find_versioned(1);
+      ASSERT_TRUE(read.has_value()) << i;
+      writes[i](m);
+      ASSERT_FALSE(m.update_if_version(1, read->version, "stale")) << i;
+      ASSERT_NE("stale", m.at(1)) << i;
+    }
+  }
+
+  TYPED_TEST(VersionedUpdateTests, WriteViewAndTransactionsAdvanceVersions) {
+    TypeParam m{{1, "one"}};
+    m.enable_versioning();
+    auto read = m.find_versioned(1);
+    if constexpr (std::is_same_v<TypeParam, UnorderedMap<int, std::string>>) {
+      auto view  = m.lock();
+      view.at(1) = "uno";
+    } else {
+      m.transaction({1}, [](auto &tx) { tx.at(1) = "uno"; });
+    }
+    ASSERT_FALSE(m.update_if_version(1, read->version, "stale"));
+    ASSERT_EQ("uno", m.at(1));
+  }
+
+  TYPED_TEST(VersionedUpdateTests, FailedInsertsKeepVersions) {
+    TypeParam m{{1, "one"}};
+    m.enable_versioning();
+    auto read = m.find_versioned(1);
+    ASSERT_FALSE(m.insert({1, "eins"}));
+    if constexpr (std::is_same_v<TypeParam, UnorderedMap<int, std::string>>) {
+      ASSERT_FALSE(m.emplace(1, "eins"));
+      ASSERT_FALSE(m.try_emplace(1, "eins"));
+    }
+    ASSERT_TRUE(m.update_if_version(1, read->version, "uno"));
+
+    // insert_or_assign() writes the element even when it does not insert one.
+    read = m.find_versioned(1);
+    ASSERT_FALSE(m.insert_or_assign(1, "eins"));
+    ASSERT_FALSE(m.update_if_version(1, read->version, "stale"));
+    ASSERT_EQ("eins", m.at(1));
+  }
+
+  TYPED_TEST(VersionedUpdateTests, CopiesKeepVersioningEnabled) {
+    TypeParam m{{1, "one"}};
+    m.enable_versioning();
+    TypeParam copy(m);
+    ASSERT_TRUE(copy.versioning_enabled());
+    auto read = copy.find_versioned(1);
+    ASSERT_TRUE(copy.update_if_version(1, read->version, "uno"));
+  }
+
+  // Optimistic increments with retries from several threads must not lose updates.
+  TYPED_TEST(VersionedUpdateTests, ConcurrentOptimisticIncrements) {
+    TypeParam m;
+    m.enable_versioning();
+    for (int k = 0; k < 4; ++k) {
+      (void) m.insert({k, "0"});
+    }
+    constexpr int thread_count = 4;
+    constexpr int per_thread   = 500;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+      threads.emplace_back([&m]() {
+        for (int i = 0; i < per_thread; ++i) {
+          while (true) {
+            auto read = m.find_versioned(i % 4);
+            if (m.update_if_version(i % 4, read->version, std::to_string(std::stoi(read->value) + 1))) break;
+          }
+          std::string expected = m.at(i % 4);
+          while (!m.compare_exchange(i % 4, expected, std::to_string(std::stoi(expected) + 1))) {
+          }
+        }
+      });
+    }
+    for (auto &t: threads) {
+      t.join();
+    }
+    int total = 0;
+    for (int k = 0; k < 4; ++k) {
+      total += std::stoi(m.at(k));
+    }
+    ASSERT_EQ(2 * thread_count * per_thread, total);
+  }
+
+} // namespace
@@ -0,0 +1,116 @@
+#include <concurrency/InMemoryStore.hpp>
+#include <concurrency/WriteBehindCache.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  using ::concurrency::InMemoryStore;
+  using ::concurrency::WriteBehindCache;
+  using namespace std::chrono_literals;
+
+  using Store = InMemoryStore<int, std::string>;
+  using Cache = WriteBehindCache<int, std::string, Store, 4>;
+
+  class WriteBehindCacheTests : public ::testing::Test {};
+
+  TEST_F(WriteBehindCacheTests, ReadsThroughToTheStore) {
+    Store store;
+    store.seed(1, "one");
+    Cache cache(store);
+    ASSERT_FALSE(cache.cached(1));
+    ASSERT_EQ("one", cache.get(1));
+    ASSERT_EQ("one", cache.get(1));
+    ASSERT_TRUE(cache.cached(1));
+    ASSERT_EQ(1, store.loads());
+    ASSERT_THROW(cache.get(2), std::out_of_range);
+    ASSERT_THROW(cache.get(2), std::out_of_range);
+    ASSERT_EQ(3, store.loads());
+  }
+
+  TEST_F(WriteBehindCacheTests, ConcurrentMissesLoadOnce) {
+    Store store(20ms);
+    store.seed(1, "one");
+    Cache cache(store);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 8; ++t) {
+      workers.emplace_back([&cache]() { ASSERT_EQ("one", cache.get(1)); });
+    }
+    for (auto &w: workers) {
+      w.join();
+    }
+    ASSERT_EQ(1, store.loads());
+  }
+
+  TEST_F(WriteBehindCacheTests, WritesAreCoalescedAndBatched) {
+    Store store;
+    Cache cache(store, 1'000, 1h);
+    for (int i = 0; i < 100; ++i) {
+      cache.put(i % 10, std::to_string(i));
+    }
+    ASSERT_EQ("99", cache.get(9));
+    ASSERT_EQ(0, store.loads());
+    ASSERT_EQ(10, cache.dirty());
+    cache.flush();
+    ASSERT_EQ(0, cache.dirty());
+    ASSERT_EQ(10, store.writes());
+    ASSERT_LE(store.batches(), 4);
+    ASSERT_EQ("95", store.data().at(5));
+  }
+
+  TEST_F(WriteBehindCacheTests, BackgroundWriterFlushes) {
+    Store store;
+    {
+      Cache cache(store, 1'000, 1ms);
+      cache.put(1, "one");
+      for (int i = 0; i < 1'000 && cache.dirty() != 0; ++i) {
+        std::this_thread::sleep_for(1ms);
+      }
+      ASSERT_EQ(0, cache.dirty());
+      ASSERT_EQ("one", store.data().at(1));
+      cache.put(2, "two");
+    }
+    // Destruction flushes the remaining writes.
+    ASSERT_EQ("two", store.data().at(2));
+  }
+
+  TEST_F(WriteBehindCacheTests, FailedWritesAreRetried) {
+    Store store;
+    Cache cache(store, 1'000, 1h);
+    store.fail_writes(true);
+    cache.put(1, "one");
+    ASSERT_THROW(cache.flush(), std::runtime_error);
+    ASSERT_EQ(1, cache.dirty());
+    cache.put(1, "uno");
+    store.fail_writes(false);
+    cache.flush();
+    ASSERT_EQ(0, cache.dirty());
+    ASSERT_EQ("uno", store.data().at(1));
+  }
+
+  TEST_F(WriteBehindCacheTests, FullQueuesApplyBackpressure) {
+    Store store(1ms);
+    Cache cache(store, 8, 1h);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+      workers.emplace_back([&cache, t]() {
+        for (int i = 0; i < 500; ++i) {
+          cache.put(t * 500 + i, std::to_string(i));
+          ASSERT_LE(cache.dirty(), 4 * 8);
+        }
+      });
+    }
+    for (auto &w: workers) {
+      w.join();
+    }
+    cache.flush();
+    auto const data = store.data();
+    ASSERT_EQ(2'000, data.size());
+    ASSERT_EQ("499", data.at(1'999));
+  }
+
+} // namespace